@@ -141,6 +141,7 @@ void SetCallback(Callback* const callback) {
         if (!lock.timedlock(500))   return mars::comm::ProxyInfo();
         
         if (sg_slproxycount < 3 || 5 * 1000 > gettickspan(sg_slporxytimetick)) {
+            sg_slproxyThread.pooled(true);
             sg_slproxyThread.start(boost::bind(&__GetProxyInfo, _host, sg_slporxytimetick));
         }
         
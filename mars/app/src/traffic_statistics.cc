@@ -9,9 +9,13 @@
 
 #include "traffic_statistics.h"
 
+#include <string.h>
 #include <time.h>
 
+#include <algorithm>
+
 #include "mars/app/app.h"
+#include "mars/comm/thread/atomic_oper.h"
 #include "mars/comm/thread/lock.h"
 #include "mars/comm/time_utils.h"
 #include "mars/comm/xlogger/xlogger.h"
@@ -26,8 +30,11 @@ TrafficStatistics::TrafficStatistics()
 , wifi_send_data_size_(0)
 , mobile_recv_data_size_(0)
 , mobile_send_data_size_(0)
-, last_report_time_(gettickcount())
-{}
+, cmd_data_size_(0)
+, last_report_time_((uint32_t)gettickcount())
+{
+    memset(cmd_slots_, 0, sizeof(cmd_slots_));
+}
 
 TrafficStatistics::TrafficStatistics(unsigned long _report_tmo, unsigned int _report_size_threshold)
     : report_timeout_(_report_tmo)
@@ -36,62 +43,133 @@ TrafficStatistics::TrafficStatistics(unsigned long _report_tmo, unsigned int _re
     , wifi_send_data_size_(0)
     , mobile_recv_data_size_(0)
     , mobile_send_data_size_(0)
-    , last_report_time_(gettickcount())
-{}
+    , cmd_data_size_(0)
+    , last_report_time_((uint32_t)gettickcount())
+{
+    memset(cmd_slots_, 0, sizeof(cmd_slots_));
+}
 
 TrafficStatistics::~TrafficStatistics() {
     xinfo_function();
     // Flush();
 }
 void TrafficStatistics::SetCallback(const boost::function<void (int32_t, int32_t, int32_t, int32_t)>& _func_report_flow) {
-    ScopedLock lock(mutex_);
+    ScopedLock lock(report_mutex_);
     xassert2(!func_report_flow_);
     func_report_flow_ = _func_report_flow;
 }
+void TrafficStatistics::SetCmdCallback(const boost::function<void (const std::vector<CmdTraffic>&)>& _func_report_cmd_flow) {
+    ScopedLock lock(report_mutex_);
+    xassert2(!func_report_cmd_flow_);
+    func_report_cmd_flow_ = _func_report_cmd_flow;
+}
 void TrafficStatistics::Flush() {
-    ScopedLock lock(mutex_);
+    ScopedLock lock(report_mutex_);
     __ReportData();
 }
 
 void TrafficStatistics::Data(unsigned int _send, unsigned int _recv) {
 
-    ScopedLock lock(mutex_);
+    if (0 < _send || 0 < _recv) {
+        if (kMobile != getNetInfo()) {
+            if (0 < _recv) atomic_add32(&wifi_recv_data_size_, _recv);
+            if (0 < _send) atomic_add32(&wifi_send_data_size_, _send);
+        } else {
+            if (0 < _recv) atomic_add32(&mobile_recv_data_size_, _recv);
+            if (0 < _send) atomic_add32(&mobile_send_data_size_, _send);
+        }
+    }
+
+    __MaybeReport();
+}
+
+void TrafficStatistics::CmdData(int _channel, uint32_t _cmdid, unsigned int _send, unsigned int _recv) {
+    if (kChannelShort != _channel && kChannelLong != _channel) {
+        xassert2(false, TSF"channel:%_", _channel);
+        return;
+    }
 
     if (0 < _send || 0 < _recv) {
-        if (kMobile != getNetInfo())
-            wifi_recv_data_size_ += _recv;
-        else
-            mobile_recv_data_size_ += _recv;
-
-        if (kMobile != getNetInfo())
-            wifi_send_data_size_ += _send;
-        else
-            mobile_send_data_size_ += _send;
+        CmdSlot& slot = __CmdSlot(_channel, _cmdid);
+        if (0 < _send) atomic_add32(&slot.send, _send);
+        if (0 < _recv) atomic_add32(&slot.recv, _recv);
+        atomic_add32(&cmd_data_size_, _send + _recv);
     }
 
+    __MaybeReport();
+}
+
+TrafficStatistics::CmdSlot& TrafficStatistics::__CmdSlot(int _channel, uint32_t _cmdid) {
+    CmdSlot* slots = cmd_slots_[kChannelLong == _channel ? 1 : 0];
+    if (kOtherCmdId == _cmdid) return slots[kCmdSlotCount];
+
+    uint32_t key = _cmdid + 1;
+    size_t start = (size_t)((key * 2654435761u) % kCmdSlotCount);
+
+    for (size_t i = 0; i < kCmdSlotCount; ++i) {
+        CmdSlot& slot = slots[(start + i) % kCmdSlotCount];
+        uint32_t old = atomic_read32(&slot.key);
+        if (0 == old) old = atomic_cas32(&slot.key, key, 0);
+        if (0 == old || key == old) return slot;
+    }
+
+    return slots[kCmdSlotCount];
+}
+
+void TrafficStatistics::__MaybeReport() {
+    if (!__IsShouldReport()) return;
+
+    // someone else is reporting, the bytes just added go with the next report
+    ScopedLock lock(report_mutex_, false);
+    if (!lock.trylock()) return;
+
     if (__IsShouldReport()) __ReportData();
 }
 
+static uint32_t __Take(volatile uint32_t* _counter) {
+    uint32_t old = atomic_read32(_counter);
+    uint32_t seen = 0;
+    while (old != (seen = atomic_cas32(_counter, 0, old))) old = seen;
+    return old;
+}
+
 void TrafficStatistics::__ReportData() {
+    uint32_t wifi_recv = __Take(&wifi_recv_data_size_);
+    uint32_t wifi_send = __Take(&wifi_send_data_size_);
+    uint32_t mobile_recv = __Take(&mobile_recv_data_size_);
+    uint32_t mobile_send = __Take(&mobile_send_data_size_);
+    __Take(&cmd_data_size_);
+
+    std::vector<CmdTraffic> cmd_flows;
+    for (int i = 0; i < 2; ++i) {
+        for (size_t j = 0; j <= kCmdSlotCount; ++j) {
+            CmdSlot& slot = cmd_slots_[i][j];
+            uint32_t key = atomic_read32(&slot.key);
+            if (0 == key && j < kCmdSlotCount) continue;
+
+            CmdTraffic flow = {0 == i ? kChannelShort : kChannelLong, j < kCmdSlotCount ? key - 1 : kOtherCmdId, __Take(&slot.send), __Take(&slot.recv)};
+            if (0 < flow.send || 0 < flow.recv) cmd_flows.push_back(flow);
+        }
+    }
+
     if (func_report_flow_) {
-        if (wifi_recv_data_size_>0 || wifi_send_data_size_ || mobile_recv_data_size_ || mobile_send_data_size_)
-            func_report_flow_(wifi_recv_data_size_, wifi_send_data_size_, mobile_recv_data_size_, mobile_send_data_size_);
-        xdebug2(TSF"wifi:%_, r:%_, mobile:s:%_, r:%_", wifi_send_data_size_, wifi_recv_data_size_, mobile_send_data_size_, mobile_recv_data_size_);
+        if (wifi_recv>0 || wifi_send || mobile_recv || mobile_send)
+            func_report_flow_(wifi_recv, wifi_send, mobile_recv, mobile_send);
+        xdebug2(TSF"wifi:%_, r:%_, mobile:s:%_, r:%_", wifi_send, wifi_recv, mobile_send, mobile_recv);
     } else {
-        xassert2(false, TSF"wifi:s:%_, r:%_, mobile:s:%_, r:%_", wifi_send_data_size_, wifi_recv_data_size_, mobile_send_data_size_, mobile_recv_data_size_);
+        xassert2(false, TSF"wifi:s:%_, r:%_, mobile:s:%_, r:%_", wifi_send, wifi_recv, mobile_send, mobile_recv);
     }
-    wifi_recv_data_size_ = 0;
-    wifi_send_data_size_ = 0;
-    mobile_recv_data_size_ = 0;
-    mobile_send_data_size_ = 0;
-    last_report_time_ = gettickcount();
+
+    if (func_report_cmd_flow_ && !cmd_flows.empty()) func_report_cmd_flow_(cmd_flows);
+
+    atomic_write32(&last_report_time_, (uint32_t)gettickcount());
 }
 
-bool TrafficStatistics::__IsShouldReport() const {
-    if ((gettickcount() - last_report_time_ > report_timeout_)
-            || (wifi_recv_data_size_ + wifi_send_data_size_ + mobile_recv_data_size_ + mobile_send_data_size_ > report_size_threshold_)) {
-        return true;
-    }
+bool TrafficStatistics::__IsShouldReport() {
+    if ((uint32_t)gettickcount() - atomic_read32(&last_report_time_) > report_timeout_) return true;
 
-    return false;
+    uint32_t total = atomic_read32(&wifi_recv_data_size_) + atomic_read32(&wifi_send_data_size_)
+                     + atomic_read32(&mobile_recv_data_size_) + atomic_read32(&mobile_send_data_size_);
+    // an app feeding only CmdData still reports by size
+    return std::max(total, atomic_read32(&cmd_data_size_)) > report_size_threshold_;
 }
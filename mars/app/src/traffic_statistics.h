@@ -10,6 +10,8 @@
 #ifndef STN_SRC_TRAFFIC_STATISTICS_H_
 #define STN_SRC_TRAFFIC_STATISTICS_H_
 
+#include <vector>
+
 #include "boost/signals2.hpp"
 #include "boost/function.hpp"
 
@@ -19,36 +21,72 @@
 namespace mars {
     namespace app {
 
+/*
+ * Data and CmdData are called on the io threads for every read and write, they only add to atomic counters.
+ * the counters are taken and reported by whichever caller finds a report due and gets report_mutex_ first,
+ * the others go on without waiting.
+ */
 class TrafficStatistics {
 
+  public:
+    // same values as Task::kChannelShort and Task::kChannelLong
+    static const int kChannelShort = 0x1;
+    static const int kChannelLong = 0x2;
+    // cmdid of the bytes that found no free slot in the cmdid table
+    static const uint32_t kOtherCmdId = 0xFFFFFFFF;
+
+    struct CmdTraffic {
+        int channel;
+        uint32_t cmdid;
+        uint32_t send;
+        uint32_t recv;
+    };
+
   public:
     TrafficStatistics();
     TrafficStatistics(unsigned long _report_tmo, unsigned int _report_size_threshold);
     ~TrafficStatistics();
     void Data(unsigned int _send, unsigned int _recv);
+    // attributes bytes to a channel and a cmdid, it does not add to the wifi/mobile totals Data counts
+    void CmdData(int _channel, uint32_t _cmdid, unsigned int _send, unsigned int _recv);
     void Flush();
     void SetCallback(const boost::function<void (int32_t, int32_t, int32_t, int32_t)>& _func_report_flow);
+    void SetCmdCallback(const boost::function<void (const std::vector<CmdTraffic>&)>& _func_report_cmd_flow);
   private:
 
     TrafficStatistics(const TrafficStatistics&);
     TrafficStatistics& operator=(const TrafficStatistics&);
 
   private:
+    static const size_t kCmdSlotCount = 64;  // per channel, slots stay with their cmdid once taken
+
+    struct CmdSlot {
+        volatile uint32_t key;  // cmdid + 1, 0 is a free slot
+        volatile uint32_t send;
+        volatile uint32_t recv;
+    };
+
+  private:
+    void __MaybeReport();
     void __ReportData();
-    bool __IsShouldReport() const;
+    bool __IsShouldReport();
+    CmdSlot& __CmdSlot(int _channel, uint32_t _cmdid);
 
   private:
     const unsigned long report_timeout_;
     const unsigned int report_size_threshold_;
     
     boost::function<void (int32_t wifi_recv, int32_t wifi_send, int32_t mobile_recv, int32_t mobile_send)> func_report_flow_;
+    boost::function<void (const std::vector<CmdTraffic>&)> func_report_cmd_flow_;
     
-    unsigned int wifi_recv_data_size_;
-    unsigned int wifi_send_data_size_;
-    unsigned int mobile_recv_data_size_;
-    unsigned int mobile_send_data_size_;
-    uint64_t last_report_time_;
-    Mutex mutex_;
+    volatile uint32_t wifi_recv_data_size_;
+    volatile uint32_t wifi_send_data_size_;
+    volatile uint32_t mobile_recv_data_size_;
+    volatile uint32_t mobile_send_data_size_;
+    volatile uint32_t cmd_data_size_;
+    volatile uint32_t last_report_time_;  // low 32 bits of gettickcount, differences survive the wrap
+    CmdSlot cmd_slots_[2][kCmdSlotCount + 1];  // [short, long], the extra slot is kOtherCmdId
+    Mutex report_mutex_;
 };
     }
 }
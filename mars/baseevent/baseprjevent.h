@@ -21,6 +21,7 @@
 #define BASEPRJEVENT_H_
 
 #include "boost/signals2.hpp"
+#include "comm/observer_list.h"
 
 extern boost::signals2::signal<void ()>& GetSignalOnCreate();
 extern boost::signals2::signal<void ()>& GetSignalOnDestroy();
@@ -29,6 +30,7 @@ extern boost::signals2::signal<void ()>& GetSignalOnExceptionCrash();
 extern boost::signals2::signal<void (bool _isForeground)>& GetSignalOnForeground();
 extern boost::signals2::signal<void ()>& GetSignalOnNetworkChange();
 
-extern boost::signals2::signal<void (const char* _tag, ssize_t _send, ssize_t _recv)>& GetSignalOnNetworkDataChange();
+// fired on every send and recv, so it does not lock
+extern ObserverList<void (const char* _tag, ssize_t _send, ssize_t _recv)>& GetSignalOnNetworkDataChange();
 
 #endif /* BASEPRJEVENT_H_ */
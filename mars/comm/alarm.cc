@@ -24,13 +24,9 @@
 #include "comm/thread/lock.h"
 #include "comm/time_utils.h"
 
-#include "comm/platform_comm.h"
-
 static Mutex sg_lock;
 static int64_t sg_seq = 1;
-static const MessageQueue::MessageTitle_t KALARM_MESSAGETITLE(0x1F1FF);
 
-#define MAX_LOCK_TIME (5000)
 #define INVAILD_SEQ (0)
 
 bool Alarm::Start(int _after) {
@@ -42,55 +38,24 @@ bool Alarm::Start(int _after) {
 
     int64_t seq = sg_seq++;
     uint64_t starttime = gettickcount();
-    broadcast_msg_id_ = MessageQueue::BroadcastMessage(MessageQueue::GetDefMessageQueue(), MessageQueue::Message(KALARM_MESSAGETITLE, (int64_t)seq, 1, "Alarm.broadcast"), MessageQueue::MessageTiming(_after));
-
-    if (MessageQueue::KNullPost == broadcast_msg_id_) {
-        xerror2(TSF"mq alarm return null post, id:%0, after:%1, seq:%2", (uintptr_t)this, _after, seq);
-        return false;
-    }
-
-#ifdef ANDROID
-
-    if (!::startAlarm((int64_t) seq, _after)) {
-        xerror2(TSF"startAlarm error, id:%0, after:%1, seq:%2", (uintptr_t)this, _after, seq);
-        MessageQueue::CancelMessage(broadcast_msg_id_);
-        broadcast_msg_id_ = MessageQueue::KNullPost;
-        return false;
-    }
-
-#endif
+    TimingWheel::Shared().Start(timer_, _after, boost::bind(&Alarm::OnAlarm, this, seq), reg_async_.Get());
 
     status_ = kStart;
     starttime_ = starttime;
     endtime_ = 0;
     after_ = _after;
     seq_ = seq;
-    xinfo2(TSF"alarm id:%0, after:%1, seq:%2, po.reg.q:%3,po.reg.s:%4,po.s:%5", (uintptr_t)this, _after, seq, broadcast_msg_id_.reg.queue, broadcast_msg_id_.reg.seq, broadcast_msg_id_.seq);
+    xinfo2(TSF"alarm id:%0, after:%1, seq:%2, reg.q:%3, reg.s:%4", (uintptr_t)this, _after, seq, reg_async_.Get().queue, reg_async_.Get().seq);
 
     return true;
 }
 
 bool Alarm::Cancel() {
     ScopedLock lock(sg_lock);
-    if (broadcast_msg_id_!=MessageQueue::KNullPost) {
-        MessageQueue::CancelMessage(broadcast_msg_id_);
-        broadcast_msg_id_=MessageQueue::KNullPost;
-    }
+    TimingWheel::Shared().Cancel(timer_);
     MessageQueue::CancelMessage(reg_async_.Get());
     if (INVAILD_SEQ == seq_) return true;
 
-#ifdef ANDROID
-
-    if (!::stopAlarm((int64_t)seq_)) {
-        xwarn2(TSF"stopAlarm error, id:%0, seq:%1", (uintptr_t)this, seq_);
-        status_ = kCancel;
-        endtime_ = gettickcount();
-        seq_ = INVAILD_SEQ;
-        return false;
-    }
-
-#endif
-
     xinfo2(TSF"alarm cancel id:%0, seq:%1, after:%2", (uintptr_t)this, seq_, after_);
     status_ = kCancel;
     endtime_ = gettickcount();
@@ -117,53 +82,28 @@ int64_t Alarm::ElapseTime() const {
     return endtime_ -  starttime_;
 }
 
-void Alarm::OnAlarm(const MessageQueue::MessagePost_t& _id, MessageQueue::Message& _message) {
-    if (KALARM_MESSAGETITLE != _message.title) return;
-
+void Alarm::OnAlarm(int64_t _seq) {
     ScopedLock lock(sg_lock);
 
-    if (MessageQueue::CurrentThreadMessageQueue() != MessageQueue::Handler2Queue(reg_async_.Get())) {
-        MessageQueue::AsyncInvoke(boost::bind(&Alarm::OnAlarm, this, _id, _message), (MessageQueue::MessageTitle_t)this, reg_async_.Get(), "Alarm::OnAlarm");
-        return;
-    }
-
-    if (seq_ != boost::any_cast<int64_t>(_message.body1)) return;
+    // cancelled or started again after the wheel posted it
+    if (seq_ != _seq) return;
 
     uint64_t  curtime = gettickcount();
     int64_t   elapseTime = curtime - starttime_;
-    int64_t   missTime = after_ - elapseTime;
-    xgroup2_define(group);
-    xinfo2(TSF"OnAlarm id:%_, seq:%_, elapsed:%_, after:%_, miss:%_, android alarm:%_, ", (uintptr_t)this, seq_, elapseTime, after_, -missTime, !bool(boost::any_cast<int>(_message.body2))) >> group;
-
-#ifdef ANDROID
-
-    if (missTime > 0) {
-        if (missTime <= MAX_LOCK_TIME) {
-            if (NULL == wakelock_) wakelock_ = new WakeUpLock();
-
-            wakelock_->Lock(missTime + 500);     // add 00ms
-            xinfo2(TSF"wakelock") >> group;
-            return;
-        }
-
-        ::stopAlarm(seq_);
-
-        if (::startAlarm((int64_t) seq_, missTime)) return;
+    xinfo2(TSF"OnAlarm id:%_, seq:%_, elapsed:%_, after:%_, miss:%_", (uintptr_t)this, seq_, elapseTime, after_, elapseTime - after_);
 
-        xerror2(TSF"startAlarm err, continue") >> group;
-    }
-
-#endif
-
-    xinfo2(TSF"runing") >> group;
     status_ = kOnAlarm;
     seq_ = INVAILD_SEQ;
     endtime_ = curtime;
 
-    if (inthread_)
+    if (inthread_) {
         runthread_.start();
-    else
-        MessageQueue::AsyncInvoke(boost::bind(&Alarm::__Run, this), (MessageQueue::MessageTitle_t)this, reg_async_.Get(), "Alarm::__Run");
+        return;
+    }
+
+    // already on the queue of reg_async_
+    lock.unlock();
+    __Run();
 }
 
 void Alarm::__Run() {
@@ -173,7 +113,3 @@ void Alarm::__Run() {
 const Thread& Alarm::RunThread() const {
     return runthread_;
 }
-
-#ifdef ANDROID
-#include "jni/OnAlarm.inl"
-#endif
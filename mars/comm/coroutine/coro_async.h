@@ -11,9 +11,19 @@
 #include "coroutine.h"
 
 #include "mars/comm/thread/thread.h"
+#include "mars/comm/messagequeue/task_pool.h"
 
 namespace coroutine {
 
+/*
+ * bounded pool for the blocking calls (getaddrinfo, platform apis) a coroutine hands off,
+ * so thousands of coroutines do not turn into thousands of threads.
+ */
+inline mq::TaskPool& BlockingPool() {
+    static mq::TaskPool* s_pool = new mq::TaskPool(4, "coro_blocking");
+    return *s_pool;
+}
+
 /////////////////running in coroutine utils///////////////////////////////
 class WaitThread {
 private:
@@ -33,8 +43,8 @@ public:
     };
     
 public:
-    WaitThread(const char* _name = NULL)
-    : thread_(_name), wrapper_(new Wrapper_) {
+    WaitThread(const char* _name = NULL, mq::TaskPool* _pool = NULL)
+    : thread_(_name), pool_(_pool), wrapper_(new Wrapper_) {
         wrapper_->status = kTimeout;
     }
     ~WaitThread() {}
@@ -67,7 +77,7 @@ public:
                 return;
             }}, NULL);
         
-        thread_.start(async_result);
+        __Start(async_result);
         lock.unlock();
         Yield();
         
@@ -100,7 +110,7 @@ public:
                 return;
             }});
         
-        thread_.start(async_result);
+        __Start(async_result);
         lock.unlock();
         Yield();
         
@@ -126,8 +136,15 @@ private:
     WaitThread(const WaitThread&);
     void operator=(const WaitThread&);
     
+    template <typename R>
+    void __Start(const mq::AsyncResult<R>& _async_result) {
+        if (pool_ && pool_->Post(_async_result)) return;
+        thread_.start(_async_result);
+    }
+    
 private:
     Thread  thread_;
+    mq::TaskPool* pool_;
     boost::shared_ptr<Wrapper_> wrapper_;
 };
 
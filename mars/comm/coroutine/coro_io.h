@@ -0,0 +1,150 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * coro_io.h
+ *
+ * socket io for code that may run either on its own thread or as a coroutine on SharedIOQueue().
+ * inside a coroutine the calls suspend it on the shared poller, otherwise they block as before.
+ * without MARS_CORO_IO these are the plain blocking calls.
+ */
+
+#ifndef CORO_IO_H_
+#define CORO_IO_H_
+
+#include "boost/utility/result_of.hpp"
+
+#include "mars/comm/socket/block_socket.h"
+#include "mars/comm/socket/complexconnect.h"
+
+#ifdef MARS_CORO_IO
+#include "coroutine.h"
+#include "coro_async.h"
+#include "coro_socket.h"
+#endif
+
+namespace coroutine {
+
+inline int auto_socket_send(SOCKET _sock, const void* _buffer, size_t _len, SocketBreaker& _breaker, int &_errcode, int _timeout=-1) {
+#ifdef MARS_CORO_IO
+    if (isCoroutine()) return coroutine::block_socket_send(_sock, _buffer, _len, _breaker, _errcode, _timeout);
+#endif
+    return ::block_socket_send(_sock, _buffer, _len, _breaker, _errcode, _timeout);
+}
+
+inline int auto_socket_recv(SOCKET _sock, AutoBuffer& _buffer, size_t _max_size, SocketBreaker& _breaker, int &_errcode, int _timeout=-1, bool _wait_full_size=false) {
+#ifdef MARS_CORO_IO
+    if (isCoroutine()) return coroutine::block_socket_recv(_sock, _buffer, _max_size, _breaker, _errcode, _timeout, _wait_full_size);
+#endif
+    return ::block_socket_recv(_sock, _buffer, _max_size, _breaker, _errcode, _timeout, _wait_full_size);
+}
+
+/*
+ * runs a call that can only block (dns, platform apis) on BlockingPool() and suspends the coroutine until it returns.
+ * cancel it the way the call itself is cancelled, e.g. DNS::Cancel().
+ */
+template <typename F>
+typename boost::result_of<F()>::type BlockingInvoke(const F& _func) {
+#ifdef MARS_CORO_IO
+    if (isCoroutine()) {
+        WaitThread wait(NULL, &BlockingPool());
+        return wait(_func);
+    }
+#endif
+    return _func();
+}
+
+/*
+ * ::ComplexConnect, or coroutine::ComplexConnect when ConnectImpatient is called from a coroutine.
+ */
+class AutoComplexConnect {
+  public:
+    AutoComplexConnect(unsigned int _timeout /*ms*/, unsigned int _interval /*ms*/)
+    : conn_(_timeout, _interval)
+#ifdef MARS_CORO_IO
+    , coro_conn_(_timeout, _interval), use_coro_(false)
+#endif
+    {}
+    AutoComplexConnect(unsigned int _timeout /*ms*/, unsigned int _interval /*ms*/, unsigned int _error_interval /*ms*/, unsigned int _max_connect)
+    : conn_(_timeout, _interval, _error_interval, _max_connect)
+#ifdef MARS_CORO_IO
+    , coro_conn_(_timeout, _interval, _error_interval, _max_connect), use_coro_(false)
+#endif
+    {}
+
+    SOCKET ConnectImpatient(const std::vector<socket_address>& _vecaddr, SocketBreaker& _breaker, ::MComplexConnect* _observer = NULL,
+                            mars::comm::ProxyType _proxy_type = mars::comm::kProxyNone, const socket_address* _proxy_addr = NULL,
+                            const std::string& _proxy_username = "", const std::string& _proxy_pwd = "") {
+#ifdef MARS_CORO_IO
+        use_coro_ = isCoroutine();
+        if (use_coro_) {
+            ObserverAdapter adapter(_observer);
+            return coro_conn_.ConnectImpatient(_vecaddr, _breaker, _observer ? &adapter : NULL, _proxy_type, _proxy_addr, _proxy_username, _proxy_pwd);
+        }
+#endif
+        return conn_.ConnectImpatient(_vecaddr, _breaker, _observer, _proxy_type, _proxy_addr, _proxy_username, _proxy_pwd);
+    }
+
+#ifdef MARS_CORO_IO
+#define CORO_IO_FORWARD(func) (use_coro_ ? coro_conn_.func() : conn_.func())
+#else
+#define CORO_IO_FORWARD(func) (conn_.func())
+#endif
+    unsigned int TryCount() const { return CORO_IO_FORWARD(TryCount);}
+    int Index() const { return CORO_IO_FORWARD(Index);}
+    int ErrorCode() const { return CORO_IO_FORWARD(ErrorCode);}
+
+    unsigned int IndexRtt() const { return CORO_IO_FORWARD(IndexRtt);}
+    unsigned int IndexTotalCost() const { return CORO_IO_FORWARD(IndexTotalCost);}
+    unsigned int TotalCost() const { return CORO_IO_FORWARD(TotalCost);}
+#undef CORO_IO_FORWARD
+
+  private:
+    AutoComplexConnect(const AutoComplexConnect&);
+    AutoComplexConnect& operator=(const AutoComplexConnect&);
+
+#ifdef MARS_CORO_IO
+    // coroutine::ComplexConnect reports to coroutine::MComplexConnect, hand the events on to the caller's observer
+    class ObserverAdapter : public MComplexConnect {
+      public:
+        ObserverAdapter(::MComplexConnect* _observer): observer_(_observer) {}
+
+        virtual void OnCreated(unsigned int _index, const socket_address& _addr, SOCKET _socket) { observer_->OnCreated(_index, _addr, _socket);}
+        virtual void OnConnect(unsigned int _index, const socket_address& _addr, SOCKET _socket) { observer_->OnConnect(_index, _addr, _socket);}
+        virtual void OnConnected(unsigned int _index, const socket_address& _addr, SOCKET _socket, int _error, int _rtt) { observer_->OnConnected(_index, _addr, _socket, _error, _rtt);}
+
+        virtual bool OnShouldVerify(unsigned int _index, const socket_address& _addr) { return observer_->OnShouldVerify(_index, _addr);}
+        virtual bool OnVerifySend(unsigned int _index, const socket_address& _addr, SOCKET _socket, AutoBuffer& _buffer_send) { return observer_->OnVerifySend(_index, _addr, _socket, _buffer_send);}
+        virtual bool OnVerifyRecv(unsigned int _index, const socket_address& _addr, SOCKET _socket, const AutoBuffer& _buffer_recv) { return observer_->OnVerifyRecv(_index, _addr, _socket, _buffer_recv);}
+        virtual void OnVerifyTimeout(unsigned int _index, const socket_address& _addr, SOCKET _socket, int _timeout) { observer_->OnVerifyTimeout(_index, _addr, _socket, _timeout);}
+
+        virtual void OnFinished(unsigned int _index, const socket_address& _addr, SOCKET _socket,
+                                int _error, int _conn_rtt, int _conn_totalcost, int _complex_totalcost) {
+            observer_->OnFinished(_index, _addr, _socket, _error, _conn_rtt, _conn_totalcost, _complex_totalcost);
+        }
+
+      private:
+        ::MComplexConnect* observer_;
+    };
+#endif
+
+  private:
+    ::ComplexConnect conn_;
+#ifdef MARS_CORO_IO
+    ComplexConnect coro_conn_;
+    bool use_coro_;
+#endif
+};
+
+}
+
+#endif // CORO_IO_H_
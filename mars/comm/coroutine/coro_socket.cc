@@ -194,6 +194,11 @@ void RunloopCond::Notify(ScopedLock& _lock) {
     ASSERT(_lock.islocked());
     multiplexing_->Breaeker().Break();
 }
+
+mq::MessageQueue_t SharedIOQueue() {
+    static mq::MessageQueue_t s_queue = mq::MessageQueueCreater::CreateNewMessageQueue(boost::shared_ptr<mq::RunloopCond>(new coroutine::RunloopCond), XLOGGER_TAG"::coro_io");
+    return s_queue;
+}
     
 #define SocketSelect coroutine::SocketSelect
 #include "comm/socket/block_socket.cc"
@@ -81,6 +81,12 @@ private:
 private:
     Multiplexing* multiplexing_;
 };
+
+/*
+ * process-wide messagequeue whose runloop waits in the shared poller (RunloopCond),
+ * so coroutines started on it wait for their sockets and its messages on one thread.
+ */
+mq::MessageQueue_t SharedIOQueue();
     
 }
 
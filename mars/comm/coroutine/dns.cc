@@ -109,7 +109,7 @@ bool DNS::GetHostByName(const std::string& _host_name, std::vector<std::string>&
     if (_breaker && _breaker->isbreak) return false;
 
     DNSFunc dnsfunc = dnsfunc_;
-    WaitThread* async_func = new WaitThread;
+    WaitThread* async_func = new WaitThread(NULL, &BlockingPool());
     
     ScopedLock lock(gs_mutex);
     dnsinfo_vec_.resize(dnsinfo_vec_.size() + 1);
@@ -5,8 +5,8 @@
  *      Author: yerungui
  */
 
-#ifndef COMM_COMM_DNS_H_
-#define COMM_COMM_DNS_H_
+#ifndef COMM_COROUTINE_DNS_H_
+#define COMM_COROUTINE_DNS_H_
 
 #include <string>
 #include <vector>
@@ -40,4 +40,4 @@ class DNS {
 }
 
 
-#endif /* COMM_COMM_DNS_H_ */
+#endif /* COMM_COROUTINE_DNS_H_ */
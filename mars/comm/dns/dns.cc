@@ -19,6 +19,9 @@
  */
 
 #include "dns/dns.h"
+
+#include "boost/bind.hpp"
+
 #include "socket/unix_socket.h"
 #include "xlogger/xlogger.h"
 #include "time_utils.h"
@@ -38,6 +41,7 @@ enum {
 };
 
 struct dnsinfo {
+    unsigned int    id;  // the lookup thread may be a pooled worker, so its tid is not unique
     thread_tid      threadid;
     DNS*            dns;
     DNS::DNSFunc    dns_func;
@@ -48,14 +52,15 @@ struct dnsinfo {
 
 static std::string DNSInfoToString(const struct dnsinfo& _info) {
     XMessage msg;
-    msg(TSF"info:%_, threadid:%_, dns:%_, host_name:%_, status:%_", &_info, _info.threadid, _info.dns, _info.host_name, _info.status);
+    msg(TSF"info:%_, id:%_, threadid:%_, dns:%_, host_name:%_, status:%_", &_info, _info.id, _info.threadid, _info.dns, _info.host_name, _info.status);
     return msg.Message();
 }
 static std::vector<dnsinfo> sg_dnsinfo_vec;
 static Condition sg_condition;
 static Mutex sg_mutex;
+static unsigned int sg_dnsinfo_seq = 0;
 
-static void __GetIP() {
+static void __GetIP(unsigned int _id) {
     xverbose_function();
 
 
@@ -66,7 +71,7 @@ static void __GetIP() {
     std::vector<dnsinfo>::iterator iter = sg_dnsinfo_vec.begin();
 
     for (; iter != sg_dnsinfo_vec.end(); ++iter) {
-        if (iter->threadid == ThreadUtil::currentthreadid()) {
+        if (iter->id == _id) {
             host_name = iter->host_name;
             dnsfunc = iter->dns_func;
             break;
@@ -97,7 +102,7 @@ static void __GetIP() {
 
         iter = sg_dnsinfo_vec.begin();
         for (; iter != sg_dnsinfo_vec.end(); ++iter) {
-            if (iter->threadid == ThreadUtil::currentthreadid()) {
+            if (iter->id == _id) {
                 break;
             }
         }
@@ -160,7 +165,7 @@ static void __GetIP() {
         
         iter = sg_dnsinfo_vec.begin();
         for (; iter != sg_dnsinfo_vec.end(); ++iter) {
-            if (iter->threadid == ThreadUtil::currentthreadid()) {
+            if (iter->id == _id) {
                 break;
             }
         }
@@ -194,7 +199,9 @@ bool DNS::GetHostByName(const std::string& _host_name, std::vector<std::string>&
 
     if (_breaker && _breaker->isbreak) return false;
 
-    Thread thread(&__GetIP, _host_name.c_str());
+    unsigned int id = ++sg_dnsinfo_seq;
+    Thread thread(boost::bind(&__GetIP, id), _host_name.c_str());
+    thread.pooled(true);
     int startRet = thread.start();
 
     if (startRet != 0) {
@@ -203,6 +210,7 @@ bool DNS::GetHostByName(const std::string& _host_name, std::vector<std::string>&
     }
 
     dnsinfo info;
+    info.id = id;
     info.threadid = thread.tid();
     info.host_name = _host_name;
     info.dns_func = dnsfunc_;
@@ -223,7 +231,7 @@ bool DNS::GetHostByName(const std::string& _host_name, std::vector<std::string>&
         std::vector<dnsinfo>::iterator it = sg_dnsinfo_vec.begin();
 
         for (; it != sg_dnsinfo_vec.end(); ++it) {
-            if (info.threadid == it->threadid)
+            if (info.id == it->id)
                 break;
         }
 
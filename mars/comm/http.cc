@@ -20,10 +20,10 @@
 #include "http.h"
 
 #include <cstddef>
+#include <ctype.h>
 #include <stdlib.h>
-#ifdef WIN32
+#include <string.h>
 #include <algorithm>
-#endif //WIN32
 #include "comm/strutil.h"
 #include "comm/xlogger/xlogger.h"
 
@@ -37,33 +37,6 @@ bool less::operator()(const std::string& __x, const std::string& __y) const {
     return 0 > strcasecmp(__x.c_str(), __y.c_str());
 }
 
-inline char* string_strnstr(const char* src, const char* sfind, int pos1) {
-    xassert2(src != NULL && sfind != NULL);
-
-    if (src == NULL || sfind == NULL)
-        return NULL;
-
-    int l1, l2;
-    l2 = (int)strlen(sfind);
-
-    if (!l2)
-        return (char*)src;
-
-    l1 = (int)strnlen(src, pos1);
-    pos1 = (pos1 > l1) ? l1 : pos1;
-
-    while (pos1 >= l2) {
-        pos1--;
-
-        if (!memcmp(src, sfind, (size_t)l2))
-            return (char*)src;
-
-        src++;
-    }
-
-    return NULL;
-}
-
 static THttpVersion __GetHttpVersion(const std::string& _strVersion) {
     for (size_t i = 0; i < sizeof(kHttpVersionString) / sizeof(kHttpVersionString[0]); ++i) {
         if (0 == strcmp(_strVersion.c_str(), kHttpVersionString[i])) {
@@ -75,36 +48,6 @@ static THttpVersion __GetHttpVersion(const std::string& _strVersion) {
     return kVersion_Unknow;
 }
 
-static bool __ParserHeaders(const std::string& _strHeaders, HeaderFields& _headers) {
-    
-    std::string::size_type linebegin = 0;
-    std::string::size_type lineend = 0;
-    
-    while ((lineend = _strHeaders.find(KStringCRLF, lineend, strlen(KStringCRLF))) != std::string::npos){
-        
-        std::string line = _strHeaders.substr(linebegin, lineend - linebegin);
-        
-        std::string::size_type namebegin = line.find_first_not_of(KStringColon, 0, strlen(KStringColon));
-        if (namebegin != std::string::npos){
-            std::string::size_type nameend = line.find_first_of(KStringColon, 0, strlen(KStringColon));
-            std::string name = line.substr(0, nameend);
-            if (line.length() > nameend + strlen(KStringColon)){
-                std::string value = line.substr(nameend + strlen(KStringColon));
-                
-                strutil::Trim(name);
-                strutil::Trim(value);
-                
-                _headers.HeaderFiled(name.c_str(), value.c_str());
-            }
-        }
-        
-        lineend += strlen(KStringCRLF);
-        linebegin = lineend;
-    }
-    
-    return true;
-}
-
 // implement of RequestLine
 
 const char* const RequestLine::kHttpMethodString[kMax] = {
@@ -659,11 +602,34 @@ bool Builder::HttpToBuffer(AutoBuffer& _http) {
 
 
 // implement of Parser
+static const size_t kFirstLineMaxLength = 8 * 1024;
+static const size_t kHeaderFieldsMaxLength = 128 * 1024;
+static const size_t kChunkLineMaxLength = 4 * 1024;
+
+static bool __IsBlank(char _c) {
+    return ' ' == _c || '\t' == _c || '\r' == _c || '\n' == _c;
+}
+
+static bool __IsEmptyLine(const char* _line, size_t _len) {
+    return 1 == _len || (2 == _len && '\r' == _line[0]);
+}
+
+static bool __ViewEqual(const char* _view, size_t _len, const char* _str) {
+    return strlen(_str) == _len && 0 == strncasecmp(_view, _str, _len);
+}
+
 Parser::Parser(BodyReceiver* _body, bool _manage)
     : recvstatus_(kStart)
-    , response_header_ready_(false)
+    , linebegin_(0)
     , csmode_(kRespond)
     , headfields_()
+    , headfields_ready_(false)
+    , chunked_(false)
+    , connection_close_(false)
+    , content_length_(0)
+    , body_length_(0)
+    , chunkstatus_(kChunkSize)
+    , chunk_left_(0)
     , bodyreceiver_(_body)
     , is_manage_body_(_manage)
     , firstlinelength_(0)
@@ -680,10 +646,11 @@ Parser::~Parser() {
 }
 
 Parser::TRecvStatus Parser::Recv(const void* _buffer, size_t _length, size_t* consumed_bytes) {
-    if((NULL == _buffer || 0 == _length) && Fields().IsConnectionClose() && recvstatus_==kBody) {
+    if (consumed_bytes) *consumed_bytes = 0;
+
+    if((NULL == _buffer || 0 == _length) && connection_close_ && recvstatus_==kBody) {
         xwarn2(TSF"status:%_", recvstatus_);
-        recvstatus_ = kEnd;
-        bodyreceiver_->EndData();
+        __End();
         return  recvstatus_;
     }
     
@@ -692,225 +659,25 @@ Parser::TRecvStatus Parser::Recv(const void* _buffer, size_t _length, size_t* co
         xwarn2(TSF"Recv(%_, %_), status:%_", NULL==_buffer?"NULL":_buffer, _length, recvstatus_);
         return recvstatus_;
     }
-    
-    if (recvstatus_ < kBody && headerbuf_.Length() < 4096 && !response_header_ready_){
-        
-        headerbuf_.Write(_buffer, std::min(_length, (size_t)4096));
-        
-        const char* pszbuf = (const char*)headerbuf_.Ptr();
-        size_t length = headerbuf_.Length();
-    
-        if (length > 4){
-            char* pos = string_strnstr(pszbuf, "\r\n\r\n", (int)length);
-            if (pos != NULL){
-                headerbuf_.Length(0, pos - pszbuf + 4);
-                response_header_ready_ = true;
-            }
-        }
+
+    const char* data = (const char*)_buffer;
+    size_t left = _length;
+
+    while (0 < left && kEnd != recvstatus_ && !Error()) {
+        if (kBody > recvstatus_)
+            __RecvHeader(data, left);
+        else
+            __RecvBody(data, left);
     }
-    
-    recvbuf_.Write(_buffer, _length);
-    size_t origin_size = recvbuf_.Length();
-    
-    while (true) {
-        switch (recvstatus_) {
-            case kStart:
-            case kFirstLine: {
-                char* pBuf = (char*)recvbuf_.Ptr();
-                char* pos = string_strnstr(pBuf, KStringCRLF, (int)recvbuf_.Length());
-                if (NULL == pos && 8 * 1024 < recvbuf_.Length()) {
-                    xerror2(TSF"wrong first line 8k buffer no found CRLF");
-                    recvstatus_ = kFirstLineError;
-                    return recvstatus_;
-                }
-                
-                if (NULL == pos) {
-                    recvstatus_ = kFirstLine;
-                    return recvstatus_;
-                }
-                
-                ptrdiff_t firstlinelength = pos - pBuf + 2;
-                std::string firstline = std::string(pBuf, (size_t)firstlinelength);
-                
-                bool parseFirstlineSuc = false;
-                
-                if (strutil::StartsWith(firstline, "HTTP/")) {
-                    if (statusline_.FromString(firstline)) {
-                        csmode_ = kRespond;
-                        parseFirstlineSuc = true;
-                    }
-                } else {
-                    if (requestline_.FromString(firstline)) {
-                        csmode_ = kRequest;
-                        parseFirstlineSuc = true;
-                    }
-                }
-                
-                if (!parseFirstlineSuc) {
-                    xerror2(TSF"wrong first line: %0", firstline);
-                    recvstatus_ = kFirstLineError;
-                    return recvstatus_;
-                }
-                
-                headerbuf_.Write(recvbuf_.Ptr(), firstlinelength);
-                // HTTP/1.1 4.7 Unauthorized\r\n\r\n
-                char* pos_2crlf = string_strnstr(pBuf, "\r\n\r\n", (int)recvbuf_.Length());
-                if (NULL != pos_2crlf && pos_2crlf == pos) {
-                    recvstatus_ = kBody;
-                    recvbuf_.Move(- (firstlinelength + 2));
-                } else {
-                    recvstatus_ = kHeaderFields;
-                    recvbuf_.Move(- firstlinelength);
-                }
-                
-                if (consumed_bytes){
-                    *consumed_bytes = origin_size - recvbuf_.Length();
-                }
-                
-                firstlinelength_ = firstlinelength;
-            }
-                break;
-                
-            case kHeaderFields: {
-                char* pBuf = (char*)recvbuf_.Ptr();
-                char* pos = string_strnstr(pBuf, "\r\n\r\n", (int)recvbuf_.Length());
-                
-                if (NULL == pos && 128 * 1024 < recvbuf_.Length()) {
-                    xerror2(TSF"wrong header fields 128k buffer no found CRLFCRLF");
-                    recvstatus_ = kHeaderFieldsError;
-                    return recvstatus_;
-                }
-                
-                if (NULL == pos) return recvstatus_;
-                
-                ptrdiff_t headerslength = pos - pBuf + 4;
-                std::string headers = std::string(pBuf, (size_t)headerslength);
-                
-                bool ret = __ParserHeaders(headers, headfields_);
-                
-                if (false == ret) {
-                    recvstatus_ = kHeaderFieldsError;
-                    return recvstatus_;
-                }
-                
-                recvstatus_ = kBody;
-                headerbuf_.Write(recvbuf_.Ptr(), headerslength);
-                recvbuf_.Move(-headerslength);
-                
-                if (consumed_bytes){
-                    *consumed_bytes = origin_size - recvbuf_.Length();
-                }
-                
-                headerlength_ = headerslength;
-            }
-                break;
-                
-            case kBody: {
-                xassert2(bodyreceiver_);
-                
-                if (bodyreceiver_) {
-                    // chunked
-                    
-                    if (headfields_.IsTransferEncodingChunked()) {
-                        char* chunkSizeBegin = (char*)recvbuf_.Ptr();
-                        char* chunkSizeEnd = string_strnstr(chunkSizeBegin, KStringCRLF, (int)recvbuf_.Length());
-                        
-                        if (NULL == chunkSizeEnd) {
-                            return recvstatus_;
-                        }
-                        
-                        std::string strChunkSize = std::string(chunkSizeBegin, chunkSizeEnd);
-                        strutil::Trim(strChunkSize);
-                        
-                        int64_t chunkSize = strtol(strChunkSize.c_str(), NULL, 16);
-                        
-                        ptrdiff_t sizeLen = chunkSizeEnd - chunkSizeBegin;
-                        
-                        if (0 != chunkSize) {
-                            if ((ptrdiff_t)recvbuf_.Length() < chunkSize + sizeLen + 4)  return recvstatus_;
-                            
-                            char* chunkBegin = chunkSizeEnd + 2;
-                            char* chunkEnd = chunkBegin + chunkSize;
-                            
-                            if (*chunkEnd != '\r' || *(chunkEnd + 1) != '\n') {
-                                recvstatus_ = kBodyError;
-                                return recvstatus_;
-                            }
-                            
-                            bodyreceiver_->AppendData(chunkBegin, (size_t)chunkSize);
-                            
-                            recvbuf_.Move(-(chunkEnd - chunkSizeBegin + 2));
-                            
-                            if (consumed_bytes){
-                                *consumed_bytes = origin_size - recvbuf_.Length();
-                            }
-                        } else {  // last chunk
-                            char* trailerBegin = chunkSizeEnd + 2;
-                            
-                            if (recvbuf_.Length() < (unsigned int)(sizeLen + 4)) return recvstatus_;
-                            
-                            char* trailerEnd = string_strnstr(trailerBegin, KStringCRLF, (int)recvbuf_.Length());
-                            
-                            if (NULL == trailerEnd)
-                                return recvstatus_;
-                            
-                            recvstatus_ = kEnd;
-                            bodyreceiver_->EndData();
-                            
-                            
-                            recvbuf_.Move(-(trailerEnd - chunkSizeBegin + 2));
-                            
-                            if (consumed_bytes){
-                                *consumed_bytes = origin_size - recvbuf_.Length();
-                            }
-                        }
-                    } else {  // no chunk
-                        int contentLength = headfields_.ContentLength();
-                        int appendlen = 0;
-                        if (Fields().IsConnectionClose() && 0==contentLength) {
-                            appendlen = int(recvbuf_.Length());
-                        } else if (int(recvbuf_.Length() + bodyreceiver_->Length()) <= contentLength)
-                            appendlen = int(recvbuf_.Length());
-                        else {
-                            xwarn2(TSF"recv len bigger than contentlen, (%_, %_, %_)", recvbuf_.Length(), bodyreceiver_->Length(), contentLength);
-                            appendlen = contentLength - int(bodyreceiver_->Length());
-                        }
-                        
-                        bodyreceiver_->AppendData(recvbuf_.Ptr(), (size_t)appendlen);
-                        recvbuf_.Move(-appendlen);
-                        
-                        if (consumed_bytes){
-                            *consumed_bytes = origin_size - recvbuf_.Length();
-                        }
-                        
-                        if ((int)bodyreceiver_->Length() == contentLength) {
-                            recvstatus_ = kEnd;
-                            bodyreceiver_->EndData();
-                            return  recvstatus_;
-                        }
-                    }
-                }
-                
-                if (0 == recvbuf_.Length())
-                    return recvstatus_;
-            }
-                break;
-                
-            case kEnd: {
-                return recvstatus_;
-            }
-                break;
-                
-            default:
-                break;
-        }
+
+    // bytes kept in headerbuf_ or recvbuf_ count as consumed, bytes after the message do not
+    if (consumed_bytes){
+        *consumed_bytes = _length - left;
     }
-    
-    xassert2(false, TSF"status:%_", recvstatus_);
+
     return recvstatus_;
 }
 
-    
 Parser::TRecvStatus Parser::Recv(AutoBuffer& _recv_buffer) {
 
     if (NULL == _recv_buffer.Ptr() || 0 == _recv_buffer.Length()) {
@@ -918,187 +685,238 @@ Parser::TRecvStatus Parser::Recv(AutoBuffer& _recv_buffer) {
         return recvstatus_;
     }
 
-    if (recvstatus_ < kBody && headerbuf_.Length() < 4096 && !response_header_ready_){
-        
-        headerbuf_.Write(_recv_buffer.Ptr(), std::min(_recv_buffer.Length(), (size_t)4096));
-        
-        const char* pszbuf = (const char*)headerbuf_.Ptr();
-        size_t length = headerbuf_.Length();
-        
-        if (length > 4){
-            char* pos = string_strnstr(pszbuf, "\r\n\r\n", (int)length);
-            if (pos != NULL){
-                headerbuf_.Length(0, pos - pszbuf + 4);
-                response_header_ready_ = true;
-            }
-        }
-    }
+    size_t consumed = 0;
+    Recv(_recv_buffer.Ptr(), _recv_buffer.Length(), &consumed);
+    _recv_buffer.Move(-(off_t)consumed);
+    return recvstatus_;
+}
+
+void Parser::__RecvHeader(const char*& _data, size_t& _left) {
+    const char* lf = (const char*)memchr(_data, '\n', _left);
+    size_t len = NULL == lf ? _left : (size_t)(lf - _data) + 1;
 
-    while (true) {
-        switch (recvstatus_) {
-        case kStart:
-        case kFirstLine: {
-            char* pBuf = (char*)_recv_buffer.Ptr();
-            char* pos = string_strnstr(pBuf, KStringCRLF, (int)_recv_buffer.Length());
+    headerbuf_.Write(_data, len);
+    _data += len;
+    _left -= len;
 
-            if (NULL == pos && 8 * 1024 < _recv_buffer.Length()) {
+    if (kHeaderFields > recvstatus_) {
+        if (NULL == lf) {
+            if (kFirstLineMaxLength < headerbuf_.Length()) {
                 xerror2(TSF"wrong first line 8k buffer no found CRLF");
                 recvstatus_ = kFirstLineError;
-                return recvstatus_;
-            }
-
-            if (NULL == pos) {
+            } else {
                 recvstatus_ = kFirstLine;
-                return recvstatus_;
             }
+            return;
+        }
 
-            ptrdiff_t firstlinelength = pos - pBuf + 2;
-            std::string firstline = std::string(pBuf, (size_t)firstlinelength);
+        if (!__ParseFirstLine((const char*)headerbuf_.Ptr(), headerbuf_.Length())) {
+            recvstatus_ = kFirstLineError;
+            return;
+        }
 
-            bool parseFirstlineSuc = false;
+        firstlinelength_ = headerbuf_.Length();
+        linebegin_ = headerbuf_.Length();
+        recvstatus_ = kHeaderFields;
+        return;
+    }
 
-            if (strutil::StartsWith(firstline, "HTTP/")) {
-                if (statusline_.FromString(firstline)) {
-                    csmode_ = kRespond;
-                    parseFirstlineSuc = true;
-                }
-            } else {
-                if (requestline_.FromString(firstline)) {
-                    csmode_ = kRequest;
-                    parseFirstlineSuc = true;
-                }
-            }
+    if (kHeaderFieldsMaxLength < headerbuf_.Length() - firstlinelength_) {
+        xerror2(TSF"wrong header fields 128k buffer no found CRLFCRLF");
+        recvstatus_ = kHeaderFieldsError;
+        return;
+    }
 
-            if (!parseFirstlineSuc) {
-                xerror2(TSF"wrong first line: %0", firstline);
-                recvstatus_ = kFirstLineError;
-                return recvstatus_;
-            }
+    if (NULL == lf) return;
+
+    const char* line = (const char*)headerbuf_.Ptr(linebegin_);
+    size_t linelen = headerbuf_.Length() - linebegin_;
+    linebegin_ = headerbuf_.Length();
+
+    if (__IsEmptyLine(line, linelen)) __OnHeaderEnd();
+}
+
+bool Parser::__ParseFirstLine(const char* _line, size_t _len) {
+    std::string firstline(_line, _len);
 
-            recvstatus_ = kHeaderFields;
-            _recv_buffer.Move(- firstlinelength);
-            firstlinelength_ = firstlinelength;
+    if (strutil::StartsWith(firstline, "HTTP/")) {
+        if (statusline_.FromString(firstline)) {
+            csmode_ = kRespond;
+            return true;
         }
-        break;
+    } else {
+        if (requestline_.FromString(firstline)) {
+            csmode_ = kRequest;
+            return true;
+        }
+    }
+
+    xerror2(TSF"wrong first line: %0", firstline);
+    return false;
+}
 
-        case kHeaderFields: {
-            char* pBuf = (char*)_recv_buffer.Ptr();
-            char* pos = string_strnstr(pBuf, "\r\n\r\n", (int)_recv_buffer.Length());
+// headerbuf_ no longer grows once the empty line is in, so the views stay valid
+void Parser::__ParseHeaderViews() {
+    const char* begin = (const char*)headerbuf_.Ptr(firstlinelength_);
+    const char* end = (const char*)headerbuf_.Ptr() + headerbuf_.Length();
 
-            if (NULL == pos && 128 * 1024 < _recv_buffer.Length()) {
-                xerror2(TSF"wrong header fields 128k buffer no found CRLFCRLF");
-                recvstatus_ = kHeaderFieldsError;
-                return recvstatus_;
-            }
+    while (begin < end) {
+        const char* lf = (const char*)memchr(begin, '\n', (size_t)(end - begin));
+        const char* lineend = NULL == lf ? end : lf;
+        if (begin < lineend && '\r' == *(lineend - 1)) --lineend;
 
-            if (NULL == pos) return recvstatus_;
+        const char* colon = (const char*)memchr(begin, ':', (size_t)(lineend - begin));
 
-            ptrdiff_t headerslength = pos - pBuf + 4;
-            std::string headers = std::string(pBuf, (size_t)headerslength);
+        if (NULL != colon && colon + 1 < lineend) {
+            const char* namebegin = begin;
+            const char* nameend = colon;
+            const char* valuebegin = colon + 1;
+            const char* valueend = lineend;
 
-            bool ret = __ParserHeaders(headers, headfields_);
+            while (namebegin < nameend && __IsBlank(*namebegin)) ++namebegin;
+            while (namebegin < nameend && __IsBlank(*(nameend - 1))) --nameend;
+            while (valuebegin < valueend && __IsBlank(*valuebegin)) ++valuebegin;
+            while (valuebegin < valueend && __IsBlank(*(valueend - 1))) --valueend;
 
-            if (false == ret) {
-                recvstatus_ = kHeaderFieldsError;
-                return recvstatus_;
+            if (namebegin < nameend) {
+                HeaderView view = {namebegin, (size_t)(nameend - namebegin), valuebegin, (size_t)(valueend - valuebegin)};
+                headerviews_.push_back(view);
             }
-
-            recvstatus_ = kBody;
-            _recv_buffer.Move(-headerslength);
-            headerlength_ = headerslength;
         }
-        break;
 
-        case kBody: {
-            xassert2(bodyreceiver_);
+        begin = NULL == lf ? end : lf + 1;
+    }
+}
 
-            if (bodyreceiver_) {
-                // chunked
+void Parser::__OnHeaderEnd() {
+    headerlength_ = headerbuf_.Length() - firstlinelength_;
+    __ParseHeaderViews();
 
-                if (headfields_.IsTransferEncodingChunked()) {
-                    char* chunkSizeBegin = (char*)_recv_buffer.Ptr();
-                    char* chunkSizeEnd = string_strnstr(chunkSizeBegin, KStringCRLF, (int)_recv_buffer.Length());
+    HeaderView view;
+    chunked_ = HeaderValue(HeaderFields::KStringTransferEncoding, view) && __ViewEqual(view.value, view.value_len, KStringChunked);
+    connection_close_ = HeaderValue(HeaderFields::KStringConnection, view) && __ViewEqual(view.value, view.value_len, KStringClose);
 
-                    if (NULL == chunkSizeEnd) {
-                        return recvstatus_;
-                    }
+    content_length_ = 0;
+    if (HeaderValue(HeaderFields::KStringContentLength, view)) {
+        for (size_t i = 0; i < view.value_len && isdigit((unsigned char)view.value[i]); ++i) {
+            content_length_ = content_length_ * 10 + (uint64_t)(view.value[i] - '0');
+        }
+    }
 
-                    std::string strChunkSize = std::string(chunkSizeBegin, chunkSizeEnd);
-                    strutil::Trim(strChunkSize);
+    recvstatus_ = kBody;
 
-                    int64_t chunkSize = strtol(strChunkSize.c_str(), NULL, 16);
+    // neither a length nor a close to wait for: the message has no body
+    if (!chunked_ && 0 == content_length_ && !connection_close_) __End();
+}
 
-                    ptrdiff_t sizeLen = chunkSizeEnd - chunkSizeBegin;
+void Parser::__RecvBody(const char*& _data, size_t& _left) {
+    xassert2(bodyreceiver_);
 
-                    if (0 != chunkSize) {
-                        if ((ptrdiff_t)_recv_buffer.Length() < chunkSize + sizeLen + 4)  return recvstatus_;
+    if (chunked_) {
+        __RecvChunked(_data, _left);
+        return;
+    }
 
-                        char* chunkBegin = chunkSizeEnd + 2;
-                        char* chunkEnd = chunkBegin + chunkSize;
+    bool until_close = connection_close_ && 0 == content_length_;
+    size_t len = _left;
 
-                        if (*chunkEnd != '\r' || *(chunkEnd + 1) != '\n') {
-                            recvstatus_ = kBodyError;
-                            return recvstatus_;
-                        }
+    if (!until_close && content_length_ - body_length_ < len) {
+        xwarn2(TSF"recv len bigger than contentlen, (%_, %_, %_)", _left, body_length_, content_length_);
+        len = (size_t)(content_length_ - body_length_);
+    }
 
-                        bodyreceiver_->AppendData(chunkBegin, (size_t)chunkSize);
+    if (bodyreceiver_) bodyreceiver_->AppendData(_data, len);
+    body_length_ += len;
+    _data += len;
+    _left -= len;
 
-                        _recv_buffer.Move(-(chunkEnd - chunkSizeBegin + 2));
-                    } else {  // last chunk
-                        char* trailerBegin = chunkSizeEnd + 2;
+    if (!until_close && body_length_ == content_length_) __End();
+}
 
-                        if (recvbuf_.Length() < (unsigned int)(sizeLen + 4)) return recvstatus_;
+void Parser::__RecvChunked(const char*& _data, size_t& _left) {
+    if (kChunkData == chunkstatus_) {
+        size_t len = (size_t)std::min<uint64_t>(chunk_left_, _left);
 
-                        char* trailerEnd = string_strnstr(trailerBegin, KStringCRLF, (int)_recv_buffer.Length());
+        if (bodyreceiver_) bodyreceiver_->AppendData(_data, len);
+        body_length_ += len;
+        chunk_left_ -= len;
+        _data += len;
+        _left -= len;
 
-                        if (NULL == trailerEnd)
-                            return recvstatus_;
+        if (0 == chunk_left_) {
+            chunkstatus_ = kChunkDataCRLF;
+            chunk_left_ = 2;  // bytes of the CRLF after the data still to come
+        }
+        return;
+    }
 
-                        recvstatus_ = kEnd;
-                        bodyreceiver_->EndData();
+    if (kChunkDataCRLF == chunkstatus_) {
+        if ((2 == chunk_left_ ? '\r' : '\n') != *_data) {
+            xerror2(TSF"chunk data not followed by CRLF, body len:%_", body_length_);
+            recvstatus_ = kBodyError;
+            return;
+        }
 
+        ++_data;
+        --_left;
+        if (0 == --chunk_left_) chunkstatus_ = kChunkSize;
+        return;
+    }
 
-                        _recv_buffer.Move(-(trailerEnd - chunkSizeBegin + 2));
-                    }
-                } else {  // no chunk
-                    int contentLength = headfields_.ContentLength();
-                    int appendlen = 0;
+    // chunk size and trailer lines, copied to recvbuf_ only when split across Recv() calls
+    const char* lf = (const char*)memchr(_data, '\n', _left);
+    size_t len = NULL == lf ? _left : (size_t)(lf - _data) + 1;
 
-                    if (int(_recv_buffer.Length() + bodyreceiver_->Length()) <= contentLength)
-                        appendlen = int(_recv_buffer.Length());
-                    else {
-                        xwarn2(TSF"contentLength:%_, body.len:%_, recv len:%_", contentLength, int(bodyreceiver_->Length()), _recv_buffer.Length());
-                        appendlen = contentLength - int(bodyreceiver_->Length());
-                    }
+    if (kChunkLineMaxLength < recvbuf_.Length() + len) {
+        xerror2(TSF"chunk line longer than %_", kChunkLineMaxLength);
+        recvstatus_ = kBodyError;
+        return;
+    }
 
-                    bodyreceiver_->AppendData(_recv_buffer.Ptr(), (size_t)appendlen);
-                    _recv_buffer.Move(-appendlen);
+    const char* line = _data;
+    size_t linelen = len;
+    _data += len;
+    _left -= len;
 
-                    if ((int)bodyreceiver_->Length() == contentLength) {
-                        recvstatus_ = kEnd;
-                        bodyreceiver_->EndData();
-                        return  recvstatus_;
-                    }
-                }
-            }
+    if (NULL == lf || 0 < recvbuf_.Length()) {
+        recvbuf_.Write(line, linelen);
+        if (NULL == lf) return;
 
-            if (0 == _recv_buffer.Length())
-                return recvstatus_;
-        }
-        break;
+        line = (const char*)recvbuf_.Ptr();
+        linelen = recvbuf_.Length();
+    }
+
+    if (kChunkSize == chunkstatus_) {
+        const char* pos = line;
+        const char* end = line + linelen;
+        uint64_t chunksize = 0;
+        size_t digits = 0;
+
+        while (pos < end && (' ' == *pos || '\t' == *pos)) ++pos;
 
-        case kEnd: {
-            return recvstatus_;
+        for (; pos < end && isxdigit((unsigned char)*pos); ++pos, ++digits) {
+            chunksize = chunksize * 16 + (uint64_t)(isdigit((unsigned char)*pos) ? *pos - '0' : (tolower((unsigned char)*pos) - 'a' + 10));
         }
-        break;
 
-        default:
-            break;
+        if (0 == digits || 15 < digits) {
+            xerror2(TSF"wrong chunk size line: %_", std::string(line, linelen));
+            recvstatus_ = kBodyError;
+        } else if (0 == chunksize) {
+            chunkstatus_ = kChunkTrailer;
+        } else {
+            chunkstatus_ = kChunkData;
+            chunk_left_ = chunksize;
         }
+    } else if (__IsEmptyLine(line, linelen)) {
+        __End();
     }
 
-    xassert2(false, TSF"status:%_", recvstatus_);
-    return recvstatus_;
+    recvbuf_.Length(0, 0);
+}
+
+void Parser::__End() {
+    recvstatus_ = kEnd;
+    if (bodyreceiver_) bodyreceiver_->EndData();
 }
 
 Parser::TRecvStatus Parser::RecvStatus() const {
@@ -1118,11 +936,35 @@ const StatusLine& Parser::Status() const {
     return statusline_;
 }
 
+const std::vector<HeaderView>& Parser::HeaderViews() const {
+    return headerviews_;
+}
+
+bool Parser::HeaderValue(const char* _name, HeaderView& _view) const {
+    for (std::vector<HeaderView>::const_iterator iter = headerviews_.begin(); iter != headerviews_.end(); ++iter) {
+        if (__ViewEqual(iter->name, iter->name_len, _name)) {
+            _view = *iter;
+            return true;
+        }
+    }
+
+    return false;
+}
+
 HeaderFields& Parser::Fields() {
+    const Parser* self = this;
+    self->Fields();
     return headfields_;
 }
 
 const HeaderFields& Parser::Fields() const {
+    if (!headfields_ready_ && FieldsReady()) {
+        for (std::vector<HeaderView>::const_iterator iter = headerviews_.begin(); iter != headerviews_.end(); ++iter) {
+            headfields_.HeaderFiled(std::pair<const std::string, std::string>(std::string(iter->name, iter->name_len), std::string(iter->value, iter->value_len)));
+        }
+        headfields_ready_ = true;
+    }
+
     return headfields_;
 }
 
@@ -21,9 +21,11 @@
 #ifndef HTTP_H_
 #define HTTP_H_
 
+#include <stdint.h>
 #include <string>
 #include <map>
 #include <list>
+#include <vector>
 
 #include "autobuffer.h"
 
@@ -293,6 +295,18 @@ class MemoryBodyReceiver : public BodyReceiver {
     AutoBuffer& body_;
 };
 
+// a header line as it sits in Parser::HeaderBuffer(), not NUL terminated
+struct HeaderView {
+    const char* name;
+    size_t name_len;
+    const char* value;
+    size_t value_len;
+};
+
+/*
+ * incremental parser: Recv() may be fed any split of the stream and picks up where the last call stopped.
+ * header bytes are kept once in HeaderBuffer(), body bytes go straight from the caller's buffer to BodyReceiver.
+ */
 class Parser {
   public:
     enum TRecvStatus {
@@ -326,6 +340,10 @@ class Parser {
     const AutoBuffer& HeaderBuffer() const;
 
     bool FieldsReady() const;
+    // views into HeaderBuffer(), valid once FieldsReady() and for the parser's lifetime
+    const std::vector<HeaderView>& HeaderViews() const;
+    bool HeaderValue(const char* _name, HeaderView& _view) const;
+    // copies the views into a map the first time it is asked for
     HeaderFields& Fields();
     const HeaderFields& Fields() const;
     size_t FirstLineLength() const;
@@ -339,17 +357,42 @@ class Parser {
     bool Error() const;
     bool Success() const;
 
+  private:
+    enum TChunkStatus {
+        kChunkSize,
+        kChunkData,
+        kChunkDataCRLF,
+        kChunkTrailer,
+    };
+
+    void __RecvHeader(const char*& _data, size_t& _left);
+    bool __ParseFirstLine(const char* _line, size_t _len);
+    void __ParseHeaderViews();
+    void __OnHeaderEnd();
+    void __RecvBody(const char*& _data, size_t& _left);
+    void __RecvChunked(const char*& _data, size_t& _left);
+    void __End();
+
   private:
     TRecvStatus recvstatus_;
-    AutoBuffer  recvbuf_;
-    AutoBuffer  headerbuf_;
-    bool response_header_ready_;
+    AutoBuffer  recvbuf_;     // a chunk size or trailer line split across Recv() calls
+    AutoBuffer  headerbuf_;   // first line and header lines, never body bytes
+    size_t      linebegin_;   // offset in headerbuf_ of the line being received
     TCsMode csmode_;
 
     StatusLine statusline_;
     RequestLine requestline_;
 
-    HeaderFields headfields_;
+    std::vector<HeaderView> headerviews_;
+    mutable HeaderFields headfields_;
+    mutable bool headfields_ready_;
+
+    bool chunked_;
+    bool connection_close_;
+    uint64_t content_length_;
+    uint64_t body_length_;
+    TChunkStatus chunkstatus_;
+    uint64_t chunk_left_;
 
     BodyReceiver* bodyreceiver_;
     bool is_manage_body_;
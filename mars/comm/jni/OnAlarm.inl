@@ -10,6 +10,6 @@
 
 extern "C" JNIEXPORT void JNICALL Java_com_tencent_mars_comm_Alarm_onAlarm(JNIEnv *, jclass, jlong id)
 {
-    xdebug2(TSF"BroadcastMessage seq:%_", (int64_t)id);
-    MessageQueue::BroadcastMessage(MessageQueue::GetDefMessageQueue(), MessageQueue::Message(KALARM_MESSAGETITLE, (int64_t)id, 0, "KALARM_MESSAGETITLE.id"));
+    xdebug2(TSF"platform alarm id:%_", (int64_t)id);
+    TimingWheel::Shared().OnPlatformAlarm((int64_t)id);
 }
@@ -1,7 +1,7 @@
 // Tencent is pleased to support the open source community by making Mars available.
 // Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
 
-// Licensed under the MIT License (the "License"); you may not use this file except in 
+// Licensed under the MIT License (the "License"); you may not use this file except in
 // compliance with the License. You may obtain a copy of the License at
 // http://opensource.org/licenses/MIT
 
@@ -18,18 +18,46 @@
     author:     Ray
 *********************************************************************/
 
+/*
+ * the live allocations are in a hash table keyed by address, split in shards with a lock each,
+ * so neither threads nor the number of live allocations make a free expensive.
+ * every record counts towards the call site that made it, the sites of a shard are in the shard
+ * and only merged when dumped.
+ * with a sample period set, allocations are sampled as a poisson process over the allocated bytes,
+ * a sampled one stands for the bytes expected to be allocated for each one sampled of its size.
+ *
+ * nothing here allocates through new, operator delete comes back here and would take a shard lock again.
+ */
+
 #include "comm/assert/__assert.h"
 
 #ifdef DEBUG
 #include <stdlib.h>
 #include <stdio.h>
-#include <assert.h>
-#include <vector>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
 
 #ifdef ANDROID
 #include <unistd.h>
 #endif
+#include "mars/boost/bind.hpp"
+#include "mars/comm/thread/atomic_oper.h"
+#include "mars/comm/thread/lock.h"
+#include "mars/comm/thread/spinlock.h"
+#include "mars/comm/thread/thread.h"
 #include "mars/comm/xlogger/xlogger.h"
+#endif
+
+#include "comm/memdbg.h"
+
+#ifdef DEBUG
+// the macros are for the code being traced
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+#undef new
 
 enum TMemoryType {
     ECType = 0,
@@ -43,50 +71,198 @@ const char* gs_typename[] = {
     "ECPPArrayType"
 };
 
+static const size_t kShardCount = 64;
+static const size_t kMemBuckets = 4096;   // per shard
+static const size_t kSiteBuckets = 256;   // per shard
+static const size_t kLeakDataLen = 100;
+
+struct CallSite {
+    memdbg_site_t   stat;
+    CallSite*       next;
+};
+
 struct CrtMem {
-    const char*                _crtFileName;
-    int                        _crtLine;
-    const char*                _crtFuncName;
-    void*                    _crtMemAddr;
-    size_t                  _crtMemLen;
-    TMemoryType                _crtMemoryType;
+    void*           _crtMemAddr;
+    size_t          _crtMemLen;
+    uint64_t        _crtWeight;  // bytes it stands for, its length unless sampled
+    TMemoryType     _crtMemoryType;
+    CallSite*       _crtSite;
+    CrtMem*         _next;
+};
 
+struct Shard {
+    SpinLock        lock;  // unlocked is all zero, a free before the static init finds it usable
+    CrtMem*         mems[kMemBuckets];
+    CallSite*       sites[kSiteBuckets];
 };
 
-static std::vector<CrtMem> gs_CrtMemRoot;
+static Shard gs_shards[kShardCount];
+static volatile uint32_t gs_sample_period = 0;
+static volatile uint32_t gs_bytes_to_sample = 0;
+static uint64_t gs_random = 88172645463325252ULL;
+static volatile uint32_t gs_dump_top = 0;
+
+static size_t __AddrHash(const void* _p) {
+    return (size_t)((((uint64_t)(uintptr_t)_p >> 4) * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+static Shard& __ShardOf(size_t _hash) {
+    return gs_shards[_hash % kShardCount];
+}
+
+static CrtMem*& __BucketOf(size_t _hash) {
+    return __ShardOf(_hash).mems[_hash / kShardCount % kMemBuckets];
+}
+
+static uint64_t __Count(const CrtMem& _mem) {
+    return 0 == _mem._crtMemLen ? 1 : std::max(_mem._crtWeight / _mem._crtMemLen, (uint64_t)1);
+}
+
+// called with the shard locked
+static CallSite* __FindSite(Shard& _shard, const char* _filename, int _line, const char* _func) {
+    CallSite*& bucket = _shard.sites[(((uintptr_t)_filename >> 3) * 31 + _line) % kSiteBuckets];
+
+    for (CallSite* site = bucket; NULL != site; site = site->next) {
+        if (_filename == site->stat.filename && _line == site->stat.line && _func == site->stat.func) return site;
+    }
+
+    CallSite* site = (CallSite*)malloc(sizeof(CallSite));
+    if (NULL == site) return NULL;
+
+    memset(site, 0, sizeof(CallSite));
+    site->stat.filename = _filename;
+    site->stat.line = _line;
+    site->stat.func = _func;
+    site->next = bucket;
+    bucket = site;
+    return site;
+}
+
+static uint32_t __NextSampleInterval(uint32_t _period) {
+    // xorshift, threads racing on it only draw the same number twice
+    uint64_t x = gs_random;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    gs_random = x;
+
+    double u = ((x >> 11) + 1) * (1.0 / 9007199254740992.0);  // (0, 1]
+    double interval = -log(u) * _period;
+    if (1 > interval) return 1;
+    if (0xFFFF0000u < interval) return 0xFFFF0000u;
+    return (uint32_t)interval;
+}
+
+static bool __Sample(size_t _size, uint64_t& _weight) {
+    uint32_t period = atomic_read32(&gs_sample_period);
+    _weight = _size;
+    if (0 == period) return true;
+
+    while (true) {
+        uint32_t left = atomic_read32(&gs_bytes_to_sample);
+
+        if (left > _size) {
+            if (left == atomic_cas32(&gs_bytes_to_sample, left - (uint32_t)_size, left)) return false;
+            continue;
+        }
+
+        if (left == atomic_cas32(&gs_bytes_to_sample, __NextSampleInterval(period), left)) break;
+    }
+
+    // one of _size bytes is sampled with 1 - exp(-_size / period)
+    double probability = 1 - exp(-(double)_size / period);
+    if (0 < probability) _weight = (uint64_t)(_size / probability + 0.5);
+    return true;
+}
 
 static void __LogAlloc(void* _retp, size_t _size, const char* _filename, int _line, const char* _func, TMemoryType _type) {
     ASSERT(_retp);
 
-    CrtMem crtMemCell;
-    crtMemCell._crtFileName   = _filename;
-    crtMemCell._crtLine       = _line;
-    crtMemCell._crtFuncName   = _func;
-    crtMemCell._crtMemAddr    = _retp;
-    crtMemCell._crtMemLen     = _size;
-    crtMemCell._crtMemoryType = _type;
+    uint64_t weight = 0;
+    if (!__Sample(_size, weight)) return;
 
+    CrtMem* crtMemCell = (CrtMem*)malloc(sizeof(CrtMem));
+    if (NULL == crtMemCell) return;
 
-    gs_CrtMemRoot.push_back(crtMemCell);
+    crtMemCell->_crtMemAddr    = _retp;
+    crtMemCell->_crtMemLen     = _size;
+    crtMemCell->_crtWeight     = weight;
+    crtMemCell->_crtMemoryType = _type;
+
+    size_t hash = __AddrHash(_retp);
+    Shard& shard = __ShardOf(hash);
+    ScopedSpinLock lock(shard.lock);
+
+    crtMemCell->_crtSite = __FindSite(shard, _filename, _line, _func);
+    if (NULL == crtMemCell->_crtSite) {
+        lock.unlock();
+        free(crtMemCell);
+        return;
+    }
+
+    CrtMem*& bucket = __BucketOf(hash);
+    crtMemCell->_next = bucket;
+    bucket = crtMemCell;
+
+    memdbg_site_t& stat = crtMemCell->_crtSite->stat;
+    stat.live_count  += __Count(*crtMemCell);
+    stat.live_bytes  += weight;
+    stat.total_count += __Count(*crtMemCell);
+    stat.total_bytes += weight;
 }
 
 static void __DeleteLogAlloc(void* _p, const char* _filename, int _line, const char* _func, TMemoryType _type) {
-    for (std::vector<CrtMem>::iterator it = gs_CrtMemRoot.begin(); it != gs_CrtMemRoot.end(); ++it) {
-        if (_p == it->_crtMemAddr) {
-            if (_type != it->_crtMemoryType) {
-                XMessage strstream;
-                strstream << "\n[" << it->_crtFileName << ", " << it->_crtLine << ", " << it->_crtFuncName << "]"
-                          << "alloc type is: " << gs_typename[it->_crtMemoryType] << "\n"
-                          << "[" << _filename << ", " << _line << ", " << _func << "]"
-                          << "dealloc type is: " << gs_typename[_type] << "\n";
-
-                __ASSERT(__FILE__, __LINE__, __FUNCTION__, strstream.String().c_str());
-            }
+    size_t hash = __AddrHash(_p);
+    CrtMem* found = NULL;
+
+    {
+        ScopedSpinLock lock(__ShardOf(hash).lock);
 
-            gs_CrtMemRoot.erase(it);
+        for (CrtMem** it = &__BucketOf(hash); NULL != *it; it = &(*it)->_next) {
+            if (_p != (*it)->_crtMemAddr) continue;
+
+            found = *it;
+            *it = found->_next;
+            found->_crtSite->stat.live_count -= __Count(*found);
+            found->_crtSite->stat.live_bytes -= found->_crtWeight;
             break;
         }
     }
+
+    // not sampled, or not allocated through here
+    if (NULL == found) return;
+
+    if (_type != found->_crtMemoryType) {
+        const memdbg_site_t& stat = found->_crtSite->stat;  // sites are never freed
+        XMessage strstream;
+        strstream << "\n[" << stat.filename << ", " << stat.line << ", " << stat.func << "]"
+                  << "alloc type is: " << gs_typename[found->_crtMemoryType] << "\n"
+                  << "[" << _filename << ", " << _line << ", " << _func << "]"
+                  << "dealloc type is: " << gs_typename[_type] << "\n";
+
+        __ASSERT(__FILE__, __LINE__, __FUNCTION__, strstream.String().c_str());
+    }
+
+    free(found);
+}
+
+static bool __SiteLess(const memdbg_site_t& _l, const memdbg_site_t& _r) {
+    if (_l.filename != _r.filename) return _l.filename < _r.filename;
+    if (_l.line != _r.line) return _l.line < _r.line;
+    return _l.func < _r.func;
+}
+
+static bool __MoreLiveBytes(const memdbg_site_t& _l, const memdbg_site_t& _r) {
+    return _l.live_bytes > _r.live_bytes;
+}
+
+static void __DumpSitesPeriodic() {
+    DumpMemorySites(atomic_read32(&gs_dump_top));
+}
+
+static Thread& __DumpThread() {
+    static Thread* thread = new Thread(boost::bind(&__DumpSitesPeriodic), "memdbg_dump");
+    return *thread;
 }
 
 extern "C" {
@@ -102,7 +278,8 @@ extern "C" {
 
     void* calloc_dbg(size_t _num, size_t _size, const char* _filename, int _line, const char* _func) {
         void* ret = calloc(_num, _size);
-        __LogAlloc(ret, _num * _size, _filename, _line, _func, ECType);
+        if (ret)
+            __LogAlloc(ret, _num * _size, _filename, _line, _func, ECType);
         return ret;
     }
 
@@ -181,31 +358,158 @@ void operator delete[](void* _p, size_t /*_size*/) {
     free(_p);
 }
 
+extern "C" void SetMemorySamplePeriod(size_t _bytes) {
+    uint32_t period = (uint32_t)std::min(_bytes, (size_t)0xFFFF0000u);
+    atomic_write32(&gs_bytes_to_sample, 0 == period ? 0 : __NextSampleInterval(period));
+    atomic_write32(&gs_sample_period, period);
+}
+
+extern "C" size_t GetMemorySites(struct memdbg_site_t* _sites, size_t _count) {
+    if (0 == _count) return 0;
+
+    memdbg_site_t* all = NULL;
+    size_t size = 0, capacity = 0;
+
+    for (size_t i = 0; i < kShardCount; ++i) {
+        ScopedSpinLock lock(gs_shards[i].lock);
+
+        for (size_t j = 0; j < kSiteBuckets; ++j) {
+            for (CallSite* site = gs_shards[i].sites[j]; NULL != site; site = site->next) {
+                if (size == capacity) {
+                    size_t grow = 0 == capacity ? 256 : capacity * 2;
+                    memdbg_site_t* grown = (memdbg_site_t*)realloc(all, grow * sizeof(memdbg_site_t));
+                    if (NULL == grown) break;
+                    all = grown;
+                    capacity = grow;
+                }
+                all[size++] = site->stat;
+            }
+        }
+    }
+
+    // the same site from different shards
+    std::sort(all, all + size, &__SiteLess);
+    size_t merged = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (0 < merged && !__SiteLess(all[merged - 1], all[i])) {
+            all[merged - 1].live_count  += all[i].live_count;
+            all[merged - 1].live_bytes  += all[i].live_bytes;
+            all[merged - 1].total_count += all[i].total_count;
+            all[merged - 1].total_bytes += all[i].total_bytes;
+        } else {
+            all[merged++] = all[i];
+        }
+    }
+
+    size_t count = std::min(_count, merged);
+    std::partial_sort(all, all + count, all + merged, &__MoreLiveBytes);
+    if (0 < count) memcpy(_sites, all, count * sizeof(memdbg_site_t));
+    free(all);
+    return count;
+}
+
+extern "C" void DumpMemorySites(size_t _top) {
+    memdbg_site_t* sites = (memdbg_site_t*)malloc(std::max(_top, (size_t)1) * sizeof(memdbg_site_t));
+    if (NULL == sites) return;
+
+    size_t count = GetMemorySites(sites, _top);
+    uint64_t live_bytes = 0;
+    for (size_t i = 0; i < count; ++i) live_bytes += sites[i].live_bytes;
+
+    xinfo2(TSF"memdbg top %_ sites, live:%_ bytes, sample period:%_", count, live_bytes, atomic_read32(&gs_sample_period));
+    for (size_t i = 0; i < count; ++i) {
+        xinfo2(TSF"memdbg [%_, %_, %_] live:%_ bytes in %_ blocks, total:%_ bytes in %_ blocks", sites[i].filename, sites[i].line, sites[i].func,
+               sites[i].live_bytes, sites[i].live_count, sites[i].total_bytes, sites[i].total_count);
+    }
+
+    free(sites);
+}
+
+extern "C" void StartMemorySitesDump(int _interval, size_t _top) {
+    StopMemorySitesDump();
+
+    atomic_write32(&gs_dump_top, (uint32_t)_top);
+    __DumpThread().start_periodic(_interval, _interval);
+}
+
+extern "C" void StopMemorySitesDump() {
+    if (!__DumpThread().isruning()) return;
+
+    __DumpThread().cancel_periodic();
+    __DumpThread().join();
+}
+
+#else
+
+extern "C" void SetMemorySamplePeriod(size_t _bytes) {}
+extern "C" size_t GetMemorySites(struct memdbg_site_t* _sites, size_t _count) { return 0; }
+extern "C" void DumpMemorySites(size_t _top) {}
+extern "C" void StartMemorySitesDump(int _interval, size_t _top) {}
+extern "C" void StopMemorySitesDump() {}
+
 #endif
 
 extern "C" void DumpMemoryLeaks(void (* _pfunoutput)(const char*)) {
     ASSERT(_pfunoutput);
 #ifdef DEBUG
 
-    if (gs_CrtMemRoot.empty()) {
+    struct Leak {
+        memdbg_site_t   site;
+        void*           addr;
+        size_t          len;
+        TMemoryType     type;
+        char            data[kLeakDataLen];
+    };
+
+    Leak* leaks = NULL;
+    size_t size = 0, capacity = 0;
+
+    // copied with the shard locked, the blocks can not be freed meanwhile
+    for (size_t i = 0; i < kShardCount; ++i) {
+        ScopedSpinLock lock(gs_shards[i].lock);
+
+        for (size_t j = 0; j < kMemBuckets; ++j) {
+            for (CrtMem* it = gs_shards[i].mems[j]; NULL != it; it = it->_next) {
+                if (size == capacity) {
+                    size_t grow = 0 == capacity ? 256 : capacity * 2;
+                    Leak* grown = (Leak*)realloc(leaks, grow * sizeof(Leak));
+                    if (NULL == grown) break;
+                    leaks = grown;
+                    capacity = grow;
+                }
+
+                Leak& leak = leaks[size++];
+                leak.site = it->_crtSite->stat;
+                leak.addr = it->_crtMemAddr;
+                leak.len = it->_crtMemLen;
+                leak.type = it->_crtMemoryType;
+                memcpy(leak.data, it->_crtMemAddr, std::min(it->_crtMemLen, kLeakDataLen));
+            }
+        }
+    }
+
+    if (0 == size) {
+        free(leaks);
         _pfunoutput("No memory leaks detected!\n");
         return;
     }
 
     XMessage strstream;
     strstream << "Detected memory leaks!\n";
+    if (0 != atomic_read32(&gs_sample_period)) strstream << "sampled, one in about every " << atomic_read32(&gs_sample_period) << " bytes is here\n";
     strstream << "<--------------------------------Dumping objects-------------------------------->\n";
 
-    for (std::vector<CrtMem>::iterator it = gs_CrtMemRoot.begin(); it != gs_CrtMemRoot.end(); ++it) {
-        strstream << "[" << it->_crtFileName << ", " << it->_crtLine << ", " << it->_crtFuncName << "]"
-                  << ": block at " << it->_crtMemAddr << ", type= " << gs_typename[it->_crtMemoryType] << ", " << it->_crtMemLen
+    for (size_t i = 0; i < size; ++i) {
+        const Leak& leak = leaks[i];
+        strstream << "[" << leak.site.filename << ", " << leak.site.line << ", " << leak.site.func << "]"
+                  << ": block at " << leak.addr << ", type= " << gs_typename[leak.type] << ", " << leak.len
                   << " bytes long\n Data <";
 
-        size_t length = it->_crtMemLen < 100 ? it->_crtMemLen : 50;
+        size_t length = leak.len < 100 ? leak.len : 50;
         char buf[12];
 
-        for (unsigned int i = 0; i < length; ++i) {
-            snprintf(buf, sizeof(buf), "%c", *(((char*)it->_crtMemAddr) + i));
+        for (unsigned int j = 0; j < length; ++j) {
+            snprintf(buf, sizeof(buf), "%c", leak.data[j]);
             strstream << buf;
         }
 
@@ -215,6 +519,7 @@ extern "C" void DumpMemoryLeaks(void (* _pfunoutput)(const char*)) {
     }
 
     strstream << "<--------------------------------Dump end----------------------------------->\n";
+    free(leaks);
     _pfunoutput(strstream.String().c_str());
 #else
     _pfunoutput("Notice memdbg isn't running, because \"NO DEBUG\" was defined");
@@ -47,8 +47,8 @@
 void* operator new(size_t _size, const char* _filename, int _line, const char* _func);
 void* operator new[](size_t _size, const char* _filename, int _line, const char* _func);
 
-void operator delete(void* _p);
-void operator delete[](void* _p);
+void operator delete(void* _p) throw();
+void operator delete[](void* _p) throw();
 
 void operator delete(void* _p, size_t _size);
 void operator delete[](void* _p, size_t _size);
@@ -77,12 +77,37 @@ void  free_dbg(void* _p, const char* _filename, int _line, const char* _func);
 // #define  new(poject) new(poject, __FILE__, __LINE__, __MEMDBG_FUNCTION__)
 #endif  //
 
+#include <stddef.h>
+#include <stdint.h>
+
+struct memdbg_site_t {
+    const char* filename;
+    int         line;
+    const char* func;
+    uint64_t    live_count;   // blocks, estimated when sampled
+    uint64_t    live_bytes;
+    uint64_t    total_count;
+    uint64_t    total_bytes;
+};
+
 #ifdef  __cplusplus
 extern "C" {
 #endif
 
 void DumpMemoryLeaks(void (*)(const char*));
 
+// 0 records every allocation, the default.
+// otherwise about one in every _bytes allocated is recorded, the leaks are only the recorded ones
+// and the sites are estimates scaled up from them
+void SetMemorySamplePeriod(size_t _bytes);
+// the _count sites holding the most live memory, returns how many were filled in
+size_t GetMemorySites(struct memdbg_site_t* _sites, size_t _count);
+// the _top sites through xlog
+void DumpMemorySites(size_t _top);
+// DumpMemorySites every _interval ms until stopped
+void StartMemorySitesDump(int _interval, size_t _top);
+void StopMemorySitesDump();
+
 #ifdef  __cplusplus
 }
 #endif
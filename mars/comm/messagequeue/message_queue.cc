@@ -20,6 +20,7 @@
 
 #include <map>
 #include <list>
+#include <vector>
 #include <string>
 #include <algorithm>
 #ifndef _WIN32
@@ -61,6 +62,7 @@ struct MessageWrapper {
         postid.seq = _seq;
         periodstatus = kImmediately;
         record_time = 0;
+        post_time = ::gettickcount();
 
         if (kImmediately != _timing.type) {
             periodstatus = kAfter;
@@ -79,6 +81,7 @@ struct MessageWrapper {
     MessageTiming timing;
     TMessageTiming periodstatus;
     uint64_t record_time;
+    uint64_t post_time;
     boost::shared_ptr<Condition> wait_end_cond;
 };
 
@@ -95,12 +98,13 @@ struct HandlerWrapper {
 };
 
 struct RunLoopInfo {
-    RunLoopInfo():runing_message(NULL) { runing_cond = boost::make_shared<Condition>();}
+    RunLoopInfo():runing_message(NULL), slow_reported(false) { runing_cond = boost::make_shared<Condition>();}
     
     boost::shared_ptr<Condition> runing_cond;
     MessagePost_t runing_message_id;
     Message* runing_message;
     std::list <MessageHandler_t> runing_handler;
+    bool slow_reported;
 };
     
 class Cond : public RunloopCond {
@@ -127,11 +131,17 @@ private:
     Condition cond_;
 };
     
+// the histograms are filled by the runloop after each message, under their own lock rather than the map's
+struct MessageQueueStatHolder {
+    Mutex mutex;
+    MessageQueueStat stat;
+};
+
 struct MessageQueueContent {
-    MessageQueueContent(): breakflag(false) {}
+    MessageQueueContent(): breakflag(false), stat(boost::make_shared<MessageQueueStatHolder>()), depth_high_water(0), slow_count(0) {}
 
 #if defined(ANDROID)
-    MessageQueueContent(const MessageQueueContent&): breakflag(false) { /*ASSERT(false);*/ }
+    MessageQueueContent(const MessageQueueContent&): breakflag(false), stat(boost::make_shared<MessageQueueStatHolder>()), depth_high_water(0), slow_count(0) { /*ASSERT(false);*/ }
 #endif
 
     MessageHandler_t invoke_reg;
@@ -141,6 +151,10 @@ struct MessageQueueContent {
     std::list<HandlerWrapper*> lst_handler;
     
     std::list<RunLoopInfo> lst_runloop_info;
+
+    boost::shared_ptr<MessageQueueStatHolder> stat;
+    size_t depth_high_water;  // these two change under the map lock anyway
+    uint64_t slow_count;
     
 private:
     void operator=(const MessageQueueContent&);
@@ -188,6 +202,205 @@ std::string DumpMQ(const MessageQueue_t& _msq_queue_id) {
     return DumpMessage(content.lst_message);
 }
 
+void MessageHistogram::Add(uint64_t _value) {
+    int index = 0;
+    while (index < kMQHistogramBuckets - 1 && 0 < (_value >> index)) ++index;
+
+    ++buckets[index];
+    ++count;
+    total += _value;
+    if (_value > max) max = _value;
+}
+
+uint64_t MessageHistogram::Percentile(double _percent) const {
+    if (0 == count) return 0;
+
+    uint64_t target = (uint64_t)(count * _percent / 100);
+    if (target >= count) target = count - 1;
+
+    uint64_t accumulate = 0;
+    for (int i = 0; i < kMQHistogramBuckets - 1; ++i) {
+        accumulate += buckets[i];
+        if (accumulate > target) return std::min(((uint64_t)1) << i, max);
+    }
+    return max;
+}
+
+std::string MessageHistogram::ToString() const {
+    XMessage xmsg;
+    xmsg(TSF"count:%_, avg:%_, p50:%_, p90:%_, p99:%_, max:%_", count, 0 == count ? 0 : total / count, Percentile(50), Percentile(90), Percentile(99), max);
+    return xmsg.String();
+}
+
+std::string MessageQueueStat::ToString() const {
+    XMessage xmsg;
+    xmsg(TSF"depth_high_water:%_, slow_count:%_, dispatch_latency:(%_)", depth_high_water, slow_count, dispatch_latency.ToString());
+    for (std::map<std::string, MessageHistogram>::const_iterator it = handler_cost.begin(); it != handler_cost.end(); ++it) {
+        xmsg(TSF"\n%_:(%_)", it->first, it->second.ToString());
+    }
+    return xmsg.String();
+}
+
+static void __UpdateDepthHighWater(MessageQueueContent& _content) {
+    if (_content.lst_message.size() > _content.depth_high_water)
+        _content.depth_high_water = _content.lst_message.size();
+}
+
+static void __SnapshotStat(const boost::shared_ptr<MessageQueueStatHolder>& _holder, size_t _depth_high_water, uint64_t _slow_count, MessageQueueStat& _stat) {
+    ScopedLock lock(_holder->mutex);
+    _stat = _holder->stat;
+    _stat.depth_high_water = _depth_high_water;
+    _stat.slow_count = _slow_count;
+}
+
+bool GetMessageQueueStat(const MessageQueue_t& _messagequeueid, MessageQueueStat& _stat) {
+    ScopedLock lock(sg_messagequeue_map_mutex);
+
+    std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(_messagequeueid);
+    if (sg_messagequeue_map.end() == pos) return false;
+
+    boost::shared_ptr<MessageQueueStatHolder> holder = pos->second.stat;
+    size_t depth_high_water = pos->second.depth_high_water;
+    uint64_t slow_count = pos->second.slow_count;
+    lock.unlock();
+
+    __SnapshotStat(holder, depth_high_water, slow_count, _stat);
+    return true;
+}
+
+void ResetMessageQueueStat(const MessageQueue_t& _messagequeueid) {
+    ScopedLock lock(sg_messagequeue_map_mutex);
+
+    std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(_messagequeueid);
+    if (sg_messagequeue_map.end() == pos) return;
+
+    pos->second.depth_high_water = 0;
+    pos->second.slow_count = 0;
+    boost::shared_ptr<MessageQueueStatHolder> holder = pos->second.stat;
+    lock.unlock();
+
+    ScopedLock stat_lock(holder->mutex);
+    holder->stat = MessageQueueStat();
+}
+
+std::string DumpMQStat(const MessageQueue_t& _messagequeueid) {
+    MessageQueueStat stat;
+    if (!GetMessageQueueStat(_messagequeueid, stat)) return "";
+    return stat.ToString();
+}
+
+#ifdef ANR_CHECK_DISABLE
+static int64_t sg_slow_handler_ms = 10 * 1000;
+#else
+static int64_t sg_slow_handler_ms = 0;
+#endif
+static int64_t sg_stat_dump_interval_ms = 0;
+static uint64_t sg_last_stat_dump = 0;
+static bool sg_watchdog_started = false;
+
+struct SlowHandler {
+    MessageQueue_t queue;
+    MessagePost_t post;
+    std::string msg_name;
+    uint64_t execute_time;
+    int64_t cost;
+};
+
+struct StatDump {
+    MessageQueue_t queue;
+    boost::shared_ptr<MessageQueueStatHolder> holder;
+    size_t depth_high_water;
+    uint64_t slow_count;
+};
+
+static void __WatchdogCheck() {
+    // collected under the map lock, formatted and logged without it
+    std::vector<SlowHandler> slow_handlers;
+    std::vector<StatDump> dumps;
+
+    ScopedLock lock(sg_messagequeue_map_mutex);
+
+    bool dump = 0 < sg_stat_dump_interval_ms && sg_stat_dump_interval_ms <= ::gettickspan(sg_last_stat_dump);
+    if (dump) sg_last_stat_dump = ::gettickcount();
+
+    for (std::map<MessageQueue_t, MessageQueueContent>::iterator it = sg_messagequeue_map.begin(); it != sg_messagequeue_map.end(); ++it) {
+        MessageQueueContent& content = it->second;
+
+        for (std::list<RunLoopInfo>::iterator info = content.lst_runloop_info.begin(); 0 < sg_slow_handler_ms && info != content.lst_runloop_info.end(); ++info) {
+            if (NULL == info->runing_message || info->slow_reported) continue;
+
+            int64_t cost = ::gettickspan(info->runing_message->execute_time);
+            if (cost < sg_slow_handler_ms) continue;
+
+            info->slow_reported = true;
+            ++content.slow_count;
+
+            SlowHandler slow = {it->first, info->runing_message_id, info->runing_message->msg_name, info->runing_message->execute_time, cost};
+            slow_handlers.push_back(slow);
+        }
+
+        if (dump) {
+            StatDump stat_dump = {it->first, content.stat, content.depth_high_water, content.slow_count};
+            dumps.push_back(stat_dump);
+        }
+    }
+
+    lock.unlock();
+
+    for (std::vector<SlowHandler>::iterator it = slow_handlers.begin(); it != slow_handlers.end(); ++it) {
+        xwarn2(TSF"slow handler, queue:%_, post:%_, msg_name:%_, execute_time:%_, cost:%_", it->queue, it->post.ToString(), it->msg_name, it->execute_time, it->cost);
+    }
+
+    for (std::vector<StatDump>::iterator it = dumps.begin(); it != dumps.end(); ++it) {
+        MessageQueueStat stat;
+        __SnapshotStat(it->holder, it->depth_high_water, it->slow_count, stat);
+        xinfo2(TSF"mq stat, queue:%_, %_", it->queue, stat.ToString());
+    }
+}
+
+static Mutex& watchdog_mutex() {
+    static Mutex* mutex = new Mutex;
+    return *mutex;
+}
+
+static void __RestartWatchdog() {
+    static Thread* s_watchdog = new Thread(&__WatchdogCheck, "mq_watchdog");
+
+    if (s_watchdog->isruning()) {
+        s_watchdog->cancel_periodic();
+        s_watchdog->join();
+    }
+
+    ScopedLock lock(sg_messagequeue_map_mutex);
+    int64_t tick = 0;
+    if (0 < sg_slow_handler_ms) tick = std::max(sg_slow_handler_ms / 2, (int64_t)100);
+    if (0 < sg_stat_dump_interval_ms) tick = 0 < tick ? std::min(tick, sg_stat_dump_interval_ms) : sg_stat_dump_interval_ms;
+    sg_last_stat_dump = ::gettickcount();
+    lock.unlock();
+
+    if (0 < tick) s_watchdog->start_periodic(tick, tick);
+}
+
+static void __StartWatchdogOnce() {
+    ScopedLock lock(watchdog_mutex());
+    if (sg_watchdog_started) return;
+
+    sg_watchdog_started = true;
+    __RestartWatchdog();
+}
+
+void SetMessageQueueWatchdog(int64_t _slow_handler_ms, int64_t _dump_interval_ms) {
+    ScopedLock lock(watchdog_mutex());
+    {
+        ScopedLock map_lock(sg_messagequeue_map_mutex);
+        sg_slow_handler_ms = _slow_handler_ms;
+        sg_stat_dump_interval_ms = _dump_interval_ms;
+    }
+
+    sg_watchdog_started = true;
+    __RestartWatchdog();
+}
+
 MessageQueue_t CurrentThreadMessageQueue() {
     ScopedLock lock(sg_messagequeue_map_mutex);
     MessageQueue_t id = (MessageQueue_t)ThreadUtil::currentthreadid();
@@ -351,6 +564,7 @@ MessagePost_t PostMessage(const MessageHandler_t& _handlerid, const Message& _me
     MessageWrapper* messagewrapper = new MessageWrapper(_handlerid, _message, _timing, __MakeSeq());
 
     content.lst_message.push_back(messagewrapper);
+    __UpdateDepthHighWater(content);
     content.breaker->Notify(lock);
     return messagewrapper->postid;
 }
@@ -387,6 +601,7 @@ MessagePost_t SingletonMessage(bool _replace, const MessageHandler_t& _handlerid
 
     MessageWrapper* messagewrapper = new MessageWrapper(_handlerid, _message, _timing, 0 != post_id.seq ? post_id.seq : __MakeSeq());
     content.lst_message.push_back(messagewrapper);
+    __UpdateDepthHighWater(content);
     content.breaker->Notify(lock);
     return messagewrapper->postid;
 }
@@ -414,6 +629,7 @@ MessagePost_t BroadcastMessage(const MessageQueue_t& _messagequeueid,  const Mes
     MessageWrapper* messagewrapper = new MessageWrapper(reg, _message, _timing, __MakeSeq());
 
     content.lst_message.push_back(messagewrapper);
+    __UpdateDepthHighWater(content);
     content.breaker->Notify(lock);
     return messagewrapper->postid;
 }
@@ -471,6 +687,7 @@ MessagePost_t FasterMessage(const MessageHandler_t& _handlerid, const Message& _
         return KNullPost;
     }
     content.lst_message.push_back(messagewrapper);
+    __UpdateDepthHighWater(content);
     content.breaker->Notify(lock);
     return messagewrapper->postid;
 }
@@ -767,12 +984,15 @@ BOOT_RUN_EXIT(__UnregisterANRCheckCallback);
 void RunLoop::Run() {
     MessageQueue_t id = CurrentThreadMessageQueue();
     ASSERT(0 != id);
+    boost::shared_ptr<MessageQueueStatHolder> stat;
     {
         ScopedLock lock(sg_messagequeue_map_mutex);
         sg_messagequeue_map[id].lst_runloop_info.push_back(RunLoopInfo());
+        stat = sg_messagequeue_map[id].stat;
     }
     
     xinfo_function(TSF"messagequeue id:%_", id);
+    __StartWatchdogOnce();
 
     while (true) {
         ScopedLock lock(sg_messagequeue_map_mutex);
@@ -780,6 +1000,7 @@ void RunLoop::Run() {
         content.lst_runloop_info.back().runing_message_id = KNullPost;
         content.lst_runloop_info.back().runing_message = NULL;
         content.lst_runloop_info.back().runing_handler.clear();
+        content.lst_runloop_info.back().slow_reported = false;
         content.lst_runloop_info.back().runing_cond->notifyAll(lock);
         
         if (duty_func_) duty_func_();
@@ -794,10 +1015,12 @@ void RunLoop::Run() {
         int64_t wait_time = 10 * 60 * 1000;
         MessageWrapper* messagewrapper = NULL;
         bool delmessage = true;
+        int64_t latency = 0;
 
         for (std::list<MessageWrapper*>::iterator it = content.lst_message.begin(); it != content.lst_message.end(); ++it) {
             if (kImmediately == (*it)->timing.type) {
                 messagewrapper = *it;
+                latency = ::gettickspan((*it)->post_time);
                 content.lst_message.erase(it);
                 break;
             } else if (kAfter == (*it)->timing.type) {
@@ -805,6 +1028,7 @@ void RunLoop::Run() {
 
                 if ((*it)->timing.after <= time_cost) {
                     messagewrapper = *it;
+                    latency = time_cost - (*it)->timing.after;
                     content.lst_message.erase(it);
                     break;
                 } else {
@@ -816,6 +1040,7 @@ void RunLoop::Run() {
 
                     if ((*it)->timing.after <= time_cost) {
                         messagewrapper = *it;
+                        latency = time_cost - (*it)->timing.after;
                         (*it)->record_time = ::gettickcount();
                         (*it)->periodstatus = kPeriod;
                         delmessage = false;
@@ -828,6 +1053,7 @@ void RunLoop::Run() {
 
                     if ((*it)->timing.period <= time_cost) {
                         messagewrapper = *it;
+                        latency = time_cost - (*it)->timing.period;
                         (*it)->record_time = ::gettickcount();
                         delmessage = false;
                         break;
@@ -859,14 +1085,17 @@ void RunLoop::Run() {
         content.lst_runloop_info.back().runing_message_id = messagewrapper->postid;
         content.lst_runloop_info.back().runing_message = &messagewrapper->message;
         int64_t anr_timeout = messagewrapper->message.anr_timeout;
+        messagewrapper->message.execute_time = ::gettickcount();
         lock.unlock();
 
-        messagewrapper->message.execute_time = ::gettickcount();
+        uint64_t cost = 0;
+
         for (std::list<HandlerWrapper>::iterator it = fit_handler.begin(); it != fit_handler.end(); ++it) {
             SCOPE_ANR_AUTO((int)anr_timeout, kMQCallANRId, &(*it).reg);
             uint64_t timestart = ::clock_app_monotonic();
             (*it).handler(messagewrapper->postid, messagewrapper->message);
             uint64_t timeend = ::clock_app_monotonic();
+            cost += timeend - timestart;
 #if defined(DEBUG) && defined(__APPLE__)
 
             if (!isDebuggerPerforming())
@@ -874,6 +1103,12 @@ void RunLoop::Run() {
                 ASSERT2(0 >= anr_timeout || anr_timeout >= (int64_t)(timeend - timestart), "anr_timeout:%" PRId64 " < cost:%" PRIu64", timestart:%" PRIu64", timeend:%" PRIu64, anr_timeout, timeend - timestart, timestart, timeend);
         }
 
+        {
+            ScopedLock stat_lock(stat->mutex);
+            stat->stat.dispatch_latency.Add((uint64_t)latency);
+            stat->stat.handler_cost[messagewrapper->message.msg_name].Add(cost);
+        }
+
         if (delmessage) {
             delete messagewrapper;
         }
@@ -23,6 +23,7 @@
 
 #include <string.h>
 #include <string>
+#include <map>
 
 #include "boost/function.hpp"
 #include "boost/any.hpp"
@@ -215,6 +216,40 @@ void CancelMessage(const MessageHandler_t& _handlerid);
 void CancelMessage(const MessageHandler_t& _handlerid, const MessageTitle_t& _title);
 
 std::string DumpMQ(const MessageQueue_t& _msq_queue_id);
+
+//statistic collected by RunLoop::Run, time in ms
+const int kMQHistogramBuckets = 16;  // [0,1), [1,2), [2,4) ... [16384, +inf)
+
+struct MessageHistogram {
+    MessageHistogram(): count(0), total(0), max(0) { memset(buckets, 0, sizeof(buckets)); }
+    void Add(uint64_t _value);
+    uint64_t Percentile(double _percent) const;  // upper bound of the bucket holding the percentile
+    std::string ToString() const;
+
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t buckets[kMQHistogramBuckets];
+};
+
+struct MessageQueueStat {
+    MessageQueueStat(): depth_high_water(0), slow_count(0) {}
+    std::string ToString() const;
+
+    MessageHistogram dispatch_latency;  // enqueue (or due time for timing message) to dispatch
+    std::map<std::string, MessageHistogram> handler_cost;  // key: msg_name
+    size_t depth_high_water;
+    uint64_t slow_count;  // handlers caught by the watchdog
+};
+
+bool GetMessageQueueStat(const MessageQueue_t& _messagequeueid, MessageQueueStat& _stat);
+void ResetMessageQueueStat(const MessageQueue_t& _messagequeueid);
+std::string DumpMQStat(const MessageQueue_t& _messagequeueid);
+/*
+ * watchdog warns when a handler runs longer than _slow_handler_ms, and dumps stat of all queues to xlog every _dump_interval_ms.
+ * 0 disables each of them.
+ */
+void SetMessageQueueWatchdog(int64_t _slow_handler_ms, int64_t _dump_interval_ms);
 //AsyncInvoke
 MessageHandler_t InstallAsyncHandler(const MessageQueue_t& id);
 
@@ -0,0 +1,190 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in 
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+/*
+ * task_pool.cc
+ */
+
+#include "comm/messagequeue/task_pool.h"
+
+#include <stdio.h>
+#include <thread>
+
+#include "boost/bind.hpp"
+
+#include "comm/thread/atomic_oper.h"
+#include "comm/xlogger/xlogger.h"
+
+namespace MessageQueue {
+
+static const long kIdleWaitTime = 1000;  // ms, only a safety net, posts always wake an idle worker
+
+static int sg_default_worker_count = 0;
+
+TaskPool& TaskPool::Default() {
+    static TaskPool* s_pool = NULL;
+    static Mutex* s_mutex = new Mutex;
+
+    ScopedLock lock(*s_mutex);
+    if (NULL == s_pool) {
+        int count = sg_default_worker_count;
+        if (0 >= count) count = (int)std::thread::hardware_concurrency();
+        if (0 >= count) count = 1;
+        s_pool = new TaskPool(count, "default_task_pool");
+    }
+    return *s_pool;
+}
+
+void TaskPool::SetDefaultWorkerCount(int _count) {
+    sg_default_worker_count = _count;
+}
+
+TaskPool::TaskPool(int _worker_count, const char* _name)
+: name_(NULL == _name ? "" : _name), next_(0), pending_(0), idle_(0), stop_(false) {
+    ASSERT(0 < _worker_count);
+    if (0 >= _worker_count) _worker_count = 1;
+
+    for (int i = 0; i < _worker_count; ++i) {
+        char thread_name[64] = {0};
+        snprintf(thread_name, sizeof(thread_name), "%s_%d", name_.c_str(), i);
+
+        Worker* worker = new Worker;
+        worker->thread = new Thread(boost::bind(&TaskPool::__Run, this, i), thread_name);
+        workers_.push_back(worker);
+    }
+
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i]->thread->start();
+    }
+    xinfo2(TSF"task pool:%_ start, worker count:%_", name_, workers_.size());
+}
+
+TaskPool::~TaskPool() {
+    Stop();
+
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        delete workers_[i]->thread;
+        delete workers_[i];
+    }
+}
+
+bool TaskPool::Post(const AsyncInvokeFunction& _task) {
+    if (!_task) return false;
+
+    int index = __CurrentWorker();
+    if (0 > index) index = (int)(atomic_inc32(&next_) % workers_.size());
+
+    atomic_inc32(&pending_);
+    {
+        ScopedLock lock(workers_[index]->mutex);
+        if (stop_) {
+            atomic_dec32(&pending_);
+            return false;
+        }
+        workers_[index]->tasks.push_back(_task);
+    }
+
+    if (0 < atomic_read32(&idle_)) {
+        ScopedLock lock(sleep_mutex_);
+        sleep_cond_.notifyOne(lock);
+    }
+    return true;
+}
+
+void TaskPool::Stop() {
+    {
+        ScopedLock lock(sleep_mutex_);
+        if (stop_) return;
+        for (size_t i = 0; i < workers_.size(); ++i) {
+            ScopedLock worker_lock(workers_[i]->mutex);
+            stop_ = true;
+        }
+        sleep_cond_.notifyAll(lock);
+    }
+
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        if (workers_[i]->thread->tid() != ThreadUtil::currentthreadid())
+            workers_[i]->thread->join();
+    }
+    xinfo2(TSF"task pool:%_ stop, steal count:%_", name_, StealCount());
+}
+
+size_t TaskPool::PendingCount() const {
+    return atomic_read32(const_cast<volatile uint32_t*>(&pending_));
+}
+
+uint64_t TaskPool::StealCount() const {
+    uint64_t count = 0;
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        ScopedLock lock(workers_[i]->mutex);
+        count += workers_[i]->steal_count;
+    }
+    return count;
+}
+
+int TaskPool::__CurrentWorker() const {
+    thread_tid tid = ThreadUtil::currentthreadid();
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        if (workers_[i]->thread->tid() == tid) return (int)i;
+    }
+    return -1;
+}
+
+bool TaskPool::__Pop(int _index, AsyncInvokeFunction& _task) {
+    Worker& worker = *workers_[_index];
+    ScopedLock lock(worker.mutex);
+    if (worker.tasks.empty()) return false;
+
+    _task.swap(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+}
+
+bool TaskPool::__Steal(int _index, AsyncInvokeFunction& _task) {
+    for (size_t i = 1; i < workers_.size(); ++i) {
+        Worker& victim = *workers_[(_index + i) % workers_.size()];
+        ScopedLock lock(victim.mutex);
+        if (victim.tasks.empty()) continue;
+
+        _task.swap(victim.tasks.front());
+        victim.tasks.pop_front();
+        lock.unlock();
+
+        ScopedLock self_lock(workers_[_index]->mutex);
+        ++workers_[_index]->steal_count;
+        return true;
+    }
+    return false;
+}
+
+void TaskPool::__Run(int _index) {
+    AsyncInvokeFunction task;
+
+    while (true) {
+        if (__Pop(_index, task) || __Steal(_index, task)) {
+            atomic_dec32(&pending_);
+            task();
+            task.clear();
+            continue;
+        }
+
+        ScopedLock lock(sleep_mutex_);
+        if (stop_ && 0 == atomic_read32(&pending_)) break;
+
+        atomic_inc32(&idle_);
+        if (0 == atomic_read32(&pending_) && !stop_) sleep_cond_.wait(lock, kIdleWaitTime);
+        atomic_dec32(&idle_);
+    }
+}
+
+}  // namespace MessageQueue
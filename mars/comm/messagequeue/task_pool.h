@@ -0,0 +1,109 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in 
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+/*
+ * task_pool.h
+ *
+ * work-stealing thread pool for cpu bound work (pack/unpack, compress, dump...),
+ * so that it doesn't serialize with the runloop of a message queue.
+ */
+
+#ifndef MESSAGEQUEUE_TASK_POOL_H_
+#define MESSAGEQUEUE_TASK_POOL_H_
+
+#include <deque>
+#include <vector>
+#include <string>
+
+#include "mars/comm/messagequeue/message_queue.h"
+#include "mars/comm/thread/lock.h"
+#include "mars/comm/thread/condition.h"
+#include "mars/comm/thread/thread.h"
+
+namespace MessageQueue {
+
+class TaskPool {
+  public:
+    /*
+     * process-wide pool, created at first use.
+     * worker count is SetDefaultWorkerCount() if called before, otherwise the number of cpu cores (at least 1).
+     */
+    static TaskPool& Default();
+    static void SetDefaultWorkerCount(int _count);
+
+    explicit TaskPool(int _worker_count, const char* _name = "task_pool");
+    ~TaskPool();
+
+  public:
+    /*
+     * tasks posted from a worker go to the back of its own deque, others are spread round-robin.
+     * a worker runs its own deque LIFO and steals FIFO from the others when it runs dry.
+     */
+    bool Post(const AsyncInvokeFunction& _task);
+    void Stop();  // runs the queued tasks and joins the workers, block api
+
+    int WorkerCount() const { return (int)workers_.size(); }
+    size_t PendingCount() const;
+    uint64_t StealCount() const;
+
+  private:
+    TaskPool(const TaskPool&);
+    TaskPool& operator=(const TaskPool&);
+
+    struct Worker {
+        Worker(): thread(NULL), steal_count(0) {}
+        Mutex mutex;
+        std::deque<AsyncInvokeFunction> tasks;
+        Thread* thread;
+        uint64_t steal_count;
+    };
+
+    void __Run(int _index);
+    int __CurrentWorker() const;
+    bool __Pop(int _index, AsyncInvokeFunction& _task);
+    bool __Steal(int _index, AsyncInvokeFunction& _task);
+
+  private:
+    std::string name_;
+    std::vector<Worker*> workers_;
+    volatile uint32_t next_;
+    volatile uint32_t pending_;
+    volatile uint32_t idle_;
+
+    Mutex sleep_mutex_;
+    Condition sleep_cond_;
+    bool stop_;
+};
+
+/*
+ * run _work on the pool, then _then on the queue of _handlerid.
+ * the continuation is dropped (like AsyncInvoke) if the queue was released in between.
+ */
+template <class F>
+bool PoolInvoke(const F& _work, TaskPool& _pool = TaskPool::Default()) {
+    return _pool.Post(_work);
+}
+
+template <class F, class C>
+bool PoolInvoke(const F& _work, const C& _then, const MessageHandler_t& _handlerid, const std::string& _msg_name = "default_name", TaskPool& _pool = TaskPool::Default()) {
+    MessageHandler_t handlerid = _handlerid;
+    std::string msg_name = _msg_name;
+    return _pool.Post([=]() {
+        _work();
+        AsyncInvoke(_then, handlerid, msg_name);
+    });
+}
+
+}  // namespace MessageQueue
+
+#endif /* MESSAGEQUEUE_TASK_POOL_H_ */
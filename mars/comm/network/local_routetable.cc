@@ -14,8 +14,12 @@
 
 #include "comm/xlogger/xlogger.h"
 
+#if defined(__linux__)
+#include <string.h>
+#include "comm/network/rtnetlink.h"
+
 #if defined(__ANDROID__)
-std::string get_local_route_table(){
+static std::string __popen_route_table(){
     const char* cmd = "ip route list table all";
     xinfo2(TSF"popen cmd=%_", cmd);
     
@@ -34,6 +38,25 @@ std::string get_local_route_table(){
     
     return result;
 }
+#endif
+
+std::string get_local_route_table(){
+    std::vector<rtnl_route_t> routes;
+    if (!rtnl_dump_routes(routes)) {
+#if defined(__ANDROID__)
+        return __popen_route_table();
+#else
+        return "";
+#endif
+    }
+
+    std::string result;
+    for (size_t i = 0; i < routes.size(); ++i) {
+        result += rtnl_route_to_string(routes[i]);
+        result += "\n";
+    }
+    return result;
+}
 #elif defined(__APPLE__)
 
 // code modified from https://opensource.apple.com/source/network_cmds/network_cmds-457/netstat.tproj/route.c
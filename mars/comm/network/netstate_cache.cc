@@ -0,0 +1,285 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * netstate_cache.cc
+ */
+
+#include "comm/network/netstate_cache.h"
+
+#include <string.h>
+
+#include "boost/bind.hpp"
+
+#include "comm/xlogger/xlogger.h"
+#include "comm/thread/lock.h"
+#include "comm/thread/thread.h"
+#include "comm/socket/socketbreaker.h"
+#include "comm/network/getaddrinfo_with_timeout.h"
+#ifndef WIN32
+#include "comm/network/local_routetable.h"
+#endif
+
+#if defined(__linux__) && !defined(MARS_NETSTATE_NO_NETLINK)
+#define NETSTATE_NETLINK
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include "comm/socket/socketpoll.h"
+#endif
+
+static const unsigned long long kNat64ResolveTimeout = 2000;
+
+NetStateCache& NetStateCache::Instance() {
+    static NetStateCache cache;
+    return cache;
+}
+
+NetStateCache::NetStateCache()
+: generation_(0)
+, ipstack_ready_(false)
+, ipstack_(ELocalIPStack_None)
+, nat64_ready_(false)
+, nat64_valid_(false)
+, ifaddrs_ready_(false)
+, ifaddrs_v4_ret_(false)
+, ifaddrs_v6_ret_(false)
+, route_ready_(false)
+, breaker_(NULL)
+, netlink_thread_(NULL) {
+    memset(&nat64_addr_, 0, sizeof(nat64_addr_));
+
+#ifdef NETSTATE_NETLINK
+    breaker_ = new SocketBreaker();
+    netlink_thread_ = new Thread(boost::bind(&NetStateCache::__ListenNetlink, this), "netstate");
+    netlink_thread_->start();
+#endif
+}
+
+NetStateCache::~NetStateCache() {
+    if (netlink_thread_) {
+        breaker_->Break();
+        if (netlink_thread_->isruning()) netlink_thread_->join();
+        delete netlink_thread_;
+    }
+    delete breaker_;
+}
+
+TLocalIPStack NetStateCache::IPStack() {
+    uint64_t generation = 0;
+    {
+        ScopedLock lock(mutex_);
+        if (ipstack_ready_) return ipstack_;
+        generation = generation_;
+    }
+
+    TLocalIPStack ipstack = local_ipstack_probe();
+
+    ScopedLock lock(mutex_);
+    if (generation == generation_) {
+        ipstack_ = ipstack;
+        ipstack_ready_ = true;
+    }
+    return ipstack;
+}
+
+bool NetStateCache::Nat64Addr(struct in6_addr& _addr) {
+    ScopedLock resolve_lock(nat64_mutex_);
+
+    uint64_t generation = 0;
+    {
+        ScopedLock lock(mutex_);
+        if (nat64_ready_) {
+            if (nat64_valid_) _addr = nat64_addr_;
+            return nat64_valid_;
+        }
+        generation = generation_;
+    }
+
+    struct in6_addr addr;
+    memset(&addr, 0, sizeof(addr));
+    bool definite = false;
+    bool valid = __ResolveNat64(addr, definite);
+
+    ScopedLock lock(mutex_);
+    // a timed out lookup says nothing about the network, ask again next time
+    if (generation == generation_ && (valid || definite)) {
+        nat64_addr_ = addr;
+        nat64_valid_ = valid;
+        nat64_ready_ = true;
+    }
+
+    if (valid) _addr = addr;
+    return valid;
+}
+
+bool NetStateCache::IfAddrsIPv4(std::vector<ifaddrinfo_ip_t>& _addrs) {
+    return __IfAddrs(false, _addrs);
+}
+
+bool NetStateCache::IfAddrsIPv6(std::vector<ifaddrinfo_ip_t>& _addrs) {
+    return __IfAddrs(true, _addrs);
+}
+
+std::string NetStateCache::RouteTable() {
+    uint64_t generation = 0;
+    {
+        ScopedLock lock(mutex_);
+        if (route_ready_) return route_table_;
+        generation = generation_;
+    }
+
+#ifdef WIN32
+    std::string route_table;
+#else
+    std::string route_table = get_local_route_table();
+#endif
+
+    ScopedLock lock(mutex_);
+    if (generation == generation_) {
+        route_table_ = route_table;
+        route_ready_ = true;
+    }
+    return route_table;
+}
+
+void NetStateCache::Invalidate(const char* _reason) {
+    ScopedLock lock(mutex_);
+    ++generation_;
+    ipstack_ready_ = false;
+    nat64_ready_ = false;
+    ifaddrs_ready_ = false;
+    route_ready_ = false;
+    route_table_.clear();
+    xinfo2(TSF"netstate invalidated by %_, generation:%_", _reason, generation_);
+}
+
+uint64_t NetStateCache::Generation() const {
+    ScopedLock lock(mutex_);
+    return generation_;
+}
+
+bool NetStateCache::__IfAddrs(bool _ipv6, std::vector<ifaddrinfo_ip_t>& _addrs) {
+    uint64_t generation = 0;
+    {
+        ScopedLock lock(mutex_);
+        if (ifaddrs_ready_) {
+            _addrs = _ipv6 ? ifaddrs_v6_ : ifaddrs_v4_;
+            return _ipv6 ? ifaddrs_v6_ret_ : ifaddrs_v4_ret_;
+        }
+        generation = generation_;
+    }
+
+    // both families are read together so the two halves belong to the same network
+    std::vector<ifaddrinfo_ip_t> v4_addrs, v6_addrs;
+    bool v4_ret = getifaddrs_ipv4_filter(v4_addrs, 0);
+    bool v6_ret = getifaddrs_ipv6_filter(v6_addrs, 0);
+
+    ScopedLock lock(mutex_);
+    if (generation == generation_) {
+        ifaddrs_v4_ = v4_addrs;
+        ifaddrs_v6_ = v6_addrs;
+        ifaddrs_v4_ret_ = v4_ret;
+        ifaddrs_v6_ret_ = v6_ret;
+        ifaddrs_ready_ = true;
+    }
+
+    _addrs.swap(_ipv6 ? v6_addrs : v4_addrs);
+    return _ipv6 ? v6_ret : v4_ret;
+}
+
+bool NetStateCache::__ResolveNat64(struct in6_addr& _addr, bool& _definite) {
+    struct addrinfo hints, *res = NULL, *res0 = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = PF_INET6;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+
+    bool is_timeout = false;
+    int error = getaddrinfo_with_timeout("ipv4only.arpa", NULL, &hints, &res0, is_timeout, kNat64ResolveTimeout);
+    _definite = !is_timeout;
+
+    bool ret = false;
+    if (0 == error) {
+        for (res = res0; res; res = res->ai_next) {
+            if (AF_INET6 == res->ai_family) {
+                memcpy(&_addr, &((sockaddr_in6*)res->ai_addr)->sin6_addr, sizeof(_addr));
+                ret = true;
+                break;
+            }
+        }
+    } else {
+        xwarn2(TSF"resolve ipv4only.arpa error:%_, timeout:%_", error, is_timeout);
+    }
+
+    if (NULL != res0) freeaddrinfo(res0);
+    return ret;
+}
+
+#ifdef NETSTATE_NETLINK
+void NetStateCache::__ListenNetlink() {
+    SOCKET sock = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+    if (INVALID_SOCKET == sock) {
+        xerror2(TSF"netlink socket error:%_", socket_errno);
+        return;
+    }
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    // routes too, a vpn or a new gateway changes the default route and the ip stack without touching an address
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR | RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+
+    // newer android refuses the bind to apps, NetCore::OnNetworkChange is all we get there
+    if (0 != bind(sock, (struct sockaddr*)&addr, sizeof(addr))) {
+        xwarn2(TSF"netlink bind error:%_", socket_errno);
+        socket_close(sock);
+        return;
+    }
+
+    socket_set_nobio(sock);
+    SocketPoll poll(*breaker_);
+    poll.AddEvent(sock, true, false, NULL);
+
+    char buf[8 * 1024];
+    while (true) {
+        poll.Poll();
+        if (poll.BreakerIsBreak() || poll.BreakerIsError()) break;
+
+        bool changed = false;
+        ssize_t len = 0;
+        while (0 < (len = recv(sock, buf, sizeof(buf), 0))) {
+            for (struct nlmsghdr* nh = (struct nlmsghdr*)buf; NLMSG_OK(nh, (size_t)len); nh = NLMSG_NEXT(nh, len)) {
+                switch (nh->nlmsg_type) {
+                case RTM_NEWLINK:
+                case RTM_DELLINK:
+                case RTM_NEWADDR:
+                case RTM_DELADDR:
+                case RTM_NEWROUTE:
+                case RTM_DELROUTE:
+                    changed = true;
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+
+        // ENOBUFS: events were dropped, assume something changed
+        if (len < 0 && ENOBUFS == socket_errno) changed = true;
+        if (changed) Invalidate("netlink");
+    }
+
+    socket_close(sock);
+}
+#else
+void NetStateCache::__ListenNetlink() {}
+#endif
@@ -0,0 +1,89 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * netstate_cache.h
+ *
+ * process-wide snapshot of the network state the connect path keeps asking for:
+ * ip stack, nat64 address, interface addresses and route table.
+ * each part is probed the first time it is asked for and kept until the network changes,
+ * which is reported by Invalidate() (NetCore::OnNetworkChange) and, on linux and android,
+ * by a netlink listener for link, address and route events.
+ */
+
+#ifndef COMM_NETWORK_NETSTATE_CACHE_H_
+#define COMM_NETWORK_NETSTATE_CACHE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "comm/socket/unix_socket.h"
+#include "comm/socket/local_ipstack.h"
+#include "comm/network/getifaddrs.h"
+#include "comm/thread/mutex.h"
+
+class Thread;
+class SocketBreaker;
+
+class NetStateCache {
+  public:
+    static NetStateCache& Instance();
+
+  public:
+    TLocalIPStack IPStack();
+    // the dns64 answer for ipv4only.arpa, false if there is none or it could not be resolved
+    bool Nat64Addr(struct in6_addr& _addr);
+    bool IfAddrsIPv4(std::vector<ifaddrinfo_ip_t>& _addrs);
+    bool IfAddrsIPv6(std::vector<ifaddrinfo_ip_t>& _addrs);
+    std::string RouteTable();
+
+    void Invalidate(const char* _reason);
+    // bumped by every Invalidate()
+    uint64_t Generation() const;
+
+  private:
+    NetStateCache();
+    ~NetStateCache();
+    NetStateCache(const NetStateCache&);
+    NetStateCache& operator=(const NetStateCache&);
+
+    bool __IfAddrs(bool _ipv6, std::vector<ifaddrinfo_ip_t>& _addrs);
+    bool __ResolveNat64(struct in6_addr& _addr, bool& _definite);
+    void __ListenNetlink();
+
+  private:
+    mutable Mutex mutex_;
+    uint64_t generation_;
+
+    bool ipstack_ready_;
+    TLocalIPStack ipstack_;
+
+    Mutex nat64_mutex_;  // one ipv4only.arpa lookup at a time
+    bool nat64_ready_;
+    bool nat64_valid_;
+    struct in6_addr nat64_addr_;
+
+    bool ifaddrs_ready_;
+    bool ifaddrs_v4_ret_;
+    bool ifaddrs_v6_ret_;
+    std::vector<ifaddrinfo_ip_t> ifaddrs_v4_;
+    std::vector<ifaddrinfo_ip_t> ifaddrs_v6_;
+
+    bool route_ready_;
+    std::string route_table_;
+
+    SocketBreaker* breaker_;
+    Thread* netlink_thread_;
+};
+
+#endif  // COMM_NETWORK_NETSTATE_CACHE_H_
@@ -0,0 +1,236 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * rtnetlink.cc
+ */
+
+#include "comm/network/rtnetlink.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include "comm/xlogger/xlogger.h"
+
+static const int kRecvTimeout = 1000;  // ms, a dump that takes longer is not coming
+
+static std::string __addr_to_string(uint8_t _family, const void* _addr) {
+    char buf[64] = {0};
+    if (NULL == inet_ntop(_family, _addr, buf, sizeof(buf))) return "";
+    return buf;
+}
+
+static std::string __ifname(int _ifindex) {
+    char buf[IF_NAMESIZE] = {0};
+    if (0 == _ifindex || NULL == if_indextoname((unsigned int)_ifindex, buf)) return "";
+    return buf;
+}
+
+/*
+ * sends one dump request and hands every answer of type _type to _parse.
+ * _req is the family specific header following nlmsghdr (rtmsg, ifaddrmsg).
+ */
+template <typename REQ, typename PARSE>
+static bool __rtnl_dump(uint16_t _type, const REQ& _req, uint16_t _reply_type, PARSE _parse) {
+    int sock = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+    if (0 > sock) {
+        xerror2(TSF"netlink socket error:%_", errno);
+        return false;
+    }
+
+    struct timeval tv = {kRecvTimeout / 1000, (kRecvTimeout % 1000) * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    static uint32_t sg_seq = 0;
+    uint32_t seq = __sync_add_and_fetch(&sg_seq, 1);
+
+    struct {
+        struct nlmsghdr nh;
+        REQ body;
+    } req;
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(REQ));
+    req.nh.nlmsg_type = _type;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nh.nlmsg_seq = seq;
+    req.body = _req;
+
+    struct sockaddr_nl kernel;
+    memset(&kernel, 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+
+    if (0 > sendto(sock, &req, req.nh.nlmsg_len, 0, (struct sockaddr*)&kernel, sizeof(kernel))) {
+        xerror2(TSF"netlink send error:%_", errno);
+        close(sock);
+        return false;
+    }
+
+    bool done = false;
+    bool ret = true;
+    char buf[32 * 1024];
+
+    while (!done && ret) {
+        ssize_t len = recv(sock, buf, sizeof(buf), 0);
+        if (0 > len && EINTR == errno) continue;
+        if (0 >= len) {
+            // 0 is no more data and no NLMSG_DONE either, waiting for it would spin forever
+            xerror2(TSF"netlink recv len:%_ error:%_", len, errno);
+            ret = false;
+            break;
+        }
+
+        for (struct nlmsghdr* nh = (struct nlmsghdr*)buf; NLMSG_OK(nh, (size_t)len); nh = NLMSG_NEXT(nh, len)) {
+            if (seq != nh->nlmsg_seq) continue;
+
+            if (NLMSG_DONE == nh->nlmsg_type) {
+                done = true;
+                break;
+            }
+
+            if (NLMSG_ERROR == nh->nlmsg_type) {
+                const struct nlmsgerr* err = (const struct nlmsgerr*)NLMSG_DATA(nh);
+                xerror2(TSF"netlink dump type:%_ error:%_", _type, err->error);
+                ret = false;
+                break;
+            }
+
+            if (_reply_type == nh->nlmsg_type) _parse(nh);
+        }
+    }
+
+    close(sock);
+    return ret;
+}
+
+namespace {
+
+struct RouteParser {
+    explicit RouteParser(std::vector<rtnl_route_t>& _routes): routes(_routes) {}
+
+    void operator()(const struct nlmsghdr* _nh) const {
+        const struct rtmsg* rtm = (const struct rtmsg*)NLMSG_DATA(_nh);
+        if (AF_INET != rtm->rtm_family && AF_INET6 != rtm->rtm_family) return;
+
+        rtnl_route_t route;
+        route.family = rtm->rtm_family;
+        route.dst_len = rtm->rtm_dst_len;
+        route.table = rtm->rtm_table;
+        route.protocol = rtm->rtm_protocol;
+        route.scope = rtm->rtm_scope;
+        route.type = rtm->rtm_type;
+
+        int attrlen = (int)RTM_PAYLOAD(_nh);
+        for (const struct rtattr* rta = RTM_RTA(rtm); RTA_OK(rta, attrlen); rta = RTA_NEXT(rta, attrlen)) {
+            switch (rta->rta_type) {
+            case RTA_DST:      route.dst = __addr_to_string(rtm->rtm_family, RTA_DATA(rta)); break;
+            case RTA_GATEWAY:  route.gateway = __addr_to_string(rtm->rtm_family, RTA_DATA(rta)); break;
+            case RTA_PREFSRC:  route.prefsrc = __addr_to_string(rtm->rtm_family, RTA_DATA(rta)); break;
+            case RTA_OIF:      route.ifindex = *(const int*)RTA_DATA(rta); break;
+            case RTA_PRIORITY: route.priority = *(const uint32_t*)RTA_DATA(rta); break;
+            case RTA_TABLE:    route.table = *(const uint32_t*)RTA_DATA(rta); break;
+            default: break;
+            }
+        }
+
+        route.ifname = __ifname(route.ifindex);
+        routes.push_back(route);
+    }
+
+    std::vector<rtnl_route_t>& routes;
+};
+
+}
+
+bool rtnl_dump_routes(std::vector<rtnl_route_t>& _routes, int _family) {
+    struct rtmsg rtm;
+    memset(&rtm, 0, sizeof(rtm));
+    rtm.rtm_family = (unsigned char)_family;
+    return __rtnl_dump(RTM_GETROUTE, rtm, RTM_NEWROUTE, RouteParser(_routes));
+}
+
+std::string rtnl_route_to_string(const rtnl_route_t& _route) {
+    static const char* const kTypes[] = {"", "", "local", "broadcast", "anycast", "multicast", "blackhole", "unreachable", "prohibit", "throw", "nat"};
+    char buf[64];
+    std::string line;
+
+    if (RTN_UNICAST != _route.type && _route.type < sizeof(kTypes) / sizeof(kTypes[0])) {
+        line += kTypes[_route.type];
+        line += " ";
+    }
+
+    if (_route.dst.empty() && 0 == _route.dst_len) {
+        line += "default";
+    } else {
+        line += _route.dst.empty() ? (AF_INET6 == _route.family ? "::" : "0.0.0.0") : _route.dst;
+        if ((AF_INET == _route.family && 32 != _route.dst_len) || (AF_INET6 == _route.family && 128 != _route.dst_len)) {
+            snprintf(buf, sizeof(buf), "/%u", _route.dst_len);
+            line += buf;
+        }
+    }
+
+    if (!_route.gateway.empty()) line += " via " + _route.gateway;
+    if (!_route.ifname.empty()) line += " dev " + _route.ifname;
+
+    if (RT_TABLE_MAIN != _route.table) {
+        if (RT_TABLE_LOCAL == _route.table) {
+            line += " table local";
+        } else {
+            snprintf(buf, sizeof(buf), " table %u", _route.table);
+            line += buf;
+        }
+    }
+
+    switch (_route.protocol) {
+    case RTPROT_BOOT: break;
+    case RTPROT_KERNEL: line += " proto kernel"; break;
+    case RTPROT_STATIC: line += " proto static"; break;
+    case RTPROT_RA: line += " proto ra"; break;
+    default:
+        snprintf(buf, sizeof(buf), " proto %u", _route.protocol);
+        line += buf;
+        break;
+    }
+
+    if (RT_SCOPE_HOST == _route.scope) line += " scope host";
+    else if (RT_SCOPE_LINK == _route.scope) line += " scope link";
+
+    if (!_route.prefsrc.empty()) line += " src " + _route.prefsrc;
+
+    if (0 != _route.priority) {
+        snprintf(buf, sizeof(buf), " metric %u", _route.priority);
+        line += buf;
+    }
+
+    return line;
+}
+
+#else
+
+bool rtnl_dump_routes(std::vector<rtnl_route_t>& _routes, int _family) {
+    return false;
+}
+
+std::string rtnl_route_to_string(const rtnl_route_t& _route) {
+    return "";
+}
+
+#endif
@@ -0,0 +1,51 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * rtnetlink.h
+ *
+ * route dumps read straight from the kernel over NETLINK_ROUTE,
+ * what `ip route list table all` prints, without forking it.
+ * only linux and android have it, elsewhere the dump returns false.
+ */
+
+#ifndef COMM_NETWORK_RTNETLINK_H_
+#define COMM_NETWORK_RTNETLINK_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct rtnl_route_t {
+    rtnl_route_t(): family(0), dst_len(0), ifindex(0), table(0), priority(0), protocol(0), scope(0), type(0) {}
+
+    uint8_t      family;
+    std::string  dst;       // empty for the default route
+    uint8_t      dst_len;
+    std::string  gateway;
+    std::string  prefsrc;
+    std::string  ifname;
+    int          ifindex;
+    uint32_t     table;
+    uint32_t     priority;
+    uint8_t      protocol;  // RTPROT_*
+    uint8_t      scope;     // RT_SCOPE_*
+    uint8_t      type;      // RTN_*
+};
+
+// _family: AF_INET, AF_INET6 or 0 for both
+bool rtnl_dump_routes(std::vector<rtnl_route_t>& _routes, int _family = 0);
+
+// one line the way `ip route` prints it
+std::string rtnl_route_to_string(const rtnl_route_t& _route);
+
+#endif  // COMM_NETWORK_RTNETLINK_H_
@@ -0,0 +1,220 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * observer_list.h
+ *
+ * a signal for the hot paths, emitting takes no lock and copies nothing.
+ * the slots are an immutable array read through an atomic pointer, connect and disconnect
+ * replace the array under a mutex. every array counts the emissions holding it, a replaced
+ * array is freed when its count is down, by the writer or at a write after that.
+ * disconnect returns when no emission holds the array it replaced, so the objects bound into
+ * the removed slots may be deleted then. emissions that began later are not waited for.
+ * it does not wait when the calling thread is inside an emission of the same list, and a slot
+ * of one list that disconnects from a second one whose slots disconnect from the first may deadlock.
+ * slots are called in the order they were connected, there are no groups.
+ */
+
+#ifndef COMM_OBSERVER_LIST_H_
+#define COMM_OBSERVER_LIST_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+#include "boost/function.hpp"
+#include "comm/thread/lock.h"
+#include "comm/thread/mutex.h"
+#include "comm/thread/thread.h"
+#include "comm/thread/tss.h"
+
+namespace observer_list {
+// the emissions running on a thread, innermost first, the frames live on its stack
+struct Emission {
+    const void* list;
+    const Emission* outer;
+};
+
+inline Tss& Emissions() {
+    static Tss emissions(NULL);
+    return emissions;
+}
+}
+
+template <typename Signature>
+class ObserverList;
+
+template <typename... Args>
+class ObserverList<void (Args...)> {
+  public:
+    typedef boost::function<void (Args...)> slot_type;
+
+  public:
+    ObserverList(): slots_(NULL), epoch_(0) {
+        guards_[0] = 0;
+        guards_[1] = 0;
+    }
+
+    // no emission may be running any more
+    ~ObserverList() {
+        delete slots_.load();
+        for (size_t i = 0; i < retired_.size(); ++i) delete retired_[i];
+    }
+
+    void connect(const slot_type& _slot) {
+        ScopedLock lock(mutex_);
+        const Slots* old = slots_.load();
+        Slots* slots = NULL == old ? new Slots : new Slots(*old);
+        slots->list.push_back(_slot);
+
+        old = __Replace(slots);
+        if (NULL != old) retired_.push_back(old);
+        __FreeRetired();
+    }
+
+    // every slot equal to _slot, a function pointer or a boost::bind the way it was connected
+    template <typename F>
+    void disconnect(const F& _slot) {
+        ScopedLock lock(mutex_);
+        const Slots* old = slots_.load();
+        if (NULL == old) return;
+
+        Slots* slots = new Slots;
+        for (typename std::vector<slot_type>::const_iterator it = old->list.begin(); it != old->list.end(); ++it) {
+            if (!(*it == _slot)) slots->list.push_back(*it);
+        }
+
+        if (slots->list.size() == old->list.size()) {
+            delete slots;
+            return;
+        }
+
+        if (slots->list.empty()) {
+            delete slots;
+            slots = NULL;
+        }
+        __Release(lock, __Replace(slots));
+    }
+
+    void disconnect_all_slots() {
+        ScopedLock lock(mutex_);
+        if (NULL == slots_.load()) return;
+        __Release(lock, __Replace(NULL));
+    }
+
+    size_t num_slots() const {
+        ScopedLock lock(mutex_);
+        const Slots* slots = slots_.load();
+        return NULL == slots ? 0 : slots->list.size();
+    }
+
+    bool empty() const { return 0 == num_slots(); }
+
+    // a slot connected or disconnected meanwhile may or may not be called by an emission already running
+    void operator()(Args... _args) const {
+        const Slots* slots = __Acquire();
+        if (NULL == slots) return;
+
+        Tss& emissions = observer_list::Emissions();
+        observer_list::Emission emission = {this, (const observer_list::Emission*)emissions.get()};
+        emissions.set((void*)&emission);
+
+        for (typename std::vector<slot_type>::const_iterator it = slots->list.begin(); it != slots->list.end(); ++it) (*it)(_args...);
+
+        emissions.set((void*)emission.outer);
+        slots->refs.fetch_sub(1);
+    }
+
+  private:
+    ObserverList(const ObserverList&);
+    ObserverList& operator=(const ObserverList&);
+
+    struct Slots {
+        Slots(): refs(0) {}
+        Slots(const Slots& _other): list(_other.list), refs(0) {}
+
+        std::vector<slot_type> list;
+        mutable std::atomic<uint32_t> refs;  // the emissions holding it
+    };
+
+    // the guard of the epoch covers the load of the array until it is counted, nothing longer
+    const Slots* __Acquire() const {
+        while (true) {
+            uint32_t epoch = epoch_.load();
+            std::atomic<uint32_t>& guard = guards_[epoch & 1];
+            guard.fetch_add(1);
+
+            // a writer flipped meanwhile may not have seen the guard, go again under the new epoch
+            if (epoch != epoch_.load()) {
+                guard.fetch_sub(1);
+                continue;
+            }
+
+            const Slots* slots = slots_.load();
+            if (NULL != slots) slots->refs.fetch_add(1);
+            guard.fetch_sub(1);
+            return slots;
+        }
+    }
+
+    // under mutex_. once the guard of the old epoch is down, every emission that got the old array counted itself
+    // in it and no other can get it any more
+    const Slots* __Replace(const Slots* _slots) {
+        const Slots* old = slots_.exchange(_slots);
+        uint32_t epoch = epoch_.fetch_add(1);
+        while (0 != guards_[epoch & 1].load()) ThreadUtil::yield();
+        return old;
+    }
+
+    // waits for the emissions holding _old without mutex_, a slot running may take it
+    void __Release(ScopedLock& _lock, const Slots* _old) {
+        __FreeRetired();
+        if (__EmittingHere()) {
+            retired_.push_back(_old);
+            return;
+        }
+        _lock.unlock();
+
+        while (0 != _old->refs.load()) ThreadUtil::yield();
+        delete _old;
+    }
+
+    void __FreeRetired() {
+        for (size_t i = 0; i < retired_.size();) {
+            if (0 == retired_[i]->refs.load()) {
+                delete retired_[i];
+                retired_.erase(retired_.begin() + i);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    // the calling thread would wait for itself
+    bool __EmittingHere() const {
+        const observer_list::Emission* emission = (const observer_list::Emission*)observer_list::Emissions().get();
+        for (; NULL != emission; emission = emission->outer) {
+            if (this == emission->list) return true;
+        }
+        return false;
+    }
+
+  private:
+    mutable Mutex mutex_;
+    std::atomic<const Slots*> slots_;
+    std::atomic<uint32_t> epoch_;
+    mutable std::atomic<uint32_t> guards_[2];
+    std::vector<const Slots*> retired_;
+};
+
+#endif  // COMM_OBSERVER_LIST_H_
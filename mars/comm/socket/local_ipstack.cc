@@ -31,6 +31,7 @@
 #endif
 
 #include "comm/network/local_routetable.h"
+#include "comm/network/netstate_cache.h"
 
 
 typedef union sockaddr_union {
@@ -238,17 +239,21 @@ TLocalIPStack __local_ipstack_detect(std::string& _log) {
 #endif
 }
 
-TLocalIPStack local_ipstack_detect() {
+TLocalIPStack local_ipstack_probe() {
     std::string log;
     return __local_ipstack_detect(log);
 }
 
+TLocalIPStack local_ipstack_detect() {
+    return NetStateCache::Instance().IPStack();
+}
+
 static void __local_info(std::string& _log);
 
 TLocalIPStack local_ipstack_detect_log(std::string& _log) {
     __local_info(_log);
-    _log += get_local_route_table();
-   return __local_ipstack_detect(_log);
+    _log += NetStateCache::Instance().RouteTable();
+   return NetStateCache::Instance().IPStack();
 }
 
 #include "network/getifaddrs.h"
@@ -288,7 +293,7 @@ static void __local_info(std::string& _log) {
     }
     
     std::vector<ifaddrinfo_ip_t> v4_addrs;
-    if (getifaddrs_ipv4_filter(v4_addrs, 0)) {
+    if (NetStateCache::Instance().IfAddrsIPv4(v4_addrs)) {
         for (size_t i = 0; i < v4_addrs.size(); ++i) {
             detail_net_info << "interface name:"<<v4_addrs[i].ifa_name << ", " << (v4_addrs[i].ifa_family==AF_INET?"AF_INET":"XX_INET")
             << ", ip:" << v4_addrs[i].ip << "\n";
@@ -297,7 +302,7 @@ static void __local_info(std::string& _log) {
         detail_net_info << "getifaddrs_ipv4_filter:false \n";
     }
     std::vector<ifaddrinfo_ip_t> v6_addrs;
-    if (getifaddrs_ipv6_filter(v6_addrs, 0)) {
+    if (NetStateCache::Instance().IfAddrsIPv6(v6_addrs)) {
         for (size_t i = 0; i < v6_addrs.size(); ++i) {
             detail_net_info << "interface name:"<<v6_addrs[i].ifa_name << ", " << (v6_addrs[i].ifa_family==AF_INET6?"AF_INET6":"XX_INET")
 	    		    	<< ", ip:" << v6_addrs[i].ip << "\n";
@@ -306,20 +311,20 @@ static void __local_info(std::string& _log) {
         detail_net_info << "getifaddrs_ipv6_filter:false \n";
     }
     
-    sockaddr_storage v4_addr = {0};
-    sockaddr_storage v6_addr = {0};
-    int have_ipv4 = _have_ipv4((sockaddr*)&v4_addr, sizeof(v4_addr));
-    int have_ipv6 = _have_ipv6((sockaddr*)&v6_addr, sizeof(v6_addr));
-    detail_net_info("have_ipv4:%d have_ipv6:%d", have_ipv4, have_ipv6);
+    TLocalIPStack ipstack = NetStateCache::Instance().IPStack();
+    detail_net_info("have_ipv4:%d have_ipv6:%d", 0 != (ipstack & ELocalIPStack_IPv4), 0 != (ipstack & ELocalIPStack_IPv6));
     
     _log += detail_net_info.Message();
 }
 
 #else
 #include <string>
-TLocalIPStack local_ipstack_detect() {
+TLocalIPStack local_ipstack_probe() {
     return ELocalIPStack_IPv4;
 }
+TLocalIPStack local_ipstack_detect() {
+    return local_ipstack_probe();
+}
 TLocalIPStack local_ipstack_detect_log(std::string& _log) {
 	_log = "no implement";
    return local_ipstack_detect();
@@ -38,7 +38,10 @@ const char* const TLocalIPStackStr[] = {
     "ELocalIPStack_Dual",
 };
 
+// answered from NetStateCache, probed again only after the network changed
 TLocalIPStack local_ipstack_detect();
+// probes with udp sockets every time
+TLocalIPStack local_ipstack_probe();
     
 #ifdef __cplusplus
 }
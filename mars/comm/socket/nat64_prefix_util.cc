@@ -25,6 +25,7 @@
 #include "strutil.h"
 #include "platform_comm.h"
 #include "mars/comm/network/getaddrinfo_with_timeout.h"
+#include "mars/comm/network/netstate_cache.h"
 
 static const uint8_t kWellKnownV4Addr1[4] = {192, 0, 0, 170};
 static const uint8_t kWellKnownV4Addr2[4] = {192, 0, 0, 171};
@@ -196,15 +197,10 @@ static void ReplaceNat64WithV4IP(struct in6_addr* _replaced_nat64_addr, const st
 	}
 }
 
-bool ConvertV4toNat64V6(const struct in_addr& _v4_addr, struct in6_addr& _v6_addr) {
-    xdebug_function();
-    if (ELocalIPStack_IPv6 != local_ipstack_detect()) {
-    	xwarn2(TSF"Current Network is not ELocalIPStack_IPv6, no need GetNetworkNat64Prefix.");
-		return false;
-    }
+#ifdef __APPLE__
+// iOS9.2 and later synthesize the address of each v4 ip themselves
+static bool ConvertV4toNat64V6BySystem(const struct in_addr& _v4_addr, struct in6_addr& _v6_addr) {
 	struct addrinfo hints, *res=NULL, *res0=NULL;
-	int error = 0;
-
 	memset(&hints, 0, sizeof(hints));
 	hints.ai_family = PF_INET6;
 	hints.ai_socktype = SOCK_STREAM;
@@ -212,70 +208,60 @@ bool ConvertV4toNat64V6(const struct in_addr& _v4_addr, struct in6_addr& _v6_add
 
 	char v4_ip[16] = {0};
 	socket_inet_ntop(AF_INET, &_v4_addr, v4_ip, sizeof(v4_ip));
-    bool is_timeout = false;
-#ifdef __APPLE__
-	if (publiccomponent_GetSystemVersion() >= 9.2f) {//higher than iOS9.2
-		error = getaddrinfo_with_timeout(v4_ip, NULL, &hints, &res0, is_timeout, 2000);
-	} else {//lower than iOS9.2 or other platform
-#endif
-		error = getaddrinfo_with_timeout("ipv4only.arpa", NULL, &hints, &res0, is_timeout, 2000);
-#ifdef __APPLE__
-	}
-#endif
+	bool is_timeout = false;
+	int error = getaddrinfo_with_timeout(v4_ip, NULL, &hints, &res0, is_timeout, 2000);
 
 	bool ret = false;
-    if (error==0) {
-    	for (res = res0; res; res = res->ai_next) {
-    		char ip_buf[64] = {0};
-
-    		if (AF_INET6 == res->ai_family) {
-#ifdef __APPLE__
-				if (publiccomponent_GetSystemVersion() >= 9.2f) { //higher than iOS9.2
-					//copy all 16 bytes
-					memcpy ( (char*)&_v6_addr, (char*)&((((sockaddr_in6*)res->ai_addr)->sin6_addr).s6_addr32), 16);
-					ret = true;
-					break;
-				} else { //lower than iOS9.2 or other platform
+	if (error==0) {
+		for (res = res0; res; res = res->ai_next) {
+			if (AF_INET6 == res->ai_family) {
+				//copy all 16 bytes
+				memcpy ( (char*)&_v6_addr, (char*)&((((sockaddr_in6*)res->ai_addr)->sin6_addr).s6_addr32), 16);
+				ret = true;
+				break;
+			}
+		}
+	} else {
+		xerror2(TSF" getaddrinfo error = %_, res0:@%_", error, res0);
+	}
+	if (NULL != res0)
+		freeaddrinfo(res0);
+	return ret;
+}
 #endif
 
-	    			if (IsNat64AddrValid((struct in6_addr*)&(((sockaddr_in6*)res->ai_addr)->sin6_addr))) {
-						ReplaceNat64WithV4IP((struct in6_addr*)&(((sockaddr_in6*)res->ai_addr)->sin6_addr) , &_v4_addr);
-#ifdef WIN32
-                        memcpy ( (char*)&_v6_addr, (char*)&((((sockaddr_in6*)res->ai_addr)->sin6_addr).u), 16);
-#else
-						memcpy ( (char*)&_v6_addr, (char*)&((((sockaddr_in6*)res->ai_addr)->sin6_addr).s6_addr16), 16);
-#endif
-						const char* ip_str = socket_inet_ntop(AF_INET6, &_v6_addr, ip_buf, sizeof(ip_buf));
-						xdebug2(TSF"AF_INET6 v4_ip=%_, nat64 ip_str = %_", v4_ip, ip_str);
-		    			ret = true;
-		    			break;
-	    			} else {
-	    				xerror2(TSF"Nat64 addr invalid, =%_",
-	    						strutil::Hex2Str((char*)&(((sockaddr_in6*)res->ai_addr)->sin6_addr), 16));
-	    				ret = false;
-	    			}
+bool ConvertV4toNat64V6(const struct in_addr& _v4_addr, struct in6_addr& _v6_addr) {
+    xdebug_function();
+    if (ELocalIPStack_IPv6 != local_ipstack_detect()) {
+    	xwarn2(TSF"Current Network is not ELocalIPStack_IPv6, no need GetNetworkNat64Prefix.");
+		return false;
+    }
 #ifdef __APPLE__
-				}
+	if (publiccomponent_GetSystemVersion() >= 9.2f) {//higher than iOS9.2
+		return ConvertV4toNat64V6BySystem(_v4_addr, _v6_addr);
+	}
 #endif
 
-    		} else if (AF_INET == res->ai_family){
-    			const char* ip_str = socket_inet_ntop(AF_INET, &(((sockaddr_in*)res->ai_addr)->sin_addr), ip_buf, sizeof(ip_buf));
-    			xinfo2(TSF"AF_INET ip_str = %_", ip_str);
-    			ret = false;
-    		} else {
-    			xerror2(TSF"invalid ai_family = %_", res->ai_family);
-    			ret = false;
-    		}
+	// ipv4only.arpa is looked up once per network by NetStateCache
+	struct in6_addr nat64_addr;
+	if (!NetStateCache::Instance().Nat64Addr(nat64_addr)) {
+		xerror2(TSF"no nat64 address for ipv4only.arpa");
+		return false;
+	}
 
-    	}
-    } else {
-        xerror2(TSF" getaddrinfo error = %_, res0:@%_", error, res0);
-    	ret = false;
-    }
-    if (NULL != res0)
-        freeaddrinfo(res0);
-    return ret;
+	if (!IsNat64AddrValid(&nat64_addr)) {
+		xerror2(TSF"Nat64 addr invalid, =%_", strutil::Hex2Str((char*)&nat64_addr, 16));
+		return false;
+	}
+
+	ReplaceNat64WithV4IP(&nat64_addr, &_v4_addr);
+	memcpy(&_v6_addr, &nat64_addr, 16);
 
+	char v4_ip[16] = {0};
+	char ip_buf[64] = {0};
+	socket_inet_ntop(AF_INET, &_v4_addr, v4_ip, sizeof(v4_ip));
+	xdebug2(TSF"AF_INET6 v4_ip=%_, nat64 ip_str = %_", v4_ip, socket_inet_ntop(AF_INET6, &_v6_addr, ip_buf, sizeof(ip_buf)));
+	return true;
 }
 
 bool ConvertV4toNat64V6(const std::string& _v4_ip, std::string& _nat64_v6_ip) {
@@ -303,6 +289,16 @@ bool  GetNetworkNat64Prefix(struct in6_addr& _nat64_prefix_in6) {
     	xwarn2(TSF"Current Network is not ELocalIPStack_IPv6, no need GetNetworkNat64Prefix.");
 		return false;
     }
+#ifndef __APPLE__
+	struct in6_addr nat64_addr;
+	if (!NetStateCache::Instance().Nat64Addr(nat64_addr)) return false;
+#ifdef WIN32
+	memcpy ( (char*)&(_nat64_prefix_in6.u), (char*)&(nat64_addr.u), 12);
+#else
+	memcpy ( (char*)&(_nat64_prefix_in6.s6_addr16), (char*)&(nat64_addr.s6_addr16), 12);
+#endif
+	return true;
+#else
 	struct addrinfo hints, *res=NULL, *res0=NULL;
 	int error = 0;
 
@@ -312,25 +308,17 @@ bool  GetNetworkNat64Prefix(struct in6_addr& _nat64_prefix_in6) {
 	hints.ai_flags = AI_ADDRCONFIG;
 
 	bool ret = false;
-#ifdef __APPLE__
 	if (publiccomponent_GetSystemVersion() >= 9.2f) {
 		error = getaddrinfo("192.0.2.1", NULL, &hints, &res0);
 	} else {
-#endif
 		error = getaddrinfo("ipv4only.arpa", NULL, &hints, &res0);
-#ifdef __APPLE__
 	}
-#endif
     if (error==0) {
     	for (res = res0; res; res = res->ai_next) {
     		char ip_buf[64] = {0};
 
     		if (AF_INET6 == res->ai_family) {
-#ifdef WIN32
-                memcpy ( (char*)&(_nat64_prefix_in6.u), (char*)&((((sockaddr_in6*)res->ai_addr)->sin6_addr).u), 12);
-#else
     			memcpy ( (char*)&(_nat64_prefix_in6.s6_addr16), (char*)&((((sockaddr_in6*)res->ai_addr)->sin6_addr).s6_addr16), 12);
-#endif
     			ret = true;
     			break;
 
@@ -352,6 +340,7 @@ bool  GetNetworkNat64Prefix(struct in6_addr& _nat64_prefix_in6) {
     if (NULL != res0)
         freeaddrinfo(res0);
     return ret;
+#endif
 }
 
 bool  GetNetworkNat64Prefix(std::string& _nat64_prefix) {
@@ -0,0 +1,112 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * udp_batch.cc
+ */
+
+#include "comm/socket/udp_batch.h"
+
+#if defined(__linux__) && (!defined(__ANDROID__) || __ANDROID_API__ >= 21)
+#define UDP_BATCH_MMSG
+#endif
+
+#ifdef UDP_BATCH_MMSG
+
+static const int kMaxBatch = 64;
+
+int udp_send_batch(SOCKET _fd, udp_datagram_t* _datagrams, int _count) {
+    struct mmsghdr msgs[kMaxBatch];
+    struct iovec iovs[kMaxBatch];
+    if (_count > kMaxBatch) _count = kMaxBatch;
+
+    memset(msgs, 0, sizeof(msgs[0]) * _count);
+    for (int i = 0; i < _count; ++i) {
+        iovs[i].iov_base = _datagrams[i].buf;
+        iovs[i].iov_len = _datagrams[i].len;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &_datagrams[i].addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(_datagrams[i].addr);
+    }
+
+    int ret = 0;
+    do {
+        ret = sendmmsg(_fd, msgs, (unsigned int)_count, MSG_NOSIGNAL);
+    } while (0 > ret && EINTR == socket_errno);
+
+    if (0 > ret) return IS_NOBLOCK_SEND_ERRNO(socket_errno) ? 0 : -1;
+    return ret;
+}
+
+int udp_recv_batch(SOCKET _fd, udp_datagram_t* _datagrams, int _count) {
+    struct mmsghdr msgs[kMaxBatch];
+    struct iovec iovs[kMaxBatch];
+    if (_count > kMaxBatch) _count = kMaxBatch;
+
+    memset(msgs, 0, sizeof(msgs[0]) * _count);
+    for (int i = 0; i < _count; ++i) {
+        iovs[i].iov_base = _datagrams[i].buf;
+        iovs[i].iov_len = _datagrams[i].len;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &_datagrams[i].addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(_datagrams[i].addr);
+    }
+
+    int ret = 0;
+    do {
+        ret = recvmmsg(_fd, msgs, (unsigned int)_count, MSG_DONTWAIT, NULL);
+    } while (0 > ret && EINTR == socket_errno);
+
+    if (0 > ret) return IS_NOBLOCK_RECV_ERRNO(socket_errno) ? 0 : -1;
+
+    for (int i = 0; i < ret; ++i) _datagrams[i].len = msgs[i].msg_len;
+    return ret;
+}
+
+#else
+
+int udp_send_batch(SOCKET _fd, udp_datagram_t* _datagrams, int _count) {
+    int sent = 0;
+    while (sent < _count) {
+        udp_datagram_t& datagram = _datagrams[sent];
+        if (0 > sendto(_fd, (const char*)datagram.buf, datagram.len, 0, (const struct sockaddr*)&datagram.addr, sizeof(datagram.addr))) {
+            int err = socket_errno;
+            if (SOCKET_ERRNO(EINTR) == err) continue;
+            if (IS_NOBLOCK_SEND_ERRNO(err)) break;
+            return 0 < sent ? sent : -1;
+        }
+        ++sent;
+    }
+    return sent;
+}
+
+int udp_recv_batch(SOCKET _fd, udp_datagram_t* _datagrams, int _count) {
+    int read = 0;
+    while (read < _count) {
+        udp_datagram_t& datagram = _datagrams[read];
+        socklen_t addr_len = sizeof(datagram.addr);
+        int ret = (int)recvfrom(_fd, (char*)datagram.buf, datagram.len, 0, (struct sockaddr*)&datagram.addr, &addr_len);
+        if (0 > ret) {
+            int err = socket_errno;
+            if (SOCKET_ERRNO(EINTR) == err) continue;
+            if (IS_NOBLOCK_RECV_ERRNO(err)) break;
+            return 0 < read ? read : -1;
+        }
+        datagram.len = (size_t)ret;
+        ++read;
+    }
+    return read;
+}
+
+#endif
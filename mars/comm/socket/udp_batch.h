@@ -0,0 +1,42 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * udp_batch.h
+ *
+ * several datagrams per syscall: sendmmsg/recvmmsg on linux and android,
+ * a sendto/recvfrom loop on a non-blocking socket elsewhere.
+ */
+
+#ifndef COMM_SOCKET_UDP_BATCH_H_
+#define COMM_SOCKET_UDP_BATCH_H_
+
+#include <string.h>
+
+#include "comm/socket/unix_socket.h"
+
+struct udp_datagram_t {
+    udp_datagram_t(): buf(NULL), len(0) { memset(&addr, 0, sizeof(addr)); }
+
+    void*               buf;
+    size_t              len;   // send: bytes to send; recv: size of buf in, size of the datagram out
+    struct sockaddr_in  addr;  // send: destination; recv: source
+};
+
+/*
+ * _fd should be non-blocking, the calls stop where it would block.
+ * return: datagrams sent or read, 0 if none could be, -1 on error (socket_errno)
+ */
+int udp_send_batch(SOCKET _fd, udp_datagram_t* _datagrams, int _count);
+int udp_recv_batch(SOCKET _fd, udp_datagram_t* _datagrams, int _count);
+
+#endif  // COMM_SOCKET_UDP_BATCH_H_
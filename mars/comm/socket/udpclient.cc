@@ -25,7 +25,7 @@
 #include "comm/socket/socket_address.h"
 
 #define DELETE_AND_NULL(a) {if (a) delete a; a = NULL;}
-#define MAX_DATAGRAM 65536
+#define UDP_SEND_BATCH 16
 
 struct UdpSendData
 {
@@ -41,31 +41,35 @@ UdpClient::UdpClient(const std::string& _ip, int _port)
 :fd_socket_(INVALID_SOCKET)
 , event_(NULL)
 , selector_(breaker_, true)
-, thread_(NULL)
+, poller_(NULL)
+, own_poller_(false)
 {
     __InitSocket(_ip, _port);
 }
 
-UdpClient::UdpClient(const std::string& _ip, int _port, IAsyncUdpClientEvent* _event)
+UdpClient::UdpClient(const std::string& _ip, int _port, IAsyncUdpClientEvent* _event, UdpPoller* _poller)
 :fd_socket_(INVALID_SOCKET)
 , event_(_event)
 , selector_(breaker_, true)
+, poller_(_poller)
+, own_poller_(NULL == _poller)
 {
-    thread_ = new Thread(boost::bind(&UdpClient::__RunLoop, this));
+    if (own_poller_)
+        poller_ = new UdpPoller;
     
     __InitSocket(_ip, _port);
 }
 
 UdpClient::~UdpClient()
 {
-    if (thread_ && thread_->isruning())
+    if (poller_)
     {
+        poller_->Remove(this);
         event_ = NULL;
-        breaker_.Break();
-        thread_->join();
+        if (own_poller_)
+            DELETE_AND_NULL(poller_);
     }
     breaker_.Break();
-    DELETE_AND_NULL(thread_);
     
     list_buffer_.clear();
     
@@ -106,13 +110,13 @@ void UdpClient::SendAsync(void* _buf, size_t _len)
     if (fd_socket_ == INVALID_SOCKET || event_ == NULL)
         return;
     
-    ScopedLock lock(mutex_);
+    mutex_.lock();
     list_buffer_.push_back(UdpSendData());
     list_buffer_.back().data.Write(_buf, _len);
+    mutex_.unlock();
     
-    if (!thread_->isruning())
-        thread_->start();
-    breaker_.Break();
+    // not before the first send, as the thread used to start; the poller locks us while polling
+    poller_->Add(this);
 }
 
 void UdpClient::SetIpPort(const std::string& _ip, int _port)
@@ -136,6 +140,13 @@ void UdpClient::__InitSocket(const std::string& _ip, int _port)
         return;
     }
     
+    // the async path reads and writes until it would block, SendBlock and ReadBlock select first
+    if (0 != socket_set_nobio(fd_socket_))
+    {
+        errCode = socket_errno;
+        xerror2(TSF"udp set nonblock error: %0", socket_strerror(errCode));
+    }
+    
     if (IPV4_BROADCAST_IP == _ip)
     {
         int on = 1;
@@ -148,58 +159,67 @@ void UdpClient::__InitSocket(const std::string& _ip, int _port)
     }
 }
 
-void UdpClient::__RunLoop()
+bool UdpClient::OnWritable(int& _errno)
 {
-    xassert2(fd_socket_ != INVALID_SOCKET, "socket invalid");
-    if (fd_socket_ == INVALID_SOCKET)
-        return;
+    udp_datagram_t datagrams[UDP_SEND_BATCH];
+    int count = 0;
     
-    char* readBuffer = new char[MAX_DATAGRAM];
-    void* buf = NULL;
-    size_t len = 0;
-    int ret = 0;
-    while (true)
+    // only this thread pops, the front stays put while SendAsync appends
+    mutex_.lock();
+    for (std::list<UdpSendData>::iterator it = list_buffer_.begin(); it != list_buffer_.end() && count < UDP_SEND_BATCH; ++it, ++count)
     {
-        mutex_.lock();
-        bool bWriteSet = list_buffer_.size() > 0;
-        if (bWriteSet)
-        {
-            buf = list_buffer_.front().data.Ptr();
-            len = list_buffer_.front().data.Length();
-        } else {
-            bzero(readBuffer, MAX_DATAGRAM);
-            buf = readBuffer;
-            len = MAX_DATAGRAM - 1;
-        }
-        mutex_.unlock();
-        
-        int err = 0;
-        ret = __DoSelect(bWriteSet ? false : true, bWriteSet, buf, len, err, -1);    // only read or write can be true
-        if (ret == -1)
-        {
-            xerror2(TSF"select error");
-            if (event_)
-                event_->OnError(this, err);
-            break;
-        }
-        
-        if (ret == -2 && event_ == NULL)
-        {
-            xinfo2(TSF"normal break");
-            break;
-        }
-        if (ret == -2)
-            continue;
-        
-        if (bWriteSet)
-        {
-            ScopedLock lock(mutex_);
-            list_buffer_.pop_front();
-            continue;
-        }
+        datagrams[count].buf = it->data.Ptr();
+        datagrams[count].len = it->data.Length();
+        datagrams[count].addr = addr_;
+    }
+    mutex_.unlock();
+    
+    int sent = udp_send_batch(fd_socket_, datagrams, count);
+    if (sent < 0)
+    {
+        _errno = socket_errno;
+        xerror2(TSF"sendto error: %0", socket_strerror(_errno));
+        return false;
     }
     
-    delete[] readBuffer;
+    mutex_.lock();
+    for (int i = 0; i < sent; ++i)
+        list_buffer_.pop_front();
+    mutex_.unlock();
+    
+    for (int i = 0; i < sent; ++i)
+    {
+        if (event_)
+            event_->OnDataSent(this);
+    }
+    return true;
+}
+
+bool UdpClient::OnReadable(UdpReadBuffers& _buffers, int& _errno)
+{
+    udp_datagram_t* datagrams = _buffers.Reset();
+    int count = udp_recv_batch(fd_socket_, datagrams, UDP_READ_BATCH);
+    if (count < 0)
+    {
+        _errno = socket_errno;
+        xerror2(TSF"recvfrom error: %0", socket_strerror(_errno));
+        return false;
+    }
+    
+    for (int i = 0; i < count; ++i)
+    {
+        ((char*)datagrams[i].buf)[datagrams[i].len] = '\0';
+        if (event_)
+            event_->OnDataGramRead(this, datagrams[i].buf, datagrams[i].len);
+    }
+    return true;
+}
+
+void UdpClient::OnError(int _errno)
+{
+    xerror2(TSF"select error");
+    if (event_)
+        event_->OnError(this, _errno);
 }
 
 /*
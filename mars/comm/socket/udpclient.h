@@ -26,7 +26,7 @@
 
 #include "comm/socket/unix_socket.h"
 #include "comm/socket/socketselect.h"
-#include "comm/thread/thread.h"
+#include "comm/socket/udppoller.h"
 #include "comm/thread/mutex.h"
 #include "comm/autobuffer.h"
 
@@ -43,10 +43,11 @@ class IAsyncUdpClientEvent {
     virtual void OnDataSent(UdpClient* _this) = 0;
 };
 
-class UdpClient {
+class UdpClient : private UdpPoller::Channel {
   public:
     UdpClient(const std::string& _ip, int _port);
-    UdpClient(const std::string& _ip, int _port, IAsyncUdpClientEvent* _event);
+    // _poller: run on a shared poller, NULL for a thread of its own
+    UdpClient(const std::string& _ip, int _port, IAsyncUdpClientEvent* _event, UdpPoller* _poller = NULL);
     ~UdpClient();
 
     /*
@@ -65,7 +66,12 @@ class UdpClient {
   private:
     void __InitSocket(const std::string& _ip, int _port);
     int __DoSelect(bool _bReadSet, bool _bWriteSet, void* _buf, size_t _len, int& _errno, int _timeoutMs);
-    void __RunLoop();
+
+    virtual SOCKET Fd() const { return fd_socket_; }
+    virtual bool WantWrite() { return HasBuuferToSend(); }
+    virtual bool OnWritable(int& _errno);
+    virtual bool OnReadable(UdpReadBuffers& _buffers, int& _errno);
+    virtual void OnError(int _errno);
 
   private:
     SOCKET fd_socket_;
@@ -74,7 +80,8 @@ class UdpClient {
 
 	SocketBreaker breaker_;
     SocketSelect selector_;
-    Thread* thread_;
+    UdpPoller* poller_;
+    bool own_poller_;
 
     std::list<UdpSendData> list_buffer_;
     Mutex mutex_;
@@ -0,0 +1,176 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * udppoller.cc
+ */
+
+#include "comm/socket/udppoller.h"
+
+#include <algorithm>
+
+#include "mars/boost/bind.hpp"
+#include "comm/thread/lock.h"
+#include "comm/xlogger/xlogger.h"
+
+udp_datagram_t* UdpReadBuffers::Reset() {
+    if (NULL == buffer_) buffer_ = new char[UDP_READ_BATCH * UDP_MAX_DATAGRAM];
+
+    for (int i = 0; i < UDP_READ_BATCH; ++i) {
+        datagrams_[i].buf = buffer_ + i * UDP_MAX_DATAGRAM;
+        datagrams_[i].len = UDP_MAX_DATAGRAM - 1;
+    }
+    return datagrams_;
+}
+
+UdpPoller& UdpPoller::Shared() {
+    // never destroyed, the channels on it may live in other statics
+    static UdpPoller* poller = new UdpPoller;
+    return *poller;
+}
+
+UdpPoller::UdpPoller()
+    : selector_(breaker_, true)
+    , thread_(boost::bind(&UdpPoller::__RunLoop, this), "udp_poller")
+    , mutex_(true)
+    , stopped_(false)
+    , running_(NULL) {
+}
+
+UdpPoller::~UdpPoller() {
+    {
+        ScopedLock lock(mutex_);
+        stopped_ = true;
+        channels_.clear();
+        pending_.clear();
+    }
+
+    breaker_.Break();
+    if (thread_.isruning()) thread_.join();
+}
+
+void UdpPoller::Add(Channel* _channel) {
+    xassert2(INVALID_SOCKET != _channel->Fd());
+
+    ScopedLock lock(mutex_);
+    if (!__IsAdded(_channel)) channels_.push_back(_channel);
+
+    if (!thread_.isruning()) thread_.start();
+    breaker_.Break();
+}
+
+void UdpPoller::Remove(Channel* _channel) {
+    ScopedLock lock(mutex_);
+    channels_.erase(std::remove(channels_.begin(), channels_.end(), _channel), channels_.end());
+    pending_.erase(std::remove(pending_.begin(), pending_.end(), _channel), pending_.end());
+    breaker_.Break();
+
+    if (thread_.tid() == ThreadUtil::currentthreadid()) return;
+    while (_channel == running_) cond_.wait(lock);
+}
+
+void UdpPoller::Wakeup() {
+    breaker_.Break();
+}
+
+bool UdpPoller::__IsAdded(Channel* _channel) const {
+    return channels_.end() != std::find(channels_.begin(), channels_.end(), _channel);
+}
+
+void UdpPoller::__Fail(Channel* _channel, int _errno) {
+    Remove(_channel);
+    _channel->OnError(_errno);
+}
+
+void UdpPoller::__Dispatch(Channel* _channel) {
+    int err = 0;
+
+    if (selector_.Exception_FD_ISSET(_channel->Fd())) {
+        err = socket_errno;
+        xerror2(TSF"udp socket exception error");
+        __Fail(_channel, err);
+        return;
+    }
+
+    if (selector_.Write_FD_ISSET(_channel->Fd()) && !_channel->OnWritable(err)) {
+        __Fail(_channel, err);
+        return;
+    }
+
+    {
+        ScopedLock lock(mutex_);
+        if (!__IsAdded(_channel)) return;
+    }
+
+    if (selector_.Read_FD_ISSET(_channel->Fd()) && !_channel->OnReadable(read_buffers_, err)) {
+        __Fail(_channel, err);
+    }
+}
+
+void UdpPoller::__RunLoop() {
+    std::vector<Channel*> polled;
+
+    while (true) {
+        {
+            ScopedLock lock(mutex_);
+            if (stopped_) break;
+
+            polled = channels_;
+            selector_.PreSelect();
+            for (std::vector<Channel*>::iterator it = polled.begin(); it != polled.end(); ++it) {
+                selector_.Read_FD_SET((*it)->Fd());
+                if ((*it)->WantWrite()) selector_.Write_FD_SET((*it)->Fd());
+                selector_.Exception_FD_SET((*it)->Fd());
+            }
+        }
+
+        int ret = selector_.Select();
+        bool failed = 0 > ret || selector_.IsException();
+        int err = selector_.Errno();
+
+        if (failed) {
+            xerror2(TSF"udp poller select error: %_", socket_strerror(err));
+        } else if (selector_.IsBreak()) {
+            continue;
+        }
+
+        ScopedLock lock(mutex_);
+        if (failed) {
+            pending_.swap(channels_);
+            channels_.clear();
+        } else {
+            // the channels removed while selecting are skipped, their fds may already be someone else's
+            pending_.clear();
+            for (std::vector<Channel*>::iterator it = polled.begin(); it != polled.end(); ++it) {
+                if (__IsAdded(*it)) pending_.push_back(*it);
+            }
+        }
+
+        // one at a time without the lock, a callback may remove or delete the channels after it
+        while (!pending_.empty()) {
+            Channel* channel = pending_.front();
+            pending_.erase(pending_.begin());
+            running_ = channel;
+            lock.unlock();
+
+            if (failed) {
+                channel->OnError(err);
+            } else {
+                __Dispatch(channel);
+            }
+
+            lock.lock();
+            running_ = NULL;
+            cond_.notifyAll(lock);
+        }
+    }
+}
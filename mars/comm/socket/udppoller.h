@@ -0,0 +1,103 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * udppoller.h
+ *
+ * one thread selecting over the sockets of several UdpClient/UdpServer.
+ * a client or server without a poller of its own gets a private one, that is the thread it used to run.
+ * the callbacks run on the poller thread without the poller locked, a channel may call Add and Remove from them.
+ */
+
+#ifndef COMM_SOCKET_UDPPOLLER_H_
+#define COMM_SOCKET_UDPPOLLER_H_
+
+#include <vector>
+
+#include "comm/socket/socketselect.h"
+#include "comm/socket/udp_batch.h"
+#include "comm/socket/unix_socket.h"
+#include "comm/thread/condition.h"
+#include "comm/thread/mutex.h"
+#include "comm/thread/thread.h"
+
+#define UDP_READ_BATCH (8)
+#define UDP_MAX_DATAGRAM (65536)
+
+class UdpReadBuffers {
+  public:
+    UdpReadBuffers(): buffer_(NULL) {}
+    ~UdpReadBuffers() { delete[] buffer_; }
+
+    // slots ready for udp_recv_batch, UDP_READ_BATCH of them
+    udp_datagram_t* Reset();
+
+  private:
+    UdpReadBuffers(const UdpReadBuffers&);
+    UdpReadBuffers& operator=(const UdpReadBuffers&);
+
+  private:
+    char* buffer_;
+    udp_datagram_t datagrams_[UDP_READ_BATCH];
+};
+
+class UdpPoller {
+  public:
+    class Channel {
+      public:
+        virtual ~Channel() {}
+        virtual SOCKET Fd() const = 0;
+        virtual bool WantWrite() = 0;
+        // return false with _errno set to give up the socket, OnError follows
+        virtual bool OnWritable(int& _errno) = 0;
+        virtual bool OnReadable(UdpReadBuffers& _buffers, int& _errno) = 0;
+        virtual void OnError(int _errno) = 0;
+    };
+
+  public:
+    static UdpPoller& Shared();
+
+    UdpPoller();
+    ~UdpPoller();
+
+    // adding one already added only wakes the poller up
+    void Add(Channel* _channel);
+    // no callback of _channel runs once it returns, it waits for the one running on the poller thread.
+    // from a callback it returns at once, the callbacks of the current round after it are skipped
+    void Remove(Channel* _channel);
+    // a channel has something new to write
+    void Wakeup();
+
+  private:
+    UdpPoller(const UdpPoller&);
+    UdpPoller& operator=(const UdpPoller&);
+
+    void __RunLoop();
+    bool __IsAdded(Channel* _channel) const;
+    void __Fail(Channel* _channel, int _errno);
+    void __Dispatch(Channel* _channel);
+
+  private:
+    SocketBreaker breaker_;
+    SocketSelect selector_;
+    Thread thread_;
+    Mutex mutex_;
+    Condition cond_;
+    bool stopped_;
+
+    std::vector<Channel*> channels_;
+    std::vector<Channel*> pending_;  // still to be called back in this round, Remove takes them out too
+    Channel* running_;
+    UdpReadBuffers read_buffers_;
+};
+
+#endif  // COMM_SOCKET_UDPPOLLER_H_
@@ -20,14 +20,12 @@
 
 #include "udpserver.h"
 
-#include "boost/bind.hpp"
-
 #include "xlogger/xlogger.h"
 #include "socket/socket_address.h"
 #include "socket/udpclient.h"
 
 #define DELETE_AND_NULL(a) {if (a) delete a; a = NULL;}
-#define MAX_DATAGRAM 65536
+#define UDP_SEND_BATCH 16
 
 struct UdpServerSendData {
     explicit UdpServerSendData(struct sockaddr_in* _addr) {
@@ -39,25 +37,26 @@ struct UdpServerSendData {
     struct sockaddr_in addr;
 };
 
-UdpServer::UdpServer(int _port, IAsyncUdpServerEvent* _event)
+UdpServer::UdpServer(int _port, IAsyncUdpServerEvent* _event, UdpPoller* _poller)
     : fd_socket_(INVALID_SOCKET)
     , event_(_event)
-    , selector_(breaker_, true) {
-    thread_ = new Thread(boost::bind(&UdpServer::__RunLoop, this));
+    , poller_(_poller)
+    , own_poller_(NULL == _poller) {
+    if (own_poller_)
+        poller_ = new UdpPoller;
 
     __InitSocket(_port);
-    thread_->start();
+
+    if (fd_socket_ != INVALID_SOCKET)
+        poller_->Add(this);
 }
 
 UdpServer::~UdpServer() {
-    if (thread_->isruning()) {
-        event_ = NULL;
-        breaker_.Break();
-        thread_->join();
-    }
+    poller_->Remove(this);
+    event_ = NULL;
 
-    breaker_.Break();
-    DELETE_AND_NULL(thread_);
+    if (own_poller_)
+        DELETE_AND_NULL(poller_);
 
     list_buffer_.clear();
 
@@ -93,14 +92,13 @@ void UdpServer::SendAsync(struct sockaddr_in* _addr, void* _buf, size_t _len) {
     if (fd_socket_ == INVALID_SOCKET || event_ == NULL)
         return;
 
-    ScopedLock lock(mutex_);
+    mutex_.lock();
     list_buffer_.push_back(UdpServerSendData(_addr));
     list_buffer_.back().data.Write(_buf, _len);
+    mutex_.unlock();
 
-    if (!thread_->isruning())
-        thread_->start();
-
-    breaker_.Break();
+    // again after an error dropped it, the poller locks us while polling
+    poller_->Add(this);
 }
 
 void UdpServer::__InitSocket(int _port) {
@@ -124,65 +122,12 @@ void UdpServer::__InitSocket(int _port) {
         errCode = socket_errno;
         xerror2(TSF"udp bind error, error: %0", socket_strerror(errCode));
     }
-}
-
-void UdpServer::__RunLoop() {
-    xassert2(fd_socket_ != INVALID_SOCKET, "socket invalid");
-
-    if (fd_socket_ == INVALID_SOCKET)
-        return;
-
-    char* readBuffer = new char[MAX_DATAGRAM];
-    void* buf = NULL;
-    size_t len = 0;
-    int ret = 0;
-    struct sockaddr_in addr;
 
-    while (true) {
-        mutex_.lock();
-        bool bWriteSet = list_buffer_.size() > 0;
-
-        if (bWriteSet) {
-            buf = list_buffer_.front().data.Ptr();
-            len = list_buffer_.front().data.Length();
-            memcpy(&addr, &list_buffer_.front().addr, sizeof(sockaddr_in));
-        } else {
-            bzero(readBuffer, MAX_DATAGRAM);
-            buf = readBuffer;
-            len = MAX_DATAGRAM - 1;
-            bzero(&addr, sizeof(sockaddr_in));
-        }
-
-        mutex_.unlock();
-
-        int err = 0;
-        ret = __DoSelect(bWriteSet ? false : true, bWriteSet, buf, len, &addr, err);    // only read or write can be true
-
-        if (ret == -1) {
-            xerror2(TSF"select error");
-
-            if (event_)
-                event_->OnError(this, err);
-
-            break;
-        }
-
-        if (ret == -2 && event_ == NULL) {
-            xinfo2(TSF"normal break");
-            break;
-        }
-
-        if (ret == -2)
-            continue;
-
-        if (bWriteSet) {
-            ScopedLock lock(mutex_);
-            list_buffer_.pop_front();
-            continue;
-        }
+    // reads and writes go on until they would block
+    if (0 != socket_set_nobio(fd_socket_)) {
+        errCode = socket_errno;
+        xerror2(TSF"udp set nonblock error: %0", socket_strerror(errCode));
     }
-
-    delete[] readBuffer;
 }
 
 bool UdpServer::__SetBroadcastOpt() {
@@ -197,84 +142,65 @@ bool UdpServer::__SetBroadcastOpt() {
     return true;
 }
 
-/*
- * return -2 break, -1 error, 0 timeout, else handle size
- */
-int UdpServer::__DoSelect(bool _bReadSet, bool _bWriteSet, void* _buf, size_t _len, struct sockaddr_in* _addr, int& _errno) {
-    xassert2((!(_bReadSet && _bWriteSet) && (_bReadSet || _bWriteSet)), "only read or write can be true, not both");
-
-    selector_.PreSelect();
-
-    if (_bWriteSet)
-        selector_.Write_FD_SET(fd_socket_);
-
-    if (_bReadSet)
-        selector_.Read_FD_SET(fd_socket_);
+bool UdpServer::WantWrite() {
+    ScopedLock lock(mutex_);
+    return !list_buffer_.empty();
+}
 
-    selector_.Exception_FD_SET(fd_socket_);
+bool UdpServer::OnWritable(int& _errno) {
+    udp_datagram_t datagrams[UDP_SEND_BATCH];
+    int count = 0;
 
-    int ret = selector_.Select();
+    // only this thread pops, the front stays put while SendAsync appends
+    mutex_.lock();
 
-    if (ret < 0) {
-        xerror2(TSF"udp select error: %0", socket_strerror(selector_.Errno()));
-        _errno = selector_.Errno();
-        return -1;
+    for (std::list<UdpServerSendData>::iterator it = list_buffer_.begin(); it != list_buffer_.end() && count < UDP_SEND_BATCH; ++it, ++count) {
+        datagrams[count].buf = it->data.Ptr();
+        datagrams[count].len = it->data.Length();
+        datagrams[count].addr = it->addr;
     }
 
-    //    if (ret == 0)
-    //    {
-    //        xinfo2(TSF"udp select timeout:%0 ms", _timeoutMs);
-    //        return 0;
-    //    }
-
-    // user break
-    if (selector_.IsException()) {
-        _errno = selector_.Errno();
-        xerror2(TSF"sel exception");
-        return -1;
-    }
+    mutex_.unlock();
 
-    if (selector_.IsBreak()) {
-        xinfo2(TSF"sel breaker");
-        return -2;
-    }
+    int sent = udp_send_batch(fd_socket_, datagrams, count);
 
-    if (selector_.Exception_FD_ISSET(fd_socket_)) {
+    if (sent < 0) {
         _errno = socket_errno;
-        xerror2(TSF"socket exception error");
-        return -1;
+        xerror2(TSF"sendto error: %0", socket_strerror(_errno));
+        return false;
     }
 
-    if (selector_.Write_FD_ISSET(fd_socket_)) {
-        int ret = (int)sendto(fd_socket_, (const char*)_buf, _len, 0, (sockaddr*)_addr, sizeof(sockaddr_in));
+    ScopedLock lock(mutex_);
+
+    for (int i = 0; i < sent; ++i)
+        list_buffer_.pop_front();
 
-        if (ret == -1) {
-            _errno = socket_errno;
-            xerror2(TSF"sendto error: %0", socket_strerror(_errno));
-            return -1;
-        }
+    return true;
+}
 
-        return ret;
-    }
+bool UdpServer::OnReadable(UdpReadBuffers& _buffers, int& _errno) {
+    udp_datagram_t* datagrams = _buffers.Reset();
+    int count = udp_recv_batch(fd_socket_, datagrams, UDP_READ_BATCH);
 
-    if (selector_.Read_FD_ISSET(fd_socket_)) {
-        socklen_t len = sizeof(sockaddr_in);
-        int ret = (int)recvfrom(fd_socket_, (char*)_buf, _len, 0, (sockaddr*)_addr, &len);
+    if (count < 0) {
+        _errno = socket_errno;
+        xerror2(TSF"recvfrom error: %0", socket_strerror(_errno));
+        return false;
+    }
 
-        if (ret == -1) {
-            _errno = socket_errno;
-            xerror2(TSF"recvfrom error: %0", socket_strerror(_errno));
-            return -1;
-        }
+    for (int i = 0; i < count; ++i) {
+        ((char*)datagrams[i].buf)[datagrams[i].len] = '\0';
 
         if (event_)
-            event_->OnDataGramRead(this, _addr, _buf, ret);
-
-        return ret;
+            event_->OnDataGramRead(this, &datagrams[i].addr, datagrams[i].buf, datagrams[i].len);
     }
 
-    return -1;
+    return true;
 }
 
+void UdpServer::OnError(int _errno) {
+    xerror2(TSF"select error");
 
-
+    if (event_)
+        event_->OnError(this, _errno);
+}
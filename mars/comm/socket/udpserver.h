@@ -21,17 +21,11 @@
 #ifndef UDPSERVER_H_
 #define UDPSERVER_H_
 
-#include "comm/socket/socketselect.h"
-#include "comm/thread/thread.h"
-#include "comm/thread/lock.h"
-#include "comm/socket/unix_socket.h"
-
 #include <string>
 #include <list>
 
 #include "comm/socket/unix_socket.h"
-#include "comm/socket/socketselect.h"
-#include "comm/thread/thread.h"
+#include "comm/socket/udppoller.h"
 #include "comm/thread/mutex.h"
 #include "comm/autobuffer.h"
 
@@ -47,9 +41,10 @@ class IAsyncUdpServerEvent {
     virtual void OnDataGramRead(UdpServer* _this, struct sockaddr_in* _addr, void* _buf, size_t _len) = 0;
 };
 
-class UdpServer {
+class UdpServer : private UdpPoller::Channel {
   public:
-    UdpServer(int _port, IAsyncUdpServerEvent* _event);
+    // _poller: run on a shared poller, NULL for a thread of its own
+    UdpServer(int _port, IAsyncUdpServerEvent* _event, UdpPoller* _poller = NULL);
     ~UdpServer();
 
     void SendBroadcast(int _port, void* _buf, size_t _len);
@@ -58,17 +53,20 @@ class UdpServer {
 
   private:
     void __InitSocket(int _port);
-    int __DoSelect(bool _bReadSet, bool _bWriteSet, void* _buf, size_t _len, struct sockaddr_in* _addr, int& _errno);
-    void __RunLoop();
     bool __SetBroadcastOpt();
 
+    virtual SOCKET Fd() const { return fd_socket_; }
+    virtual bool WantWrite();
+    virtual bool OnWritable(int& _errno);
+    virtual bool OnReadable(UdpReadBuffers& _buffers, int& _errno);
+    virtual void OnError(int _errno);
+
   private:
     SOCKET fd_socket_;
     IAsyncUdpServerEvent* event_;
 
-	SocketBreaker breaker_;
-    SocketSelect selector_;
-    Thread* thread_;
+    UdpPoller* poller_;
+    bool own_poller_;
 
     std::list<UdpServerSendData> list_buffer_;
     Mutex mutex_;
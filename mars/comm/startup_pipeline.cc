@@ -0,0 +1,142 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * startup_pipeline.cc
+ */
+
+#include "comm/startup_pipeline.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "mars/boost/bind.hpp"
+#include "comm/thread/lock.h"
+#include "comm/thread/thread.h"
+#include "comm/time_utils.h"
+#include "comm/xlogger/xlogger.h"
+
+static const char* const kStepTypeNames[] = {"", " spawned", " deferred"};
+
+StartupPipeline& StartupPipeline::Shared() {
+    // never destroyed, a deferred step may record itself at exit
+    static StartupPipeline* pipeline = new StartupPipeline;
+    return *pipeline;
+}
+
+StartupPipeline::StartupPipeline()
+    : spawning_(0)
+    , finishing_(false)
+    , reported_(false)
+{}
+
+void StartupPipeline::Run(const char* _name, const boost::function<void ()>& _step) {
+    uint64_t begin = gettickcount();
+    _step();
+    Record(_name, begin, gettickcount() - begin, kStepRun);
+}
+
+void StartupPipeline::Spawn(const char* _name, const boost::function<void ()>& _step) {
+    {
+        ScopedLock lock(mutex_);
+        ++spawning_;
+    }
+
+    // it owns itself once started, nothing joins it
+    Thread thread(boost::bind(&StartupPipeline::__RunSpawned, this, std::string(_name), _step), "startup");
+    thread.pooled(true);
+    thread.start();
+}
+
+void StartupPipeline::Record(const char* _name, uint64_t _begin, uint64_t _cost, TStepType _type) {
+    Step step = {_name, _type, _begin, _cost};
+
+    ScopedLock lock(mutex_);
+    steps_.push_back(step);
+    if (!reported_) return;
+
+    lock.unlock();
+    xinfo2(TSF"startup step after the breakdown, %_ %_ms%_", step.name, step.cost, kStepTypeNames[step.type]);
+}
+
+void StartupPipeline::Wait() {
+    ScopedLock lock(mutex_);
+    while (0 < spawning_) cond_.wait(lock);
+}
+
+void StartupPipeline::Finish() {
+    ScopedLock lock(mutex_);
+    if (reported_) return;
+
+    if (0 < spawning_) {
+        finishing_ = true;  // the last spawned step reports
+        return;
+    }
+
+    reported_ = true;
+    std::string dump = __Dump();
+    lock.unlock();
+    xinfo2(TSF"%_", dump);
+}
+
+std::vector<StartupPipeline::Step> StartupPipeline::Steps() const {
+    ScopedLock lock(mutex_);
+    return steps_;
+}
+
+std::string StartupPipeline::Dump() const {
+    ScopedLock lock(mutex_);
+    return __Dump();
+}
+
+void StartupPipeline::__RunSpawned(const std::string& _name, const boost::function<void ()>& _step) {
+    uint64_t begin = gettickcount();
+    _step();
+    Step step = {_name, kStepSpawned, begin, gettickcount() - begin};
+
+    ScopedLock lock(mutex_);
+    steps_.push_back(step);
+    if (0 < --spawning_) return;
+
+    cond_.notifyAll(lock);
+    if (!finishing_ || reported_) return;
+
+    reported_ = true;
+    std::string dump = __Dump();
+    lock.unlock();
+    xinfo2(TSF"%_", dump);
+}
+
+std::string StartupPipeline::__Dump() const {
+    if (steps_.empty()) return "startup no steps";
+
+    uint64_t first = steps_.front().begin;
+    uint64_t last = 0;
+    uint64_t caller = 0;
+    for (std::vector<Step>::const_iterator it = steps_.begin(); it != steps_.end(); ++it) {
+        first = std::min(first, it->begin);
+        last = std::max(last, it->begin + it->cost);
+        if (kStepRun == it->type) caller += it->cost;
+    }
+
+    char line[256] = {0};
+    snprintf(line, sizeof(line), "startup wall:%" PRIu64 "ms, on the caller:%" PRIu64 "ms", last - first, caller);
+    std::string dump = line;
+
+    for (std::vector<Step>::const_iterator it = steps_.begin(); it != steps_.end(); ++it) {
+        snprintf(line, sizeof(line), "\n  +%" PRIu64 "ms %s %" PRIu64 "ms%s", it->begin - first, it->name.c_str(), it->cost, kStepTypeNames[it->type]);
+        dump += line;
+    }
+    return dump;
+}
@@ -0,0 +1,80 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * startup_pipeline.h
+ *
+ * the steps of bringing the modules up and what each of them cost.
+ * a step the caller needs done is Run on its thread, an independent one is Spawned on a thread of
+ * its own, and one that is deferred to its first use Records itself when it has run.
+ * Finish logs the breakdown once the spawned steps are done, without making the caller wait for them.
+ */
+
+#ifndef COMM_STARTUP_PIPELINE_H_
+#define COMM_STARTUP_PIPELINE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "boost/function.hpp"
+#include "comm/thread/condition.h"
+#include "comm/thread/mutex.h"
+
+class StartupPipeline {
+  public:
+    enum TStepType {
+        kStepRun,
+        kStepSpawned,
+        kStepDeferred,
+    };
+
+    struct Step {
+        std::string name;
+        TStepType type;
+        uint64_t begin;  // tick
+        uint64_t cost;  // ms
+    };
+
+  public:
+    static StartupPipeline& Shared();
+
+    StartupPipeline();
+
+    void Run(const char* _name, const boost::function<void ()>& _step);
+    void Spawn(const char* _name, const boost::function<void ()>& _step);
+    void Record(const char* _name, uint64_t _begin, uint64_t _cost, TStepType _type = kStepDeferred);
+
+    void Wait();  // for the spawned steps, block api
+    void Finish();
+
+    std::vector<Step> Steps() const;
+    std::string Dump() const;
+
+  private:
+    StartupPipeline(const StartupPipeline&);
+    StartupPipeline& operator=(const StartupPipeline&);
+
+    void __RunSpawned(const std::string& _name, const boost::function<void ()>& _step);
+    std::string __Dump() const;
+
+  private:
+    mutable Mutex mutex_;
+    Condition cond_;
+    std::vector<Step> steps_;
+    int spawning_;
+    bool finishing_;
+    bool reported_;
+};
+
+#endif  // COMM_STARTUP_PIPELINE_H_
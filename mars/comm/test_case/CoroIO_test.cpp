@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "boost/bind.hpp"
+
+#include "../coroutine/coro_io.h"
+#include "../socket/socket_address.h"
+#include "../socket/socketbreaker.h"
+#include "../thread/thread.h"
+#include "../thread/atomic_oper.h"
+#include "../autobuffer.h"
+#include "../time_utils.h"
+
+// build with MARS_CORO_IO defined and the comm/coroutine sources linked in
+
+namespace
+{
+
+static const int kCoroCount = 200;
+
+static volatile uint32_t sg_done = 0;
+static volatile uint32_t sg_ok = 0;
+
+static SOCKET Listen(uint16_t& _port)
+{
+	SOCKET sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	socket_address addr("127.0.0.1", 0);
+	bind(sock, &addr.address(), addr.address_length());
+	listen(sock, kCoroCount + 16);
+	_port = socket_address::getsockname(sock).port();
+	return sock;
+}
+
+// answers every connection with what it sent, one at a time
+static void EchoServer(SOCKET _listen, int _count)
+{
+	for (int i = 0; i < _count; ++i) {
+		SOCKET sock = accept(_listen, NULL, NULL);
+		if (INVALID_SOCKET == sock) return;
+		char buf[16];
+		ssize_t len = recv(sock, buf, sizeof(buf), 0);
+		if (0 < len) send(sock, buf, len, 0);
+		socket_close(sock);
+	}
+}
+
+static void Request(uint16_t _port)
+{
+	EXPECT_TRUE(coroutine::isCoroutine());
+
+	std::vector<socket_address> vecaddr;
+	vecaddr.push_back(socket_address("127.0.0.1", _port));
+	SocketBreaker breaker;
+	coroutine::AutoComplexConnect conn(10 * 1000, 1000);
+	SOCKET sock = conn.ConnectImpatient(vecaddr, breaker);
+
+	if (INVALID_SOCKET != sock) {
+		int err = 0;
+		AutoBuffer buf;
+		if (4 == coroutine::auto_socket_send(sock, "ping", 4, breaker, err, 10 * 1000)
+			&& 4 == coroutine::auto_socket_recv(sock, buf, 4, breaker, err, 10 * 1000, true)
+			&& 0 == memcmp(buf.Ptr(), "ping", 4)) {
+			atomic_inc32(&sg_ok);
+		}
+		socket_close(sock);
+	}
+	atomic_inc32(&sg_done);
+}
+
+static bool WaitDone(int _count, uint64_t _timeout)
+{
+	uint64_t start = gettickcount();
+	while ((int)atomic_read32(&sg_done) < _count) {
+		if (gettickcount() - start > _timeout) return false;
+		ThreadUtil::usleep(1000);
+	}
+	return true;
+}
+
+}
+
+TEST(CoroIO, ManyRequestsOnOneThread)
+{
+	uint16_t port = 0;
+	SOCKET listen_sock = Listen(port);
+	Thread server(boost::bind(&EchoServer, listen_sock, kCoroCount));
+	server.start();
+
+	atomic_write32(&sg_done, 0);
+	atomic_write32(&sg_ok, 0);
+
+	std::vector<coroutine::Coroutine*> coros;
+	for (int i = 0; i < kCoroCount; ++i) {
+		coros.push_back(new coroutine::Coroutine(boost::bind(&Request, port), MessageQueue::DefAsyncInvokeHandler(coroutine::SharedIOQueue())));
+		coros.back()->Start();
+	}
+
+	EXPECT_TRUE(WaitDone(kCoroCount, 30 * 1000));
+	EXPECT_EQ(kCoroCount, (int)atomic_read32(&sg_ok));
+
+	for (size_t i = 0; i < coros.size(); ++i) {
+		coros[i]->Join();
+		delete coros[i];
+	}
+	server.join();
+	socket_close(listen_sock);
+}
+
+static void BlockedRecv(SOCKET _sock, SocketBreaker& _breaker, int& _ret)
+{
+	int err = 0;
+	AutoBuffer buf;
+	_ret = coroutine::auto_socket_recv(_sock, buf, 4, _breaker, err, 60 * 1000);
+}
+
+TEST(CoroIO, BreakerCancelsWait)
+{
+	uint16_t port = 0;
+	SOCKET listen_sock = Listen(port);  // never accepts, the connection sits in the backlog
+
+	SOCKET sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	socket_address addr("127.0.0.1", port);
+	ASSERT_EQ(0, connect(sock, &addr.address(), addr.address_length()));
+	socket_set_nobio(sock);  // like every socket ComplexConnect hands out
+
+	SocketBreaker breaker;
+	int ret = 1;
+	coroutine::Coroutine coro(boost::bind(&BlockedRecv, sock, boost::ref(breaker), boost::ref(ret)), MessageQueue::DefAsyncInvokeHandler(coroutine::SharedIOQueue()));
+	coro.Start();
+
+	ThreadUtil::usleep(100 * 1000);
+	EXPECT_EQ(1, ret);
+
+	uint64_t start = gettickcount();
+	breaker.Break();
+	coro.Join();
+
+	EXPECT_LT(gettickcount() - start, 1000u);
+	EXPECT_TRUE(breaker.IsBreak());
+	EXPECT_NE(1, ret);
+
+	socket_close(sock);
+	socket_close(listen_sock);
+}
+
+static std::vector<std::string> SlowLookup(const std::string& _host)
+{
+	ThreadUtil::usleep(50 * 1000);
+	return std::vector<std::string>(1, _host);
+}
+
+static void Lookup(const std::string& _host)
+{
+	std::vector<std::string> ips = coroutine::BlockingInvoke(boost::bind(&SlowLookup, _host));
+	if (1 == ips.size() && ips[0] == _host) atomic_inc32(&sg_ok);
+	atomic_inc32(&sg_done);
+}
+
+TEST(CoroIO, BlockingCallsDoNotStallThePoller)
+{
+	atomic_write32(&sg_done, 0);
+	atomic_write32(&sg_ok, 0);
+
+	uint64_t start = gettickcount();
+	std::vector<coroutine::Coroutine*> coros;
+	for (int i = 0; i < 8; ++i) {
+		coros.push_back(new coroutine::Coroutine(boost::bind(&Lookup, std::string("host")), MessageQueue::DefAsyncInvokeHandler(coroutine::SharedIOQueue())));
+		coros.back()->Start();
+	}
+
+	// 8 lookups of 50ms on the 4 worker pool overlap instead of running one after another
+	EXPECT_TRUE(WaitDone(8, 5 * 1000));
+	EXPECT_EQ(8, (int)atomic_read32(&sg_ok));
+	EXPECT_LT(gettickcount() - start, 8 * 50u);
+
+	for (size_t i = 0; i < coros.size(); ++i) {
+		coros[i]->Join();
+		delete coros[i];
+	}
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "../http.h"
+#include "../autobuffer.h"
+#include "../time_utils.h"
+
+using namespace http;
+
+namespace
+{
+
+static std::string Body(size_t _len)
+{
+	std::string body(_len, 0);
+	for (size_t i = 0; i < _len; ++i) body[i] = (char)('a' + i % 26);
+	return body;
+}
+
+static std::string Chunked(const std::string& _body, size_t _chunk)
+{
+	std::string resp = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+	for (size_t pos = 0; pos < _body.size(); pos += _chunk) {
+		size_t len = std::min(_chunk, _body.size() - pos);
+		char size[32];
+		snprintf(size, sizeof(size), "%zx\r\n", len);
+		resp += size;
+		resp.append(_body, pos, len);
+		resp += "\r\n";
+	}
+	return resp + "0\r\n\r\n";
+}
+
+static std::string ContentLength(const std::string& _body)
+{
+	char header[128];
+	snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n\r\n", _body.size());
+	return header + _body;
+}
+
+// feeds _resp _step bytes at a time, the way a socket hands it over
+static Parser::TRecvStatus Feed(Parser& _parser, const std::string& _resp, size_t _step)
+{
+	Parser::TRecvStatus status = Parser::kStart;
+	for (size_t pos = 0; pos < _resp.size() && !_parser.Error() && Parser::kEnd != status; pos += _step) {
+		status = _parser.Recv(_resp.data() + pos, std::min(_step, _resp.size() - pos));
+	}
+	return status;
+}
+
+}
+
+TEST(HttpParser, ContentLengthAnySplit)
+{
+	std::string body = Body(1000);
+	std::string resp = ContentLength(body);
+
+	for (size_t step = 1; step <= resp.size(); step += (step < 64 ? 1 : 97)) {
+		AutoBuffer buf;
+		Parser parser(new MemoryBodyReceiver(buf), true);
+		ASSERT_EQ(Parser::kEnd, Feed(parser, resp, step)) << "step " << step;
+		EXPECT_EQ(200, parser.Status().StatusCode());
+		EXPECT_EQ(1000, parser.Fields().ContentLength());
+		EXPECT_STREQ("text/plain", parser.Fields().HeaderField("content-type"));
+		ASSERT_EQ(body.size(), buf.Length());
+		EXPECT_EQ(0, memcmp(body.data(), buf.Ptr(), body.size()));
+	}
+}
+
+TEST(HttpParser, ChunkedAnySplit)
+{
+	std::string body = Body(3000);
+	std::string resp = Chunked(body, 700);
+
+	for (size_t step = 1; step <= resp.size(); step += (step < 64 ? 1 : 97)) {
+		AutoBuffer buf;
+		Parser parser(new MemoryBodyReceiver(buf), true);
+		ASSERT_EQ(Parser::kEnd, Feed(parser, resp, step)) << "step " << step;
+		ASSERT_EQ(body.size(), buf.Length());
+		EXPECT_EQ(0, memcmp(body.data(), buf.Ptr(), body.size()));
+	}
+}
+
+TEST(HttpParser, ChunkedTrailerAndBadCRLF)
+{
+	std::string resp = "HTTP/1.1 200 OK\r\nTransfer-Encoding: Chunked\r\n\r\n3;ext=1\r\nabc\r\n0\r\nX-Sum: 1\r\n\r\n";
+	AutoBuffer buf;
+	Parser parser(new MemoryBodyReceiver(buf), true);
+	EXPECT_EQ(Parser::kEnd, Feed(parser, resp, resp.size()));
+	EXPECT_EQ(3u, buf.Length());
+
+	Parser bad;
+	EXPECT_EQ(Parser::kBodyError, Feed(bad, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabcd\r\n", 5));
+}
+
+TEST(HttpParser, HeaderViewsPointIntoHeaderBuffer)
+{
+	std::string resp = "HTTP/1.1 404 Not Found\r\nServer:  mars \r\nX-Empty: \r\nContent-Length: 0\r\n\r\nleftover";
+	Parser parser;
+	size_t consumed = 0;
+	EXPECT_EQ(Parser::kEnd, parser.Recv(resp.data(), resp.size(), &consumed));
+	EXPECT_EQ(resp.size() - strlen("leftover"), consumed);
+	EXPECT_EQ(404, parser.Status().StatusCode());
+	EXPECT_EQ(consumed, parser.HeaderBuffer().Length());
+
+	HeaderView view;
+	ASSERT_TRUE(parser.HeaderValue("server", view));
+	EXPECT_EQ(std::string("mars"), std::string(view.value, view.value_len));
+	EXPECT_TRUE(view.value >= parser.HeaderBuffer().Ptr() && view.value < (const char*)parser.HeaderBuffer().Ptr() + parser.HeaderBuffer().Length());
+	EXPECT_EQ(3u, parser.HeaderViews().size());
+	EXPECT_FALSE(parser.HeaderValue("location", view));
+}
+
+TEST(HttpParser, ConnectionCloseReadsUntilClose)
+{
+	AutoBuffer buf;
+	Parser parser(new MemoryBodyReceiver(buf), true);
+	EXPECT_EQ(Parser::kBody, Feed(parser, "HTTP/1.0 200 OK\r\nConnection: close\r\n\r\nhello", 7));
+	EXPECT_EQ(Parser::kEnd, parser.Recv(NULL, 0));
+	EXPECT_EQ(5u, buf.Length());
+}
+
+TEST(HttpParser, Benchmark)
+{
+	std::string large = ContentLength(Body(8 * 1024 * 1024));
+	std::string chunked = Chunked(Body(8 * 1024 * 1024), 4 * 1024);
+	const int rounds = 10;
+	const size_t step = 1460;
+
+	uint64_t start = gettickcount();
+	for (int i = 0; i < rounds; ++i) {
+		Parser parser;
+		EXPECT_EQ(Parser::kEnd, Feed(parser, large, step));
+	}
+	uint64_t large_cost = gettickcount() - start;
+
+	start = gettickcount();
+	for (int i = 0; i < rounds; ++i) {
+		Parser parser;
+		EXPECT_EQ(Parser::kEnd, Feed(parser, chunked, step));
+	}
+	uint64_t chunked_cost = gettickcount() - start;
+
+	printf("8MB in 1460B reads x %d: content-length %llums, chunked(4KB) %llums\n", rounds, (unsigned long long)large_cost, (unsigned long long)chunked_cost);
+}
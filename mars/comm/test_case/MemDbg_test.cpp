@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "boost/bind.hpp"
+#include "../thread/thread.h"
+#include "../time_utils.h"
+
+#include "../memdbg.h"
+
+
+namespace
+{
+
+static const int kThreadCount = 4;
+static const int kAllocsPerThread = 200000;
+static const int kLiveWindow = 1000;
+static const int kManyLive = 200000;
+static const size_t kSamplePeriod = 16 * 1024;
+static const int kSampledCount = 20000;
+static const size_t kSampledSize = 1000;
+
+static void* AllocBlock(size_t _size)
+{
+	return malloc(_size);
+}
+
+static void* AllocSampled(size_t _size)
+{
+	return malloc(_size);
+}
+
+static bool FindSite(const char* _func, memdbg_site_t& _site)
+{
+	memdbg_site_t sites[64];
+	size_t count = GetMemorySites(sites, 64);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (NULL == strstr(sites[i].func, _func)) continue;
+		_site = sites[i];
+		return true;
+	}
+	return false;
+}
+
+static void AllocFreeLoop()
+{
+	std::vector<void*> live(kLiveWindow, (void*)NULL);
+
+	for (int i = 0; i < kAllocsPerThread; ++i)
+	{
+		void*& slot = live[i % kLiveWindow];
+		free(slot);
+		slot = AllocBlock(16 + i % 64);
+	}
+
+	for (int i = 0; i < kLiveWindow; ++i) free(live[i]);
+}
+
+static std::string sg_leaks;
+static void OnLeaks(const char* _report)
+{
+	sg_leaks = _report;
+}
+
+}
+
+TEST(MemDbg, ConcurrentAllocFree)
+{
+	std::vector<Thread*> threads;
+	for (int i = 0; i < kThreadCount; ++i) threads.push_back(new Thread(&AllocFreeLoop));
+	for (int i = 0; i < kThreadCount; ++i) threads[i]->start();
+	for (int i = 0; i < kThreadCount; ++i)
+	{
+		threads[i]->join();
+		delete threads[i];
+	}
+
+	memdbg_site_t site;
+	ASSERT_TRUE(FindSite("AllocBlock", site));
+	EXPECT_EQ((uint64_t)kThreadCount * kAllocsPerThread, site.total_count);
+	EXPECT_EQ(0u, site.live_count);
+	EXPECT_EQ(0u, site.live_bytes);
+
+	// the test registrations of this file are allocated through memdbg too and live on
+	DumpMemoryLeaks(&OnLeaks);
+	EXPECT_EQ(std::string::npos, sg_leaks.find("AllocBlock"));
+}
+
+TEST(MemDbg, FreeCostWithManyLive)
+{
+	std::vector<void*> live;
+	for (int i = 0; i < kManyLive; ++i) live.push_back(AllocBlock(32));
+
+	uint64_t start = gettickcount();
+	for (int i = 0; i < kManyLive; ++i) free(AllocBlock(32));
+	uint64_t cost = gettickspan(start);
+
+	printf("live blocks:%d alloc+free:%.0fns\n", kManyLive, cost * 1e6 / kManyLive);
+	EXPECT_GT(1000u, cost);
+
+	for (int i = 0; i < kManyLive; ++i) free(live[i]);
+}
+
+TEST(MemDbg, SampledSiteEstimate)
+{
+	SetMemorySamplePeriod(kSamplePeriod);
+
+	std::vector<void*> live;
+	for (int i = 0; i < kSampledCount; ++i) live.push_back(AllocSampled(kSampledSize));
+
+	memdbg_site_t site;
+	ASSERT_TRUE(FindSite("AllocSampled", site));
+	printf("period:%zu allocated:%zu bytes estimated:%llu bytes in %llu blocks\n", kSamplePeriod, kSampledCount * kSampledSize,
+		   (unsigned long long)site.live_bytes, (unsigned long long)site.live_count);
+	EXPECT_NEAR((double)(kSampledCount * kSampledSize), (double)site.live_bytes, kSampledCount * kSampledSize * 0.1);
+
+	for (int i = 0; i < kSampledCount; ++i) free(live[i]);
+	SetMemorySamplePeriod(0);
+
+	ASSERT_TRUE(FindSite("AllocSampled", site));
+	EXPECT_EQ(0u, site.live_bytes);
+}
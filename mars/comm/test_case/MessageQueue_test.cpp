@@ -323,3 +323,29 @@ TEST(MessageQueue_test, WaitMessage_SingletonMessage)
 	}
 
 }
+
+static void Stat_test_handler()
+{
+}
+
+TEST(MessageQueue_test, MessageQueueStat)
+{
+	MessageQueue::MessageQueueCreater creater(true, "stat_test");
+	MessageQueue::MessageQueue_t queue = creater.GetMessageQueue();
+
+	MessageQueue::MessagePost_t post;
+	for (int i = 0; i < 10; ++i)
+		post = MessageQueue::AsyncInvoke(&Stat_test_handler, MessageQueue::DefAsyncInvokeHandler(queue), "stat_test_handler");
+	MessageQueue::WaitMessage(post);
+	MessageQueue::WaitMessage(MessageQueue::AsyncInvoke(&Stat_test_handler, MessageQueue::DefAsyncInvokeHandler(queue), "stat_test_end"));
+
+	MessageQueue::MessageQueueStat stat;
+	EXPECT_TRUE(MessageQueue::GetMessageQueueStat(queue, stat));
+	EXPECT_GE(stat.depth_high_water, 1u);
+	EXPECT_EQ(stat.handler_cost["stat_test_handler"].count, 10u);
+	EXPECT_GE(stat.dispatch_latency.count, 10u);
+
+	MessageQueue::ResetMessageQueueStat(queue);
+	EXPECT_TRUE(MessageQueue::GetMessageQueueStat(queue, stat));
+	EXPECT_EQ(stat.dispatch_latency.count, 0u);
+}
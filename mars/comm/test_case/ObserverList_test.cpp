@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+#include "boost/bind.hpp"
+#include "boost/signals2.hpp"
+
+#include "../observer_list.h"
+#include "../thread/atomic_oper.h"
+#include "../thread/thread.h"
+#include "../time_utils.h"
+
+
+namespace
+{
+
+static const int kEmissions = 4000000;
+static const int kMaxSubscribers = 4;
+
+struct Counter
+{
+	Counter(): bytes(0) {}
+	void OnData(const char* _tag, ssize_t _send, ssize_t _recv) { bytes += _send + _recv; }
+	ssize_t bytes;
+};
+
+template <typename Signal>
+static double EmissionsPerSecond(Signal& _signal)
+{
+	uint64_t start = gettickcount();
+	for (int i = 0; i < kEmissions; ++i) _signal("stn", 1, 0);
+	uint64_t cost = std::max(gettickcount() - start, (uint64_t)1);
+	return kEmissions * 1000.0 / cost;
+}
+
+TEST(ObserverList, EmissionsPerSecond)
+{
+	for (int subscribers = 1; subscribers <= kMaxSubscribers; ++subscribers)
+	{
+		Counter counters[kMaxSubscribers];
+		boost::signals2::signal<void (const char*, ssize_t, ssize_t)> signal;
+		ObserverList<void (const char*, ssize_t, ssize_t)> list;
+
+		for (int i = 0; i < subscribers; ++i)
+		{
+			signal.connect(boost::bind(&Counter::OnData, &counters[i], _1, _2, _3));
+			list.connect(boost::bind(&Counter::OnData, &counters[i], _1, _2, _3));
+		}
+
+		double signals2 = EmissionsPerSecond(signal);
+		double observers = EmissionsPerSecond(list);
+		printf("subscribers:%d signals2:%.1fM/s observer list:%.1fM/s\n", subscribers, signals2 / 1000000, observers / 1000000);
+
+		for (int i = 0; i < subscribers; ++i) EXPECT_EQ(2 * kEmissions, counters[i].bytes);
+		EXPECT_LT(signals2, observers);
+	}
+}
+
+TEST(ObserverList, DisconnectByBind)
+{
+	Counter a, b;
+	ObserverList<void (const char*, ssize_t, ssize_t)> list;
+	list.connect(boost::bind(&Counter::OnData, &a, _1, _2, _3));
+	list.connect(boost::bind(&Counter::OnData, &b, _1, _2, _3));
+
+	list("stn", 1, 1);
+	list.disconnect(boost::bind(&Counter::OnData, &a, _1, _2, _3));
+	list("stn", 1, 1);
+
+	EXPECT_EQ(1u, list.num_slots());
+	EXPECT_EQ(2, a.bytes);
+	EXPECT_EQ(4, b.bytes);
+
+	list.disconnect_all_slots();
+	EXPECT_TRUE(list.empty());
+	list("stn", 1, 1);
+	EXPECT_EQ(4, b.bytes);
+}
+
+static ObserverList<void (const char*, ssize_t, ssize_t)> sg_list;
+static volatile uint32_t sg_stop = 0;
+static volatile uint32_t sg_calls = 0;
+
+static void OnDataCounted(const char*, ssize_t, ssize_t) { atomic_inc32(&sg_calls); }
+
+static void Emit()
+{
+	while (0 == atomic_read32(&sg_stop)) sg_list("stn", 1, 0);
+}
+
+// the arrays replaced under the emitters must stay valid until they are done with them
+TEST(ObserverList, ConnectWhileEmitting)
+{
+	Thread first(&Emit), second(&Emit);
+	first.start();
+	second.start();
+
+	for (int i = 0; i < 10000; ++i)
+	{
+		sg_list.connect(&OnDataCounted);
+		sg_list.disconnect(&OnDataCounted);
+		if (0 == i % 1000) usleep(1000);
+	}
+
+	sg_list.connect(&OnDataCounted);
+	usleep(10 * 1000);
+	atomic_write32(&sg_stop, 1);
+	first.join();
+	second.join();
+
+	EXPECT_EQ(1u, sg_list.num_slots());
+	EXPECT_LT(0u, atomic_read32(&sg_calls));
+}
+
+struct SlowObserver
+{
+	SlowObserver(): entered(0), alive(1), called_dead(0) {}
+	void OnData(const char*, ssize_t, ssize_t)
+	{
+		atomic_write32(&entered, 1);
+		usleep(50 * 1000);
+		if (0 == atomic_read32(&alive)) atomic_write32(&called_dead, 1);
+	}
+	volatile uint32_t entered;
+	volatile uint32_t alive;
+	volatile uint32_t called_dead;
+};
+
+static ObserverList<void (const char*, ssize_t, ssize_t)> sg_slow_list;
+
+static void EmitOnce() { sg_slow_list("stn", 1, 0); }
+
+// the way NetCore disconnects itself before its members are deleted
+TEST(ObserverList, DisconnectWaitsForTheRunningEmission)
+{
+	SlowObserver observer;
+	sg_slow_list.connect(boost::bind(&SlowObserver::OnData, &observer, _1, _2, _3));
+
+	Thread emitter(&EmitOnce);
+	emitter.start();
+	while (0 == atomic_read32(&observer.entered)) usleep(1000);
+
+	sg_slow_list.disconnect(boost::bind(&SlowObserver::OnData, &observer, _1, _2, _3));
+	atomic_write32(&observer.alive, 0);
+	emitter.join();
+
+	EXPECT_EQ(0u, atomic_read32(&observer.called_dead));
+	EXPECT_TRUE(sg_slow_list.empty());
+}
+
+static ObserverList<void (const char*, ssize_t, ssize_t)> sg_other_list;
+static SlowObserver* sg_other_observer = NULL;
+
+static void EmitOtherOnce() { sg_other_list("stn", 1, 0); }
+
+static void DisconnectFromOther()
+{
+	sg_other_list.disconnect(boost::bind(&SlowObserver::OnData, sg_other_observer, _1, _2, _3));
+	atomic_write32(&sg_other_observer->alive, 0);
+}
+
+// inside an emission of one list, a disconnect from another one still waits
+TEST(ObserverList, DisconnectFromASlotOfAnotherList)
+{
+	SlowObserver observer;
+	sg_other_observer = &observer;
+	sg_other_list.connect(boost::bind(&SlowObserver::OnData, &observer, _1, _2, _3));
+
+	Thread emitter(&EmitOtherOnce);
+	emitter.start();
+	while (0 == atomic_read32(&observer.entered)) usleep(1000);
+
+	ObserverList<void ()> list;
+	list.connect(&DisconnectFromOther);
+	list();
+	emitter.join();
+
+	EXPECT_EQ(0u, atomic_read32(&observer.called_dead));
+	EXPECT_TRUE(sg_other_list.empty());
+}
+
+static ObserverList<void (const char*, ssize_t, ssize_t)> sg_busy_list;
+static volatile uint32_t sg_busy_stop = 0;
+
+static void OnDataBusy(const char*, ssize_t, ssize_t) { usleep(200); }
+
+static void EmitBusy()
+{
+	while (0 == atomic_read32(&sg_busy_stop)) sg_busy_list("stn", 1, 0);
+}
+
+// the emissions overlap all the time, a disconnect waits only for the ones holding the slots it replaced
+TEST(ObserverList, DisconnectUnderSteadyEmissions)
+{
+	sg_busy_list.connect(&OnDataBusy);
+
+	Thread first(&EmitBusy), second(&EmitBusy), third(&EmitBusy);
+	first.start();
+	second.start();
+	third.start();
+	usleep(10 * 1000);
+
+	uint64_t start = gettickcount();
+	for (int i = 0; i < 100; ++i)
+	{
+		sg_busy_list.connect(&OnDataCounted);
+		sg_busy_list.disconnect(&OnDataCounted);
+	}
+	uint64_t cost = gettickcount() - start;
+
+	atomic_write32(&sg_busy_stop, 1);
+	first.join();
+	second.join();
+	third.join();
+
+	EXPECT_GT(2000u, cost);
+	EXPECT_EQ(1u, sg_busy_list.num_slots());
+}
+
+static ObserverList<void ()> sg_self_list;
+static int sg_self_calls = 0;
+
+static void DisconnectSelf()
+{
+	++sg_self_calls;
+	sg_self_list.disconnect(&DisconnectSelf);
+}
+
+TEST(ObserverList, DisconnectFromInsideASlot)
+{
+	sg_self_list.connect(&DisconnectSelf);
+	sg_self_list();
+	sg_self_list();
+
+	EXPECT_EQ(1, sg_self_calls);
+	EXPECT_TRUE(sg_self_list.empty());
+}
+
+}
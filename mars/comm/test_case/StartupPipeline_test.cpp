@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+#include "../startup_pipeline.h"
+#include "../time_utils.h"
+
+
+namespace
+{
+
+static const int kStepCount = 3;
+static const int kStepCost = 100;  // ms, a file read or a platform call that blocks
+
+static void BlockingStep()
+{
+	usleep(kStepCost * 1000);
+}
+
+TEST(StartupPipeline, SpawnedStepsOverlap)
+{
+	StartupPipeline pipeline;
+	uint64_t begin = gettickcount();
+
+	pipeline.Run("serial", &BlockingStep);
+	pipeline.Spawn("first", &BlockingStep);
+	pipeline.Spawn("second", &BlockingStep);
+	pipeline.Spawn("third", &BlockingStep);
+	uint64_t caller = gettickcount() - begin;
+
+	pipeline.Wait();
+	uint64_t wall = gettickcount() - begin;
+	printf("%d steps of %dms, on the caller:%llums wall:%llums\n", kStepCount + 1, kStepCost, (unsigned long long)caller, (unsigned long long)wall);
+
+	EXPECT_LT(caller, (uint64_t)(kStepCost * 3 / 2));
+	EXPECT_LT(wall, (uint64_t)(kStepCost * (kStepCount + 1) * 3 / 4));
+	EXPECT_EQ((size_t)(kStepCount + 1), pipeline.Steps().size());
+}
+
+TEST(StartupPipeline, FinishReportsSpawnedAndDeferred)
+{
+	StartupPipeline pipeline;
+	pipeline.Run("serial", &BlockingStep);
+	pipeline.Spawn("spawned", &BlockingStep);
+	pipeline.Finish();  // returns before the spawned step is done
+	EXPECT_EQ(1u, pipeline.Steps().size());
+
+	pipeline.Wait();
+	pipeline.Record("deferred", gettickcount(), 5);
+
+	std::string dump = pipeline.Dump();
+	printf("%s\n", dump.c_str());
+	EXPECT_NE(std::string::npos, dump.find("serial 10"));
+	EXPECT_NE(std::string::npos, dump.find(" spawned"));
+	EXPECT_NE(std::string::npos, dump.find("deferred 5ms deferred"));
+}
+
+}
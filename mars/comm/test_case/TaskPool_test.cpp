@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "boost/bind.hpp"
+
+#include "../messagequeue/task_pool.h"
+#include "../messagequeue/message_queue.h"
+#include "../thread/atomic_oper.h"
+#include "../time_utils.h"
+#include "../adler32.h"
+
+
+namespace
+{
+
+static const int kWorkerCount = 4;
+static const int kTaskCount = 2000;
+
+static volatile uint32_t sg_done = 0;
+static unsigned char sg_buffer[256 * 1024];
+
+// uneven cost: every 16th task is 16 times heavier, like a big Buf2Resp among small ones
+static void CpuTask(int _index)
+{
+	size_t len = (0 == _index % 16) ? sizeof(sg_buffer) : sizeof(sg_buffer) / 16;
+	volatile unsigned long sum = adler32(1, sg_buffer, len);
+	(void)sum;
+	atomic_inc32(&sg_done);
+}
+
+static void WaitDone(int _count)
+{
+	while ((int)atomic_read32(&sg_done) < _count) ThreadUtil::usleep(100);
+}
+
+static double QueuePerThread(int _queue_count)
+{
+	std::vector<MessageQueue::MessageQueueCreater*> queues;
+	for (int i = 0; i < _queue_count; ++i)
+		queues.push_back(new MessageQueue::MessageQueueCreater(true, "bench_mq"));
+
+	atomic_write32(&sg_done, 0);
+	uint64_t start = gettickcount();
+	for (int i = 0; i < kTaskCount; ++i)
+		MessageQueue::AsyncInvoke(boost::bind(&CpuTask, i), MessageQueue::DefAsyncInvokeHandler(queues[i % _queue_count]->GetMessageQueue()), "bench");
+	WaitDone(kTaskCount);
+	uint64_t cost = gettickcount() - start;
+
+	for (size_t i = 0; i < queues.size(); ++i) delete queues[i];
+	return kTaskCount * 1000.0 / (0 == cost ? 1 : cost);
+}
+
+static double Pool(int _worker_count)
+{
+	MessageQueue::TaskPool pool(_worker_count, "bench_pool");
+
+	atomic_write32(&sg_done, 0);
+	uint64_t start = gettickcount();
+	for (int i = 0; i < kTaskCount; ++i)
+		pool.Post(boost::bind(&CpuTask, i));
+	WaitDone(kTaskCount);
+	uint64_t cost = gettickcount() - start;
+
+	printf("steal count:%llu\n", (unsigned long long)pool.StealCount());
+	return kTaskCount * 1000.0 / (0 == cost ? 1 : cost);
+}
+
+static MessageQueue::MessageQueue_t sg_then_queue = 0;
+static bool sg_then_on_queue = false;
+static void Then()
+{
+	sg_then_on_queue = MessageQueue::CurrentThreadMessageQueue() == sg_then_queue;
+}
+
+}
+
+TEST(TaskPool_test, PostAndContinue)
+{
+	MessageQueue::TaskPool pool(kWorkerCount, "test_pool");
+	MessageQueue::MessageQueueCreater creater(true, "test_then");
+	sg_then_queue = creater.GetMessageQueue();
+
+	atomic_write32(&sg_done, 0);
+	for (int i = 0; i < 100; ++i)
+		EXPECT_TRUE(pool.Post(boost::bind(&CpuTask, i)));
+	EXPECT_TRUE(MessageQueue::PoolInvoke(boost::bind(&CpuTask, 0), &Then, MessageQueue::DefAsyncInvokeHandler(sg_then_queue), "then", pool));
+	WaitDone(101);
+
+	pool.Stop();
+	EXPECT_FALSE(pool.Post(boost::bind(&CpuTask, 0)));
+	EXPECT_EQ(0u, pool.PendingCount());
+
+	MessageQueue::WaitMessage(MessageQueue::AsyncInvoke(&Then, MessageQueue::DefAsyncInvokeHandler(sg_then_queue)));
+	EXPECT_TRUE(sg_then_on_queue);
+}
+
+TEST(TaskPool_test, Benchmark)
+{
+	printf("single queue:          %.0f tasks/s\n", QueuePerThread(1));
+	printf("%d queues (1 per thread): %.0f tasks/s\n", kWorkerCount, QueuePerThread(kWorkerCount));
+	printf("pool of %d workers:     %.0f tasks/s\n", kWorkerCount, Pool(kWorkerCount));
+}
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+#include "boost/bind.hpp"
+#include "../thread/atomic_oper.h"
+#include "../thread/thread.h"
+#include "../time_utils.h"
+
+
+namespace
+{
+
+static const int kRounds = 20000;
+
+static volatile uint32_t sg_runs = 0;
+
+static void Work()
+{
+	atomic_inc32(&sg_runs);
+}
+
+// start-to-joined of one short lived thread, in us
+static double StartJoinCost(bool _pooled, uint64_t& _creations)
+{
+	Thread thread(&Work, "short_lived");
+	thread.pooled(_pooled);
+
+	uint64_t creations = ThreadPool::Shared().creations();
+	uint64_t start = gettickcount();
+	for (int i = 0; i < kRounds; ++i)
+	{
+		thread.start();
+		thread.join();
+	}
+	uint64_t cost = gettickspan(start);
+
+	_creations = ThreadPool::Shared().creations() - creations;
+	return cost * 1000.0 / kRounds;
+}
+
+}
+
+TEST(ThreadPool, StartJoinChurn)
+{
+	atomic_write32(&sg_runs, 0);
+
+	uint64_t own_creations = 0, pooled_creations = 0;
+	double own = StartJoinCost(false, own_creations);
+	double pooled = StartJoinCost(true, pooled_creations);
+
+	printf("rounds:%d thread of its own:%.1fus creations:%llu pooled:%.1fus creations:%llu\n", kRounds,
+		   own, (unsigned long long)own_creations, pooled, (unsigned long long)pooled_creations);
+
+	EXPECT_EQ((uint32_t)kRounds * 2, atomic_read32(&sg_runs));
+	EXPECT_EQ((uint64_t)kRounds, own_creations);
+	// a handoff costs about what a create and join does on an idle box, it is the churn that goes
+	EXPECT_GE(1u, pooled_creations);
+}
+
+TEST(ThreadPool, PeriodicAndDestroyedWhileRunning)
+{
+	atomic_write32(&sg_runs, 0);
+	Thread periodic(&Work, "periodic");
+	periodic.pooled(true);
+	periodic.start_periodic(0, 10);
+	usleep(105 * 1000);
+	periodic.cancel_periodic();
+	periodic.join();
+	EXPECT_LE(8u, atomic_read32(&sg_runs));
+	EXPECT_GE(12u, atomic_read32(&sg_runs));
+
+	// the way DNS lets its thread go when a lookup times out
+	atomic_write32(&sg_runs, 0);
+	{
+		Thread thread(boost::bind(&usleep, 50 * 1000), "dropped");
+		thread.pooled(true);
+		thread.start();
+	}
+	usleep(100 * 1000);
+	Thread next(&Work, "next");
+	next.pooled(true);
+	next.start();
+	next.join();
+	EXPECT_EQ(1u, atomic_read32(&sg_runs));
+	EXPECT_LE(1u, ThreadPool::Shared().idle());
+}
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "boost/bind.hpp"
+#include "../alarm.h"
+#include "../thread/atomic_oper.h"
+#include "../time_utils.h"
+#include "../timing_wheel.h"
+
+
+namespace
+{
+
+static const int kAlarmCount = 1000;
+static const int kMinAfter = 200;		// ms, the longer ones are cascaded down from level 1
+static const int kMaxAfter = 1200;		// ms
+static const int kSchedulingLatency = 50;	// ms, from the wheel posting it to the queue running it
+
+static volatile uint32_t sg_fired = 0;
+static uint64_t sg_fired_at[kAlarmCount];
+
+static void OnFire(int _index)
+{
+	sg_fired_at[_index] = gettickcount();
+	atomic_inc32(&sg_fired);
+}
+
+static bool WaitFired(uint32_t _count, int _timeout)
+{
+	uint64_t start = gettickcount();
+	while (atomic_read32(&sg_fired) < _count)
+	{
+		if ((int64_t)gettickspan(start) > _timeout) return false;
+		usleep(10 * 1000);
+	}
+	return true;
+}
+
+}
+
+TEST(TimingWheel, ManyAlarmsFewWakeups)
+{
+	MessageQueue::MessageQueueCreater creater(true, "timing_wheel_test");
+	MessageQueue::MessageQueue_t queue = creater.CreateMessageQueue();
+
+	std::vector<Alarm*> alarms;
+	std::vector<uint64_t> started(kAlarmCount);
+	for (int i = 0; i < kAlarmCount; ++i) alarms.push_back(new Alarm(boost::bind(&OnFire, i), queue));
+
+	atomic_write32(&sg_fired, 0);
+	uint64_t wakeups = TimingWheel::Shared().Wakeups();
+
+	for (int i = 0; i < kAlarmCount; ++i)
+	{
+		started[i] = gettickcount();
+		alarms[i]->Start(kMinAfter + i % (kMaxAfter - kMinAfter));
+	}
+
+	EXPECT_TRUE(WaitFired(kAlarmCount, kMaxAfter * 3));
+	wakeups = TimingWheel::Shared().Wakeups() - wakeups;
+
+	int64_t max_late = 0;
+	for (int i = 0; i < kAlarmCount; ++i)
+	{
+		int after = kMinAfter + i % (kMaxAfter - kMinAfter);
+		int64_t late = (int64_t)(sg_fired_at[i] - started[i]) - after;
+		EXPECT_LE(0, late) << "alarm:" << i;
+		EXPECT_GE(after * 5 / 100 + kSchedulingLatency, late) << "alarm:" << i;
+		if (late > max_late) max_late = late;
+	}
+
+	printf("alarms:%d wheel wakeups:%llu max late:%lldms\n", kAlarmCount, (unsigned long long)wakeups, (long long)max_late);
+	EXPECT_GE((uint64_t)kAlarmCount / 5, wakeups);
+
+	for (int i = 0; i < kAlarmCount; ++i) delete alarms[i];
+}
+
+TEST(TimingWheel, CancelledAlarmsDoNotFire)
+{
+	MessageQueue::MessageQueueCreater creater(true, "timing_wheel_test");
+	MessageQueue::MessageQueue_t queue = creater.CreateMessageQueue();
+
+	std::vector<Alarm*> alarms;
+	for (int i = 0; i < 100; ++i) alarms.push_back(new Alarm(boost::bind(&OnFire, i), queue));
+
+	atomic_write32(&sg_fired, 0);
+	for (int i = 0; i < 100; ++i) alarms[i]->Start(100 + i);
+	for (int i = 0; i < 100; i += 2) alarms[i]->Cancel();
+
+	usleep(500 * 1000);
+	EXPECT_EQ(50u, atomic_read32(&sg_fired));
+	EXPECT_EQ(0u, TimingWheel::Shared().Size());
+
+	for (int i = 0; i < 100; ++i) delete alarms[i];
+}
@@ -0,0 +1,199 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../socket/udpclient.h"
+#include "../socket/udpserver.h"
+#include "../socket/udppoller.h"
+#include "../thread/atomic_oper.h"
+#include "../thread/lock.h"
+#include "../time_utils.h"
+
+
+namespace
+{
+
+static const int kClientCount = 16;
+static const int kDatagramCount = 500;		// per client
+static const size_t kDatagramSize = 64;
+
+static volatile uint32_t sg_echoed = 0;
+
+class EchoServer : public IAsyncUdpServerEvent
+{
+  public:
+	EchoServer(): server_(0, this) {}
+
+	virtual void OnError(UdpServer* _this, int _errno) {}
+	virtual void OnDataGramRead(UdpServer* _this, struct sockaddr_in* _addr, void* _buf, size_t _len)
+	{
+		_this->SendAsync(_addr, _buf, _len);
+	}
+
+	UdpServer server_;
+};
+
+class EchoCounter : public IAsyncUdpClientEvent
+{
+  public:
+	virtual void OnError(UdpClient* _this, int _errno) {}
+	virtual void OnDataGramRead(UdpClient* _this, void* _buf, size_t _len) { atomic_inc32(&sg_echoed); }
+	virtual void OnDataSent(UdpClient* _this) {}
+};
+
+static int ThreadCount()
+{
+	int count = 0;
+	DIR* dir = opendir("/proc/self/task");
+	if (NULL == dir) return -1;
+	while (NULL != readdir(dir)) ++count;
+	closedir(dir);
+	return count - 2;	// . and ..
+}
+
+static uint16_t ServerPort(UdpServer& _server)
+{
+	// UdpServer binds INADDR_ANY:_port, the test asks for port 0 and looks the one it got up
+	for (int fd = 3; fd < 1024; ++fd)
+	{
+		struct sockaddr_in addr;
+		socklen_t len = sizeof(addr);
+		int type = 0;
+		socklen_t type_len = sizeof(type);
+		if (0 != getsockname(fd, (struct sockaddr*)&addr, &len) || AF_INET != addr.sin_family) continue;
+		if (0 != getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &type_len) || SOCK_DGRAM != type) continue;
+		if (INADDR_ANY == ntohl(addr.sin_addr.s_addr) && 0 != addr.sin_port) return ntohs(addr.sin_port);
+	}
+	return 0;
+}
+
+// ms until every datagram came back
+static uint64_t EchoRound(uint16_t _port, UdpPoller* _poller, int& _threads)
+{
+	atomic_write32(&sg_echoed, 0);
+	EchoCounter counter;
+	std::vector<UdpClient*> clients;
+	char datagram[kDatagramSize] = {0};
+
+	uint64_t start = gettickcount();
+	for (int i = 0; i < kClientCount; ++i) clients.push_back(new UdpClient("127.0.0.1", _port, &counter, _poller));
+	for (int j = 0; j < kDatagramCount; ++j)
+	{
+		for (int i = 0; i < kClientCount; ++i) clients[i]->SendAsync(datagram, sizeof(datagram));
+		// loopback drops what overflows the socket buffers, keep the offered load below that
+		if (0 == j % 5) ThreadUtil::usleep(2 * 1000);
+	}
+
+	uint32_t expected = kClientCount * kDatagramCount;
+	while (atomic_read32(&sg_echoed) < expected * 99 / 100 && gettickcount() - start < 10 * 1000) ThreadUtil::usleep(1000);
+	uint64_t cost = gettickcount() - start;
+	_threads = ThreadCount();
+
+	for (size_t i = 0; i < clients.size(); ++i) delete clients[i];
+	EXPECT_GE(atomic_read32(&sg_echoed), expected * 99 / 100);
+	return cost;
+}
+
+// the app's own lock, taken in the callback and held around SendAsync
+class LockingCounter : public IAsyncUdpClientEvent
+{
+  public:
+	LockingCounter(): count_(0) {}
+
+	virtual void OnError(UdpClient* _this, int _errno) {}
+	virtual void OnDataGramRead(UdpClient* _this, void* _buf, size_t _len) { ScopedLock lock(mutex_); ++count_; }
+	virtual void OnDataSent(UdpClient* _this) {}
+
+	Mutex mutex_;
+	int count_;
+};
+
+class SlowReader : public IAsyncUdpClientEvent
+{
+  public:
+	SlowReader(): in_callback_(0) {}
+
+	virtual void OnError(UdpClient* _this, int _errno) {}
+	virtual void OnDataGramRead(UdpClient* _this, void* _buf, size_t _len)
+	{
+		atomic_write32(&in_callback_, 1);
+		ThreadUtil::usleep(100 * 1000);
+		atomic_write32(&in_callback_, 0);
+	}
+	virtual void OnDataSent(UdpClient* _this) {}
+
+	volatile uint32_t in_callback_;
+};
+
+}
+
+TEST(UdpPoller, SendAsyncUnderTheLockOfTheCallback)
+{
+	EchoServer server;
+	uint16_t port = ServerPort(server.server_);
+	ASSERT_NE(0, port);
+
+	UdpPoller poller;
+	LockingCounter counter;
+	UdpClient client("127.0.0.1", port, &counter, &poller);
+	char datagram[kDatagramSize] = {0};
+
+	for (int i = 0; i < 200; ++i)
+	{
+		ScopedLock lock(counter.mutex_);
+		client.SendAsync(datagram, sizeof(datagram));
+		ThreadUtil::usleep(100);
+	}
+
+	uint64_t start = gettickcount();
+	int count = 0;
+	while (count < 200 * 99 / 100 && gettickcount() - start < 5 * 1000)
+	{
+		ThreadUtil::usleep(1000);
+		ScopedLock lock(counter.mutex_);
+		count = counter.count_;
+	}
+	EXPECT_GE(count, 200 * 99 / 100);
+}
+
+TEST(UdpPoller, RemoveWaitsForTheRunningCallback)
+{
+	EchoServer server;
+	uint16_t port = ServerPort(server.server_);
+	ASSERT_NE(0, port);
+
+	UdpPoller poller;
+	SlowReader reader;
+	UdpClient* client = new UdpClient("127.0.0.1", port, &reader, &poller);
+	char datagram[kDatagramSize] = {0};
+	client->SendAsync(datagram, sizeof(datagram));
+
+	uint64_t start = gettickcount();
+	while (0 == atomic_read32(&reader.in_callback_) && gettickcount() - start < 5 * 1000) ThreadUtil::usleep(1000);
+	ASSERT_EQ(1u, atomic_read32(&reader.in_callback_));
+
+	delete client;
+	EXPECT_EQ(0u, atomic_read32(&reader.in_callback_));
+}
+
+TEST(UdpPoller, EchoThreadPerClientVsShared)
+{
+	EchoServer server;
+	uint16_t port = ServerPort(server.server_);
+	ASSERT_NE(0, port);
+
+	int base_threads = ThreadCount();
+	int own_threads = 0, shared_threads = 0;
+	uint64_t own = EchoRound(port, NULL, own_threads);
+	UdpPoller poller;
+	uint64_t shared = EchoRound(port, &poller, shared_threads);
+
+	printf("clients:%d datagrams:%d thread per client:%llums threads:%d shared poller:%llums threads:%d\n",
+		   kClientCount, kClientCount * kDatagramCount, (unsigned long long)own, own_threads - base_threads,
+		   (unsigned long long)shared, shared_threads - base_threads);
+
+	EXPECT_EQ(kClientCount, own_threads - base_threads);
+	EXPECT_EQ(1, shared_threads - base_threads);
+}
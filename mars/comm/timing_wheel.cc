@@ -0,0 +1,305 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * timing_wheel.cc
+ *
+ * ticks are milliseconds of gettickcount. level 0 has a slot per tick for the next 256 ticks,
+ * each of the 3 levels above has 64 slots, each 64 times as wide as a slot of the level below.
+ * a slot of a higher level is cascaded down when level 0 wraps to it, a timer further away than
+ * the top level reaches waits in its last slot and is placed again when that one is cascaded.
+ */
+
+#include "comm/timing_wheel.h"
+
+#include <algorithm>
+
+#include "mars/boost/bind.hpp"
+#include "comm/thread/lock.h"
+#include "comm/time_utils.h"
+#include "comm/xlogger/xlogger.h"
+
+#ifdef ANDROID
+#include "comm/platform_comm.h"
+#endif
+
+static const int kDefaultSlackPercent = 5;
+static const int kDefaultSlackMax = 1000;  // ms
+static const int kSlackGrains[] = {1000, 100, 10};  // ms, deadlines are rounded up to the largest one within the slack
+
+#ifdef ANDROID
+static const int64_t kMaxLockTime = 5000;  // ms, a platform alarm this early keeps the cpu awake instead of being started again
+#endif
+
+TimingWheel& TimingWheel::Shared() {
+    // never destroyed, the alarms on it may live in other statics
+    static TimingWheel* wheel = new TimingWheel;
+    return *wheel;
+}
+
+TimingWheel::TimingWheel()
+    : thread_(boost::bind(&TimingWheel::__RunLoop, this), "timing_wheel")
+    , stopped_(false)
+    , current_(gettickcount())
+    , wake_at_(0)
+    , wakeups_(0)
+    , slack_percent_(kDefaultSlackPercent)
+    , slack_max_(kDefaultSlackMax)
+#ifdef ANDROID
+    , platform_id_(0)
+    , platform_expire_(0)
+    , wakelock_(NULL)
+#endif
+{
+    for (int i = 0; i < kLevel0Slots; ++i) level0_[i].prev_ = level0_[i].next_ = &level0_[i];
+
+    for (int level = 0; level < kLevels - 1; ++level) {
+        for (int i = 0; i < kLevelSlots; ++i) levels_[level][i].prev_ = levels_[level][i].next_ = &levels_[level][i];
+    }
+
+    for (int level = 0; level < kLevels; ++level) counts_[level] = 0;
+}
+
+TimingWheel::~TimingWheel() {
+    {
+        ScopedLock lock(mutex_);
+        stopped_ = true;
+        cond_.notifyAll(lock);
+    }
+
+    if (thread_.isruning()) thread_.join();
+#ifdef ANDROID
+    delete wakelock_;
+#endif
+}
+
+void TimingWheel::Start(Timer& _timer, int _after, const boost::function<void ()>& _callback, const MessageQueue::MessageHandler_t& _handler) {
+    ScopedLock lock(mutex_);
+    uint64_t now = gettickcount();
+
+    if (_timer.IsPending()) __Unlink(_timer);
+    if (0 == __Size()) current_ = std::max(current_, now);  // nothing to catch up on
+
+    _timer.expire_ = __Deadline(now, _after);
+    _timer.callback_ = _callback;
+    _timer.handler_ = _handler;
+    __Add(_timer);
+
+    if (!thread_.isruning()) {
+        thread_.start();
+    } else if (0 == wake_at_ || _timer.expire_ < wake_at_) {
+        cond_.notifyAll(lock);
+    }
+}
+
+bool TimingWheel::Cancel(Timer& _timer) {
+    ScopedLock lock(mutex_);
+    if (!_timer.IsPending()) return false;
+
+    // the thread may wake up for it once, that is cheaper than waking it up now to plan again
+    __Unlink(_timer);
+    return true;
+}
+
+void TimingWheel::SetSlack(int _percent, int _max) {
+    ScopedLock lock(mutex_);
+    slack_percent_ = std::max(_percent, 0);
+    slack_max_ = std::max(_max, 0);
+}
+
+size_t TimingWheel::Size() const {
+    ScopedLock lock(mutex_);
+    return __Size();
+}
+
+uint64_t TimingWheel::Wakeups() const {
+    ScopedLock lock(mutex_);
+    return wakeups_;
+}
+
+size_t TimingWheel::__Size() const {
+    size_t size = 0;
+    for (int level = 0; level < kLevels; ++level) size += counts_[level];
+    return size;
+}
+
+uint64_t TimingWheel::__Deadline(uint64_t _now, int _after) const {
+    uint64_t deadline = _now + std::max(_after, 0);
+    int64_t slack = std::min((int64_t)_after * slack_percent_ / 100, (int64_t)slack_max_);
+
+    for (size_t i = 0; i < sizeof(kSlackGrains) / sizeof(kSlackGrains[0]); ++i) {
+        if (kSlackGrains[i] <= slack) return (deadline + kSlackGrains[i] - 1) / kSlackGrains[i] * kSlackGrains[i];
+    }
+    return deadline;
+}
+
+TimingWheel::Timer& TimingWheel::__Slot(int _level, uint64_t _tick) {
+    if (0 == _level) return level0_[_tick & (kLevel0Slots - 1)];
+    return levels_[_level - 1][(_tick >> (kLevel0Bits + (_level - 1) * kLevelBits)) & (kLevelSlots - 1)];
+}
+
+void TimingWheel::__Add(Timer& _timer) {
+    static const uint64_t kRange = (uint64_t)1 << (kLevel0Bits + (kLevels - 1) * kLevelBits);
+
+    uint64_t tick = std::max(_timer.expire_, current_);  // a late one fires with the next tick
+    if (kRange <= tick - current_) tick = current_ + kRange - 1;
+
+    int level = 0;
+    while (level < kLevels - 1 && ((uint64_t)1 << (kLevel0Bits + level * kLevelBits)) <= tick - current_) ++level;
+
+    Timer& head = __Slot(level, tick);
+    _timer.prev_ = head.prev_;
+    _timer.next_ = &head;
+    head.prev_->next_ = &_timer;
+    head.prev_ = &_timer;
+    _timer.level_ = level;
+    ++counts_[level];
+}
+
+void TimingWheel::__Unlink(Timer& _timer) {
+    _timer.prev_->next_ = _timer.next_;
+    _timer.next_->prev_ = _timer.prev_;
+    _timer.prev_ = _timer.next_ = NULL;
+    --counts_[_timer.level_];
+}
+
+size_t TimingWheel::__Cascade(int _level) {
+    size_t index = (current_ >> (kLevel0Bits + (_level - 1) * kLevelBits)) & (kLevelSlots - 1);
+    Timer& head = levels_[_level - 1][index];
+    if (head.next_ == &head) return index;
+
+    // detached first, a timer beyond the top level goes back to the top level
+    Timer* timer = head.next_;
+    head.prev_->next_ = NULL;
+    head.prev_ = head.next_ = &head;
+
+    while (NULL != timer) {
+        Timer* next = timer->next_;
+        --counts_[_level];
+        __Add(*timer);
+        timer = next;
+    }
+    return index;
+}
+
+void TimingWheel::__Advance(uint64_t _now) {
+    while (current_ <= _now) {
+        size_t index = current_ & (kLevel0Slots - 1);
+        // the lower level first, the higher one is cascaded when the lower one wraps
+        if (0 == index) for (int level = 1; level < kLevels && 0 == __Cascade(level); ++level) {}
+
+        Timer& head = level0_[index];
+        while (head.next_ != &head) {
+            Timer& timer = *head.next_;
+            __Unlink(timer);
+            MessageQueue::AsyncInvoke(timer.callback_, timer.handler_, "TimingWheel.fire");
+        }
+
+        ++current_;
+        // nothing can fire before the next cascade
+        if (0 == counts_[0]) current_ = std::min(_now + 1, (current_ + kLevel0Slots - 1) & ~(uint64_t)(kLevel0Slots - 1));
+    }
+}
+
+uint64_t TimingWheel::__NextExpire() {
+    uint64_t next = 0;
+
+    for (int i = 0; 0 < counts_[0] && i < kLevel0Slots; ++i) {
+        Timer& head = level0_[(current_ + i) & (kLevel0Slots - 1)];
+        if (head.next_ == &head) continue;
+        next = current_ + i;
+        break;
+    }
+
+    // the first slot of a higher level to be cascaded holds its earliest timers, but not in order
+    for (int level = 1; level < kLevels; ++level) {
+        if (0 == counts_[level]) continue;
+
+        size_t index = (current_ >> (kLevel0Bits + (level - 1) * kLevelBits)) & (kLevelSlots - 1);
+        for (int i = 1; i <= kLevelSlots; ++i) {
+            Timer& head = levels_[level - 1][(index + i) & (kLevelSlots - 1)];
+            if (head.next_ == &head) continue;
+
+            for (Timer* timer = head.next_; timer != &head; timer = timer->next_) {
+                if (0 == next || timer->expire_ < next) next = timer->expire_;
+            }
+            break;
+        }
+    }
+
+    return next;
+}
+
+void TimingWheel::__RunLoop() {
+    ScopedLock lock(mutex_);
+
+    while (!stopped_) {
+        uint64_t now = gettickcount();
+        __Advance(now);
+        wake_at_ = __NextExpire();
+#ifdef ANDROID
+        __ArmPlatformAlarm(wake_at_, now);
+#endif
+
+        if (0 == wake_at_) {
+            cond_.wait(lock);
+        } else {
+            cond_.wait(lock, (long)(wake_at_ - now));
+        }
+        ++wakeups_;
+    }
+}
+
+#ifdef ANDROID
+
+void TimingWheel::__ArmPlatformAlarm(uint64_t _next, uint64_t _now) {
+    static int64_t sg_id = 0;
+
+    if (_next == platform_expire_) return;
+
+    if (0 != platform_id_ && !::stopAlarm(platform_id_)) xwarn2(TSF"stopAlarm error, id:%_", platform_id_);
+    platform_id_ = 0;
+    platform_expire_ = 0;
+
+    if (0 == _next) return;
+
+    int64_t id = ++sg_id;
+    if (!::startAlarm(id, (int)(_next - _now))) {
+        xerror2(TSF"startAlarm error, id:%_, after:%_", id, _next - _now);
+        return;
+    }
+
+    platform_id_ = id;
+    platform_expire_ = _next;
+}
+
+void TimingWheel::OnPlatformAlarm(int64_t _id) {
+    ScopedLock lock(mutex_);
+    if (_id != platform_id_) return;
+
+    platform_id_ = 0;
+    int64_t miss = 0 == wake_at_ ? 0 : (int64_t)(wake_at_ - gettickcount());
+    xinfo2(TSF"platform alarm id:%_, miss:%_", _id, -miss);
+
+    if (0 < miss && miss <= kMaxLockTime) {
+        if (NULL == wakelock_) wakelock_ = new WakeUpLock();
+        wakelock_->Lock(miss + 500);
+    } else {
+        platform_expire_ = 0;  // started again for what is left
+    }
+
+    cond_.notifyAll(lock);
+}
+
+#include "jni/OnAlarm.inl"
+
+#endif
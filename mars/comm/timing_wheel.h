@@ -0,0 +1,127 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * timing_wheel.h
+ *
+ * the timers of the whole process on one hierarchical wheel driven by a single thread.
+ * start and cancel are O(1), a timer that fires is posted to the handler it was started with.
+ * deadlines are rounded up within a slack so timers started around the same time wake the thread once.
+ * on android the thread's next wakeup is the only platform alarm.
+ */
+
+#ifndef COMM_TIMING_WHEEL_H_
+#define COMM_TIMING_WHEEL_H_
+
+#include <stdint.h>
+
+#include "boost/function.hpp"
+#include "comm/messagequeue/message_queue.h"
+#include "comm/thread/condition.h"
+#include "comm/thread/mutex.h"
+#include "comm/thread/thread.h"
+
+#ifdef ANDROID
+#include "android/wakeuplock.h"
+#endif
+
+class TimingWheel {
+  public:
+    // owned by the caller, it has to be cancelled before it is destroyed
+    class Timer {
+      public:
+        Timer(): prev_(NULL), next_(NULL), expire_(0), level_(0) {}
+        bool IsPending() const { return NULL != prev_; }
+
+      private:
+        Timer(const Timer&);
+        Timer& operator=(const Timer&);
+
+      private:
+        friend class TimingWheel;
+        Timer* prev_;
+        Timer* next_;
+        uint64_t expire_;  // tick it fires at, the slack included
+        int level_;
+        boost::function<void ()> callback_;
+        MessageQueue::MessageHandler_t handler_;
+    };
+
+  public:
+    static TimingWheel& Shared();
+
+    TimingWheel();
+    ~TimingWheel();
+
+    // a pending _timer is restarted
+    void Start(Timer& _timer, int _after, const boost::function<void ()>& _callback, const MessageQueue::MessageHandler_t& _handler);  // ms
+    // false if _timer was not pending, it may have fired and its callback be on the way
+    bool Cancel(Timer& _timer);
+
+    // a timer may fire up to min(_after * _percent / 100, _max) ms late, 0 turns coalescing off
+    void SetSlack(int _percent, int _max);
+
+    size_t Size() const;
+    uint64_t Wakeups() const;
+
+#ifdef ANDROID
+    void OnPlatformAlarm(int64_t _id);
+#endif
+
+  private:
+    TimingWheel(const TimingWheel&);
+    TimingWheel& operator=(const TimingWheel&);
+
+    size_t __Size() const;
+    uint64_t __Deadline(uint64_t _now, int _after) const;
+    Timer& __Slot(int _level, uint64_t _tick);
+    void __Add(Timer& _timer);
+    void __Unlink(Timer& _timer);
+    size_t __Cascade(int _level);
+    void __Advance(uint64_t _now);
+    uint64_t __NextExpire();
+    void __RunLoop();
+
+  private:
+    enum {
+        kLevels = 4,
+        kLevel0Bits = 8,
+        kLevelBits = 6,
+        kLevel0Slots = 1 << kLevel0Bits,
+        kLevelSlots = 1 << kLevelBits,
+    };
+
+    mutable Mutex mutex_;
+    Condition cond_;
+    Thread thread_;
+    bool stopped_;
+
+    Timer level0_[kLevel0Slots];
+    Timer levels_[kLevels - 1][kLevelSlots];
+    size_t counts_[kLevels];
+    uint64_t current_;  // the next tick to process
+    uint64_t wake_at_;  // 0 when the thread waits for a timer to be started
+    uint64_t wakeups_;
+
+    int slack_percent_;
+    int slack_max_;
+
+#ifdef ANDROID
+    void __ArmPlatformAlarm(uint64_t _next, uint64_t _now);
+
+    int64_t platform_id_;
+    uint64_t platform_expire_;
+    WakeUpLock* wakelock_;
+#endif
+};
+
+#endif  // COMM_TIMING_WHEEL_H_
@@ -188,16 +188,14 @@ bool SocketPoll::ConsignReport(SocketPoll& _consignor, int64_t _timeout) const {
             i.revents = find_it->revents;
             ++triggered_event_count;
             
-            if (i.fd == _consignor.events_[0].fd) {
-                xassert2(&i == &(_consignor.events_[0]));
-                continue;
+            // the breaker only counts, it is not a triggered event; find_it must still move on with i
+            if (&i != &(_consignor.events_[0])) {
+                PollEvent traggered_event;
+                traggered_event.poll_event_ = i;
+                traggered_event.user_data_  = _consignor.events_user_data_[i.fd];
+                
+                _consignor.triggered_events_.push_back(traggered_event);
             }
-            
-            PollEvent traggered_event;
-            traggered_event.poll_event_ = i;
-            traggered_event.user_data_  = _consignor.events_user_data_[i.fd];
-            
-            _consignor.triggered_events_.push_back(traggered_event);
         }
         ++find_it;
     }
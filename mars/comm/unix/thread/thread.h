@@ -20,9 +20,13 @@
 #include <string.h>
 #include <signal.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "comm/assert/__assert.h"
 #include "comm/thread/condition.h"
 #include "comm/thread/runnable.h"
+#include "comm/time_utils.h"
 
 typedef pthread_t thread_tid;
 //注意！！！！！！！！！！！！！！！！！！！！！！！！！！！！！！！！！！！！！！
@@ -68,6 +72,180 @@ class ThreadUtil {
     }
 };
 
+/*
+ * parked workers for the Thread objects marked pooled, a start hands the routine to an idle worker
+ * instead of creating a thread. a worker with nothing to do for kIdleTimeout exits, so do the ones
+ * finishing while max_idle others are parked already.
+ * every thread created through Thread, pooled or not, is counted here.
+ */
+class ThreadPool {
+  public:
+    typedef void* (*routine_t)(void*);
+
+    static ThreadPool& Shared() {
+        // never destroyed, parked workers still use it at exit
+        static ThreadPool* pool = new ThreadPool;
+        return *pool;
+    }
+
+    // for the workers created from now on, a thread asking for more gets a worker with its size
+    void stack_size(size_t _stacksize) {
+        ScopedLock lock(mutex_);
+        if (0 != _stacksize) stacksize_ = _stacksize;
+    }
+
+    size_t stack_size() const {
+        ScopedLock lock(mutex_);
+        return stacksize_;
+    }
+
+    void max_idle(size_t _count) {
+        ScopedLock lock(mutex_);
+        maxidle_ = _count;
+    }
+
+    size_t idle() const {
+        ScopedLock lock(mutex_);
+        return idle_.size();
+    }
+
+    // threads created since the process started, and in the last full second
+    uint64_t creations() const {
+        ScopedLock lock(mutex_);
+        return created_;
+    }
+
+    uint32_t creations_per_second() {
+        ScopedLock lock(mutex_);
+        __roll_second();
+        return lastsecondcount_;
+    }
+
+    void count_creation() {
+        ScopedLock lock(mutex_);
+        __roll_second();
+        ++secondcount_;
+        ++created_;
+    }
+
+    // _tid is the worker the routine runs on, set before the routine can run
+    int run(routine_t _routine, void* _arg, size_t _stacksize, thread_tid& _tid) {
+        ScopedLock lock(mutex_);
+
+        // the one parked last is the most likely to be warm
+        for (std::vector<Worker*>::reverse_iterator it = idle_.rbegin(); it != idle_.rend(); ++it) {
+            Worker* worker = *it;
+            if (worker->stacksize < _stacksize) continue;
+
+            idle_.erase(--(it.base()));
+            worker->routine = _routine;
+            worker->arg = _arg;
+            _tid = worker->tid;
+            worker->cond.notifyAll(lock);
+            return 0;
+        }
+
+        Worker* worker = new Worker(std::max(_stacksize, stacksize_));
+        worker->routine = _routine;
+        worker->arg = _arg;
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        pthread_attr_setstacksize(&attr, worker->stacksize);
+        int ret = pthread_create(&worker->tid, &attr, &__worker_main, worker);
+        pthread_attr_destroy(&attr);
+
+        if (0 != ret) {
+            delete worker;
+            return ret;
+        }
+
+        _tid = worker->tid;
+        lock.unlock();
+        count_creation();
+        return 0;
+    }
+
+  private:
+    enum {
+        kIdleTimeout = 60 * 1000,  // ms
+        kDefaultMaxIdle = 8,
+    };
+
+    struct Worker {
+        explicit Worker(size_t _stacksize): tid(0), stacksize(_stacksize), routine(NULL), arg(NULL) {}
+
+        thread_tid tid;
+        size_t stacksize;
+        routine_t routine;
+        void* arg;
+        Condition cond;
+    };
+
+    ThreadPool(): stacksize_(0), maxidle_(kDefaultMaxIdle), created_(0), second_(0), secondcount_(0), lastsecondcount_(0) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_getstacksize(&attr, &stacksize_);
+        pthread_attr_destroy(&attr);
+    }
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    void __roll_second() {
+        uint64_t second = gettickcount() / 1000;
+        if (second == second_) return;
+
+        lastsecondcount_ = second == second_ + 1 ? secondcount_ : 0;
+        second_ = second;
+        secondcount_ = 0;
+    }
+
+    static void* __worker_main(void* _arg) {
+        Worker* worker = static_cast<Worker*>(_arg);
+        ThreadPool& pool = Shared();
+        ScopedLock lock(pool.mutex_);
+
+        while (true) {
+            if (NULL == worker->routine) {
+                if (ETIMEDOUT == worker->cond.wait(lock, kIdleTimeout) && NULL == worker->routine) {
+                    pool.idle_.erase(std::remove(pool.idle_.begin(), pool.idle_.end(), worker), pool.idle_.end());
+                    break;
+                }
+                continue;
+            }
+
+            routine_t routine = worker->routine;
+            void* arg = worker->arg;
+            worker->routine = NULL;
+            worker->arg = NULL;
+
+            lock.unlock();
+            routine(arg);
+            lock.lock();
+
+            if (pool.maxidle_ <= pool.idle_.size()) break;
+            pool.idle_.push_back(worker);
+        }
+
+        lock.unlock();
+        delete worker;
+        return 0;
+    }
+
+  private:
+    mutable Mutex mutex_;
+    std::vector<Worker*> idle_;
+    size_t stacksize_;
+    size_t maxidle_;
+
+    uint64_t created_;
+    uint64_t second_;
+    uint32_t secondcount_;
+    uint32_t lastsecondcount_;
+};
+
 class Thread {
   private:
     class RunnableReference {
@@ -75,7 +253,7 @@ class Thread {
         RunnableReference(Runnable* _target)
             : target(_target), count(0), tid(0), isjoined(false), isended(true)
             , aftertime(LONG_MAX), periodictime(LONG_MAX), iscanceldelaystart(false)
-            , condtime(), splock(), isinthread(false), killsig(0) {
+            , condtime(), splock(), isinthread(false), killsig(0), ispooled(false) {
             memset(thread_name, 0, sizeof(thread_name));
         }
 
@@ -118,12 +296,15 @@ class Thread {
         bool isinthread;  // 猥琐的东西，是为了解决线程还没有起来的时就发送信号出现crash的问题
         int killsig;
         char thread_name[128];
+        bool ispooled;      // its tid is a worker of ThreadPool, never joined or detached
+        Mutex endmutex;
+        Condition endcond;  // a join of a pooled one waits on it
     };
 
   public:
     template<class T>
     explicit Thread(const T& op, const char* _thread_name = NULL, bool _outside_join = false)
-        : runable_ref_(NULL), outside_join_(_outside_join) {
+        : runable_ref_(NULL), outside_join_(_outside_join), pooled_(false) {
         runable_ref_ = new RunnableReference(detail::transform(op));
         ScopedSpinLock lock(runable_ref_->splock);
         runable_ref_->AddRef();
@@ -134,7 +315,7 @@ class Thread {
     }
 
     Thread(const char* _thread_name = NULL, bool _outside_join = false)
-        : runable_ref_(NULL), outside_join_(_outside_join) {
+        : runable_ref_(NULL), outside_join_(_outside_join), pooled_(false) {
         runable_ref_ = new RunnableReference(NULL);
         ScopedSpinLock lock(runable_ref_->splock);
         runable_ref_->AddRef();
@@ -148,7 +329,7 @@ class Thread {
         int res = pthread_attr_destroy(&attr_);
         ASSERT2(0 == res, "res=%d", res);
         ScopedSpinLock lock(runable_ref_->splock);
-        if (0 != runable_ref_->tid && !runable_ref_->isjoined) pthread_detach(runable_ref_->tid);
+        __detach();
         runable_ref_->RemoveRef(lock);
     }
 
@@ -158,14 +339,14 @@ class Thread {
         if (_newone) *_newone = false;
 
         if (isruning())return 0;
-        if (0 != runable_ref_->tid && !runable_ref_->isjoined) pthread_detach(runable_ref_->tid);
+        __detach();
 
         ASSERT(runable_ref_->target);
         runable_ref_->isended = false;
         runable_ref_->isjoined = outside_join_;
         runable_ref_->AddRef();
 
-        int ret =  pthread_create(reinterpret_cast<thread_tid*>(&runable_ref_->tid), &attr_, start_routine, runable_ref_);
+        int ret =  __create(start_routine);
         ASSERT(0 == ret);
 
         if (_newone) *_newone = true;
@@ -185,7 +366,7 @@ class Thread {
         if (_newone) *_newone = false;
 
         if (isruning())return 0;
-        if (0 != runable_ref_->tid && !runable_ref_->isjoined) pthread_detach(runable_ref_->tid);
+        __detach();
         
         delete runable_ref_->target;
         runable_ref_->target = detail::transform(op);
@@ -194,7 +375,7 @@ class Thread {
         runable_ref_->isjoined = outside_join_;
         runable_ref_->AddRef();
 
-        int ret =  pthread_create(reinterpret_cast<thread_tid*>(&runable_ref_->tid), &attr_, start_routine, runable_ref_);
+        int ret =  __create(start_routine);
         ASSERT(0 == ret);
 
         if (_newone) *_newone = true;
@@ -211,7 +392,7 @@ class Thread {
         ScopedSpinLock lock(runable_ref_->splock);
 
         if (isruning())return 0;
-        if (0 != runable_ref_->tid && !runable_ref_->isjoined) pthread_detach(runable_ref_->tid);
+        __detach();
 
         ASSERT(runable_ref_->target);
         runable_ref_->condtime.cancelAnyWayNotify();
@@ -221,7 +402,7 @@ class Thread {
         runable_ref_->iscanceldelaystart = false;
         runable_ref_->AddRef();
 
-        int ret =  pthread_create(reinterpret_cast<thread_tid*>(&runable_ref_->tid), &attr_, start_routine_after, runable_ref_);
+        int ret =  __create(start_routine_after);
         ASSERT(0 == ret);
 
         if (0 != ret) {
@@ -246,7 +427,7 @@ class Thread {
         ScopedSpinLock lock(runable_ref_->splock);
 
         if (isruning()) return 0;
-        if (0 != runable_ref_->tid && !runable_ref_->isjoined) pthread_detach(runable_ref_->tid);
+        __detach();
 
         ASSERT(runable_ref_->target);
         runable_ref_->condtime.cancelAnyWayNotify();
@@ -257,7 +438,7 @@ class Thread {
         runable_ref_->periodictime = periodic;
         runable_ref_->AddRef();
 
-        int ret = pthread_create(reinterpret_cast<thread_tid*>(&runable_ref_->tid), &attr_, start_routine_periodic, runable_ref_);
+        int ret = __create(start_routine_periodic);
         ASSERT(0 == ret);
 
         if (0 != ret) {
@@ -287,7 +468,14 @@ class Thread {
 
         if (tid() == ThreadUtil::currentthreadid()) return EDEADLK;
 
-        if (isruning()) {
+        if (isruning() && runable_ref_->ispooled) {
+            runable_ref_->isjoined = true;
+            lock.unlock();
+
+            // the worker lives on, it is the routine that is waited for
+            ScopedLock endlock(runable_ref_->endmutex);
+            while (isruning()) runable_ref_->endcond.wait(endlock);
+        } else if (isruning()) {
             runable_ref_->isjoined = true;
             lock.unlock();
             ret = pthread_join(tid(), 0);
@@ -354,7 +542,30 @@ class Thread {
         return runable_ref_->thread_name;
     }
 
+    // from the next start on, run on a parked worker of ThreadPool instead of a thread of its own.
+    // for short lived threads started again and again, unsafe_exit ends the worker with them
+    void pooled(bool _pooled) {
+        pooled_ = _pooled;
+    }
+
+    bool pooled() const {
+        return pooled_;
+    }
+
   private:
+    // called with splock held
+    int __create(ThreadPool::routine_t _routine) {
+        runable_ref_->ispooled = pooled_;
+        if (pooled_) return ThreadPool::Shared().run(_routine, runable_ref_, stack_size(), runable_ref_->tid);
+
+        int ret = pthread_create(reinterpret_cast<thread_tid*>(&runable_ref_->tid), &attr_, _routine, runable_ref_);
+        if (0 == ret) ThreadPool::Shared().count_creation();
+        return ret;
+    }
+
+    void __detach() {
+        if (0 != runable_ref_->tid && !runable_ref_->isjoined && !runable_ref_->ispooled) pthread_detach(runable_ref_->tid);
+    }
 
 #ifdef ANDROID
     static void exit_handler(int _sig) {
@@ -400,7 +611,12 @@ class Thread {
         runableref->isinthread = false;
         runableref->killsig = 0;
         runableref->isended = true;
-        
+
+        if (runableref->ispooled) {
+            ScopedLock endlock((const_cast<RunnableReference*>(runableref))->endmutex);
+            (const_cast<RunnableReference*>(runableref))->endcond.notifyAll(endlock);
+        }
+
         (const_cast<RunnableReference*>(runableref))->RemoveRef(lock);
     }
 
@@ -457,6 +673,7 @@ class Thread {
     RunnableReference*  runable_ref_;
     pthread_attr_t attr_;
     bool outside_join_;
+    bool pooled_;
 };
 
 
@@ -387,6 +387,10 @@ class Thread {
         return !m_runableref->isended;
     }
 
+    // no ThreadPool here, a pooled thread is a thread of its own
+    void pooled(bool _pooled) {}
+    bool pooled() const { return false; }
+
   private:
     static void init(void* arg) {
         volatile RunnableReference* runableref = static_cast<RunnableReference*>(arg);
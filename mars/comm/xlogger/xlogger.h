@@ -37,6 +37,16 @@
 #define  xlogger_Write(...)				((void)0)
 #endif
 
+/* levels below XLOGGER_MIN_LEVEL are compiled out, no runtime check and no argument evaluation.
+ * define it per project (like XLOGGER_TAG) or before including this header in a source file.
+ */
+#ifndef XLOGGER_MIN_LEVEL
+#define XLOGGER_MIN_LEVEL kLevelAll
+#endif
+
+#define XLOGGER_LEVEL_COMPILED(level)	((int)(level) >= (int)(XLOGGER_MIN_LEVEL))
+#define XLOGGER_LEVEL_ENABLED(level)	(XLOGGER_LEVEL_COMPILED(level) && xlogger_IsEnabledFor(level))
+
 #ifdef __cplusplus
 #include <string>
 
@@ -247,7 +257,7 @@ private:
 class XScopeTracer {
 public:
 	XScopeTracer(TLogLevel _level, const char* _tag, const char* _name, const char* _file, const char* _func, int _line, const char* _log)
-	:m_enable(xlogger_IsEnabledFor(_level)), m_info(), m_tv() {
+	:m_enable(XLOGGER_LEVEL_ENABLED(_level)), m_info(), m_tv() {
 		m_info.level = _level;
 
 		if (m_enable) {
@@ -282,6 +292,7 @@ public:
 		}
 	}
 	
+	bool IsEnabled() const { return m_enable; }
 	void Exit(const std::string& _exitmsg) { m_exitmsg += _exitmsg; }
 	
 private:
@@ -611,12 +622,12 @@ __attribute__((__format__ (printf, 2, 3)))
 #endif
 __inline void  __xlogger_c_write(const XLoggerInfo* _info, const char* _log, ...) { xlogger_Write(_info, _log); }
 
-#define xlogger2(level, tag, file, func, line, ...)		 if ((!xlogger_IsEnabledFor(level)));\
+#define xlogger2(level, tag, file, func, line, ...)		 if ((!XLOGGER_LEVEL_ENABLED(level)));\
 															  else { XLoggerInfo info= {level, tag, file, func, line,\
 																	 {0, 0}, -1, -1, -1};\ gettimeofday(&info.m_tv, NULL);\
 																	 XLOGGER_ROUTER_OUTPUT(__xlogger_c_write(&info, __VA_ARGS__),xlogger_Print(&info, __VA_ARGS__), __VA_ARGS__);}
 
-#define xlogger2_if(exp, level, tag, file, func, line, ...)    if (!(exp) || !xlogger_IsEnabledFor(level));\
+#define xlogger2_if(exp, level, tag, file, func, line, ...)    if (!XLOGGER_LEVEL_COMPILED(level) || !(exp) || !xlogger_IsEnabledFor(level));\
 																	else { XLoggerInfo info= {level, tag, file, func, line,\
 																		   {0, 0}, -1, -1, -1}; gettimeofday(&info.timeval, NULL);\
 																		   XLOGGER_ROUTER_OUTPUT(__xlogger_c_write(&info, __VA_ARGS__),xlogger_Print(&info, __VA_ARGS__), __VA_ARGS__);}
@@ -650,15 +661,15 @@ __inline void  __xlogger_c_write(const XLoggerInfo* _info, const char* _log, ...
 #define XLOGGER_HOOK NULL
 #endif
 
-#define xlogger(level, tag, file, func, line, ...)	   if ((!xlogger_IsEnabledFor(level)));\
+#define xlogger(level, tag, file, func, line, ...)	   if ((!XLOGGER_LEVEL_ENABLED(level)));\
 													   else XLogger(level, tag, file, func, line, XLOGGER_HOOK)\
 															 XLOGGER_ROUTER_OUTPUT(.WriteNoFormat(TSF __VA_ARGS__),(TSF __VA_ARGS__), __VA_ARGS__)
 
-#define xlogger2(level, tag, file, func, line, ...)		if ((!xlogger_IsEnabledFor(level)));\
+#define xlogger2(level, tag, file, func, line, ...)		if ((!XLOGGER_LEVEL_ENABLED(level)));\
 														else XLogger(level, tag, file, func, line, XLOGGER_HOOK)\
 															 XLOGGER_ROUTER_OUTPUT(.WriteNoFormat(__VA_ARGS__),(__VA_ARGS__), __VA_ARGS__)
 
-#define xlogger2_if(exp, level, tag, file, func, line, ...)		if ((!(exp) || !xlogger_IsEnabledFor(level)));\
+#define xlogger2_if(exp, level, tag, file, func, line, ...)		if ((!XLOGGER_LEVEL_COMPILED(level) || !(exp) || !xlogger_IsEnabledFor(level)));\
 																else XLogger(level, tag, file, func, line, XLOGGER_HOOK)\
 																	 XLOGGER_ROUTER_OUTPUT(.WriteNoFormat(__VA_ARGS__),(__VA_ARGS__), __VA_ARGS__)
 
@@ -693,20 +704,21 @@ __inline void  __xlogger_c_write(const XLoggerInfo* _info, const char* _log, ...
 #define xmessage2(...)					XMessage() XLOGGER_ROUTER_OUTPUT(.WriteNoFormat(__VA_ARGS__),(__VA_ARGS__), __VA_ARGS__)
 
 
-#define XLOGGER_SCOPE_MESSAGE(...)		PP_IF(PP_NUM_PARAMS(__VA_ARGS__), xmessage2(__VA_ARGS__).String().c_str(), NULL)
-#define __xscope_impl(level, name, ...)   XScopeTracer __ANONYMOUS_VARIABLE__(_tracer_)(level, XLOGGER_TAG, name, __XFILE__, __XFUNCTION__, __LINE__, XLOGGER_SCOPE_MESSAGE(__VA_ARGS__))
+//message is only formatted when the level is enabled
+#define XLOGGER_SCOPE_MESSAGE(level, ...)	PP_IF(PP_NUM_PARAMS(__VA_ARGS__), (XLOGGER_LEVEL_ENABLED(level) ? xmessage2(__VA_ARGS__).String().c_str() : NULL), NULL)
+#define __xscope_impl(level, name, ...)   XScopeTracer __ANONYMOUS_VARIABLE__(_tracer_)(level, XLOGGER_TAG, name, __XFILE__, __XFUNCTION__, __LINE__, XLOGGER_SCOPE_MESSAGE(level, __VA_ARGS__))
 
 #define xverbose_scope(name, ...)		__xscope_impl(kLevelVerbose, name, __VA_ARGS__)
 #define xdebug_scope(name, ...)			__xscope_impl(kLevelDebug, name, __VA_ARGS__)
 #define xinfo_scope(name, ...)			__xscope_impl(kLevelInfo, name, __VA_ARGS__)
 
-#define __xfunction_scope_impl(level, name, ...)	XScopeTracer ____xloger_anonymous_function_scope_20151022____(level, XLOGGER_TAG, name, __XFILE__, __XFUNCTION__, __LINE__, XLOGGER_SCOPE_MESSAGE(__VA_ARGS__))
+#define __xfunction_scope_impl(level, name, ...)	XScopeTracer ____xloger_anonymous_function_scope_20151022____(level, XLOGGER_TAG, name, __XFILE__, __XFUNCTION__, __LINE__, XLOGGER_SCOPE_MESSAGE(level, __VA_ARGS__))
 
 #define xverbose_function(...)			__xfunction_scope_impl(kLevelVerbose, __FUNCTION__, __VA_ARGS__)
 #define xdebug_function(...)			__xfunction_scope_impl(kLevelDebug, __FUNCTION__, __VA_ARGS__)
 #define xinfo_function(...)				__xfunction_scope_impl(kLevelInfo, __FUNCTION__, __VA_ARGS__)
-#define xexitmsg_function(...)			   ____xloger_anonymous_function_scope_20151022____.Exit(xmessage2(__VA_ARGS__).String())
-#define xexitmsg_function_if(exp, ...)	   if((!exp)); else ____xloger_anonymous_function_scope_20151022____.Exit(xmessage2(__VA_ARGS__).String())
+#define xexitmsg_function(...)			   if (!____xloger_anonymous_function_scope_20151022____.IsEnabled()); else ____xloger_anonymous_function_scope_20151022____.Exit(xmessage2(__VA_ARGS__).String())
+#define xexitmsg_function_if(exp, ...)	   if((!exp) || !____xloger_anonymous_function_scope_20151022____.IsEnabled()); else ____xloger_anonymous_function_scope_20151022____.Exit(xmessage2(__VA_ARGS__).String())
 
 
 #define TSF __tsf__,
@@ -0,0 +1,168 @@
+/* xxhash64.c -- XXH64, a fast non-cryptographic 64-bit hash
+ * algorithm by Yann Collet (BSD 2-Clause), see https://github.com/Cyan4973/xxHash
+ *
+ * four independent lanes of 8 bytes per round, so it runs near memory speed without simd.
+ */
+
+#include "xxhash64.h"
+
+#include <string.h>
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+/* memcpy keeps unaligned reads legal, compilers turn it into a single load */
+static uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static uint64_t round64(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    acc = ROTL64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static uint64_t merge_round64(uint64_t acc, uint64_t val) {
+    acc ^= round64(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+static const unsigned char* consume_stripes(uint64_t v[4], const unsigned char* p, const unsigned char* limit) {
+    uint64_t v1 = v[0], v2 = v[1], v3 = v[2], v4 = v[3];
+    do {
+        v1 = round64(v1, read64(p)); p += 8;
+        v2 = round64(v2, read64(p)); p += 8;
+        v3 = round64(v3, read64(p)); p += 8;
+        v4 = round64(v4, read64(p)); p += 8;
+    } while (p <= limit);
+    v[0] = v1; v[1] = v2; v[2] = v3; v[3] = v4;
+    return p;
+}
+
+static uint64_t finalize(uint64_t h, const unsigned char* p, size_t len) {
+    while (len >= 8) {
+        h ^= round64(0, read64(p));
+        h = ROTL64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+        len -= 8;
+    }
+    if (len >= 4) {
+        h ^= (uint64_t)read32(p) * PRIME64_1;
+        h = ROTL64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+        len -= 4;
+    }
+    while (len > 0) {
+        h ^= (*p) * PRIME64_5;
+        h = ROTL64(h, 11) * PRIME64_1;
+        ++p;
+        --len;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static uint64_t converge(const uint64_t v[4]) {
+    uint64_t h = ROTL64(v[0], 1) + ROTL64(v[1], 7) + ROTL64(v[2], 12) + ROTL64(v[3], 18);
+    h = merge_round64(h, v[0]);
+    h = merge_round64(h, v[1]);
+    h = merge_round64(h, v[2]);
+    h = merge_round64(h, v[3]);
+    return h;
+}
+
+uint64_t xxh64(const void* buf, size_t len, uint64_t seed) {
+    const unsigned char* p = (const unsigned char*)buf;
+    uint64_t h;
+
+    if (len >= 32) {
+        uint64_t v[4];
+        v[0] = seed + PRIME64_1 + PRIME64_2;
+        v[1] = seed + PRIME64_2;
+        v[2] = seed;
+        v[3] = seed - PRIME64_1;
+        p = consume_stripes(v, p, p + len - 32);
+        h = converge(v);
+    } else {
+        h = seed + PRIME64_5;
+    }
+
+    h += (uint64_t)len;
+    return finalize(h, p, len & 31);
+}
+
+void xxh64_reset(xxh64_state* state, uint64_t seed) {
+    memset(state, 0, sizeof(*state));
+    state->v[0] = seed + PRIME64_1 + PRIME64_2;
+    state->v[1] = seed + PRIME64_2;
+    state->v[2] = seed;
+    state->v[3] = seed - PRIME64_1;
+}
+
+void xxh64_update(xxh64_state* state, const void* buf, size_t len) {
+    const unsigned char* p = (const unsigned char*)buf;
+    const unsigned char* end = p + len;
+
+    if (NULL == buf || 0 == len) return;
+    state->total_len += len;
+
+    if (state->mem_size + len < 32) {
+        memcpy(state->mem + state->mem_size, p, len);
+        state->mem_size += (unsigned int)len;
+        return;
+    }
+
+    if (state->mem_size > 0) {
+        size_t fill = 32 - state->mem_size;
+        memcpy(state->mem + state->mem_size, p, fill);
+        consume_stripes(state->v, state->mem, state->mem);
+        p += fill;
+        state->mem_size = 0;
+    }
+
+    if (end - p >= 32) {
+        p = consume_stripes(state->v, p, end - 32);
+    }
+
+    if (p < end) {
+        memcpy(state->mem, p, (size_t)(end - p));
+        state->mem_size = (unsigned int)(end - p);
+    }
+}
+
+uint64_t xxh64_digest(const xxh64_state* state) {
+    uint64_t h;
+
+    if (state->total_len >= 32) {
+        h = converge(state->v);
+    } else {
+        h = state->v[2] + PRIME64_5;
+    }
+
+    h += state->total_len;
+    return finalize(h, state->mem, state->mem_size);
+}
@@ -0,0 +1,34 @@
+/* xxhash64.h -- XXH64, a fast non-cryptographic 64-bit hash
+ * algorithm by Yann Collet (BSD 2-Clause), see https://github.com/Cyan4973/xxHash
+ */
+#ifndef COMM_XXHASH64_H_
+#define COMM_XXHASH64_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct xxh64_state {
+    uint64_t total_len;
+    uint64_t v[4];
+    unsigned char mem[32];
+    unsigned int mem_size;
+} xxh64_state;
+
+/* one-shot */
+uint64_t xxh64(const void* buf, size_t len, uint64_t seed);
+
+/* streaming, xxh64_digest(update(a), update(b)) == xxh64(a+b) */
+void xxh64_reset(xxh64_state* state, uint64_t seed);
+void xxh64_update(xxh64_state* state, const void* buf, size_t len);
+uint64_t xxh64_digest(const xxh64_state* state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // COMM_XXHASH64_H_
@@ -154,6 +154,11 @@ bool (*longlink_complexconnect_need_verify)()
     return false;
 };
 
+bool (*longlink_resume_req)(uint32_t& _cmdid, AutoBuffer& _body, AutoBuffer& _extend)
+= [](uint32_t& _cmdid, AutoBuffer& _body, AutoBuffer& _extend) {
+    return false;
+};
+
 bool (*longlink_ispush)(uint32_t _cmdid, uint32_t _taskid, const AutoBuffer& _body, const AutoBuffer& _extend)
 = [](uint32_t _cmdid, uint32_t _taskid, const AutoBuffer& _body, const AutoBuffer& _extend) {
     return PUSH_DATA_TASKID == _taskid;
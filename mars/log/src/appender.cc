@@ -66,6 +66,7 @@
 #include "mars/comm/mmap_util.h"
 #include "mars/comm/tickcount.h"
 #include "mars/comm/verinfo.h"
+#include "mars/comm/startup_pipeline.h"
 
 #ifdef __APPLE__
 #include "mars/comm/objc/data_protect_attr.h"
@@ -122,6 +123,10 @@ static std::string sg_log_extra_msg;
 
 static boost::iostreams::mapped_file& sg_mmmap_file = *(new boost::iostreams::mapped_file);
 
+// what the last process left in the mmap, the async thread writes it before anything newer
+static AutoBuffer sg_mmap_recovered;
+static std::string sg_mmap_recovered_mark;
+
 namespace {
 class ScopeErrno {
   public:
@@ -623,6 +628,12 @@ static void __writetips2file(const char* _tips_format, ...) {
     __log2file(tmp_buff.Ptr(), tmp_buff.Length(), false);
 }
 
+static void __write_recovered_mmap(const AutoBuffer& _buffer, const char* _mark_info) {
+    __writetips2file("~~~~~ begin of mmap ~~~~~\n");
+    __log2file(_buffer.Ptr(), _buffer.Length(), false);
+    __writetips2file("~~~~~ end of mmap ~~~~~%s\n", _mark_info);
+}
+
 static void __async_log_thread() {
     while (true) {
 
@@ -630,6 +641,18 @@ static void __async_log_thread() {
 
         if (NULL == sg_log_buff) break;
 
+        if (NULL != sg_mmap_recovered.Ptr()) {
+            AutoBuffer recovered;
+            std::string mark_info;
+            recovered.Attach(sg_mmap_recovered);
+            mark_info.swap(sg_mmap_recovered_mark);
+            lock_buffer.unlock();
+
+            __write_recovered_mmap(recovered, mark_info.c_str());
+            lock_buffer.lock();
+            if (NULL == sg_log_buff) break;
+        }
+
         AutoBuffer tmp;
         sg_log_buff->Flush(tmp);
         lock_buffer.unlock();
@@ -862,23 +885,28 @@ void appender_open(TAppenderMode _mode, const char* _dir, const char* _nameprefi
     AutoBuffer buffer;
     sg_log_buff->Flush(buffer);
 
+    char mark_info[512] = {0};
+    get_mark_info(mark_info, sizeof(mark_info));
+
+    // the caller doesn't wait for the log file to be opened and written unless the mode is sync
+    bool recover_async = kAppednerAsync == _mode && NULL != buffer.Ptr();
+    if (recover_async) {
+        ScopedLock lock_buffer(sg_mutex_buffer_async);
+        sg_mmap_recovered.Attach(buffer);
+        sg_mmap_recovered_mark = mark_info;
+    }
+
     ScopedLock lock(sg_mutex_log_file);
     sg_logdir = _dir;
     sg_logfileprefix = _nameprefix;
     sg_log_close = false;
     appender_setmode(_mode);
     lock.unlock();
-    
-    char mark_info[512] = {0};
-    get_mark_info(mark_info, sizeof(mark_info));
 
-    if (buffer.Ptr()) {
-        __writetips2file("~~~~~ begin of mmap ~~~~~\n");
-        __log2file(buffer.Ptr(), buffer.Length(), false);
-        __writetips2file("~~~~~ end of mmap ~~~~~%s\n", mark_info);
-    }
+    if (!recover_async && buffer.Ptr()) __write_recovered_mmap(buffer, mark_info);
 
     tickcountdiff_t get_mmap_time = tickcount_t().gettickcount() - tick;
+    StartupPipeline::Shared().Record("appender_open", ::gettickcount() - (uint64_t)get_mmap_time, (uint64_t)get_mmap_time, StartupPipeline::kStepRun);
 
     char appender_info[728] = {0};
     snprintf(appender_info, sizeof(appender_info), "^^^^^^^^^^" __DATE__ "^^^" __TIME__ "^^^^^^^^^^%s", mark_info);
@@ -20,8 +20,12 @@
 
 #include "basechecker.h"
 
+#include <algorithm>
+
 #include "mars/comm/thread/lock.h"
+#include "mars/comm/time_utils.h"
 #include "mars/comm/xlogger/xlogger.h"
+#include "mars/sdt/constants.h"
 
 using namespace mars::sdt;
 
@@ -54,4 +58,32 @@ int BaseChecker::CancelDoCheck() {
 
 void BaseChecker::__DoCheck(CheckRequestProfile& _check_request) {
     xverbose_function();
+
+    std::vector<CheckProbe> probes;
+    CollectProbes(_check_request, probes);
+
+    for (std::vector<CheckProbe>::iterator iter = probes.begin(); iter != probes.end(); ++iter) {
+        if (is_canceled_) {
+            xinfo2(TSF"checker is canceled.");
+            return;
+        }
+
+        int timeout = UNUSE_TIMEOUT == _check_request.total_timeout ? DefaultTimeout() : (int)_check_request.total_timeout;
+
+        uint64_t start_time = ::gettickcount();
+        CheckResultProfile profile;
+        bool succ = DoProbe(*iter, timeout, NULL, profile);
+        uint64_t cost_time = ::gettickcount() - start_time;
+
+        _check_request.checkresult_profiles.push_back(profile);
+        _check_request.check_status = succ ? kCheckContinue : kCheckFinish;
+
+        if (_check_request.total_timeout != UNUSE_TIMEOUT) {
+            _check_request.total_timeout -= std::min((uint64_t)_check_request.total_timeout, cost_time);
+            if (_check_request.total_timeout <= 0) {
+                xinfo2(TSF"check, host: %_, ip: %_, timeout.", iter->host, iter->ip);
+                break;
+            }
+        }
+    }
 }
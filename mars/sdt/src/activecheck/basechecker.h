@@ -31,9 +31,20 @@
 
 #include "netchecker_profile.h"
 
+class NetCheckTrafficMonitor;
+
 namespace mars {
 namespace sdt {
 
+// one endpoint of a check
+struct CheckProbe {
+    CheckProbe(): port(0) {}
+
+    std::string host;
+    std::string ip;
+    unsigned int port;
+};
+
 class BaseChecker {
   public:
     BaseChecker();
@@ -43,8 +54,21 @@ class BaseChecker {
     virtual int StartDoCheck(CheckRequestProfile& _check_request) = 0;
     int CancelDoCheck();
 
+    // the endpoints of _check_request this checker probes, each one is probed by itself
+    virtual void CollectProbes(const CheckRequestProfile& _check_request, std::vector<CheckProbe>& _probes) = 0;
+    /*
+     * probes one endpoint within _timeout ms, returns false when it failed.
+     * CheckEngine calls it from several threads at once.
+     */
+    virtual bool DoProbe(const CheckProbe& _probe, int _timeout, NetCheckTrafficMonitor* _traffic_monitor, CheckResultProfile& _profile) = 0;
+    // ms, what a probe gets when the check has no total_timeout
+    virtual int DefaultTimeout() const = 0;
+    // how many probes of this checker CheckEngine runs at the same time
+    virtual int MaxConcurrentProbes() const { return 4; }
+
   protected:
-    virtual void __DoCheck(CheckRequestProfile& _check_request) = 0;
+    // probes the endpoints one after another
+    virtual void __DoCheck(CheckRequestProfile& _check_request);
   protected:
     bool is_canceled_ = false;
 };
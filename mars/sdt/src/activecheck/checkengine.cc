@@ -0,0 +1,132 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in 
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * checkengine.cc
+ */
+
+#include "checkengine.h"
+
+#include <limits.h>
+
+#include <algorithm>
+
+#include "boost/bind.hpp"
+
+#include "mars/comm/thread/lock.h"
+#include "mars/comm/thread/thread.h"
+#include "mars/comm/time_utils.h"
+#include "mars/comm/xlogger/xlogger.h"
+#include "mars/sdt/constants.h"
+
+#include "sdt/src/tools/netchecker_trafficmonitor.h"
+
+using namespace mars::sdt;
+
+CheckEngine::CheckEngine(CheckRequestProfile& _check_request)
+    : check_request_(_check_request)
+    , deadline_(0)
+    , cancel_(false) {
+}
+
+CheckEngine::~CheckEngine() {
+}
+
+void CheckEngine::Reset() {
+    ScopedLock lock(mutex_);
+    cancel_ = false;
+}
+
+void CheckEngine::Run(const std::list<BaseChecker*>& _checkers) {
+    xinfo_function();
+
+    uint64_t start_time = ::gettickcount();
+    {
+        ScopedLock lock(mutex_);
+        deadline_ = UNUSE_TIMEOUT == check_request_.total_timeout ? 0 : start_time + check_request_.total_timeout;
+        check_request_.check_status = kCheckContinue;
+    }
+    NetCheckTrafficMonitor traffic_monitor(kMobileDataThreshold);
+
+    std::vector<ProbeQueue> queues(_checkers.size());
+    size_t index = 0;
+    for (std::list<BaseChecker*>::const_iterator iter = _checkers.begin(); iter != _checkers.end(); ++iter, ++index) {
+        queues[index].checker = *iter;
+        (*iter)->CollectProbes(check_request_, queues[index].probes);
+    }
+
+    std::vector<Thread*> threads;
+    for (size_t i = 0; i < queues.size(); ++i) {
+        size_t count = std::min(queues[i].probes.size(), (size_t)std::max(1, queues[i].checker->MaxConcurrentProbes()));
+        for (size_t j = 0; j < count; ++j) {
+            Thread* thread = new Thread(boost::bind(&CheckEngine::__RunProbes, this, &queues[i], &traffic_monitor), "netcheck");
+            if (0 != thread->start()) {
+                xerror2(TSF"start probe thread fail");
+                delete thread;
+                break;
+            }
+            threads.push_back(thread);
+        }
+    }
+
+    xinfo2(TSF"checkers:%_, probe threads:%_, total_timeout:%_", queues.size(), threads.size(), check_request_.total_timeout);
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i]->join();
+        delete threads[i];
+    }
+
+    uint64_t cost_time = ::gettickcount() - start_time;
+
+    ScopedLock lock(mutex_);
+    if (UNUSE_TIMEOUT != check_request_.total_timeout)
+        check_request_.total_timeout -= (uint32_t)std::min((uint64_t)check_request_.total_timeout, cost_time);
+    check_request_.check_status = kCheckFinish;
+    xinfo2(TSF"all probes end, cancel:%_, results:%_, cost:%_", cancel_, check_request_.checkresult_profiles.size(), cost_time);
+}
+
+void CheckEngine::Cancel() {
+    ScopedLock lock(mutex_);
+    cancel_ = true;
+}
+
+int CheckEngine::__ProbeTimeout(const BaseChecker& _checker) const {
+    if (0 == deadline_) return _checker.DefaultTimeout();
+
+    uint64_t now = ::gettickcount();
+    if (now >= deadline_) return 0;
+    return (int)std::min(deadline_ - now, (uint64_t)INT_MAX);
+}
+
+void CheckEngine::__RunProbes(ProbeQueue* _queue, NetCheckTrafficMonitor* _traffic_monitor) {
+    while (true) {
+        CheckProbe probe;
+        {
+            ScopedLock lock(mutex_);
+            if (cancel_ || _queue->next >= _queue->probes.size()) return;
+            probe = _queue->probes[_queue->next++];
+        }
+
+        int timeout = __ProbeTimeout(*_queue->checker);
+        if (0 >= timeout) {
+            xinfo2(TSF"check timeout, host:%_, ip:%_ not probed", probe.host, probe.ip);
+            return;
+        }
+
+        CheckResultProfile profile;
+        bool succ = _queue->checker->DoProbe(probe, timeout, _traffic_monitor, profile);
+
+        ScopedLock lock(mutex_);
+        check_request_.checkresult_profiles.push_back(profile);
+        xinfo2(TSF"probe end, type:%_, host:%_, ip:%_, succ:%_, results:%_", profile.netcheck_type, probe.host, probe.ip, succ, check_request_.checkresult_profiles.size());
+    }
+}
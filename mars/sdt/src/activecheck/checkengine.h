@@ -0,0 +1,77 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in 
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * checkengine.h
+ *
+ * runs the probes of all the checkers of a check at the same time.
+ * every checker gets up to MaxConcurrentProbes threads pulling its probes, the timeout of a probe is cut
+ * to what is left of the check's total_timeout and the probes not started by then are dropped.
+ * results go into CheckRequestProfile::checkresult_profiles as the probes finish.
+ */
+
+#ifndef SDT_SRC_ACTIVECHECK_CHECKENGINE_H_
+#define SDT_SRC_ACTIVECHECK_CHECKENGINE_H_
+
+#include <list>
+#include <vector>
+
+#include "mars/comm/thread/mutex.h"
+#include "mars/sdt/netchecker_profile.h"
+
+#include "basechecker.h"
+
+namespace mars {
+namespace sdt {
+
+class CheckEngine {
+  public:
+    // bytes all the probes of a check may send on mobile
+    static const unsigned long kMobileDataThreshold = 512 * 1024;
+
+  public:
+    explicit CheckEngine(CheckRequestProfile& _check_request);
+    ~CheckEngine();
+
+    // called when a check is set up, a Cancel from then on stops the next Run
+    void Reset();
+    // blocks until every probe ended, the total_timeout passed or Cancel
+    void Run(const std::list<BaseChecker*>& _checkers);
+    // probes running go on until their timeout, no new one starts
+    void Cancel();
+
+  private:
+    CheckEngine(const CheckEngine&);
+    CheckEngine& operator=(const CheckEngine&);
+
+  private:
+    struct ProbeQueue {
+        ProbeQueue(): checker(NULL), next(0) {}
+
+        BaseChecker* checker;
+        std::vector<CheckProbe> probes;
+        size_t next;
+    };
+
+    void __RunProbes(ProbeQueue* _queue, NetCheckTrafficMonitor* _traffic_monitor);
+    int __ProbeTimeout(const BaseChecker& _checker) const;
+
+  private:
+    CheckRequestProfile& check_request_;
+    uint64_t deadline_;  // 0 without total_timeout
+    volatile bool cancel_;
+    Mutex mutex_;
+};
+
+}}
+
+#endif  // SDT_SRC_ACTIVECHECK_CHECKENGINE_H_
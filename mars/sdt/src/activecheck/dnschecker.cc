@@ -23,6 +23,7 @@
 #include "mars/comm/singleton.h"
 #include "mars/comm/xlogger/xlogger.h"
 #include "mars/comm/time_utils.h"
+#include "mars/comm/socket/unix_socket.h"
 #include "mars/sdt/constants.h"
 
 #include "sdt/src/checkimpl/dnsquery.h"
@@ -43,103 +44,54 @@ int DnsChecker::StartDoCheck(CheckRequestProfile& _check_request) {
 }
 
 
-void DnsChecker::__DoCheck(CheckRequestProfile& _check_request) {
-    xinfo_function();
-
+void DnsChecker::CollectProbes(const CheckRequestProfile& _check_request, std::vector<CheckProbe>& _probes) {
     //longlink host dns
-    for (CheckIPPorts_Iterator iter = _check_request.longlink_items.begin(); iter != _check_request.longlink_items.end(); ++iter) {
-        
-        if (is_canceled_) {
-            xinfo2(TSF"HttpChecker is canceled.");
-            return;
-        }
-        
-		CheckResultProfile profile;
-		profile.domain_name = iter->first;
-		profile.netcheck_type = kDnsCheck;
-		profile.network_type = ::getNetInfo();
-
-		struct socket_ipinfo_t ipinfo;
-		int timeout = (_check_request.total_timeout == UNUSE_TIMEOUT ? DEFAULT_DNS_TIMEOUT : _check_request.total_timeout);
-        uint64_t start_time = gettickcount();
-        int ret = socket_gethostbyname(profile.domain_name.c_str(), &ipinfo, timeout, NULL);
-        uint64_t cost_time = gettickcount() - start_time;
-
-        profile.error_code = ret;
-        profile.rtt = cost_time;
-
-        if (0 == ret) {
-			xinfo2(TSF"%0, check dns, host: %1, ret: %2", NET_CHECK_TAG, profile.domain_name, CHECK_SUC);
-			if (ipinfo.size >= 2){
-				profile.ip1 = inet_ntoa(ipinfo.ip[0]);
-				profile.ip2 = inet_ntoa(ipinfo.ip[1]);
-			}else if (1 == ipinfo.size){
-				profile.ip1 = inet_ntoa(ipinfo.ip[0]);
-			}else{
-				xerror2(TSF"ret = 0, but ipinfo.size = %d", ipinfo.size);
-			}
-		} else {
-			xinfo2(TSF"%0, check dns, host: %1, ret: %2", NET_CHECK_TAG, profile.domain_name, CHECK_FAIL);
-		}
-
-        _check_request.checkresult_profiles.push_back(profile);
-        _check_request.check_status = (ret >= 0 ? kCheckContinue : kCheckFinish);
-
-		if (_check_request.total_timeout != UNUSE_TIMEOUT) {
-			_check_request.total_timeout -= cost_time;
-			if (_check_request.total_timeout <= 0) {
-				xinfo2(TSF"dns check, host: %0, timeout.", profile.domain_name);
-				break;
-			}
-		}
-	}
+    for (CheckIPPorts::const_iterator iter = _check_request.longlink_items.begin(); iter != _check_request.longlink_items.end(); ++iter) {
+        CheckProbe probe;
+        probe.host = iter->first;
+        _probes.push_back(probe);
+    }
 
     //shortlink host dns
-    for (CheckIPPorts_Iterator iter = _check_request.shortlink_items.begin(); iter != _check_request.shortlink_items.end(); ++iter) {
-        
-        if (is_canceled_) {
-            xinfo2(TSF"HttpChecker is canceled.");
-            return;
-        }
-        
-		CheckResultProfile profile;
-		profile.domain_name = iter->first;
-		profile.netcheck_type = kDnsCheck;
-		profile.network_type = ::getNetInfo();
-
-		struct socket_ipinfo_t ipinfo;
-		int timeout = (_check_request.total_timeout == UNUSE_TIMEOUT ? DEFAULT_DNS_TIMEOUT : _check_request.total_timeout);
-        uint64_t start_time = gettickcount();
-        int ret = socket_gethostbyname(profile.domain_name.c_str(), &ipinfo, timeout, NULL);
-        uint64_t cost_time = gettickcount() - start_time;
-
-        profile.error_code = ret;
-        profile.rtt = cost_time;
-
-        if (0 == ret) {
-			xinfo2(TSF"%0, check dns, host: %1, ret: %2", NET_CHECK_TAG, profile.domain_name, CHECK_SUC);
-			if (ipinfo.size >= 2){
-				profile.ip1 = inet_ntoa(ipinfo.ip[0]);
-				profile.ip2 = inet_ntoa(ipinfo.ip[1]);
-			}else if (1 == ipinfo.size){
-				profile.ip1 = inet_ntoa(ipinfo.ip[0]);
-			}else{
-				xerror2(TSF"ret = 0, but ipinfo.size = %d", ipinfo.size);
-			}
-		} else {
-			xinfo2(TSF"%0, check dns, host: %1, ret: %2", NET_CHECK_TAG, profile.domain_name, CHECK_FAIL);
-		}
+    for (CheckIPPorts::const_iterator iter = _check_request.shortlink_items.begin(); iter != _check_request.shortlink_items.end(); ++iter) {
+        CheckProbe probe;
+        probe.host = iter->first;
+        _probes.push_back(probe);
+    }
+}
 
-        _check_request.checkresult_profiles.push_back(profile);
-        _check_request.check_status = (ret >= 0 ? kCheckContinue : kCheckFinish);
+int DnsChecker::DefaultTimeout() const {
+    return DEFAULT_DNS_TIMEOUT;
+}
 
-		if (_check_request.total_timeout != UNUSE_TIMEOUT) {
-			_check_request.total_timeout -= cost_time;
-			if (_check_request.total_timeout <= 0) {
-				xinfo2(TSF"dns check, host: %0, timeout.", profile.domain_name);
-				break;
-			}
+bool DnsChecker::DoProbe(const CheckProbe& _probe, int _timeout, NetCheckTrafficMonitor* _traffic_monitor, CheckResultProfile& _profile) {
+	_profile.domain_name = _probe.host;
+	_profile.netcheck_type = kDnsCheck;
+	_profile.network_type = ::getNetInfo();
+
+	struct socket_ipinfo_t ipinfo;
+    uint64_t start_time = gettickcount();
+    int ret = socket_gethostbyname(_profile.domain_name.c_str(), &ipinfo, _timeout, NULL, _traffic_monitor);
+    uint64_t cost_time = gettickcount() - start_time;
+
+    _profile.error_code = ret;
+    _profile.rtt = cost_time;
+
+    if (0 == ret) {
+		xinfo2(TSF"%0, check dns, host: %1, ret: %2", NET_CHECK_TAG, _profile.domain_name, CHECK_SUC);
+		// not inet_ntoa, its buffer is shared by the probes running at the same time
+		char ip[64] = {0};
+		if (ipinfo.size >= 2){
+			_profile.ip1 = socket_inet_ntop(AF_INET, &ipinfo.ip[0], ip, sizeof(ip));
+			_profile.ip2 = socket_inet_ntop(AF_INET, &ipinfo.ip[1], ip, sizeof(ip));
+		}else if (1 == ipinfo.size){
+			_profile.ip1 = socket_inet_ntop(AF_INET, &ipinfo.ip[0], ip, sizeof(ip));
+		}else{
+			xerror2(TSF"ret = 0, but ipinfo.size = %d", ipinfo.size);
 		}
-    }
-}
+	} else {
+		xinfo2(TSF"%0, check dns, host: %1, ret: %2", NET_CHECK_TAG, _profile.domain_name, CHECK_FAIL);
+	}
 
+    return ret >= 0;
+}
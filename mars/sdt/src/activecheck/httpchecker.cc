@@ -56,54 +56,41 @@ int HttpChecker::StartDoCheck(CheckRequestProfile& _check_request) {
 }
 
 
-void HttpChecker::__DoCheck(CheckRequestProfile& _check_request) {
-    xinfo_function();
-
-    for (CheckIPPorts_Iterator iter = _check_request.shortlink_items.begin(); iter != _check_request.shortlink_items.end(); ++iter) {
-    	std::string host = iter->first;
-    	for (std::vector<CheckIPPort>::iterator ipport = iter->second.begin(); ipport != iter->second.end(); ++ipport) {
-            
-            if (is_canceled_) {
-                xinfo2(TSF"HttpChecker is canceled.");
-                return;
-            }
-            
-    		CheckResultProfile profile;
-    		profile.netcheck_type = kHttpCheck;
-    		profile.network_type = ::getNetInfo();
-    		profile.ip = (*ipport).ip;
-    		profile.port = (*ipport).port;
-
-    		profile.url = (iter->first.empty() ? DEFAULT_HTTP_HOST : (iter->first));
-    		profile.url.append(sg_netcheck_cgi.c_str());
-    		uint64_t start_time = gettickcount();
-    		std::string errmsg;
-            
-            if (!strutil::StartsWith(profile.url, "http://")) {
-                profile.url = std::string("http://") + profile.url;
-            }
-            
-    		int ret = SendHttpQuery(profile.url, profile.status_code, errmsg, _check_request.total_timeout);
-    		uint64_t cost_time = gettickcount() - start_time;
-    		profile.rtt = cost_time;
-
-            if (ret >= 0) {
-                xinfo2(TSF"http check, host: %_, ret: %_", profile.url, profile.status_code);
-            }
-            else {
-                xinfo2(TSF"http check, host: %_, ret: %_", profile.url, profile.status_code);
-            }
-
-            _check_request.checkresult_profiles.push_back(profile);
-            _check_request.check_status = (ret >= 0 ? kCheckContinue : kCheckFinish);
-
-			if (_check_request.total_timeout != UNUSE_TIMEOUT) {
-				_check_request.total_timeout -= cost_time;
-				if (_check_request.total_timeout <= 0) {
-					xinfo2(TSF"http check, host: %_, timeout.", host);
-					break;
-				}
-			}
+void HttpChecker::CollectProbes(const CheckRequestProfile& _check_request, std::vector<CheckProbe>& _probes) {
+    for (CheckIPPorts::const_iterator iter = _check_request.shortlink_items.begin(); iter != _check_request.shortlink_items.end(); ++iter) {
+    	for (std::vector<CheckIPPort>::const_iterator ipport = iter->second.begin(); ipport != iter->second.end(); ++ipport) {
+    		CheckProbe probe;
+    		probe.host = iter->first;
+    		probe.ip = (*ipport).ip;
+    		probe.port = (*ipport).port;
+    		_probes.push_back(probe);
     	}
     }
 }
+
+int HttpChecker::DefaultTimeout() const {
+    return HTTP_DEFAULT_TIMEOUT;
+}
+
+bool HttpChecker::DoProbe(const CheckProbe& _probe, int _timeout, NetCheckTrafficMonitor* _traffic_monitor, CheckResultProfile& _profile) {
+	_profile.netcheck_type = kHttpCheck;
+	_profile.network_type = ::getNetInfo();
+	_profile.ip = _probe.ip;
+	_profile.port = _probe.port;
+
+	_profile.url = (_probe.host.empty() ? DEFAULT_HTTP_HOST : _probe.host);
+	_profile.url.append(sg_netcheck_cgi.c_str());
+	uint64_t start_time = gettickcount();
+	std::string errmsg;
+
+    if (!strutil::StartsWith(_profile.url, "http://")) {
+        _profile.url = std::string("http://") + _profile.url;
+    }
+
+	int ret = SendHttpQuery(_profile.url, _profile.status_code, errmsg, _timeout);
+	_profile.rtt = gettickcount() - start_time;
+
+    xinfo2(TSF"http check, host: %_, ret: %_", _profile.url, _profile.status_code);
+
+    return ret >= 0;
+}
@@ -20,6 +20,8 @@
 
 #include "pingchecker.h"
 
+#include <algorithm>
+
 #include "mars/comm/xlogger/xlogger.h"
 #include "mars/comm/singleton.h"
 #include "mars/comm/time_utils.h"
@@ -47,126 +49,72 @@ int PingChecker::StartDoCheck(CheckRequestProfile& _check_request) {
 #endif
 }
 
-void PingChecker::__DoCheck(CheckRequestProfile& _check_request) {
-
+void PingChecker::CollectProbes(const CheckRequestProfile& _check_request, std::vector<CheckProbe>& _probes) {
 #if defined(ANDROID) || defined(__APPLE__)
-    xinfo_function();
-
     // longlink ip ping
-    for (CheckIPPorts_Iterator iter = _check_request.longlink_items.begin(); iter != _check_request.longlink_items.end(); ++iter) {
-		for (std::vector<CheckIPPort>::iterator ipport = iter->second.begin(); ipport != iter->second.end(); ++ipport) {
-            
-            if (is_canceled_) {
-                xinfo2(TSF"PingChecker is canceled.");
-                return;
-            }
-            
-			CheckResultProfile profile;
-			std::string host = (*ipport).ip.empty() ? DEFAULT_PING_HOST : (*ipport).ip;
-			profile.ip = host;
-			profile.netcheck_type = kPingCheck;
-			profile.network_type = ::getNetInfo();
-
-			uint64_t start_time = gettickcount();
-			PingQuery ping_query;
-			int ret = ping_query.RunPingQuery(0, 0, (UNUSE_TIMEOUT == _check_request.total_timeout ? 0 : _check_request.total_timeout / 1000), host.c_str());
-			uint64_t cost_time = gettickcount() - start_time;
-
-			profile.error_code = ret;
-			profile.checkcount = DEFAULT_PING_COUNT;
-
-			struct PingStatus ping_status;  // = {0};  //can not define pingStatus in if(0==ret),because we need pingStatus.ip
-			char loss_rate[16] = {0};
-			char avgrtt[16] = {0};
-
-			if (0 == ret) {
-				ping_query.GetPingStatus(ping_status);
-				const float EPSINON = 0.00001;
-
-				if ((ping_status.loss_rate - 1.0) >= -EPSINON && (ping_status.loss_rate - 1.0) <= EPSINON) {
-					xinfo2(TSF"ping check, host: %_ failed.", host);
-				} else {
-					xinfo2(TSF"ping check, host: %_ success.", host);
-				}
-
-				snprintf(loss_rate, 16, "%f", ping_status.loss_rate);
-				snprintf(avgrtt, 16, "%f", ping_status.avgrtt);
-
-				profile.loss_rate = loss_rate;
-				profile.rtt_str = avgrtt;
-			}
-
-			_check_request.checkresult_profiles.push_back(profile);
-			_check_request.check_status = (profile.error_code == 0) ? kCheckContinue : kCheckFinish;
-
-			if (_check_request.total_timeout != UNUSE_TIMEOUT) {
-				_check_request.total_timeout -= cost_time;
-				if (_check_request.total_timeout <= 0) {
-					xinfo2(TSF"ping check, host: %_, timeout.", host);
-					break;
-				}
-			}
+    for (CheckIPPorts::const_iterator iter = _check_request.longlink_items.begin(); iter != _check_request.longlink_items.end(); ++iter) {
+		for (std::vector<CheckIPPort>::const_iterator ipport = iter->second.begin(); ipport != iter->second.end(); ++ipport) {
+			CheckProbe probe;
+			probe.ip = (*ipport).ip.empty() ? DEFAULT_PING_HOST : (*ipport).ip;
+			_probes.push_back(probe);
 		}
     }
 
     // shortlink ip ping
-    for (CheckIPPorts_Iterator iter = _check_request.shortlink_items.begin(); iter != _check_request.shortlink_items.end(); ++iter) {
-		for (std::vector<CheckIPPort>::iterator ipport = iter->second.begin(); ipport != iter->second.end(); ++ipport) {
-            
-            if (is_canceled_) {
-                xinfo2(TSF"PingChecker is canceled.");
-                return;
-            }
-            
-			CheckResultProfile profile;
-			std::string host = (*ipport).ip.empty() ? DEFAULT_PING_HOST : (*ipport).ip;
-			profile.ip = host;
-			profile.netcheck_type = kPingCheck;
-
-			uint64_t start_time = gettickcount();
-			PingQuery ping_query;
-			int ret = ping_query.RunPingQuery(0, 0, (UNUSE_TIMEOUT == _check_request.total_timeout ? 0 : _check_request.total_timeout / 1000), host.c_str());
-			uint64_t cost_time = gettickcount() - start_time;
-
-			profile.error_code = ret;
-			profile.checkcount = DEFAULT_PING_COUNT;
-
-			struct PingStatus ping_status;  // = {0};  //can not define pingStatus in if(0==ret),because we need pingStatus.ip
-			char loss_rate[16] = {0};
-			char avgrtt[16] = {0};
-
-			if (0 == ret) {
-				ping_query.GetPingStatus(ping_status);
-				const float EPSINON = 0.00001;
-
-				if ((ping_status.loss_rate - 1.0) >= -EPSINON && (ping_status.loss_rate - 1.0) <= EPSINON) {
-					xinfo2(TSF"ping check, host: %_ failed.", host);
-				} else {
-					xinfo2(TSF"ping check, host: %_ success.", host);
-				}
-
-				snprintf(loss_rate, 16, "%f", ping_status.loss_rate);
-				snprintf(avgrtt, 16, "%f", ping_status.avgrtt);
-
-				profile.loss_rate = loss_rate;
-				profile.rtt_str = avgrtt;
-			}
-
-			_check_request.checkresult_profiles.push_back(profile);
-			_check_request.check_status = (profile.error_code == 0) ? kCheckContinue : kCheckFinish;
-
-			if (_check_request.total_timeout != UNUSE_TIMEOUT) {
-				_check_request.total_timeout -= cost_time;
-				if (_check_request.total_timeout <= 0) {
-					xinfo2(TSF"ping check, host: %_, timeout.", host);
-					break;
-				}
-			}
-
+    for (CheckIPPorts::const_iterator iter = _check_request.shortlink_items.begin(); iter != _check_request.shortlink_items.end(); ++iter) {
+		for (std::vector<CheckIPPort>::const_iterator ipport = iter->second.begin(); ipport != iter->second.end(); ++ipport) {
+			CheckProbe probe;
+			probe.ip = (*ipport).ip.empty() ? DEFAULT_PING_HOST : (*ipport).ip;
+			_probes.push_back(probe);
 		}
 	}
+#endif
+}
 
+int PingChecker::DefaultTimeout() const {
+    return DEFAULT_PING_TIMEOUT * 1000;
+}
+
+int PingChecker::MaxConcurrentProbes() const {
+#ifdef __APPLE__
+    // the icmp ping of pingquery.cc keeps its state in statics
+    return 1;
+#else
+    return BaseChecker::MaxConcurrentProbes();
 #endif
 }
 
+bool PingChecker::DoProbe(const CheckProbe& _probe, int _timeout, NetCheckTrafficMonitor* _traffic_monitor, CheckResultProfile& _profile) {
+	_profile.ip = _probe.ip;
+	_profile.netcheck_type = kPingCheck;
+	_profile.network_type = ::getNetInfo();
 
+	PingQuery ping_query(_traffic_monitor);
+	int ret = ping_query.RunPingQuery(0, 0, std::max(1, _timeout / 1000), _probe.ip.c_str());
+
+	_profile.error_code = ret;
+	_profile.checkcount = DEFAULT_PING_COUNT;
+
+	struct PingStatus ping_status;  // = {0};  //can not define pingStatus in if(0==ret),because we need pingStatus.ip
+	char loss_rate[16] = {0};
+	char avgrtt[16] = {0};
+
+	if (0 == ret) {
+		ping_query.GetPingStatus(ping_status);
+		const float EPSINON = 0.00001;
+
+		if ((ping_status.loss_rate - 1.0) >= -EPSINON && (ping_status.loss_rate - 1.0) <= EPSINON) {
+			xinfo2(TSF"ping check, host: %_ failed.", _probe.ip);
+		} else {
+			xinfo2(TSF"ping check, host: %_ success.", _probe.ip);
+		}
+
+		snprintf(loss_rate, 16, "%f", ping_status.loss_rate);
+		snprintf(avgrtt, 16, "%f", ping_status.avgrtt);
+
+		_profile.loss_rate = loss_rate;
+		_profile.rtt_str = avgrtt;
+	}
+
+	return 0 == ret;
+}
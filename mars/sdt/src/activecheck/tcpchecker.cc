@@ -19,6 +19,8 @@
 //
 #include "tcpchecker.h"
 
+#include <algorithm>
+
 #include "mars/stn/stn_logic.h"
 
 #include "mars/comm/singleton.h"
@@ -47,77 +49,68 @@ int TcpChecker::StartDoCheck(CheckRequestProfile& _check_request) {
 }
 
 
-void TcpChecker::__DoCheck(CheckRequestProfile& _check_request) {
-    xinfo_function();
-
-    for (CheckIPPorts_Iterator iter = _check_request.longlink_items.begin(); iter != _check_request.longlink_items.end(); ++iter) {
-    	std::string host = iter->first;
-    	for (std::vector<CheckIPPort>::iterator ipport = iter->second.begin(); ipport != iter->second.end(); ++ipport) {
-            if (is_canceled_) {
-                xinfo2(TSF"TcpChecker is canceled.");
-                return;
-            }
-    		CheckResultProfile profile;
-			profile.netcheck_type = kTcpCheck;
-    		profile.ip = (*ipport).ip;
-    		profile.port = (*ipport).port;
-			profile.network_type = ::getNetInfo();
-
-    		unsigned int timeout = UNUSE_TIMEOUT == _check_request.total_timeout ? DEFAULT_TCP_CONN_TIMEOUT : _check_request.total_timeout;
-			xinfo2(TSF"tcp check ip: %0, port: %1, timeout: %2", profile.ip, profile.port, timeout);
-
-    		uint64_t start_time = ::gettickcount();
-    		TcpQuery tcp_query(profile.ip.c_str(), profile.port, 0);
-
-            AutoBuffer noop_send;
-            __NoopReq(noop_send);
-
-            int ret = tcp_query.tcp_send((const unsigned char *)noop_send.Ptr(), (int)noop_send.Length(), timeout);
-
-			if (ret < 0) {
-				profile.error_code = kSndRcvErr;
-				xerror2(TSF"tcp send nooping data error.");
-			} else {
-				xinfo2(TSF"tcp check send nooping data success.");
-			}
-
-			uint64_t cost_time = 0;
-			if (ret >= 0) {
-				AutoBuffer recv_buff;
-				recv_buff.AllocWrite(64 * 1024, false);
-
-				ret = tcp_query.tcp_receive(recv_buff, 64*1024, timeout);
-				cost_time = ::gettickcount() - start_time;
-
-				if (ret < 0) {
-					profile.error_code = kSndRcvErr;
-					xerror2(TSF"tcp recv nooping data error.");
-					_check_request.checkresult_profiles.push_back(profile);
-					continue;
-				} else {
-					uint32_t cmdid = 0, seq = 0; size_t packlen = 0; AutoBuffer recv_body;
-					profile.rtt = cost_time;
-					if (!__NoopResp(recv_buff, cmdid, seq, packlen, recv_body)) {	//not noop resp
-						profile.error_code = kTcpRespErr;
-					}
-				}
-			}
-
-			_check_request.checkresult_profiles.push_back(profile);
-			_check_request.check_status = (profile.error_code == 0) ? kCheckContinue : kCheckFinish;
-
-			if (_check_request.total_timeout != UNUSE_TIMEOUT) {
-				_check_request.total_timeout -= cost_time;
-				if (_check_request.total_timeout <= 0) {
-					xinfo2(TSF"tcp check, host: %0, timeout.", host);
-					break;
-				}
-			}
-
+void TcpChecker::CollectProbes(const CheckRequestProfile& _check_request, std::vector<CheckProbe>& _probes) {
+    for (CheckIPPorts::const_iterator iter = _check_request.longlink_items.begin(); iter != _check_request.longlink_items.end(); ++iter) {
+    	for (std::vector<CheckIPPort>::const_iterator ipport = iter->second.begin(); ipport != iter->second.end(); ++ipport) {
+    		CheckProbe probe;
+    		probe.host = iter->first;
+    		probe.ip = (*ipport).ip;
+    		probe.port = (*ipport).port;
+    		_probes.push_back(probe);
     	}
     }
 }
 
+int TcpChecker::DefaultTimeout() const {
+    return DEFAULT_TCP_CONN_TIMEOUT;
+}
+
+bool TcpChecker::DoProbe(const CheckProbe& _probe, int _timeout, NetCheckTrafficMonitor* _traffic_monitor, CheckResultProfile& _profile) {
+	_profile.netcheck_type = kTcpCheck;
+	_profile.ip = _probe.ip;
+	_profile.port = _probe.port;
+	_profile.network_type = ::getNetInfo();
+
+	xinfo2(TSF"tcp check ip: %0, port: %1, timeout: %2", _profile.ip, _profile.port, _timeout);
+
+	// connect, send and receive share _timeout
+	uint64_t start_time = ::gettickcount();
+	TcpQuery tcp_query(_profile.ip.c_str(), _profile.port, _timeout, _traffic_monitor);
+
+	AutoBuffer noop_send;
+	__NoopReq(noop_send);
+
+	int left = std::max(1, _timeout - (int)(::gettickcount() - start_time));
+	int ret = tcp_query.tcp_send((const unsigned char *)noop_send.Ptr(), (int)noop_send.Length(), left);
+
+	if (ret < 0) {
+		_profile.error_code = kSndRcvErr;
+		xerror2(TSF"tcp send nooping data error.");
+		return false;
+	}
+	xinfo2(TSF"tcp check send nooping data success.");
+
+	AutoBuffer recv_buff;
+	recv_buff.AllocWrite(64 * 1024, false);
+
+	left = std::max(1, _timeout - (int)(::gettickcount() - start_time));
+	ret = tcp_query.tcp_receive(recv_buff, 64*1024, left);
+
+	if (ret < 0) {
+		_profile.error_code = kSndRcvErr;
+		xerror2(TSF"tcp recv nooping data error.");
+		return false;
+	}
+
+	uint32_t cmdid = 0, seq = 0; size_t packlen = 0; AutoBuffer recv_body;
+	_profile.rtt = ::gettickcount() - start_time;
+	if (!__NoopResp(recv_buff, cmdid, seq, packlen, recv_body)) {	//not noop resp
+		_profile.error_code = kTcpRespErr;
+	}
+
+	return 0 == _profile.error_code;
+}
+
 void TcpChecker::__NoopReq(AutoBuffer& _noop_send) {
 	AutoBuffer noop_body;
 	AutoBuffer noop_extension;
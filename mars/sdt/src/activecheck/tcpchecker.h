@@ -36,8 +36,9 @@ class TcpChecker : public BaseChecker {
 
     virtual int StartDoCheck(CheckRequestProfile& _check_request);
 
-  protected:
-    virtual void __DoCheck(CheckRequestProfile& _check_request);
+    virtual void CollectProbes(const CheckRequestProfile& _check_request, std::vector<CheckProbe>& _probes);
+    virtual bool DoProbe(const CheckProbe& _probe, int _timeout, NetCheckTrafficMonitor* _traffic_monitor, CheckResultProfile& _profile);
+    virtual int DefaultTimeout() const;
 
   private:
     void __NoopReq(AutoBuffer& noop_send);
@@ -27,6 +27,8 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
+#include <algorithm>
+#include <numeric>
 
 #include "mars/comm/xlogger/xlogger.h"
 #include "mars/comm/network/getgateway.h"
@@ -48,10 +50,18 @@ static void clearPingStatus(struct PingStatus& _ping_status) {
     _ping_status.avgrtt = 0.0;
     memset(_ping_status.ip, 0, 16);
 }
-#ifdef ANDROID
+#if defined(__linux__)
+
+#include <netdb.h>
+#include <time.h>
+#include <netinet/ip_icmp.h>
 
 #define MAXLINE (512) /* max text line length */
 
+static const int kNativePingUnavailable = -2;
+static const unsigned int kDefaultDataLen = 56;
+static const unsigned int kMaxDataLen = 4096;
+
 void str_split(char _spliter, std::string _pingresult, std::vector<std::string>& _vec_pingres) {
     int find_begpos = 0;
     int findpos = 0;
@@ -63,7 +73,13 @@ void str_split(char _spliter, std::string _pingresult, std::vector<std::string>&
     }
 }
 
-int PingQuery::RunPingQuery(int _querycount, int interval/*S*/, int timeout/*S*/, const char* dest, unsigned int packetSize) {  // use popen
+static uint64_t __now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+int PingQuery::RunPingQuery(int _querycount, int interval/*S*/, int timeout/*S*/, const char* dest, unsigned int packetSize) {
     xinfo2(TSF"in runpingquery");
     xassert2(_querycount >= 0, "ping count should be more than 0");
     xassert2(interval >= 0, "interval should be more than 0");
@@ -78,6 +94,7 @@ int PingQuery::RunPingQuery(int _querycount, int interval/*S*/, int timeout/*S*/
     if (timeout == 0)
         timeout = DEFAULT_PING_TIMEOUT;
 
+    std::string gateway;
     if (NULL == dest || 0 == strlen(dest)) {
         struct  in_addr _addr;
         int ret = getdefaultgateway(&_addr);
@@ -87,9 +104,10 @@ int PingQuery::RunPingQuery(int _querycount, int interval/*S*/, int timeout/*S*/
             return -1;
         }
 
-        dest = socket_address(_addr).ip();
+        gateway = socket_address(_addr).ip();
+        dest = gateway.c_str();
 
-        if (NULL == dest || 0 == strlen(dest)) {
+        if (0 == strlen(dest)) {
             xerror2(TSF"ping dest host is NULL.");
             return -1;
         }
@@ -97,8 +115,10 @@ int PingQuery::RunPingQuery(int _querycount, int interval/*S*/, int timeout/*S*/
         xinfo2(TSF"get default gateway: %0", dest);
     }
 
-    char line[MAXLINE] = {0};
     pingresult_.clear();
+    vecrtts_.clear();
+    sendtimes_ = 0;
+    pingip_.clear();
 
     if (NULL != traffic_monitor_) {
         int sendLen = (packetSize > 0 ? packetSize : 56) * _querycount;
@@ -109,8 +129,146 @@ int PingQuery::RunPingQuery(int _querycount, int interval/*S*/, int timeout/*S*/
         }
     }
 
-    char cmd[256] = {0};
+    // forking ping from a big multi-threaded process is slow, use it only when icmp datagram sockets are not allowed
+    int ret = __runNativePing(_querycount, interval, timeout, dest, packetSize);
+    native_ = (kNativePingUnavailable != ret);
+    if (native_) return ret;
+
+    return __runPopenPing(_querycount, interval, timeout, dest, packetSize);
+}
+
+/*
+ * SOCK_DGRAM + IPPROTO_ICMP: the kernel fills in the id and checksum and hands back
+ * replies to our own requests only, without the ip header. needs net.ipv4.ping_group_range
+ * to cover the process, which android does for apps.
+ */
+int PingQuery::__runNativePing(int _querycount, int _interval, int _timeout, const char* _dest, unsigned int _packet_size) {
+    struct addrinfo hints, *ai = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    int gai_ret = getaddrinfo(_dest, NULL, &hints, &ai);
+    if (0 != gai_ret || NULL == ai) {
+        xerror2(TSF"resolve %_ error:%_", _dest, gai_strerror(gai_ret));
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memcpy(&addr, ai->ai_addr, sizeof(addr));
+    freeaddrinfo(ai);
+
+    SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_ICMP);
+    if (INVALID_SOCKET == sock) {
+        xwarn2(TSF"icmp datagram socket unavailable:%_", socket_strerror(socket_errno));
+        return kNativePingUnavailable;
+    }
+    socket_set_nobio(sock);
+
+    char ip[16] = {0};
+    socket_inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+    pingip_ = ip;
+
+    size_t datalen = 0 < _packet_size ? std::min(_packet_size, kMaxDataLen) : kDefaultDataLen;
+    char line[MAXLINE] = {0};
+    snprintf(line, sizeof(line), "PING %s (%s) %zu(%zu) bytes of data.\n", _dest, ip, datalen, datalen + 28);
+    pingresult_ += line;
+
+    std::vector<uint64_t> sendtime(_querycount, 0);
+    std::vector<bool> replied(_querycount, false);
+    std::vector<char> packet(sizeof(struct icmphdr) + datalen, (char)0xa5);
+    char recvbuf[sizeof(struct icmphdr) + kMaxDataLen];
+
+    uint64_t start = __now_us();
+    uint64_t deadline = start + (uint64_t)_timeout * 1000000;
+    uint64_t next_send = start;
+    int received = 0;
+    int ret = 0;
+    SocketBreaker breaker;
+
+    while (received < _querycount) {
+        uint64_t now = __now_us();
+        if (now >= deadline) break;
+
+        if (sendtimes_ < _querycount && now >= next_send) {
+            struct icmphdr* icmp = (struct icmphdr*)&packet[0];
+            memset(icmp, 0, sizeof(*icmp));
+            icmp->type = ICMP_ECHO;
+            icmp->un.echo.sequence = htons((uint16_t)sendtimes_);
+
+            if (0 > sendto(sock, &packet[0], packet.size(), 0, (struct sockaddr*)&addr, sizeof(addr))) {
+                xwarn2(TSF"icmp sendto error:%_", socket_strerror(socket_errno));
+            }
+
+            sendtime[sendtimes_++] = now;
+            next_send = now + (uint64_t)_interval * 1000000;
+        }
+
+        uint64_t wait_until = sendtimes_ < _querycount ? std::min(deadline, next_send) : deadline;
+        SocketSelect sel(breaker);
+        sel.PreSelect();
+        sel.Read_FD_SET(sock);
+        sel.Exception_FD_SET(sock);
+
+        if (0 > sel.Select((int)((wait_until - now + 999) / 1000))) {
+            xerror2(TSF"select error:%_", sel.Errno());
+            ret = -1;
+            break;
+        }
+
+        if (!sel.Read_FD_ISSET(sock)) continue;
 
+        ssize_t len = 0;
+        while (0 < (len = recv(sock, recvbuf, sizeof(recvbuf), 0))) {
+            if (NULL != traffic_monitor_ && traffic_monitor_->recvLimitCheck((int)len)) {
+                xwarn2(TSF"limitCheck,recv Size=%0", len);
+                socket_close(sock);
+                return TRAFFIC_LIMIT_RET_CODE;
+            }
+
+            const struct icmphdr* reply = (const struct icmphdr*)recvbuf;
+            if ((size_t)len < sizeof(*reply) || ICMP_ECHOREPLY != reply->type) continue;
+
+            int seq = ntohs(reply->un.echo.sequence);
+            if (seq >= sendtimes_ || replied[seq]) continue;
+
+            replied[seq] = true;
+            ++received;
+
+            double rtt = (double)(__now_us() - sendtime[seq]) / 1000.0;
+            vecrtts_.push_back(rtt);
+
+            snprintf(line, sizeof(line), "%zd bytes from %s: icmp_seq=%d time=%.3f ms\n", len, ip, seq + 1, rtt);
+            pingresult_ += line;
+        }
+    }
+
+    socket_close(sock);
+
+    snprintf(line, sizeof(line), "\n--- %s ping statistics ---\n%d packets transmitted, %d received, %d%% packet loss, time %dms\n",
+             _dest, sendtimes_, received, 0 < sendtimes_ ? (sendtimes_ - received) * 100 / sendtimes_ : 0, (int)((__now_us() - start) / 1000));
+    pingresult_ += line;
+
+    if (!vecrtts_.empty()) {
+        snprintf(line, sizeof(line), "rtt min/avg/max = %.3f/%.3f/%.3f ms\n",
+                 *std::min_element(vecrtts_.begin(), vecrtts_.end()),
+                 std::accumulate(vecrtts_.begin(), vecrtts_.end(), 0.0) / vecrtts_.size(),
+                 *std::max_element(vecrtts_.begin(), vecrtts_.end()));
+        pingresult_ += line;
+    }
+    xinfo2(TSF"m_strPingResult = %0", pingresult_);
+
+    if (0 != ret) return ret;
+    if (0 == received) {
+        xinfo2(TSF"remote host is not available");
+        return -1;
+    }
+    return 0;
+}
+
+int PingQuery::__runPopenPing(int _querycount, int interval/*S*/, int timeout/*S*/, const char* dest, unsigned int packetSize) {
+    char line[MAXLINE] = {0};
+    char cmd[256] = {0};
     if (strlen(dest) > 200) {
         xerror2(TSF"domain name is too long.");
         return -1;
@@ -174,6 +332,20 @@ int PingQuery::GetPingStatus(struct PingStatus& _ping_status) {
     xinfo_function();
     clearPingStatus(_ping_status);
 
+    if (native_) {
+        _ping_status.res = pingresult_;
+        strncpy(_ping_status.ip, pingip_.c_str(), sizeof(_ping_status.ip) - 1);
+
+        if (0 == sendtimes_) return -1;
+        _ping_status.loss_rate = 1 - (double)vecrtts_.size() / sendtimes_;
+
+        if (vecrtts_.empty()) return -1;
+        _ping_status.minrtt = *std::min_element(vecrtts_.begin(), vecrtts_.end());
+        _ping_status.maxrtt = *std::max_element(vecrtts_.begin(), vecrtts_.end());
+        _ping_status.avgrtt = std::accumulate(vecrtts_.begin(), vecrtts_.end(), 0.0) / vecrtts_.size();
+        return 0;
+    }
+
     if (pingresult_.empty())  return -1;
 
     _ping_status.res = pingresult_;  //
@@ -55,6 +55,10 @@ struct PingStatus {
 class PingQuery {
   public:
     PingQuery(NetCheckTrafficMonitor* trafficMonitor = NULL): pingresult_("")
+#if defined(__linux__)
+        , native_(false),
+        sendtimes_(0)
+#endif
 #ifdef __APPLE__
         , nsent_(0),
         sockfd_(-1),
@@ -88,6 +92,12 @@ class PingQuery {
     int RunPingQuery(int queryCount, int interval/*S*/, int timeout/*S*/,
                        const char* dest, unsigned int packetSize = 0);
 
+#if defined(__linux__)
+  private:
+    int  __runNativePing(int _querycount, int _interval, int _timeout, const char* _dest, unsigned int _packet_size);
+    int  __runPopenPing(int _querycount, int _interval, int _timeout, const char* _dest, unsigned int _packet_size);
+#endif
+
 #ifdef __APPLE__
   private:
     void proc_v4(char* ptr, ssize_t len, struct msghdr* msg, struct timeval* tvrecv);
@@ -106,6 +116,13 @@ class PingQuery {
   private:
     std::string                pingresult_;
 
+#if defined(__linux__)
+    bool                    native_;    // answered by an icmp datagram socket, not by the ping command
+    std::vector<double>     vecrtts_;
+    int                     sendtimes_;
+    std::string             pingip_;
+#endif
+
 #ifdef __APPLE__
     int                     nsent_;                /* add 1 for each sendto() */
     int                     sockfd_;
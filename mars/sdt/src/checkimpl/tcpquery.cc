@@ -35,7 +35,8 @@ TcpQuery::TcpQuery(const char* _ip, uint16_t _port, unsigned int _conn_timeout,
     , select_(pipe_)
     , status_(kTcpInit)
     , errcode_(0)
-    , conn_timeout_(_conn_timeout) {
+    , conn_timeout_(_conn_timeout)
+    , traffic_monitor_(_traffic_monitor) {
     if (!pipe_.IsCreateSuc()) {
         xassert2(false, "TcpQuery create breaker error.");
         status_ = kTcpInitErr;
@@ -62,6 +63,11 @@ TcpQuery::~TcpQuery() {
 
 TcpErrCode TcpQuery::tcp_send(const unsigned char* _buff, unsigned int _size, int _timeout) {
     if (kTcpConnected == status_) {
+        if (NULL != traffic_monitor_ && traffic_monitor_->sendLimitCheck(_size)) {
+            xwarn2(TSF"limitCheck!!!sendLen=%0", _size);
+            return kSndRcvErr;
+        }
+
         return NetCheckerSocketUtils::writenWithNonBlock(sock_, select_, _timeout, _buff, _size, errcode_);
     }
 
@@ -77,6 +83,11 @@ TcpErrCode TcpQuery::tcp_receive(AutoBuffer& _recvbuf, unsigned int _size, int _
             ret = kTcpSucc;
         }
 
+        if (NULL != traffic_monitor_ && traffic_monitor_->recvLimitCheck(_recvbuf.Length())) {
+            xwarn2(TSF"limitCheck!!!recvLen=%0", _recvbuf.Length());
+            return kSndRcvErr;
+        }
+
         return ret;
     }
 
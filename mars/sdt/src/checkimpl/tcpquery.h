@@ -64,6 +64,7 @@ class TcpQuery {
     TcpStatus status_;
     int errcode_;
     unsigned int conn_timeout_;
+    NetCheckTrafficMonitor* traffic_monitor_;
 };
 
 }}
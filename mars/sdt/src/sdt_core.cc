@@ -41,6 +41,7 @@ using namespace mars::sdt;
 SdtCore::SdtCore()
     : thread_(boost::bind(&SdtCore::__RunOn, this))
     , check_list_(std::list<BaseChecker*>())
+    , engine_(check_request_)
     , cancel_(false)
     , checking_(false) {
     xinfo_function();
@@ -75,6 +76,7 @@ void SdtCore::__InitCheckReq(CheckIPPorts& _longlink_items, CheckIPPorts& _short
 	checking_ = true;
 
 	check_request_.Reset();
+	engine_.Reset();
 	check_request_.longlink_items.insert(_longlink_items.begin(), _longlink_items.end());
 	check_request_.mode = _mode;
 	check_request_.total_timeout = _timeout;
@@ -120,12 +122,8 @@ void SdtCore::__Reset() {
 void SdtCore::__RunOn() {
     xinfo_function();
 
-    for (std::list<BaseChecker*>::iterator iter = check_list_.begin(); iter != check_list_.end(); ++iter) {
-        if (cancel_ || check_request_.check_status == kCheckFinish)
-            break;
-
-        (*iter)->StartDoCheck(check_request_);
-    }
+    // the checkers run at the same time, a failed probe no longer stops the checkers after it
+    if (!cancel_) engine_.Run(check_list_);
 
     xinfo2(TSF"all checkers end! cancel_=%_, check_request_.check_status_=%_, check_list__size=%_", cancel_, check_request_.check_status, check_list_.size());
 
@@ -159,6 +157,7 @@ void SdtCore::__DumpCheckResult() {
 void SdtCore::CancelCheck() {
     xinfo_function();
     cancel_ = true;
+    engine_.Cancel();
     for (std::list<BaseChecker*>::iterator iter = check_list_.begin(); iter != check_list_.end(); ++iter) {
         (*iter)->CancelDoCheck();
     }
@@ -32,6 +32,8 @@
 #include "mars/sdt/sdt.h"
 #include "mars/sdt/netchecker_profile.h"
 
+#include "activecheck/checkengine.h"
+
 namespace mars {
 namespace sdt {
 
@@ -69,6 +71,7 @@ class SdtCore {
     std::list<BaseChecker*>   check_list_;
 
     CheckRequestProfile		  check_request_;
+    CheckEngine               engine_;
     volatile bool             cancel_;
     volatile bool             checking_;
     Mutex					  checking_mutex_;
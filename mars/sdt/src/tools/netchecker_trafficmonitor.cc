@@ -19,6 +19,7 @@
  */
 #include "netchecker_trafficmonitor.h"
 
+#include "mars/comm/thread/atomic_oper.h"
 #include "mars/comm/xlogger/xlogger.h"
 #include "mars/comm/platform_comm.h"
 
@@ -40,26 +41,33 @@ NetCheckTrafficMonitor::~NetCheckTrafficMonitor() {
 
 
 bool NetCheckTrafficMonitor::sendLimitCheck(unsigned long sendDataSize) {
-    ScopedLock lock(mutex_);
-
-    if ((wifi_send_data_size_ + sendDataSize) > wifi_data_threshold_
-            || (mobile_send_data_size_ + sendDataSize) > mobile_data_threshold_) {
-        xwarn2(TSF"sendLimitCheck!!!wifi_data_threshold_=%0,mobile_data_threshold_=%1,wifi_send_=%2,wifi_recv_=%3,mobile_send_=%4"
-               ",mobile_recv_=%5,sendDataSize=%6", wifi_data_threshold_, mobile_data_threshold_, wifi_send_data_size_, wifi_recv_data_size_, mobile_send_data_size_, mobile_recv_data_size_, sendDataSize);
-        return true;
-    } else {
-        __data(sendDataSize, 0);
-    }
+    bool mobile = kMobile == getNetInfo();
+    volatile uint32_t* send_data_size = mobile ? &mobile_send_data_size_ : &wifi_send_data_size_;
+    unsigned long data_threshold = mobile ? mobile_data_threshold_ : wifi_data_threshold_;
+
+    uint32_t old = atomic_read32(send_data_size);
+    while (true) {
+        if ((uint64_t)old + sendDataSize > data_threshold) {
+            xwarn2(TSF"sendLimitCheck!!!wifi_data_threshold_=%0,mobile_data_threshold_=%1,wifi_send_=%2,wifi_recv_=%3,mobile_send_=%4"
+                   ",mobile_recv_=%5,sendDataSize=%6", wifi_data_threshold_, mobile_data_threshold_, wifi_send_data_size_, wifi_recv_data_size_, mobile_send_data_size_, mobile_recv_data_size_, sendDataSize);
+            return true;
+        }
 
-    return false;
+        uint32_t seen = atomic_cas32(send_data_size, old + (uint32_t)sendDataSize, old);
+        if (seen == old) return false;
+        old = seen;
+    }
 }
 bool NetCheckTrafficMonitor::recvLimitCheck(unsigned long recvDataSize) {
-    ScopedLock lock(mutex_);
-    __data(0, recvDataSize);
+    bool mobile = kMobile == getNetInfo();
+    volatile uint32_t* send_data_size = mobile ? &mobile_send_data_size_ : &wifi_send_data_size_;
+    volatile uint32_t* recv_data_size = mobile ? &mobile_recv_data_size_ : &wifi_recv_data_size_;
+    unsigned long data_threshold = mobile ? mobile_data_threshold_ : wifi_data_threshold_;
+
+    atomic_add32(recv_data_size, (uint32_t)recvDataSize);
 
     if (!is_ignore_recv_data_) {
-        if ((wifi_send_data_size_ + wifi_recv_data_size_) > wifi_data_threshold_
-                || (mobile_send_data_size_ + mobile_recv_data_size_) > mobile_data_threshold_) {
+        if ((uint64_t)atomic_read32(send_data_size) + atomic_read32(recv_data_size) > data_threshold) {
             xwarn2(TSF"recvLimitCheck!!!wifi_data_threshold_=%0,mobile_data_threshold_=%1,wifi_send_=%2,wifi_recv_=%3,mobile_send_=%4"
                    ",mobile_recv_=%5", wifi_data_threshold_, mobile_data_threshold_, wifi_send_data_size_, wifi_recv_data_size_, mobile_send_data_size_, mobile_recv_data_size_);
             return true;
@@ -69,31 +77,14 @@ bool NetCheckTrafficMonitor::recvLimitCheck(unsigned long recvDataSize) {
     return false;
 }
 void NetCheckTrafficMonitor::reset() {
-    ScopedLock lock(mutex_);
-    wifi_recv_data_size_ = 0;
-    wifi_send_data_size_ = 0;
-    mobile_recv_data_size_ = 0;
-    mobile_send_data_size_ = 0;
+    atomic_write32(&wifi_recv_data_size_, 0);
+    atomic_write32(&wifi_send_data_size_, 0);
+    atomic_write32(&mobile_recv_data_size_, 0);
+    atomic_write32(&mobile_send_data_size_, 0);
     wifi_data_threshold_ = 0;
     mobile_data_threshold_ = 0;
 }
 
-int NetCheckTrafficMonitor::__data(unsigned long sendDataSize, unsigned long recvDataSize) {
-    if (0 < sendDataSize || 0 < recvDataSize) {
-        if (kMobile != getNetInfo())
-            wifi_recv_data_size_ += recvDataSize;
-        else
-            mobile_recv_data_size_ += recvDataSize;
-
-        if (kMobile != getNetInfo())
-            wifi_send_data_size_ += sendDataSize;
-        else
-            mobile_send_data_size_ += sendDataSize;
-    }
-
-    return 0;
-}
-
 void NetCheckTrafficMonitor::__dumpDataSize() {
     xinfo_function();
     xinfo2(TSF"m_wifiRecvDataSize=%_,wifi_send_data_size_=%_,mobile_recv_data_size_=%_,mobile_send_data_size_=%_,wifi_data_threshold_=%_,mobile_data_threshold_=%_,is_ignore_recv_data_=%_"
@@ -22,10 +22,13 @@
 #define NETCHECKTRAFFICMONITOR_H_
 
 #include <limits.h>
+#include <stdint.h>
 
-#include "mars/comm/thread/mutex.h"
-#include "mars/comm/thread/lock.h"
-
+/*
+ * shared by the probes of a check running at the same time, the counters are atomics.
+ * sendLimitCheck reserves the bytes with a cas, so probes racing for the last bytes under a threshold
+ * can not get past it together.
+ */
 class NetCheckTrafficMonitor {
   public:
     NetCheckTrafficMonitor(unsigned long mobileDataThreshold, bool isIgnoreRecvData = true, unsigned long wifiDataThreshold = ULONG_MAX);
@@ -35,7 +38,6 @@ class NetCheckTrafficMonitor {
     void reset();
 
   private:
-    int __data(unsigned long sendDataSize, unsigned long recvDataSize);
     void __dumpDataSize();
 
   private:
@@ -43,14 +45,13 @@ class NetCheckTrafficMonitor {
     NetCheckTrafficMonitor& operator=(const NetCheckTrafficMonitor&);
 
   private:
-    unsigned long wifi_recv_data_size_;
-    unsigned long wifi_send_data_size_;
-    unsigned long mobile_recv_data_size_;
-    unsigned long mobile_send_data_size_;
+    volatile uint32_t wifi_recv_data_size_;
+    volatile uint32_t wifi_send_data_size_;
+    volatile uint32_t mobile_recv_data_size_;
+    volatile uint32_t mobile_send_data_size_;
     unsigned long wifi_data_threshold_;
     unsigned long mobile_data_threshold_;
     bool is_ignore_recv_data_;
-    Mutex mutex_;
 };
 
 
@@ -0,0 +1,157 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * checkengine_test.cc
+ *
+ * wall time of a tcp check over kEndpointCount longlink endpoints, probed one after another by
+ * TcpChecker::StartDoCheck and all at once by CheckEngine.
+ * the mock server answers a noop kMockRtt after it arrives.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <list>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/xlogger/xlogger.h"
+#include "mars/sdt/constants.h"
+#include "mars/sdt/src/activecheck/checkengine.h"
+#include "mars/sdt/src/activecheck/tcpchecker.h"
+#include "mars/stn/proto/longlink_packer.h"
+
+using namespace mars::sdt;
+using namespace mars::stn;
+
+static const std::chrono::milliseconds kMockRtt(200);
+static const int kEndpointCount = 20;
+
+namespace {
+
+class MockServer {
+  public:
+    MockServer(): listen_fd_(socket(AF_INET, SOCK_STREAM, 0)), port_(0) {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+
+        bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr));
+        listen(listen_fd_, 64);
+        getsockname(listen_fd_, (struct sockaddr*)&addr, &len);
+        port_ = ntohs(addr.sin_port);
+
+        std::thread([this] {
+            int fd = -1;
+            while (0 <= (fd = accept(listen_fd_, NULL, NULL))) std::thread(&MockServer::__Serve, fd).detach();
+        }).detach();
+    }
+
+    uint16_t Port() const { return port_; }
+
+  private:
+    static void __Serve(int _fd) {
+        AutoBuffer in;
+        char buf[4096];
+        ssize_t recvlen = 0;
+        while (0 < (recvlen = recv(_fd, buf, sizeof(buf), 0))) {
+            in.Write(buf, recvlen);
+
+            uint32_t cmdid = 0, seq = 0;
+            size_t packlen = 0;
+            AutoBuffer body, extension;
+            if (LONGLINK_UNPACK_OK != longlink_unpack(in, cmdid, seq, packlen, body, extension, NULL)) continue;
+
+            std::this_thread::sleep_for(kMockRtt);
+            AutoBuffer out;
+            longlink_pack(cmdid, seq, body, extension, out, NULL);
+            send(_fd, out.Ptr(), out.Length(), MSG_NOSIGNAL);
+            break;
+        }
+        close(_fd);
+    }
+
+  private:
+    int listen_fd_;
+    uint16_t port_;
+};
+
+}
+
+static void __InitRequest(CheckRequestProfile& _request, uint16_t _port, uint32_t _total_timeout) {
+    _request.Reset();
+    _request.mode = NET_CHECK_LONG;
+    _request.total_timeout = _total_timeout;
+    for (int i = 0; i < kEndpointCount; ++i) _request.longlink_items["longlink.mock"].push_back(CheckIPPort("127.0.0.1", _port));
+}
+
+static size_t __SuccCount(const CheckRequestProfile& _request) {
+    size_t count = 0;
+    for (size_t i = 0; i < _request.checkresult_profiles.size(); ++i)
+        if (0 == _request.checkresult_profiles[i].error_code) ++count;
+    return count;
+}
+
+TEST(CheckEngine, TcpCheckWallTime) {
+    xlogger_SetLevel(kLevelNone);
+    MockServer server;
+
+    CheckRequestProfile request;
+    TcpChecker checker;
+    std::list<BaseChecker*> checkers(1, &checker);
+
+    __InitRequest(request, server.Port(), UNUSE_TIMEOUT);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    checker.StartDoCheck(request);
+    double serial = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ((size_t)kEndpointCount, __SuccCount(request));
+
+    __InitRequest(request, server.Port(), UNUSE_TIMEOUT);
+    CheckEngine engine(request);
+    start = std::chrono::steady_clock::now();
+    engine.Run(checkers);
+    double concurrent = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ((size_t)kEndpointCount, __SuccCount(request));
+
+    printf("endpoints:%d rtt:%dms serial:%.0fms engine:%.0fms\n", kEndpointCount, (int)kMockRtt.count(), serial, concurrent);
+    EXPECT_LT(concurrent, serial / 2);
+}
+
+TEST(CheckEngine, TotalTimeoutBoundsWallTime) {
+    xlogger_SetLevel(kLevelNone);
+    MockServer server;
+
+    CheckRequestProfile request;
+    TcpChecker checker;
+    std::list<BaseChecker*> checkers(1, &checker);
+
+    // room for two rounds of 4 probes, the rest are never started
+    const uint32_t total_timeout = 500;
+    __InitRequest(request, server.Port(), total_timeout);
+    CheckEngine engine(request);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    engine.Run(checkers);
+    double cost = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    printf("total_timeout:%ums cost:%.0fms results:%zu succ:%zu\n", total_timeout, cost, request.checkresult_profiles.size(), __SuccCount(request));
+    EXPECT_LT(cost, total_timeout + 100);
+    EXPECT_LT(request.checkresult_profiles.size(), (size_t)kEndpointCount);
+    EXPECT_EQ(kCheckFinish, request.check_status);
+}
@@ -37,6 +37,8 @@
 #define HeartStep (60 * 1000)      // try to increse current heartbeat by HeartStep
 #define SuccessStep  (20 * 1000)   // when finish compute choose successHeart-=SuccessStep as the stable heartbeat
 
+#define MinNoopTimeout (5 * 1000)  // the noop timeout learned from the rtt goes no lower, a timeout drops the link
+
 #define MaxHeartFailCount (3)
 #define BaseSuccCount (3)
 #define NetStableTestCount (3)     //We think it's time to test after NetStableCount times heartbeat using MinHeartInterval
@@ -93,6 +95,12 @@ const static int kDynTimeTaskMidPkgMeetExpectTag = 2;
 const static int kDynTimeTaskBigPkgMeetExpectTag = 3;
 const static int kDynTimeTaskBiggerPkgMeetExpectTag = 4;
 
+//the timeouts a cgi gets from its own latency: p99 plus half of it, at least kDynTimeLatencyMinMargin more
+const static unsigned int kDynTimeLatencyMinSamples = 20;
+const static unsigned int kDynTimeLatencyMinMargin = 1000;
+const static unsigned int kDynTimeLatencyMinFirstPkgTimeout = 3*1000;
+const static unsigned int kDynTimeLatencyMaxCgiCount = 128;  // cgi and network pairs
+
 //longlink_task_manager
 const static unsigned int kFastSendUseLonglinkTaskCntLimit = 0;
 
@@ -100,6 +108,9 @@ const static unsigned int kFastSendUseLonglinkTaskCntLimit = 0;
 const static unsigned int kLonglinkConnTimeout = 10 * 1000;
 const static unsigned int kLonglinkConnInteral = 4 * 1000;
 const static unsigned int kLonglinkConnMax = 3;
+// a longlink that dropped by itself less than kLonglinkResumeWindow ago goes straight back to the ip it was on
+const static unsigned int kLonglinkResumeWindow = 30 * 1000;
+const static unsigned int kLonglinkResumeConnTimeout = 3 * 1000;
 
 //shortlink connect params
 const static unsigned int kShortlinkConnTimeout = 10 * 1000;
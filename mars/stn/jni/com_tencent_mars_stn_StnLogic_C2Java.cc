@@ -327,6 +327,11 @@ void (*TrafficData)(ssize_t _send, ssize_t _recv)
 
 };
 
+// java only takes the totals from trafficData
+void (*TrafficCmdData)(int _channel, uint32_t _cmdid, ssize_t _send, ssize_t _recv)
+= [](int _channel, uint32_t _cmdid, ssize_t _send, ssize_t _recv) {
+};
+
 DEFINE_FIND_STATIC_METHOD(KC2Java_reportNetConnectInfo, KC2Java, "reportConnectStatus", "(II)V")
 void (*ReportConnectStatus)(int _all_connstatus, int _longlink_connstatus)
 = [](int _all_connstatus, int _longlink_connstatus) {
@@ -458,6 +463,11 @@ void (*ReportTaskLimited)(int _check_type, const Task& _task, unsigned int& _par
 
 };
 
+// tasks from java never set stream_response, buf2Resp gets the whole body
+void (*OnResponseChunk)(uint32_t _taskid, const void* _data, size_t _len)
+= [](uint32_t _taskid, const void* _data, size_t _len) {
+};
+
 void (*ReportDnsProfile)(const DnsProfile& _dns_profile)
 = [](const DnsProfile& _dns_profile) {
 };
@@ -24,16 +24,40 @@
 #include <arpa/inet.h>
 #endif // !WIN32
 
+#include <string.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+
 #ifdef __APPLE__
 #include "mars/xlog/xlogger.h"
 #else
 #include "mars/comm/xlogger/xlogger.h"
 #endif
 #include "mars/comm/autobuffer.h"
+#include "mars/comm/thread/atomic_oper.h"
+#include "mars/comm/thread/lock.h"
+#include "mars/comm/thread/mutex.h"
 #include "mars/stn/stn.h"
+#include "stnproto_logic.h"
+
+#define MAX_PACKAGE_LEN (1024 * 1024)
+#define COMPRESS_LEVEL (1)  // level 6 takes 2-3x the cpu for about 5 points fewer bytes, see longlink_compress_test
+
+#define XP_EXT_MAGIC (0x58505A31)  // "XPZ1", a longer header of a server without it is skipped as before
+
+// __STNetMsgXpHeaderExt.flags
+#define XP_FLAG_ACCEPT_DEFLATE (0x1)  // the sender inflates deflated bodies
+#define XP_FLAG_DEFLATED (0x2)        // this body is deflated
 
 static uint32_t sg_client_version = 0;
 
+static size_t sg_compress_threshold = 0;  // 0: off, the header is the plain one
+static std::string sg_compress_dict;
+static uint32_t sg_compress_dict_id = 0;
+
 #pragma pack(push, 1)
 struct __STNetMsgXpHeader {
     uint32_t    head_length;
@@ -42,21 +66,134 @@ struct __STNetMsgXpHeader {
     uint32_t    seq;
     uint32_t	body_length;
 };
+
+/*
+ * follows __STNetMsgXpHeader when compression is on. head_length covers it,
+ * a server that skips head_length bytes to the body reads these packets as before.
+ */
+struct __STNetMsgXpHeaderExt {
+    uint32_t    magic;       // XP_EXT_MAGIC
+    uint32_t    flags;
+    uint32_t    dict_id;     // adler32 of the dictionary the sender has, 0 for none
+    uint32_t    raw_length;  // body length before deflate
+};
 #pragma pack(pop)
 
+namespace {
+
+// the trackers made by the default Create, the app may have replaced it with its own
+static Mutex sg_xp_trackers_mutex;
+static std::set<const mars::stn::longlink_tracker*> sg_xp_trackers;
+
+// what the peer of one connection has said it takes, written by unpack, read by pack on the senders' threads
+class XpTracker : public mars::stn::longlink_tracker {
+  public:
+    XpTracker(): peer_flags_(0), peer_dict_id_(0) {
+        ScopedLock lock(sg_xp_trackers_mutex);
+        sg_xp_trackers.insert(this);
+    }
+
+    ~XpTracker() {
+        ScopedLock lock(sg_xp_trackers_mutex);
+        sg_xp_trackers.erase(this);
+    }
+
+    static XpTracker* From(mars::stn::longlink_tracker* _tracker) {
+        if (NULL == _tracker) return NULL;
+        ScopedLock lock(sg_xp_trackers_mutex);
+        return sg_xp_trackers.end() == sg_xp_trackers.find(_tracker) ? NULL : static_cast<XpTracker*>(_tracker);
+    }
+
+    void OnPeerHeader(const __STNetMsgXpHeaderExt& _ext) {
+        atomic_write32(&peer_dict_id_, _ext.dict_id);
+        atomic_write32(&peer_flags_, _ext.flags);
+    }
+    bool PeerAcceptsDeflate() { return 0 != (atomic_read32(&peer_flags_) & XP_FLAG_ACCEPT_DEFLATE); }
+    bool PeerHasDict() { return 0 != sg_compress_dict_id && sg_compress_dict_id == atomic_read32(&peer_dict_id_); }
+
+  private:
+    volatile uint32_t peer_flags_;
+    volatile uint32_t peer_dict_id_;
+};
+
+}
+
+static bool __deflate(const void* _raw, size_t _raw_len, bool _with_dict, AutoBuffer& _out) {
+    // a window and hash no bigger than the body, setting up the default 256K of them costs more than deflating a small body
+    size_t span = _raw_len + (_with_dict ? sg_compress_dict.size() : 0);
+    int window_bits = 9;
+    while (window_bits < MAX_WBITS && ((size_t)1 << window_bits) < span) ++window_bits;
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (Z_OK != deflateInit2(&zs, COMPRESS_LEVEL, Z_DEFLATED, window_bits, std::max(1, window_bits - 7), Z_DEFAULT_STRATEGY)) return false;
+
+    if (_with_dict && Z_OK != deflateSetDictionary(&zs, (const Bytef*)sg_compress_dict.data(), (uInt)sg_compress_dict.size())) {
+        deflateEnd(&zs);
+        return false;
+    }
+
+    uLong bound = deflateBound(&zs, (uLong)_raw_len);
+    _out.AddCapacity(bound);
+    zs.next_in = (Bytef*)_raw;
+    zs.avail_in = (uInt)_raw_len;
+    zs.next_out = (Bytef*)_out.Ptr();
+    zs.avail_out = (uInt)bound;
+
+    int ret = deflate(&zs, Z_FINISH);
+    _out.Length(0, zs.total_out);
+    deflateEnd(&zs);
+    return Z_STREAM_END == ret;
+}
+
+// appends _raw_len inflated bytes at _body's pos, the way unpack writes a plain body
+static bool __inflate(const void* _deflated, size_t _deflated_len, size_t _raw_len, AutoBuffer& _body) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (Z_OK != inflateInit(&zs)) return false;
+
+    _body.AllocWrite(_raw_len, false);
+    zs.next_in = (Bytef*)_deflated;
+    zs.avail_in = (uInt)_deflated_len;
+    zs.next_out = (Bytef*)_body.PosPtr();
+    zs.avail_out = (uInt)_raw_len;
+
+    int ret = inflate(&zs, Z_FINISH);
+    if (Z_NEED_DICT == ret && 0 != sg_compress_dict_id && zs.adler == sg_compress_dict_id
+            && Z_OK == inflateSetDictionary(&zs, (const Bytef*)sg_compress_dict.data(), (uInt)sg_compress_dict.size())) {
+        ret = inflate(&zs, Z_FINISH);
+    }
+
+    bool ok = Z_STREAM_END == ret && _raw_len == zs.total_out;
+    inflateEnd(&zs);
+    if (!ok) {
+        xerror2(TSF"inflate error:%_, raw len:%_, inflated:%_", ret, _raw_len, zs.total_out);
+        return false;
+    }
+
+    _body.Length(_body.Pos() + _raw_len, std::max(_body.Length(), (size_t)_body.Pos() + _raw_len));
+    return true;
+}
+
 namespace mars {
 namespace stn {
 longlink_tracker* (*longlink_tracker::Create)()
-= []() {
-    return new longlink_tracker;
+= []() -> longlink_tracker* {
+    return new XpTracker;
 };
     
 void SetClientVersion(uint32_t _client_version)  {
     sg_client_version = _client_version;
 }
 
+void SetLonglinkCompression(size_t _threshold, const std::string& _dictionary) {
+    sg_compress_threshold = _threshold;
+    sg_compress_dict = _dictionary;
+    sg_compress_dict_id = _dictionary.empty() ? 0 : (uint32_t)adler32(adler32(0, NULL, 0), (const Bytef*)_dictionary.data(), (uInt)_dictionary.size());
+}
+
 
-static int __unpack_test(const void* _packed, size_t _packed_len, uint32_t& _cmdid, uint32_t& _seq, size_t& _package_len, size_t& _body_len) {
+static int __unpack_test(const void* _packed, size_t _packed_len, uint32_t& _cmdid, uint32_t& _seq, size_t& _package_len, size_t& _body_len, __STNetMsgXpHeaderExt& _ext) {
     __STNetMsgXpHeader st = {0};
     if (_packed_len < sizeof(__STNetMsgXpHeader)) {
         _package_len = 0;
@@ -78,8 +215,22 @@ static int __unpack_test(const void* _packed, size_t _packed_len, uint32_t& _cmd
 	_body_len = ntohl(st.body_length);
 	_package_len = head_len + _body_len;
 
-    if (_package_len > 1024*1024) { return LONGLINK_UNPACK_FALSE; }
+    if (_package_len > MAX_PACKAGE_LEN) { return LONGLINK_UNPACK_FALSE; }
     if (_package_len > _packed_len) { return LONGLINK_UNPACK_CONTINUE; }
+
+    // the rest of a longer header is skipped, unless compression is on and it starts with the extension
+    memset(&_ext, 0, sizeof(_ext));
+    if (0 < sg_compress_threshold && head_len >= sizeof(__STNetMsgXpHeader) + sizeof(__STNetMsgXpHeaderExt)) {
+        __STNetMsgXpHeaderExt ext;
+        memcpy(&ext, (const char*)_packed + sizeof(__STNetMsgXpHeader), sizeof(ext));
+        if (XP_EXT_MAGIC == ntohl(ext.magic)) {
+            _ext.magic = XP_EXT_MAGIC;
+            _ext.flags = ntohl(ext.flags);
+            _ext.dict_id = ntohl(ext.dict_id);
+            _ext.raw_length = ntohl(ext.raw_length);
+            if ((_ext.flags & XP_FLAG_DEFLATED) && _ext.raw_length > MAX_PACKAGE_LEN) { return LONGLINK_UNPACK_FALSE; }
+        }
+    }
     
     return LONGLINK_UNPACK_OK;
 }
@@ -87,16 +238,45 @@ static int __unpack_test(const void* _packed, size_t _packed_len, uint32_t& _cmd
 void (*longlink_pack)(uint32_t _cmdid, uint32_t _seq, const AutoBuffer& _body, const AutoBuffer& _extension, AutoBuffer& _packed, longlink_tracker* _tracker)
 = [](uint32_t _cmdid, uint32_t _seq, const AutoBuffer& _body, const AutoBuffer& _extension, AutoBuffer& _packed, longlink_tracker* _tracker) {
     __STNetMsgXpHeader st = {0};
-    st.head_length = htonl(sizeof(__STNetMsgXpHeader));
+    __STNetMsgXpHeaderExt ext = {0};
+    XpTracker* tracker = 0 < sg_compress_threshold ? XpTracker::From(_tracker) : NULL;
+    bool extended = NULL != tracker;
+    const void* body = _body.Ptr();
+    size_t body_len = _body.Length();
+    AutoBuffer deflated;
+
+    if (extended) {
+        ext.magic = XP_EXT_MAGIC;
+        ext.flags = XP_FLAG_ACCEPT_DEFLATE;
+        ext.dict_id = sg_compress_dict_id;
+        ext.raw_length = (uint32_t)_body.Length();
+
+        // only to a peer that has said it inflates, and only when it saves something
+        if (_body.Length() >= sg_compress_threshold && tracker->PeerAcceptsDeflate()
+                && __deflate(_body.Ptr(), _body.Length(), tracker->PeerHasDict(), deflated) && deflated.Length() < _body.Length()) {
+            ext.flags |= XP_FLAG_DEFLATED;
+            body = deflated.Ptr();
+            body_len = deflated.Length();
+        }
+
+        ext.magic = htonl(ext.magic);
+        ext.flags = htonl(ext.flags);
+        ext.dict_id = htonl(ext.dict_id);
+        ext.raw_length = htonl(ext.raw_length);
+    }
+
+    size_t head_len = sizeof(st) + (extended ? sizeof(ext) : 0);
+    st.head_length = htonl(head_len);
     st.client_version = htonl(sg_client_version);
     st.cmdid = htonl(_cmdid);
     st.seq = htonl(_seq);
-    st.body_length = htonl(_body.Length());
+    st.body_length = htonl(body_len);
 
-    _packed.AllocWrite(sizeof(__STNetMsgXpHeader) + _body.Length());
+    _packed.AllocWrite(head_len + body_len);
     _packed.Write(&st, sizeof(st));
+    if (extended) _packed.Write(&ext, sizeof(ext));
     
-    if (NULL != _body.Ptr()) _packed.Write(_body.Ptr(), _body.Length());
+    if (NULL != body) _packed.Write(body, body_len);
     
     _packed.Seek(0, AutoBuffer::ESeekStart);
 };
@@ -105,9 +285,20 @@ void (*longlink_pack)(uint32_t _cmdid, uint32_t _seq, const AutoBuffer& _body, c
 int (*longlink_unpack)(const AutoBuffer& _packed, uint32_t& _cmdid, uint32_t& _seq, size_t& _package_len, AutoBuffer& _body, AutoBuffer& _extension, longlink_tracker* _tracker)
 = [](const AutoBuffer& _packed, uint32_t& _cmdid, uint32_t& _seq, size_t& _package_len, AutoBuffer& _body, AutoBuffer& _extension, longlink_tracker* _tracker) {
    size_t body_len = 0;
-   int ret = __unpack_test(_packed.Ptr(), _packed.Length(), _cmdid,  _seq, _package_len, body_len);
+   __STNetMsgXpHeaderExt ext;
+   int ret = __unpack_test(_packed.Ptr(), _packed.Length(), _cmdid,  _seq, _package_len, body_len, ext);
     
     if (LONGLINK_UNPACK_OK != ret) return ret;
+
+    if (XP_EXT_MAGIC == ext.magic) {
+        XpTracker* tracker = XpTracker::From(_tracker);
+        if (NULL != tracker) tracker->OnPeerHeader(ext);
+    }
+
+    if (ext.flags & XP_FLAG_DEFLATED) {
+        if (!__inflate(_packed.Ptr(_package_len-body_len), body_len, ext.raw_length, _body)) return LONGLINK_UNPACK_FALSE;
+        return ret;
+    }
     
     _body.Write(AutoBuffer::ESeekCur, _packed.Ptr(_package_len-body_len), body_len);
     
@@ -154,6 +345,11 @@ bool (*longlink_complexconnect_need_verify)()
     return false;
 };
 
+bool (*longlink_resume_req)(uint32_t& _cmdid, AutoBuffer& _body, AutoBuffer& _extend)
+= [](uint32_t& _cmdid, AutoBuffer& _body, AutoBuffer& _extend) {
+    return false;
+};
+
 bool (*longlink_ispush)(uint32_t _cmdid, uint32_t _taskid, const AutoBuffer& _body, const AutoBuffer& _extend)
 = [](uint32_t _cmdid, uint32_t _taskid, const AutoBuffer& _body, const AutoBuffer& _extend) {
     return PUSH_DATA_TASKID == _taskid;
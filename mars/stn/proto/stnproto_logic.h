@@ -17,8 +17,11 @@
  *      Author: caoshaokun
  */
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include <string>
+
 #ifndef STNPROTOCOL_INTERFACE_STNPROTO_LOGIC_H_
 #define STNPROTOCOL_INTERFACE_STNPROTO_LOGIC_H_
 
@@ -27,6 +30,14 @@ namespace stn {
 
 void SetClientVersion(uint32_t _client_version);
 
+/*
+ * deflate longlink bodies of at least _threshold bytes, 0 (default) turns it off.
+ * negotiated per connection: the packets carry an extended header saying what their sender inflates,
+ * a body goes out deflated only after the server's packets have said it takes them.
+ * _dictionary: a preset deflate dictionary, used when the server has the same one
+ */
+void SetLonglinkCompression(size_t _threshold, const std::string& _dictionary = "");
+
 }}
 
 
@@ -41,16 +41,23 @@ AntiAvalanche::~AntiAvalanche() {
     delete frequency_limit_;
 }
 
-bool AntiAvalanche::Check(const Task& _task, const void* _buffer, int _len) {
+bool AntiAvalanche::Check(const Task& _task, const void* _buffer, int _len, int _channel, bool _deferred, uint64_t _max_defer, uint64_t& _defer) {
     xverbose_function();
+    _defer = 0;
 
     unsigned int span = 0;
-    if (!frequency_limit_->Check(_task, _buffer, _len, span)){
+    if (!_deferred && !frequency_limit_->Check(_task, _buffer, _len, span)){
 		ReportTaskLimited(kFrequencyLimit, _task, span);
     	return false;
     }
 
-    if (kMobile == getNetInfo() && !flow_limit_->Check(_task, _buffer, _len)) {
+    uint64_t wait = 0;
+    if (kMobile == getNetInfo() && !flow_limit_->Check(_task, _channel, _len, wait)) {
+    	if (FlowLimit::kNever != wait && wait < _max_defer) {
+    		_defer = wait;
+    		return false;
+    	}
+
     	ReportTaskLimited(kFlowLimit, _task, (unsigned int&)_len);
 		return false;
     }
@@ -21,6 +21,8 @@
 #ifndef STN_SRC_ANTI_AVALANCHE_H_
 #define STN_SRC_ANTI_AVALANCHE_H_
 
+#include <stdint.h>
+
 namespace mars {
 namespace stn {
 
@@ -39,7 +41,9 @@ class AntiAvalanche {
     AntiAvalanche(bool _isactive);
     virtual ~AntiAvalanche();
 
-    bool Check(const Task& _task, const void* _buffer, int _len);
+    // when false, the task may go after _defer ms, 0 when it fails. it waits for the flow limit no longer than _max_defer,
+    // and a task _deferred before is not counted by the frequency limit again. only the tasks that fail are reported
+    bool Check(const Task& _task, const void* _buffer, int _len, int _channel, bool _deferred, uint64_t _max_defer, uint64_t& _defer);
     void OnSignalActive(bool _isactive);
 
   public:
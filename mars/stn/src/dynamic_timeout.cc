@@ -20,12 +20,15 @@
 
 #include "dynamic_timeout.h"
 
+#include <algorithm>
 #include <string>
 
 #include "mars/comm/time_utils.h"
 #include "mars/comm/platform_comm.h"
+#include "mars/comm/thread/lock.h"
 #include "mars/comm/xlogger/xlogger.h"
 #include "mars/stn/config.h"
+#include "mars/stn/task_profile.h"
 
 using namespace mars::stn;
 
@@ -93,6 +96,73 @@ int DynamicTimeout::GetStatus() {
     return dyntime_status_;
 }
 
+static uint64_t __LatencyTimeout(uint64_t _p99) {
+    return _p99 + std::max((uint64_t)kDynTimeLatencyMinMargin, _p99 / 2);
+}
+
+void DynamicTimeout::CgiLatencyStatistic(const std::string& _cgi_uri, uint64_t _first_pkg_cost, uint64_t _total_cost) {
+    if (_cgi_uri.empty()) return;
+    
+    ScopedLock lock(latency_mutex_);
+    CgiLatencyKey key(getNetInfo(), _cgi_uri);
+    std::map<CgiLatencyKey, CgiLatency>::iterator it = latencies_.find(key);
+    
+    if (latencies_.end() == it && kDynTimeLatencyMaxCgiCount <= latencies_.size()) {
+        std::map<CgiLatencyKey, CgiLatency>::iterator oldest = latencies_.begin();
+        for (std::map<CgiLatencyKey, CgiLatency>::iterator i = latencies_.begin(); i != latencies_.end(); ++i) {
+            if (i->second.last_tick < oldest->second.last_tick) oldest = i;
+        }
+        latencies_.erase(oldest);
+    }
+    
+    CgiLatency& latency = latencies_[key];
+    latency.first_pkg.Add(_first_pkg_cost);
+    latency.total.Add(std::max(_first_pkg_cost, _total_cost));
+    latency.last_tick = gettickcount();
+}
+
+bool DynamicTimeout::CgiTimeout(const std::string& _cgi_uri, uint64_t& _first_pkg_timeout, uint64_t& _read_write_timeout) {
+    ScopedLock lock(latency_mutex_);
+    std::map<CgiLatencyKey, CgiLatency>::const_iterator it = latencies_.find(CgiLatencyKey(getNetInfo(), _cgi_uri));
+    if (latencies_.end() == it || it->second.total.Count() < kDynTimeLatencyMinSamples) return false;
+    
+    uint64_t first_pkg_p99 = it->second.first_pkg.Percentile(99);
+    uint64_t total_p99 = it->second.total.Percentile(99);
+    lock.unlock();
+    
+    // a slow cgi may get as long as the biggest request, the fixed rule would cut it off early
+    uint64_t max_first_pkg = (kMobile != getNetInfo()) ? kMaxFirstPackageWifiTimeout : kMaxFirstPackageGPRSTimeout;
+    max_first_pkg = std::max(max_first_pkg, _first_pkg_timeout);
+    
+    uint64_t first_pkg_timeout = std::min(max_first_pkg, std::max((uint64_t)kDynTimeLatencyMinFirstPkgTimeout, __LatencyTimeout(first_pkg_p99)));
+    uint64_t read_write_timeout = std::min(__ReadWriteTimeout(max_first_pkg), std::max(first_pkg_timeout, __LatencyTimeout(total_p99)));
+    
+    xdebug2(TSF"cgi:%_, p99(first:%_, total:%_), timeout(first:%_->%_, rw:%_->%_)", _cgi_uri, first_pkg_p99, total_p99, _first_pkg_timeout, first_pkg_timeout, _read_write_timeout, read_write_timeout);
+    _first_pkg_timeout = first_pkg_timeout;
+    _read_write_timeout = read_write_timeout;
+    return true;
+}
+
+void DynamicTimeout::GetCgiLatencies(std::vector<CgiLatencyProfile>& _latencies) const {
+    ScopedLock lock(latency_mutex_);
+    _latencies.clear();
+    _latencies.reserve(latencies_.size());
+    
+    for (std::map<CgiLatencyKey, CgiLatency>::const_iterator it = latencies_.begin(); it != latencies_.end(); ++it) {
+        CgiLatencyProfile profile;
+        profile.net_type = it->first.first;
+        profile.cgi = it->first.second;
+        profile.samples = it->second.total.Count();
+        profile.first_pkg_p50 = it->second.first_pkg.Percentile(50);
+        profile.first_pkg_p99 = it->second.first_pkg.Percentile(99);
+        profile.total_p50 = it->second.total.Percentile(50);
+        profile.total_p99 = it->second.total.Percentile(99);
+        it->second.first_pkg.Buckets(profile.first_pkg_histogram);
+        it->second.total.Buckets(profile.total_histogram);
+        _latencies.push_back(profile);
+    }
+}
+
 void DynamicTimeout::__StatusSwitch(std::string _cgi_uri, int _task_status) {
     
     if (dyntime_fncount_latstmodify_time_ == 0 || (gettickcount() - dyntime_fncount_latstmodify_time_) > kDynTimeCountExpireTime) {
@@ -21,8 +21,17 @@
 #ifndef STN_SRC_DYNAMIC_TIMEOUT_H_
 #define STN_SRC_DYNAMIC_TIMEOUT_H_
 
+#include <stdint.h>
+
 #include <bitset>
+#include <map>
 #include <string>
+#include <vector>
+
+#include "mars/comm/thread/mutex.h"
+#include "mars/stn/stn.h"
+
+#include "latency_sketch.h"
 
 enum DynamicTimeoutStatus {
     kEValuating = 1,
@@ -45,9 +54,27 @@ class DynamicTimeout {
     
     int GetStatus();
     
+    // a timed out task counts with the time it was given, so the timeouts do not shrink from only the fast samples
+    void CgiLatencyStatistic(const std::string& _cgi_uri, uint64_t _first_pkg_cost, uint64_t _total_cost);
+    
+    // replaces the fixed timeouts by what the latency of the cgi on the current network calls for,
+    // leaves them until there are kDynTimeLatencyMinSamples
+    bool CgiTimeout(const std::string& _cgi_uri, uint64_t& _first_pkg_timeout, uint64_t& _read_write_timeout);
+    
+    void GetCgiLatencies(std::vector<CgiLatencyProfile>& _latencies) const;
+    
   private:
     void __StatusSwitch(std::string _cgi_uri, int _task_status);
     
+  private:
+    struct CgiLatency {
+        CgiLatency(): last_tick(0) {}
+        LatencySketch first_pkg;
+        LatencySketch total;
+        uint64_t last_tick;
+    };
+    typedef std::pair<int, std::string> CgiLatencyKey;  // net type, cgi
+    
   private:
     int                     dyntime_status_;
     unsigned int            dyntime_continuous_good_count_;
@@ -55,6 +82,9 @@ class DynamicTimeout {
     std::bitset<10>         dyntime_failed_normal_count_;
     unsigned long           dyntime_fncount_latstmodify_time_;    //ms
     size_t                  dyntime_fncount_pos_;
+    
+    mutable Mutex           latency_mutex_;
+    std::map<CgiLatencyKey, CgiLatency> latencies_;
 };
         
     }
@@ -22,78 +22,158 @@
 
 #include <algorithm>
 
+#include "mars/comm/thread/lock.h"
 #include "mars/comm/xlogger/xlogger.h"
 #include "mars/comm/time_utils.h"
-#include "mars/stn/stn.h"
 
 #if true
 static const int kInactiveSpeed = (2 * 1024 * 1024 / 3600);
 static const int kActiveSpeed = (8 * 1024 * 1024 / 3600);
-static const int kInactiveMinvol = (6 * 1024 * 1024);
 static const int kMaxVol = (8 * 1024 * 1024);
 #else
 static const int kInactiveSpeed = (1);
 static const int kActiveSpeed = (3);
-static const int kInactiveMinvol = (1500);
 static const int kMaxVol = (2 * 1024);
 #endif
 
+static const size_t kMaxCmdIdBuckets = 256;
+
 using namespace mars::stn;
 
-FlowLimit::FlowLimit(bool _isactive)
-    : funnel_speed_(_isactive ? kActiveSpeed : kInactiveSpeed)
-    , cur_funnel_vol_(0)
-    , time_lastflow_computer_(::gettickcount())
+FlowLimitStrategy::FlowLimitStrategy()
+    : active_rate(kActiveSpeed)
+    , inactive_rate(kInactiveSpeed)
+    , burst(kMaxVol)
+    , cmdid_quota(kActiveSpeed / 4, kMaxVol / 4)
+{}
+
+static Mutex sg_strategy_mutex;
+static FlowLimitStrategy sg_strategy;
+
+const uint64_t FlowLimit::kNever;
+
+void FlowLimit::SetStrategy(const FlowLimitStrategy& _strategy) {
+    ScopedLock lock(sg_strategy_mutex);
+    sg_strategy = _strategy;
+}
+
+FlowLimit::Bucket::Bucket(const FlowQuota& _quota)
+    : quota(_quota)
+    , tokens((int64_t)_quota.burst * 1000)
+    , last_refill(::gettickcount())
 {}
 
+void FlowLimit::Bucket::Refill(uint64_t _now) {
+    if (_now <= last_refill) return;
+
+    tokens = std::min((int64_t)quota.burst * 1000, tokens + (int64_t)(_now - last_refill) * quota.rate);
+    last_refill = _now;
+}
+
+uint64_t FlowLimit::Bucket::Wait(int64_t _bytes) const {
+    if (tokens >= _bytes * 1000) return 0;
+    if (_bytes > quota.burst || 0 >= quota.rate) return kNever;
+    return (uint64_t)((_bytes * 1000 - tokens + quota.rate - 1) / quota.rate);
+}
+
+FlowLimit::FlowLimit(bool _isactive) {
+    ScopedLock lock(sg_strategy_mutex);
+    strategy_ = sg_strategy;
+    lock.unlock();
+
+    global_ = Bucket(FlowQuota(_isactive ? strategy_.active_rate : strategy_.inactive_rate, strategy_.burst));
+    for (std::map<int, FlowQuota>::const_iterator it = strategy_.channel_quotas.begin(); it != strategy_.channel_quotas.end(); ++it) {
+        channels_[it->first] = Bucket(it->second);
+    }
+}
+
 FlowLimit::~FlowLimit()
 {}
 
-bool FlowLimit::Check(const mars::stn::Task& _task, const void* _buffer, int _len) {
+bool FlowLimit::Check(const mars::stn::Task& _task, int _channel, int _len, uint64_t& _wait) {
     xverbose_function();
+    _wait = 0;
 
     if (!_task.limit_flow) {
         return true;
     }
 
-    __FlashCurVol();
+    uint64_t now = ::gettickcount();
+    Bucket* parents[2] = {&global_, NULL};
+    global_.Refill(now);
+
+    std::map<int, Bucket>::iterator channel = channels_.find(_channel);
+    if (channels_.end() != channel) {
+        channel->second.Refill(now);
+        parents[1] = &channel->second;
+    }
 
-    if (cur_funnel_vol_ + _len > kMaxVol) {
-        xerror2(TSF"Task Info: ptr=%_, cmdid=%_, need_authed=%_, cgi:%_, channel_select=%_, limit_flow=%_, cur_funnel_vol_(%_)+_len(%_)=%_,MAX_VOL:%_ ",
-                &_task, _task.cmdid, _task.need_authed, _task.cgi, _task.channel_select, _task.limit_flow, cur_funnel_vol_ + _len, cur_funnel_vol_, _len, cur_funnel_vol_ + _len, kMaxVol);
+    Bucket* cmdid = __CmdIdBucket(_task.cmdid, now);
 
+    // with the bytes of its cmdid, or borrowed while the buckets above keep the reserve of its priority
+    int priority = std::min(std::max(_task.priority, (int)Task::kTaskPriorityHighest), (int)Task::kTaskPriorityLowest);
+    uint64_t own_wait = NULL == cmdid ? 0 : cmdid->Wait(_len);
+    uint64_t borrow_wait = NULL == cmdid ? kNever : 0;
+
+    for (size_t i = 0; i < sizeof(parents) / sizeof(parents[0]) && NULL != parents[i]; ++i) {
+        own_wait = std::max(own_wait, parents[i]->Wait(_len));
+        if (NULL == cmdid) continue;
+
+        int64_t reserve = (int64_t)parents[i]->quota.burst / 2 * priority / Task::kTaskPriorityLowest;
+        borrow_wait = std::max(borrow_wait, parents[i]->Wait(_len + reserve));
+    }
+
+    _wait = std::min(own_wait, borrow_wait);
+    if (0 < _wait) {
+        xerror2(TSF"Task Info: ptr=%_, cmdid=%_, need_authed=%_, cgi:%_, channel_select=%_, limit_flow=%_, priority:%_, channel:%_, len:%_, global:%_/%_, cmdid:%_, wait:%_",
+                &_task, _task.cmdid, _task.need_authed, _task.cgi, _task.channel_select, _task.limit_flow, _task.priority, _channel, _len,
+                global_.tokens / 1000, global_.quota.burst, NULL == cmdid ? -1 : cmdid->tokens / 1000, kNever == _wait ? -1 : (int64_t)_wait);
         return false;
     }
 
-    cur_funnel_vol_ += _len;
+    if (0 == own_wait && NULL != cmdid) cmdid->tokens -= (int64_t)_len * 1000;
+    for (size_t i = 0; i < sizeof(parents) / sizeof(parents[0]) && NULL != parents[i]; ++i) {
+        parents[i]->tokens -= (int64_t)_len * 1000;
+    }
+
+    xdebug2_if(0 != own_wait, TSF"cmdid:%_ borrowed %_, global left:%_", _task.cmdid, _len, global_.tokens / 1000);
     return true;
 }
 
 void FlowLimit::Active(bool _isactive) {
-    __FlashCurVol();
+    global_.Refill(::gettickcount());
 
     if (!_isactive) {
-        xdebug2(TSF"iCurFunnelVol=%0, INACTIVE_MIN_VOL=%1", cur_funnel_vol_, kInactiveMinvol);
-
-        if (cur_funnel_vol_ > kInactiveMinvol)
-            cur_funnel_vol_ = kInactiveMinvol;
+        // as the funnel did, going to the background leaves a quarter of the burst at least
+        global_.tokens = std::max(global_.tokens, (int64_t)global_.quota.burst * 1000 / 4);
     }
 
-    funnel_speed_ = _isactive ? kActiveSpeed : kInactiveSpeed;
-    xdebug2(TSF"Active:%0, iFunnelSpeed=%1", _isactive, funnel_speed_);
+    global_.quota.rate = _isactive ? strategy_.active_rate : strategy_.inactive_rate;
+    xdebug2(TSF"Active:%0, rate:%1, tokens:%2", _isactive, global_.quota.rate, global_.tokens / 1000);
 }
 
-void FlowLimit::__FlashCurVol() {
-    uint64_t timeCur = ::gettickcount();
-	xassert2(timeCur >= time_lastflow_computer_, TSF"%_, %_", timeCur, time_lastflow_computer_);
-    uint64_t interval = (timeCur - time_lastflow_computer_) / 1000;
-    
-    if (0 == interval) return;
+FlowLimit::Bucket* FlowLimit::__CmdIdBucket(uint32_t _cmdid, uint64_t _now) {
+    std::map<uint32_t, Bucket>::iterator it = cmdids_.find(_cmdid);
+    if (cmdids_.end() != it) {
+        it->second.Refill(_now);
+        return &it->second;
+    }
 
-    xdebug2(TSF"iCurFunnelVol=%0, iFunnelSpeed=%1, interval=%2", cur_funnel_vol_, funnel_speed_, interval);
-    cur_funnel_vol_ -= interval * funnel_speed_;
-    cur_funnel_vol_ = std::max(0, cur_funnel_vol_);
-    xdebug2(TSF"iCurFunnelVol=%0", cur_funnel_vol_);
+    std::map<uint32_t, FlowQuota>::const_iterator quota = strategy_.cmdid_quotas.find(_cmdid);
+    const FlowQuota& cmdid_quota = strategy_.cmdid_quotas.end() == quota ? strategy_.cmdid_quota : quota->second;
+    if (0 >= cmdid_quota.burst) return NULL;
+
+    if (kMaxCmdIdBuckets <= cmdids_.size()) {
+        // a full bucket is as good as a new one, the ones still refilling stay
+        for (it = cmdids_.begin(); it != cmdids_.end();) {
+            it->second.Refill(_now);
+            if (it->second.tokens >= (int64_t)it->second.quota.burst * 1000) {
+                cmdids_.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+    }
 
-    time_lastflow_computer_ = timeCur;
+    return &(cmdids_[_cmdid] = Bucket(cmdid_quota));
 }
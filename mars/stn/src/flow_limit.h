@@ -23,26 +23,46 @@
 
 #include <stdint.h>
 
+#include <map>
+
+#include "mars/stn/stn.h"
+
 namespace mars {
 namespace stn {
 
-struct Task;
-
 class FlowLimit {
+  public:
+    static const uint64_t kNever = ~(uint64_t)0;
+
+    // for the FlowLimits made after it
+    static void SetStrategy(const FlowLimitStrategy& _strategy);
+
   public:
     FlowLimit(bool _isactive);
     virtual ~FlowLimit();
 
-    bool Check(const mars::stn::Task& _task, const void* _buffer, int _len);
+    // true when the task may go now, its bytes are taken then. otherwise _wait is how long until
+    // it may in ms, kNever when it is bigger than a bucket
+    bool Check(const mars::stn::Task& _task, int _channel, int _len, uint64_t& _wait);
     void Active(bool _isactive);
 
   private:
-    void __FlashCurVol();
+    struct Bucket {
+        Bucket(const FlowQuota& _quota = FlowQuota());
+        void Refill(uint64_t _now);
+        uint64_t Wait(int64_t _bytes) const;  // until it holds _bytes
+        FlowQuota quota;
+        int64_t tokens;  // 1/1000 byte, a ms at a rate of a byte per second
+        uint64_t last_refill;
+    };
+
+    Bucket* __CmdIdBucket(uint32_t _cmdid, uint64_t _now);
 
   private:
-    int funnel_speed_;
-    int cur_funnel_vol_;
-    uint64_t time_lastflow_computer_;
+    FlowLimitStrategy strategy_;
+    Bucket global_;
+    std::map<int, Bucket> channels_;
+    std::map<uint32_t, Bucket> cmdids_;
 };
 
 }}
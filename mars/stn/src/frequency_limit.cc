@@ -18,26 +18,35 @@
  *      Author: yerungui
  */
 
+
 #include "frequency_limit.h"
 
-#include "mars/comm/adler32.h"
+#include <string.h>
+
+#include "mars/comm/xxhash64.h"
 #include "mars/comm/time_utils.h"
 #include "mars/comm/xlogger/xlogger.h"
 #include "mars/stn/stn.h"
 
-#define MAX_RECORD_COUNT (30)
 #define RECORD_INTERCEPT_COUNT (105)
 
-#define NOT_CLEAR_INTERCEPT_COUNT_RETRY (99)
-#define NOT_CLEAR_INTERCEPT_COUNT (75)
-#define NOT_CLEAR_INTERCEPT_INTERVAL_MINUTE (10*60*1000)
-#define RUN_CLEAR_RECORDS_INTERVAL_MINUTE  (60*60*1000)
+#define MAX_PROBE_COUNT (8)
+#define WINDOW_BUCKET_SPAN (10*60*1000)
+#define WINDOW_SPAN (WINDOW_BUCKET_SPAN * kAvalancheWindowBuckets)
 
 using namespace mars::stn;
 
-FrequencyLimit::FrequencyLimit()
-    : itime_record_clear_(::gettickcount())
-{}
+FrequencyLimit::FrequencyLimit(size_t _capacity)
+    : mask_(0)
+{
+    size_t capacity = MAX_PROBE_COUNT;
+    while (capacity < _capacity) capacity <<= 1;
+
+    STAvalancheRecord empty;
+    memset(&empty, 0, sizeof(empty));
+    records_.assign(capacity, empty);
+    mask_ = capacity - 1;
+}
 
 FrequencyLimit::~FrequencyLimit()
 {}
@@ -47,117 +56,90 @@ bool FrequencyLimit::Check(const mars::stn::Task& _task, const void* _buffer, in
 
     if (!_task.limit_frequency) return true;
 
-    unsigned long time_cur = ::gettickcount();
-    xassert2(time_cur >= itime_record_clear_);
-    unsigned long interval = time_cur - itime_record_clear_;
+    uint64_t time_cur = ::gettickcount();
+    uint64_t hash = ::xxh64(_buffer, 0 < _len ? (size_t)_len : 0, 0);
+    if (0 == hash) hash = 1;  // 0 marks an empty slot
 
-    if (RUN_CLEAR_RECORDS_INTERVAL_MINUTE <= interval) {
-        xdebug2(TSF"__ClearRecord interval=%0, timeCur=%1, itimeRecordClear=%2", interval, time_cur, itime_record_clear_);
-        itime_record_clear_ = time_cur;
-        __ClearRecord();
-    }
+    STAvalancheRecord* record = __Locate(hash, time_cur);
 
-    unsigned long hash = ::adler32(0, (const unsigned char*)_buffer, _len);
-    int find_index = __LocateIndex(hash);
+    if (NULL == record) {
+        xdebug2(TSF"InsertRecord Task Info: ptr=%0, cmdid=%1, need_authed=%2, cgi:%3, channel_select=%4, limit_flow=%5",
+                &_task, _task.cmdid, _task.need_authed, _task.cgi, _task.channel_select, _task.limit_flow);
 
-    if (0 <= find_index) {
-    	_span = __GetLastUpdateTillNow(find_index);
-        __UpdateRecord(find_index);
+        __Touch(__Insert(hash, time_cur), time_cur);
+        return true;
+    }
 
-        if (!__CheckRecord(find_index)) {
-            xerror2(TSF"Anti-Avalanche had Catch Task, Task Info: ptr=%0, cmdid=%1, need_authed=%2, cgi:%3, channel_select=%4, limit_flow=%5",
-                    &_task, _task.cmdid, _task.need_authed, _task.cgi, _task.channel_select, _task.limit_flow);
-            xerror2(TSF"apBuffer Len=%0, Hash=%1, Count=%2, timeLastUpdate=%3",
-                    _len, iarr_record_[find_index].hash_, iarr_record_[find_index].count_, iarr_record_[find_index].time_last_update_);
-            xassert2(false);
+    _span = (unsigned int)(time_cur - record->time_last_update_);
+    int count = __Touch(*record, time_cur);
 
-            return false;
-        }
-    } else {
-        xdebug2(TSF"InsertRecord Task Info: ptr=%0, cmdid=%1, need_authed=%2, cgi:%3, channel_select=%4, limit_flow=%5",
+    if (RECORD_INTERCEPT_COUNT < count) {
+        xerror2(TSF"Anti-Avalanche had Catch Task, Task Info: ptr=%0, cmdid=%1, need_authed=%2, cgi:%3, channel_select=%4, limit_flow=%5",
                 &_task, _task.cmdid, _task.need_authed, _task.cgi, _task.channel_select, _task.limit_flow);
+        xerror2(TSF"apBuffer Len=%0, Hash=%1, Count=%2, timeLastUpdate=%3",
+                _len, record->hash_, count, record->time_last_update_);
+        xassert2(false);
 
-        __InsertRecord(hash);
+        return false;
     }
 
     return true;
 }
 
-void FrequencyLimit::__ClearRecord() {
-    xdebug2(TSF"iarrRecord size=%0", iarr_record_.size());
-
-    unsigned long time_cur = ::gettickcount();
-
-    std::vector<STAvalancheRecord>::iterator first = iarr_record_.begin();
-
-    while (first != iarr_record_.end()) {
-        xassert2(time_cur >= first->time_last_update_);
-        unsigned long interval = time_cur - first->time_last_update_;
+STAvalancheRecord* FrequencyLimit::__Locate(uint64_t _hash, uint64_t _now) {
+    for (size_t i = 0; i < MAX_PROBE_COUNT; ++i) {
+        STAvalancheRecord& record = records_[(_hash + i) & mask_];
+        if (record.hash_ != _hash) continue;
 
-        if (interval <= NOT_CLEAR_INTERCEPT_INTERVAL_MINUTE && NOT_CLEAR_INTERCEPT_COUNT <= first->count_) {
-            int oldcount = first->count_;
-
-            if (NOT_CLEAR_INTERCEPT_COUNT_RETRY < first->count_) first->count_ = NOT_CLEAR_INTERCEPT_COUNT_RETRY;
-
-            xwarn2(TSF"timeCur:%_,  first->timeLastUpdate:%_, interval:%_, Hash:%_, oldcount:%_, Count:%_", time_cur, first->time_last_update_, interval, first->hash_, oldcount, first->count_);
-            ++first;
-        } else {
-            first = iarr_record_.erase(first);
-        }
-    }
-}
-
-int FrequencyLimit::__LocateIndex(unsigned long _hash) const {
-    for (int i = (int)iarr_record_.size() - 1; i >= 0; --i) {
-        if (iarr_record_[i].hash_ == _hash)
-            return i;
+        // nothing left in the window, the slot is free to reuse
+        if (WINDOW_SPAN <= _now - record.time_last_update_) return NULL;
+        return &record;
     }
 
-    return -1;
+    return NULL;
 }
 
-void FrequencyLimit::__InsertRecord(unsigned long _hash) {
-    if (MAX_RECORD_COUNT < iarr_record_.size()) {
-        xassert2(false);
-        return;
-    }
+STAvalancheRecord& FrequencyLimit::__Insert(uint64_t _hash, uint64_t _now) {
+    STAvalancheRecord* victim = NULL;
 
-    STAvalancheRecord temp;
-    temp.count_ = 1;
-    temp.hash_ = _hash;
-    temp.time_last_update_ = ::gettickcount();
+    for (size_t i = 0; i < MAX_PROBE_COUNT; ++i) {
+        STAvalancheRecord& record = records_[(_hash + i) & mask_];
 
-    if (MAX_RECORD_COUNT == iarr_record_.size()) {
-        unsigned int del_index = 0;
-
-        for (unsigned int i = 1; i < iarr_record_.size(); i++) {
-            if (iarr_record_[del_index].time_last_update_ > iarr_record_[i].time_last_update_) {
-                del_index = i;
-            }
+        if (0 == record.hash_ || _hash == record.hash_ || WINDOW_SPAN <= _now - record.time_last_update_) {
+            victim = &record;
+            break;
         }
 
-        std::vector<STAvalancheRecord>::iterator it = iarr_record_.begin();
-        it += del_index;
-        iarr_record_.erase(it);
+        if (NULL == victim || victim->time_last_update_ > record.time_last_update_) victim = &record;
     }
 
-    iarr_record_.push_back(temp);
+    xdebug2_if(0 != victim->hash_ && _hash != victim->hash_ && WINDOW_SPAN > _now - victim->time_last_update_,
+               TSF"evict hash:%_, last update:%_", victim->hash_, victim->time_last_update_);
+
+    memset(victim, 0, sizeof(*victim));
+    victim->hash_ = _hash;
+    victim->last_bucket_ = _now / WINDOW_BUCKET_SPAN;
+    return *victim;
 }
 
-void FrequencyLimit::__UpdateRecord(int _index) {
-    xassert2(0 <= _index && (unsigned int)_index < iarr_record_.size());
+int FrequencyLimit::__Touch(STAvalancheRecord& _record, uint64_t _now) const {
+    uint64_t bucket = _now / WINDOW_BUCKET_SPAN;
 
-    iarr_record_[_index].count_ += 1;
-    iarr_record_[_index].time_last_update_ = ::gettickcount();
-}
+    if (bucket - _record.last_bucket_ >= kAvalancheWindowBuckets) {
+        memset(_record.counts_, 0, sizeof(_record.counts_));
+    } else {
+        for (uint64_t i = _record.last_bucket_ + 1; i <= bucket; ++i) {
+            _record.counts_[i % kAvalancheWindowBuckets] = 0;
+        }
+    }
 
-unsigned int FrequencyLimit::__GetLastUpdateTillNow(int _index) {
-    xassert2(0 <= _index && (unsigned int)_index < iarr_record_.size());
+    _record.last_bucket_ = bucket;
+    _record.time_last_update_ = _now;
 
-    return (unsigned int)(::gettickcount() - iarr_record_[_index].time_last_update_);
-}
+    uint16_t& cur = _record.counts_[bucket % kAvalancheWindowBuckets];
+    if (0xFFFF > cur) ++cur;
 
-bool FrequencyLimit::__CheckRecord(int _index) const {
-    xassert2(0 <= _index && (unsigned int)_index < iarr_record_.size());
-    return (iarr_record_[_index].count_) <= RECORD_INTERCEPT_COUNT;
+    int count = 0;
+    for (int i = 0; i < kAvalancheWindowBuckets; ++i) count += _record.counts_[i];
+    return count;
 }
@@ -21,6 +21,8 @@
 #ifndef STN_SRC_FREQUENCY_LIMIT_H_
 #define STN_SRC_FREQUENCY_LIMIT_H_
 
+#include <stddef.h>
+#include <stdint.h>
 #include <vector>
 
 namespace mars {
@@ -29,30 +31,39 @@ namespace stn {
 struct Task;
 struct STAvalancheRecord;
 
+enum {
+    kAvalancheWindowBuckets = 6,
+};
+
 struct STAvalancheRecord {
-    unsigned long hash_;
-    int count_;
-    unsigned long time_last_update_;
+    uint64_t hash_;  // 0: empty slot
+    uint64_t time_last_update_;
+    uint64_t last_bucket_;  // absolute bucket index (tick / bucket span) counts_ was last advanced to
+    uint16_t counts_[kAvalancheWindowBuckets];  // ring of per-bucket counts, the sliding window
 };
 
+/*
+ * counts identical request buffers in a sliding time window and rejects a buffer sent too often.
+ * records live in an open-addressed table of fixed capacity: a hash probes a short run of slots
+ * from its home slot and, when the run is full, replaces the least recently updated record there.
+ */
 class FrequencyLimit {
   public:
-    FrequencyLimit();
+    explicit FrequencyLimit(size_t _capacity = 256);
     virtual ~FrequencyLimit();
 
     bool Check(const mars::stn::Task& _task, const void* _buffer, int _len, unsigned int& _span);
 
+    size_t Capacity() const { return records_.size(); }
+
   private:
-    void __ClearRecord();
-    void __InsertRecord(unsigned long _hash);
-    bool __CheckRecord(int _index) const;
-    void __UpdateRecord(int _index);
-    unsigned int __GetLastUpdateTillNow(int _index);
-    int __LocateIndex(unsigned long _hash) const;
+    STAvalancheRecord* __Locate(uint64_t _hash, uint64_t _now);
+    STAvalancheRecord& __Insert(uint64_t _hash, uint64_t _now);
+    int __Touch(STAvalancheRecord& _record, uint64_t _now) const;
 
   private:
-    std::vector<STAvalancheRecord> iarr_record_;
-    unsigned long itime_record_clear_;
+    std::vector<STAvalancheRecord> records_;
+    size_t mask_;
 };
 
 }
@@ -0,0 +1,83 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * latency_sketch.cc
+ */
+
+#include "latency_sketch.h"
+
+#include <math.h>
+#include <string.h>
+
+using namespace mars::stn;
+
+static const unsigned int kSubBucketBits = 3;
+static const uint64_t kSubBucketCount = 1 << kSubBucketBits;
+
+const size_t LatencySketch::kBucketCount;
+const uint32_t LatencySketch::kDecayCount;
+
+LatencySketch::LatencySketch()
+    : count_(0) {
+    memset(buckets_, 0, sizeof(buckets_));
+}
+
+void LatencySketch::Add(uint64_t _ms) {
+    ++buckets_[__Index(_ms)];
+    if (++count_ < kDecayCount) return;
+
+    count_ = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        buckets_[i] /= 2;
+        count_ += buckets_[i];
+    }
+}
+
+uint64_t LatencySketch::Percentile(double _percent) const {
+    if (0 == count_) return 0;
+
+    uint64_t rank = (uint64_t)ceil(count_ * _percent / 100);
+    if (0 == rank) rank = 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        seen += buckets_[i];
+        if (seen >= rank) return __UpperBound(i);
+    }
+    return __UpperBound(kBucketCount - 1);
+}
+
+void LatencySketch::Buckets(std::vector<std::pair<uint64_t, uint32_t> >& _buckets) const {
+    _buckets.clear();
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        if (0 < buckets_[i]) _buckets.push_back(std::make_pair(__UpperBound(i), buckets_[i]));
+    }
+}
+
+size_t LatencySketch::__Index(uint64_t _ms) {
+    if (_ms < kSubBucketCount) return (size_t)_ms;
+
+    unsigned int exponent = 0;
+    for (uint64_t value = _ms; 1 < value; value >>= 1) ++exponent;
+
+    size_t index = (exponent - kSubBucketBits + 1) * kSubBucketCount + ((_ms >> (exponent - kSubBucketBits)) & (kSubBucketCount - 1));
+    return index < kBucketCount ? index : kBucketCount - 1;
+}
+
+uint64_t LatencySketch::__UpperBound(size_t _index) {
+    if (_index < kSubBucketCount) return _index;
+
+    unsigned int shift = (unsigned int)(_index / kSubBucketCount) - 1;
+    uint64_t sub_bucket = kSubBucketCount + _index % kSubBucketCount;
+    return ((sub_bucket + 1) << shift) - 1;
+}
@@ -0,0 +1,62 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * latency_sketch.h
+ *
+ * a log-linear histogram of latencies in ms, the way hdr histogram buckets them: exact below 8ms,
+ * then 8 buckets for each power of two, so a percentile is off by 1/8 at most. values from 2^18ms
+ * (about 4 minutes) share the last bucket.
+ * the counts are halved when they reach kDecayCount, older samples weigh less and less.
+ */
+
+#ifndef STN_SRC_LATENCY_SKETCH_H_
+#define STN_SRC_LATENCY_SKETCH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <utility>
+#include <vector>
+
+namespace mars {
+namespace stn {
+
+class LatencySketch {
+  public:
+    static const size_t kBucketCount = 128;
+    static const uint32_t kDecayCount = 1024;
+
+  public:
+    LatencySketch();
+
+    void Add(uint64_t _ms);
+    uint32_t Count() const { return count_; }
+
+    // the upper bound of the bucket holding the _percent percentile, 0 without samples
+    uint64_t Percentile(double _percent) const;
+
+    // the non-empty buckets, upper bound in ms and count
+    void Buckets(std::vector<std::pair<uint64_t, uint32_t> >& _buckets) const;
+
+  private:
+    static size_t __Index(uint64_t _ms);
+    static uint64_t __UpperBound(size_t _index);
+
+  private:
+    uint32_t buckets_[kBucketCount];
+    uint32_t count_;
+};
+
+}}
+
+#endif  // STN_SRC_LATENCY_SKETCH_H_
@@ -53,10 +53,12 @@
 using namespace mars::stn;
 using namespace mars::app;
 
+static const uint64_t kNoopPiggybackMinDelay = 10 * 1000;  // longer than a noop takes to come back
+
 namespace {
 class LongLinkConnectObserver : public MComplexConnect {
   public:
-    LongLinkConnectObserver(LongLink& _longlink, const std::vector<IPPortItem>& _iplist): longlink_(_longlink), ip_items_(_iplist) {
+    LongLinkConnectObserver(LongLink& _longlink, NetSource& _netsource, const std::vector<IPPortItem>& _iplist): longlink_(_longlink), netsource_(_netsource), ip_items_(_iplist) {
     	memset(connecting_index_, 0, sizeof(connecting_index_));
     };
 
@@ -65,6 +67,8 @@ class LongLinkConnectObserver : public MComplexConnect {
     	connecting_index_[_index] = 1;
     }
     virtual void OnConnected(unsigned int _index, const socket_address& _addr, SOCKET _socket, int _error, int _rtt) {
+        netsource_.ReportConnect(0 == _error, ip_items_[_index].str_ip, ip_items_[_index].port, _rtt);
+
         if (0 == _error) {
             if (!OnShouldVerify(_index, _addr)) {
                 connecting_index_[_index] = 0;
@@ -125,6 +129,7 @@ class LongLinkConnectObserver : public MComplexConnect {
 
   public:
     LongLink& longlink_;
+    NetSource& netsource_;
     const std::vector<IPPortItem>& ip_items_;
 };
 
@@ -136,6 +141,8 @@ LongLink::LongLink(const mq::MessageQueue_t& _messagequeueid, NetSource& _netsou
     , thread_(boost::bind(&LongLink::__Run, this), XLOGGER_TAG "::lonklink")
 	, connectstatus_(kConnectIdle)
 	, disconnectinternalcode_(kNone)
+    , ip_rotation_(0)
+    , resuming_(false)
 #ifdef ANDROID
     , smartheartbeat_(new SmartHeartbeat)
     , wakelock_(new WakeUpLock)
@@ -163,7 +170,8 @@ LongLink::~LongLink() {
 bool LongLink::Send(const AutoBuffer& _body, const AutoBuffer& _extension, const Task& _task) {
     ScopedLock lock(mutex_);
 
-    if (kConnected != connectstatus_) return false;
+    // a resuming longlink packs the tasks while it connects, they go out in its first flight
+    if (kConnected != connectstatus_ && !(resuming_ && kConnecting == connectstatus_)) return false;
 
     xassert2(tracker_.get());
     
@@ -228,6 +236,9 @@ bool LongLink::MakeSureConnected(bool* _newone) {
     thread_.start(&newone);
 
     if (newone) {
+        resuming_ = __CanResume();
+        if (resuming_) resume_item_ = conn_profile_.ip_items[conn_profile_.ip_index];
+
         connectstatus_ = kConnectIdle;
         conn_profile_.Reset();
         identifychecker_.Reset();
@@ -270,6 +281,18 @@ void LongLink::Disconnect(TDisconnectInternalCode _scene) {
     }
 }
 
+bool LongLink::__CanResume() const {
+    // the other scenes ask for fresh ips on purpose
+    if (kNone != disconnectinternalcode_) return false;
+    if (0 > conn_profile_.ip_index || (size_t)conn_profile_.ip_index >= conn_profile_.ip_items.size()) return false;
+    if (kIPSourceProxy == conn_profile_.ip_type || 0 == conn_profile_.disconn_time) return false;
+    if (::gettickcount() - conn_profile_.disconn_time > kLonglinkResumeWindow) return false;
+
+    std::string net_label;
+    getCurrNetLabel(net_label);
+    return net_label == conn_profile_.net_type;
+}
+
 bool LongLink::__NoopReq(XLogger& _log, Alarm& _alarm, bool need_active_timeout) {
     AutoBuffer buffer;
     uint32_t req_cmdid = 0;
@@ -287,10 +310,11 @@ bool LongLink::__NoopReq(XLogger& _log, Alarm& _alarm, bool need_active_timeout)
     }
     
     if (suc) {
+        unsigned int timeout = __GetNoopTimeout(need_active_timeout ? (5* 1000) : (8 * 1000));
         _alarm.Cancel();
-        _alarm.Start(need_active_timeout ? (5* 1000) : (8 * 1000));
+        _alarm.Start((int)timeout);
 #ifdef ANDROID
-        wakelock_->Lock(8 * 1000);
+        wakelock_->Lock(timeout);
 #endif
     } else {
         xerror2("send noop fail");
@@ -399,7 +423,14 @@ void LongLink::__Run() {
         __UpdateProfile(conn_profile);
         
         ScopedLock lock(mutex_);
+        bool stranded = !lstsenddata_.empty();
+        lstsenddata_.clear();
         tracker_.reset();
+        lock.unlock();
+
+        // tasks packed while resuming never went out. __RunConnect reports its failure unless a disconnect
+        // scene stopped it, without a report they would wait for their task timeout
+        if (stranded && kNone != disconnectinternalcode_) __RunResponseError(kEctSocket, kEctSocketMakeSocketPrepared, conn_profile, false);
         return;
     }
     
@@ -433,11 +464,23 @@ SOCKET LongLink::__RunConnect(ConnectProfile& _conn_profile) {
     __ConnectStatus(kConnecting);
     _conn_profile.dns_time = ::gettickcount();
      __UpdateProfile(_conn_profile);
+
+    if (resuming_) {
+        SOCKET sock = __RunResumeConnect(_conn_profile);
+        if (INVALID_SOCKET != sock || kNone != disconnectinternalcode_) return sock;
+
+        // tasks packed meanwhile stay in lstsenddata_ for whichever ip connects below
+        ScopedLock lock(mutex_);
+        resuming_ = false;
+    }
     
     std::vector<IPPortItem> ip_items;
     std::vector<socket_address> vecaddr;
 
     netsource_.GetLongLinkItems(ip_items, dns_util_);
+    if (0 < ip_rotation_ && 1 < ip_items.size()) {
+        std::rotate(ip_items.begin(), ip_items.begin() + ip_rotation_ % ip_items.size(), ip_items.end());
+    }
     mars::comm::ProxyInfo proxy_info = mars::app::GetProxyInfo("");
     bool use_proxy = proxy_info.IsValid() && mars::comm::kProxyNone != proxy_info.type && mars::comm::kProxyHttp != proxy_info.type && netsource_.GetLongLinkDebugIP().empty();
     xinfo2(TSF"task socket dns ip:%_ proxytype:%_ useproxy:%_", NetSource::DumpTable(ip_items), proxy_info.type, use_proxy);
@@ -498,7 +541,7 @@ SOCKET LongLink::__RunConnect(ConnectProfile& _conn_profile) {
     
     // set the first ip info to the profiler, after connect, the ip info will be overwrriten by the real one
     
-    LongLinkConnectObserver connect_observer(*this, ip_items);
+    LongLinkConnectObserver connect_observer(*this, netsource_, ip_items);
     ComplexConnect com_connect(kLonglinkConnTimeout, kLonglinkConnInteral, kLonglinkConnInteral, kLonglinkConnMax);
 
     SOCKET sock = com_connect.ConnectImpatient(vecaddr, connectbreak_, &connect_observer, proxy_info.type, proxy_addr, proxy_info.username, proxy_info.password);
@@ -530,6 +573,10 @@ SOCKET LongLink::__RunConnect(ConnectProfile& _conn_profile) {
                 fun_network_report_(__LINE__, kEctSocket, SOCKET_ERRNO(ETIMEDOUT), ip_items[i].str_ip, ip_items[i].port);
         }
     }
+
+    for (int i = 0; i < com_connect.Index(); ++i) {
+        if (1 == connect_observer.connecting_index_[i]) netsource_.ReportConnect(false, ip_items[i].str_ip, ip_items[i].port, -1);
+    }
     
     _conn_profile.ip_index = com_connect.Index();
     _conn_profile.host = ip_items[com_connect.Index()].str_host;
@@ -556,6 +603,69 @@ SOCKET LongLink::__RunConnect(ConnectProfile& _conn_profile) {
     return sock;
 }
 
+SOCKET LongLink::__RunResumeConnect(ConnectProfile& _conn_profile) {
+    mars::comm::ProxyInfo proxy_info = mars::app::GetProxyInfo("");
+    if (proxy_info.IsValid() && mars::comm::kProxyNone != proxy_info.type && mars::comm::kProxyHttp != proxy_info.type) return INVALID_SOCKET;
+
+    bool isnat64 = ELocalIPStack_IPv6 == local_ipstack_detect();
+    std::vector<socket_address> vecaddr(1, socket_address(resume_item_.str_ip.c_str(), resume_item_.port).v4tov6_address(isnat64));
+
+    _conn_profile.ip_items.assign(1, resume_item_);
+    _conn_profile.host = resume_item_.str_host;
+    _conn_profile.ip_type = resume_item_.source_type;
+    _conn_profile.ip = resume_item_.str_ip;
+    _conn_profile.port = resume_item_.port;
+    _conn_profile.nat64 = isnat64;
+    _conn_profile.dns_endtime = ::gettickcount();
+    __UpdateProfile(_conn_profile);
+
+    // the ip answered a moment ago, no dns, no racing and no verify
+    ComplexConnect com_connect(kLonglinkResumeConnTimeout, kLonglinkConnInteral, kLonglinkConnInteral, 1);
+    SOCKET sock = com_connect.ConnectImpatient(vecaddr, connectbreak_);
+    if (kNone == disconnectinternalcode_) netsource_.ReportConnect(INVALID_SOCKET != sock, resume_item_.str_ip, resume_item_.port, com_connect.IndexRtt());
+
+    _conn_profile.conn_time = gettickcount();
+    _conn_profile.conn_errcode = com_connect.ErrorCode();
+    _conn_profile.conn_rtt = com_connect.IndexRtt();
+    _conn_profile.conn_cost = com_connect.TotalCost();
+    _conn_profile.tryip_count = com_connect.TryCount();
+
+    if (INVALID_SOCKET == sock) {
+        xwarn2(TSF"resume connect fail ip:%_, port:%_, costtime:%_, scene:%_", resume_item_.str_ip, resume_item_.port, com_connect.TotalCost(), disconnectinternalcode_);
+        if (kNone != disconnectinternalcode_) __ConnectStatus(kConnectFailed);
+        __UpdateProfile(_conn_profile);
+        return INVALID_SOCKET;
+    }
+
+    _conn_profile.ip_index = 0;
+    _conn_profile.local_ip = socket_address::getsockname(sock).ip();
+    _conn_profile.local_port = socket_address::getsockname(sock).port();
+
+    uint32_t cmdid = 0;
+    AutoBuffer body;
+    AutoBuffer extension;
+    bool has_token = longlink_resume_req(cmdid, body, extension);
+    ScopedLock lock(mutex_);
+    if (has_token) {
+        Task task(Task::kLongLinkIdentifyCheckerTaskID);
+        task.send_only = true;
+        task.cmdid = cmdid;
+        lstsenddata_.push_front(std::make_pair(task, move_wrapper<AutoBuffer>(AutoBuffer())));
+        longlink_pack(cmdid, task.taskid, body, extension, lstsenddata_.front().second, tracker_.get());
+        lstsenddata_.front().second->Seek(0, AutoBuffer::ESeekStart);
+        identifychecker_.MarkChecked();
+    }
+    xinfo2(TSF"resume connect suc sock:%_, host:%_, ip:%_, port:%_, local_ip:%_, local_port:%_, rtt:%_, queued:%_, token:%_",
+           sock, _conn_profile.host, _conn_profile.ip, _conn_profile.port, _conn_profile.local_ip, _conn_profile.local_port, com_connect.IndexRtt(), lstsenddata_.size(), has_token);
+    lock.unlock();
+
+    __ConnectStatus(kConnected);
+    __UpdateProfile(_conn_profile);
+
+    xerror2_if(0 != socket_disable_nagle(sock, 1), TSF"socket_disable_nagle sock:%0, %1(%2)", sock, socket_errno, socket_strerror(socket_errno));
+    return sock;
+}
+
 void LongLink::__RunReadWrite(SOCKET _sock, ErrCmdType& _errtype, int& _errcode, ConnectProfile& _profile) {
     
     Alarm alarmnoopinterval(boost::bind(&LongLink::__OnAlarm, this), false);
@@ -578,6 +688,16 @@ void LongLink::__RunReadWrite(SOCKET _sock, ErrCmdType& _errtype, int& _errcode,
             if(first_noop_sent && alarmnoopinterval.Status() == Alarm::kOnAlarm) {
               __NotifySmartHeartbeatJudgeDozeStyle();
             }
+            // data came in since the last noop, the nat keeps the link that long from then on
+            uint64_t recv_span = lastrecvtime_.isValid() ? (uint64_t)lastrecvtime_.gettickspan() : UINT64_MAX;
+            uint64_t next_interval = __GetNextHeartbeatInterval();
+            if (first_noop_sent && !nooping && recv_span + kNoopPiggybackMinDelay < next_interval) {
+                xinfo2(TSF"noop skipped, recv %_ms ago, next in %_", recv_span, next_interval - recv_span);
+                alarmnoopinterval.Cancel();
+                alarmnoopinterval.Start((int)(next_interval - recv_span));
+                continue;
+            }
+
             xgroup2_define(noop_xlog);
             uint64_t last_noop_interval = alarmnoopinterval.After();
             uint64_t last_noop_actual_interval = (alarmnoopinterval.Status() == Alarm::kOnAlarm) ? alarmnoopinterval.ElapseTime() : 0;
@@ -590,10 +710,9 @@ void LongLink::__RunReadWrite(SOCKET _sock, ErrCmdType& _errtype, int& _errcode,
             
             first_noop_sent = true;
 
-            uint64_t noop_interval = __GetNextHeartbeatInterval();
-            xinfo2(TSF" last:(%_,%_), next:%_", last_noop_interval, last_noop_actual_interval, noop_interval) >> noop_xlog;
+            xinfo2(TSF" last:(%_,%_), next:%_", last_noop_interval, last_noop_actual_interval, next_interval) >> noop_xlog;
             alarmnoopinterval.Cancel();
-            alarmnoopinterval.Start((int)noop_interval);
+            alarmnoopinterval.Start((int)next_interval);
         }
         
         if (nooping && (alarmnooptimeout.Status() == Alarm::kInit || alarmnooptimeout.Status() == Alarm::kCancel)) {
@@ -706,6 +825,8 @@ void LongLink::__RunReadWrite(SOCKET _sock, ErrCmdType& _errtype, int& _errcode,
             while (it != lstsenddata_.end() && 0 < writelen) {
                 if (0 == it->second->Pos() && OnSend) OnSend(it->first.taskid);
                 
+                TrafficCmdData(Task::kChannelLong, it->first.cmdid, std::min((size_t)writelen, it->second->PosLength()), 0);
+                
                 if ((size_t)writelen >= it->second->PosLength()) {
                     xinfo2(TSF"sub send taskid:%_, cmdid:%_, %_, len(S:%_, %_/%_), ", it->first.taskid, it->first.cmdid, it->first.cgi, it->second->PosLength(), it->second->PosLength(), it->second->Length()) >> xlog_group;
                     writelen -= it->second->PosLength();
@@ -776,7 +897,16 @@ void LongLink::__RunReadWrite(SOCKET _sock, ErrCmdType& _errtype, int& _errcode,
                     break;
                 }
                 
-                if (stream_resp.stream->Ptr()) {
+                TrafficCmdData(Task::kChannelLong, cmdid, 0, packlen);
+                
+                if (stream_resp.task.stream_response) {
+                    // every LONGLINK_UNPACK_STREAM_PACKAGE frame is handed over and dropped, memory stays at one frame
+                    if (!stream_resp.chunk_started) {
+                        stream_resp.chunk_started = true;
+                        OnResponseChunk(taskid, NULL, 0);
+                    }
+                    if (0 < body.Length()) OnResponseChunk(taskid, body.Ptr(), body.Length());
+                } else if (stream_resp.stream->Ptr()) {
                     stream_resp.stream->Write(body);
                 } else {
                     stream_resp.stream->Attach(body);
@@ -931,6 +1061,16 @@ void LongLink::__NotifySmartHeartbeatConnectStatus(TLongLinkStatus _status) {
     }
 }
 
+unsigned int LongLink::__GetNoopTimeout(unsigned int _max) {
+    if (longlink_noop_interval() > 0) {
+        return _max;
+    }
+
+    if (!smartheartbeat_) return _max;
+
+    return smartheartbeat_->GetNoopTimeout(_max);
+}
+
 unsigned int LongLink::__GetNextHeartbeatInterval() {
     if (longlink_noop_interval() > 0) {
         return longlink_noop_interval();
@@ -66,11 +66,12 @@ struct LongLinkNWriteData {
         
 struct StreamResp {
     StreamResp(const Task& _task = Task(Task::kInvalidTaskID))
-    : task(_task), stream(KNullAtuoBuffer), extension(KNullAtuoBuffer) {}
+    : task(_task), stream(KNullAtuoBuffer), extension(KNullAtuoBuffer), chunk_started(false) {}
     
     Task task;
     move_wrapper<AutoBuffer> stream;
     move_wrapper<AutoBuffer> extension;
+    bool chunk_started;  // task.stream_response: the body goes to OnResponseChunk instead of stream
 };
 
 class LongLink {
@@ -130,6 +131,11 @@ class LongLink {
 
     ConnectProfile  Profile() const   { return conn_profile_; }
     tickcount_t&    GetLastRecvTime() { return lastrecvtime_; }
+
+    // connect from the _rotation-th ip of GetLongLinkItems on, for pooled longlinks that should not all sit on one ip
+    void            SetIPRotation(size_t _rotation) { ip_rotation_ = _rotation; }
+    // reconnecting straight to the ip of the last connection, Send takes tasks before it is connected
+    bool            IsResuming() const { return resuming_; }
     
   private:
     LongLink(const LongLink&);
@@ -147,10 +153,13 @@ class LongLink {
     virtual void     __OnAlarm();
     virtual void     __Run();
     virtual SOCKET   __RunConnect(ConnectProfile& _conn_profile);
+    bool             __CanResume() const;
+    SOCKET           __RunResumeConnect(ConnectProfile& _conn_profile);
     virtual void     __RunReadWrite(SOCKET _sock, ErrCmdType& _errtype, int& _errcode, ConnectProfile& _profile);
   protected:
     
     uint32_t   __GetNextHeartbeatInterval();
+    uint32_t   __GetNoopTimeout(uint32_t _max);
     void       __NotifySmartHeartbeatConnectStatus(TLongLinkStatus _status);
     void       __NotifySmartHeartbeatHeartReq(ConnectProfile& _profile, uint64_t _internal, uint64_t _actual_internal);
     void       __NotifySmartHeartbeatHeartResult(bool _succes, bool _fail_of_timeout, ConnectProfile& _profile);
@@ -174,6 +183,9 @@ class LongLink {
     LongLinkIdentifyChecker                              identifychecker_;
     std::list<std::pair<Task, move_wrapper<AutoBuffer>>> lstsenddata_;
     tickcount_t                                          lastrecvtime_;
+    size_t                                               ip_rotation_;
+    bool                                                 resuming_;
+    IPPortItem                                           resume_item_;
     
     SmartHeartbeat*                              smartheartbeat_;
     WakeUpLock*                                  wakelock_;
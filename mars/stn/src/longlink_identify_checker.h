@@ -37,6 +37,8 @@ class LongLinkIdentifyChecker {
     bool OnIdentifyResp(AutoBuffer& _buffer);
 
     void Reset();
+    // the connection is known to be ours already, e.g. it resumed the session of the last one
+    void MarkChecked() { has_checked_ = true; }
 
 
   private:
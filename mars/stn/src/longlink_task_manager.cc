@@ -46,11 +46,23 @@ using namespace mars::stn;
 #define AYNC_HANDLER asyncreg_.Get()
 #define RETURN_LONKLINK_SYNC2ASYNC_FUNC(func) RETURN_SYNC2ASYNC_FUNC(func, )
 
+static unsigned int sg_pool_size = 1;
+static size_t sg_bulk_send_size = kDynTimeBigPackageLen;
+static bool sg_spread_ips = false;
+
+void LongLinkTaskManager::SetPoolStrategy(unsigned int _pool_size, size_t _bulk_send_size, bool _spread_ips) {
+    xinfo2(TSF"longlink pool size:%_, bulk send size:%_, spread ips:%_", _pool_size, _bulk_send_size, _spread_ips);
+    sg_pool_size = std::max(1u, _pool_size);
+    sg_bulk_send_size = _bulk_send_size;
+    sg_spread_ips = _spread_ips;
+}
+
 LongLinkTaskManager::LongLinkTaskManager(NetSource& _netsource, ActiveLogic& _activelogic, DynamicTimeout& _dynamictimeout, MessageQueue::MessageQueue_t  _messagequeue_id)
     : asyncreg_(MessageQueue::InstallAsyncHandler(_messagequeue_id))
     , lastbatcherrortime_(0)
     , retry_interval_(0)
     , tasks_continuous_fail_count_(0)
+    , netsource_(_netsource)
     , longlink_(LongLinkChannelFactory::Create(_messagequeue_id, _netsource))
     , longlinkconnectmon_(new LongLinkConnectMonitor(_activelogic, *longlink_, _messagequeue_id))
     , dynamic_timeout_(_dynamictimeout)
@@ -59,20 +71,23 @@ LongLinkTaskManager::LongLinkTaskManager(NetSource& _netsource, ActiveLogic& _ac
 #endif
 {
     xinfo_function(TSF"handler:(%_,%_)", asyncreg_.Get().queue, asyncreg_.Get().seq);
-    longlink_->OnSend = boost::bind(&LongLinkTaskManager::__OnSend, this, _1);
-    longlink_->OnRecv = boost::bind(&LongLinkTaskManager::__OnRecv, this, _1, _2, _3);
-    longlink_->OnResponse = boost::bind(&LongLinkTaskManager::__OnResponse, this, _1, _2, _3, _4, _5, _6, _7);
-    longlink_->SignalConnection.connect(boost::bind(&LongLinkTaskManager::__SignalConnection, this, _1));
+    __Observe(*longlink_);
 }
 
 LongLinkTaskManager::~LongLinkTaskManager() {
     xinfo_function();
     longlink_->SignalConnection.disconnect(boost::bind(&LongLinkTaskManager::__SignalConnection, this, _1));
+    for (std::vector<LongLink*>::iterator it = bulk_longlinks_.begin(); it != bulk_longlinks_.end(); ++it) {
+        (*it)->SignalConnection.disconnect(boost::bind(&LongLinkTaskManager::__SignalConnection, this, _1));
+    }
     asyncreg_.CancelAndWait();
     
-    __BatchErrorRespHandle(kEctLocal, kEctLocalReset, kTaskFailHandleTaskEnd, Task::kInvalidTaskID, longlink_->Profile(), false);
+    __BatchErrorRespHandle(NULL, kEctLocal, kEctLocalReset, kTaskFailHandleTaskEnd, Task::kInvalidTaskID, longlink_->Profile(), false);
     
     delete longlinkconnectmon_;
+    for (std::vector<LongLink*>::iterator it = bulk_longlinks_.begin(); it != bulk_longlinks_.end(); ++it) {
+        LongLinkChannelFactory::Destory(*it);
+    }
     LongLinkChannelFactory::Destory(longlink_);
 #ifdef ANDROID
     delete wakeup_lock_;
@@ -103,7 +118,7 @@ bool LongLinkTaskManager::StopTask(uint32_t _taskid) {
         if (_taskid == first->task.taskid) {
             xinfo2(TSF"find the task taskid:%0", _taskid);
 
-            longlink_->Stop(first->task.taskid);
+            __LinkOf(*first).Stop(first->task.taskid);
             lst_cmd_.erase(first);
             return true;
         }
@@ -132,7 +147,7 @@ bool LongLinkTaskManager::HasTask(uint32_t _taskid) const {
 
 void LongLinkTaskManager::ClearTasks() {
     xverbose_function();
-    longlink_->Disconnect(LongLink::kReset);
+    Disconnect(LongLink::kReset);
     MessageQueue::CancelMessage(asyncreg_.Get(), 0);
     lst_cmd_.clear();
 }
@@ -158,7 +173,7 @@ void LongLinkTaskManager::RedoTasks() {
         first->last_failed_dyntime_status = 0;
         if (first->running_id) {
             xinfo2(TSF "task redo, taskid:%_", first->task.taskid);
-            __SingleRespHandle(first, kEctLocal, kEctLocalCancel, kTaskFailHandleDefault, longlink_->Profile());
+            __SingleRespHandle(first, kEctLocal, kEctLocalCancel, kTaskFailHandleDefault, __LinkOf(*first).Profile());
         }
 
         first = next;
@@ -172,7 +187,42 @@ void LongLinkTaskManager::RedoTasks() {
 
 void LongLinkTaskManager::RetryTasks(ErrCmdType _err_type, int _err_code, int _fail_handle, uint32_t _src_taskid) {
     xverbose_function();
-    __BatchErrorRespHandle(_err_type, _err_code, _fail_handle, _src_taskid, longlink_->Profile());
+    __BatchErrorRespHandle(NULL, _err_type, _err_code, _fail_handle, _src_taskid, longlink_->Profile());
+    __RunLoop();
+}
+
+void LongLinkTaskManager::Disconnect(LongLink::TDisconnectInternalCode _scene) {
+    __Disconnect(NULL, _scene);
+}
+
+void LongLinkTaskManager::OnNetworkChange() {
+    xinfo_function();
+
+    for (std::vector<LongLink*>::iterator it = bulk_longlinks_.begin(); it != bulk_longlinks_.end(); ++it) {
+        (*it)->Disconnect(LongLink::kNetworkChange);
+    }
+
+    if (longlinkconnectmon_->NetworkChange()) {
+        RedoTasks();
+        return;
+    }
+
+    // the main longlink may be kept a little longer (see LongLinkConnectMonitor), the bulk ones are gone
+    std::list<TaskProfile>::iterator first = lst_cmd_.begin();
+    std::list<TaskProfile>::iterator last = lst_cmd_.end();
+
+    while (first != last) {
+        std::list<TaskProfile>::iterator next = first;
+        ++next;
+
+        if (first->running_id && (intptr_t)longlink_ != first->running_id) {
+            xinfo2(TSF "task redo, taskid:%_", first->task.taskid);
+            __SingleRespHandle(first, kEctLocal, kEctLocalCancel, kTaskFailHandleDefault, __LinkOf(*first).Profile());
+        }
+
+        first = next;
+    }
+
     __RunLoop();
 }
 
@@ -191,12 +241,14 @@ void LongLinkTaskManager::__RunLoop() {
     __RunOnStartTask();
 
     if (!lst_cmd_.empty()) {
+        // only tasks waiting for the flow limit, nothing to do until the first of them may go
+        uint64_t deferred = __FlowDeferredWait(lst_cmd_);
 #ifdef ANDROID
-        wakeup_lock_->Lock(30 * 1000);
+        if (0 == deferred) wakeup_lock_->Lock(30 * 1000);
 #endif
       MessageQueue::FasterMessage(asyncreg_.Get(),
                                   MessageQueue::Message((MessageQueue::MessageTitle_t)this, boost::bind(&LongLinkTaskManager::__RunLoop, this), "LongLinkTaskManager::__RunLoop"),
-                                  MessageQueue::MessageTiming(1000));
+                                  MessageQueue::MessageTiming(0 == deferred ? 1000 : deferred));
     } else {
 #ifdef ANDROID
         /*cancel the last wakeuplock*/
@@ -213,18 +265,24 @@ void LongLinkTaskManager::__RunOnTimeout() {
     int socket_timeout_code = 0;
     uint32_t src_taskid = Task::kInvalidTaskID;
     bool istasktimeout = false;
+    LongLink* socket_timeout_longlink = NULL;
+    LongLink* task_timeout_longlink = NULL;  // NULL: more than one or none of them
 
     while (first != last) {
         std::list<TaskProfile>::iterator next = first;
         ++next;
 
+        LongLink& longlink = __LinkOf(*first);
+
         if (first->running_id && 0 < first->transfer_profile.start_send_time) {
             if (0 == first->transfer_profile.last_receive_pkg_time && cur_time - first->transfer_profile.start_send_time >= first->transfer_profile.first_pkg_timeout) {
                 xerror2(TSF"task first-pkg timeout taskid:%_,  nStartSendTime=%_, nfirstpkgtimeout=%_",
                         first->task.taskid, first->transfer_profile.start_send_time / 1000, first->transfer_profile.first_pkg_timeout / 1000);
                 socket_timeout_code = kEctLongFirstPkgTimeout;
                 src_taskid = first->task.taskid;
+                socket_timeout_longlink = &longlink;
                 __SetLastFailedStatus(first);
+                dynamic_timeout_.CgiLatencyStatistic(first->task.cgi, first->transfer_profile.first_pkg_timeout, first->transfer_profile.first_pkg_timeout);
             }
 
             if (0 < first->transfer_profile.last_receive_pkg_time && cur_time - first->transfer_profile.last_receive_pkg_time >= ((kMobile != getNetInfo()) ? kWifiPackageInterval : kGPRSPackageInterval)) {
@@ -232,6 +290,7 @@ void LongLinkTaskManager::__RunOnTimeout() {
                         first->task.taskid, first->transfer_profile.last_receive_pkg_time / 1000, ((kMobile != getNetInfo()) ? kWifiPackageInterval : kGPRSPackageInterval) / 1000);
                 socket_timeout_code = kEctLongPkgPkgTimeout;
                 src_taskid = first->task.taskid;
+                socket_timeout_longlink = &longlink;
             }
             
             if (cur_time - first->transfer_profile.start_send_time >= first->transfer_profile.read_write_timeout) {
@@ -239,13 +298,17 @@ void LongLinkTaskManager::__RunOnTimeout() {
                         first->task.taskid, first->transfer_profile.start_send_time / 1000, first->transfer_profile.read_write_timeout / 1000);
                 socket_timeout_code = kEctLongReadWriteTimeout;
                 src_taskid = first->task.taskid;
+                socket_timeout_longlink = &longlink;
+                dynamic_timeout_.CgiLatencyStatistic(first->task.cgi, 0 < first->transfer_profile.first_receive_pkg_time ? first->transfer_profile.first_receive_pkg_time - first->transfer_profile.start_send_time : first->transfer_profile.read_write_timeout, first->transfer_profile.read_write_timeout);
             }
         }
 
         if (cur_time - first->start_task_time >= first->task_timeout) {
             xerror2(TSF"task timeout, taskid:%_, nStartSendTime=%_, cur_time=%_, timeout:%_",
                     first->task.taskid, first->transfer_profile.start_send_time / 1000, cur_time / 1000, first->task_timeout / 1000);
-            __SingleRespHandle(first, kEctLocal, kEctLocalTaskTimeout, kTaskFailHandleTaskTimeout, longlink_->Profile());
+            LongLink* timeout_longlink = first->running_id ? &longlink : NULL;
+            task_timeout_longlink = (!istasktimeout || task_timeout_longlink == timeout_longlink) ? timeout_longlink : NULL;
+            __SingleRespHandle(first, kEctLocal, kEctLocalTaskTimeout, kTaskFailHandleTaskTimeout, longlink.Profile());
             istasktimeout = true;
         }
 
@@ -254,11 +317,12 @@ void LongLinkTaskManager::__RunOnTimeout() {
 
     if (0 != socket_timeout_code) {
         dynamic_timeout_.CgiTaskStatistic("", kDynTimeTaskFailedPkgLen, 0);
-        __BatchErrorRespHandle(kEctNetMsgXP, socket_timeout_code, kTaskFailHandleDefault, src_taskid, longlink_->Profile());
+        __BatchErrorRespHandle(socket_timeout_longlink, kEctNetMsgXP, socket_timeout_code, kTaskFailHandleDefault, src_taskid, socket_timeout_longlink->Profile());
         xassert2(fun_notify_network_err_);
-        fun_notify_network_err_(__LINE__, kEctNetMsgXP, socket_timeout_code, longlink_->Profile().ip,  longlink_->Profile().port);
+        fun_notify_network_err_(__LINE__, kEctNetMsgXP, socket_timeout_code, socket_timeout_longlink->Profile().ip,  socket_timeout_longlink->Profile().port);
     } else if (istasktimeout) {
-        __BatchErrorRespHandle(kEctNetMsgXP, kEctLocalTaskTimeout, kTaskFailHandleDefault, src_taskid, longlink_->Profile());
+        __BatchErrorRespHandle(task_timeout_longlink, kEctNetMsgXP, kEctLocalTaskTimeout, kTaskFailHandleDefault, src_taskid,
+                               (NULL == task_timeout_longlink ? *longlink_ : *task_timeout_longlink).Profile());
     }
 }
 
@@ -272,14 +336,20 @@ void LongLinkTaskManager::__RunOnStartTask() {
 
     bool canretry = curtime - lastbatcherrortime_ >= retry_interval_;
     bool canprint = true;
-    int sent_count = 0;
+    std::map<intptr_t, int> sent_count;  // per longlink
 
     while (first != last) {
         std::list<TaskProfile>::iterator next = first;
         ++next;
 
         if (first->running_id) {
-            ++sent_count;
+            ++sent_count[first->running_id];
+            first = next;
+            continue;
+        }
+
+        // held back by the flow limit
+        if (first->retry_time_interval > curtime - first->retry_start_time) {
             first = next;
             continue;
         }
@@ -319,9 +389,7 @@ void LongLinkTaskManager::__RunOnStartTask() {
 				continue;
 			}
 			// 雪崩检测
-			xassert2(fun_anti_avalanche_check_);
-			if (!fun_anti_avalanche_check_(first->task, bufreq.Ptr(), (int)bufreq.Length())) {
-				__SingleRespHandle(first, kEctLocal, kEctLocalAntiAvalanche, kTaskFailHandleTaskEnd, longlink_->Profile());
+			if (!__AntiAvalancheCheck(first, bufreq, longlink_->Profile())) {
 				first = next;
 				continue;
 			}
@@ -329,42 +397,56 @@ void LongLinkTaskManager::__RunOnStartTask() {
         }
 
         xassert2(first->antiavalanche_checked);
-		if (!longlinkconnectmon_->MakeSureConnected()) {
+        LongLink* longlink = __SelectLink(*first, bufreq.Length(), sent_count);
+
+        // a bulk longlink that failed to connect is tried again, its tasks go on the main one meanwhile
+        bool connect_failed = LongLink::kConnectFailed == longlink->ConnectStatus();
+        bool connected = __MakeSureConnected(*longlink);
+        if (!connected && connect_failed && longlink != longlink_) {
+            longlink = longlink_;
+            connected = __MakeSureConnected(*longlink);
+        }
+        // a resuming longlink packs the task now and sends it the moment it is connected
+        if (!connected && 0 == first->task.channel_id && longlink->IsResuming()) {
+            connected = LongLink::kConnecting == longlink->ConnectStatus();
+        }
+
+		if (!connected) {
             if (0 != first->task.channel_id) {
-                __SingleRespHandle(first, kEctLocal, kEctLocalChannelID, kTaskFailHandleTaskEnd, longlink_->Profile());
+                __SingleRespHandle(first, kEctLocal, kEctLocalChannelID, kTaskFailHandleTaskEnd, longlink->Profile());
             }
             
             first = next;
             continue;
 		}
 
-        if (0 != first->task.channel_id && longlink_->Profile().start_time != first->task.channel_id) {
-            __SingleRespHandle(first, kEctLocal, kEctLocalChannelID, kTaskFailHandleTaskEnd, longlink_->Profile());
+        if (0 != first->task.channel_id && longlink->Profile().start_time != first->task.channel_id) {
+            __SingleRespHandle(first, kEctLocal, kEctLocalChannelID, kTaskFailHandleTaskEnd, longlink->Profile());
             first = next;
             continue;
         }
         
 		if (0 == bufreq.Length()) {
 			if (!Req2Buf(first->task.taskid, first->task.user_context, bufreq, buffer_extension, error_code, Task::kChannelLong)) {
-				__SingleRespHandle(first, kEctEnDecode, error_code, kTaskFailHandleTaskEnd, longlink_->Profile());
+				__SingleRespHandle(first, kEctEnDecode, error_code, kTaskFailHandleTaskEnd, longlink->Profile());
 				first = next;
 				continue;
 			}
 			// 雪崩检测
-			xassert2(fun_anti_avalanche_check_);
-			if (!fun_anti_avalanche_check_(first->task, bufreq.Ptr(), (int)bufreq.Length())) {
-				__SingleRespHandle(first, kEctLocal, kEctLocalAntiAvalanche, kTaskFailHandleTaskEnd, longlink_->Profile());
+			if (!__AntiAvalancheCheck(first, bufreq, longlink->Profile())) {
 				first = next;
 				continue;
 			}
 		}
 
 		first->transfer_profile.loop_start_task_time = ::gettickcount();
-        first->transfer_profile.first_pkg_timeout = __FirstPkgTimeout(first->task.server_process_cost, bufreq.Length(), sent_count, dynamic_timeout_.GetStatus());
+        first->transfer_profile.first_pkg_timeout = __FirstPkgTimeout(first->task.server_process_cost, bufreq.Length(), sent_count[(intptr_t)longlink], dynamic_timeout_.GetStatus());
         first->current_dyntime_status = (first->task.server_process_cost <= 0) ? dynamic_timeout_.GetStatus() : kEValuating;
         first->transfer_profile.read_write_timeout = __ReadWriteTimeout(first->transfer_profile.first_pkg_timeout);
+        if (first->task.server_process_cost <= 0) dynamic_timeout_.CgiTimeout(first->task.cgi, first->transfer_profile.first_pkg_timeout, first->transfer_profile.read_write_timeout);
         first->transfer_profile.send_data_size = bufreq.Length();
-        first->running_id = longlink_->Send(bufreq, buffer_extension, first->task);
+        // running_id is the longlink the task is on
+        first->running_id = longlink->Send(bufreq, buffer_extension, first->task) ? (intptr_t)longlink : 0;
 
         if (!first->running_id) {
             xwarn2(TSF"task add into longlink readwrite fail cgi:%_, cmdid:%_, taskid:%_", first->task.cgi, first->task.cmdid, first->task.taskid);
@@ -377,14 +459,101 @@ void LongLinkTaskManager::__RunOnStartTask() {
                first->transfer_profile.read_write_timeout / 1000, first->task_timeout / 1000, first->remain_retry_count, curtime, first->start_task_time);
 
         if (first->task.send_only) {
-            __SingleRespHandle(first, kEctOK, 0, kTaskFailHandleNoError, longlink_->Profile());
+            __SingleRespHandle(first, kEctOK, 0, kTaskFailHandleNoError, longlink->Profile());
         }
 
-        ++sent_count;
+        ++sent_count[(intptr_t)longlink];
         first = next;
     }
 }
 
+LongLink& LongLinkTaskManager::__LinkOf(const TaskProfile& _task_profile) {
+    return _task_profile.running_id ? *(LongLink*)_task_profile.running_id : *longlink_;
+}
+
+LongLink* LongLinkTaskManager::__SelectLink(const TaskProfile& _task_profile, size_t _send_size, const std::map<intptr_t, int>& _running_count) {
+    if (0 != _task_profile.task.channel_id) {
+        for (std::vector<LongLink*>::iterator it = bulk_longlinks_.begin(); it != bulk_longlinks_.end(); ++it) {
+            if ((*it)->Profile().start_time == _task_profile.task.channel_id) return *it;
+        }
+        return longlink_;
+    }
+
+    bool bulk = Task::kTaskPriorityNormal < _task_profile.task.priority || (0 < _send_size && sg_bulk_send_size <= _send_size);
+    if (!bulk || 1 >= sg_pool_size) return longlink_;
+
+    while (bulk_longlinks_.size() + 1 < sg_pool_size) {
+        LongLink* longlink = LongLinkChannelFactory::Create(asyncreg_.Get().queue, netsource_);
+        if (sg_spread_ips) longlink->SetIPRotation(bulk_longlinks_.size() + 1);
+        longlink->fun_network_report_ = fun_notify_network_err_;
+        __Observe(*longlink);
+        bulk_longlinks_.push_back(longlink);
+        xinfo2(TSF"new bulk longlink:%_, pool:%_", longlink, bulk_longlinks_.size() + 1);
+    }
+
+    LongLink* idlest = NULL;
+    int idlest_count = 0;
+    for (std::vector<LongLink*>::iterator it = bulk_longlinks_.begin(); it != bulk_longlinks_.end(); ++it) {
+        std::map<intptr_t, int>::const_iterator count = _running_count.find((intptr_t)*it);
+        int running = _running_count.end() == count ? 0 : count->second;
+
+        if (NULL == idlest || running < idlest_count) {
+            idlest = *it;
+            idlest_count = running;
+        }
+    }
+
+    return NULL == idlest ? longlink_ : idlest;
+}
+
+bool LongLinkTaskManager::__MakeSureConnected(LongLink& _longlink) {
+    if (&_longlink == longlink_) return longlinkconnectmon_->MakeSureConnected();
+    return _longlink.MakeSureConnected();
+}
+
+void LongLinkTaskManager::__Disconnect(LongLink* _longlink, LongLink::TDisconnectInternalCode _scene) {
+    if (NULL != _longlink) {
+        _longlink->Disconnect(_scene);
+        return;
+    }
+
+    longlink_->Disconnect(_scene);
+    for (std::vector<LongLink*>::iterator it = bulk_longlinks_.begin(); it != bulk_longlinks_.end(); ++it) {
+        (*it)->Disconnect(_scene);
+    }
+}
+
+void LongLinkTaskManager::__Observe(LongLink& _longlink) {
+    _longlink.OnSend = boost::bind(&LongLinkTaskManager::__OnSend, this, _1);
+    _longlink.OnRecv = boost::bind(&LongLinkTaskManager::__OnRecv, this, _1, _2, _3);
+    _longlink.OnResponse = boost::bind(&LongLinkTaskManager::__OnResponse, this, &_longlink, _1, _2, _3, _4, _5, _6, _7);
+    _longlink.SignalConnection.connect(boost::bind(&LongLinkTaskManager::__SignalConnection, this, _1));
+}
+
+bool LongLinkTaskManager::__AntiAvalancheCheck(std::list<TaskProfile>::iterator _it, const AutoBuffer& _bufreq, const ConnectProfile& _connect_profile) {
+    xassert2(fun_anti_avalanche_check_);
+
+    // over the flow quota, it waits for the tokens if they come before the task times out
+    uint64_t curtime = ::gettickcount();
+    uint64_t deadline = _it->start_task_time + _it->task_timeout;
+    uint64_t defer = 0;
+    if (fun_anti_avalanche_check_(_it->task, _bufreq.Ptr(), (int)_bufreq.Length(), _it->flow_deferred, deadline > curtime ? deadline - curtime : 0, defer)) {
+        _it->flow_deferred = false;
+        return true;
+    }
+
+    if (0 < defer) {
+        xwarn2(TSF"task deferred by flow limit, taskid:%_, cmdid:%_, cgi:%_, defer:%_", _it->task.taskid, _it->task.cmdid, _it->task.cgi, defer);
+        _it->flow_deferred = true;
+        _it->retry_start_time = curtime;
+        _it->retry_time_interval = defer;
+        return false;
+    }
+
+    __SingleRespHandle(_it, kEctLocal, kEctLocalAntiAvalanche, kTaskFailHandleTaskEnd, _connect_profile);
+    return false;
+}
+
 bool LongLinkTaskManager::__SingleRespHandle(std::list<TaskProfile>::iterator _it, ErrCmdType _err_type, int _err_code, int _fail_handle, const ConnectProfile& _connect_profile) {
     xverbose_function();
     xassert2(kEctServer != _err_type);
@@ -451,7 +620,7 @@ bool LongLinkTaskManager::__SingleRespHandle(std::list<TaskProfile>::iterator _i
     return false;
 }
 
-void LongLinkTaskManager::__BatchErrorRespHandle(ErrCmdType _err_type, int _err_code, int _fail_handle, uint32_t _src_taskid, const ConnectProfile& _connect_profile, bool _callback_runing_task_only) {
+void LongLinkTaskManager::__BatchErrorRespHandle(LongLink* _longlink, ErrCmdType _err_type, int _err_code, int _fail_handle, uint32_t _src_taskid, const ConnectProfile& _connect_profile, bool _callback_runing_task_only) {
     xassert2(kEctOK != _err_type);
     xassert2(kTaskFailHandleTaskTimeout != _fail_handle);
 
@@ -462,7 +631,7 @@ void LongLinkTaskManager::__BatchErrorRespHandle(ErrCmdType _err_type, int _err_
         std::list<TaskProfile>::iterator next = first;
         ++next;
 
-        if (_callback_runing_task_only && !first->running_id) {
+        if (_callback_runing_task_only && (!first->running_id || (NULL != _longlink && (intptr_t)_longlink != first->running_id))) {
             first = next;
             continue;
         }
@@ -482,20 +651,20 @@ void LongLinkTaskManager::__BatchErrorRespHandle(ErrCmdType _err_type, int _err_
     }
     
     if (kTaskFailHandleSessionTimeout == _fail_handle || kTaskFailHandleRetryAllTasks == _fail_handle) {
-        longlink_->Disconnect(LongLink::kDecodeErr);
+        __Disconnect(_longlink, LongLink::kDecodeErr);
         MessageQueue::CancelMessage(asyncreg_.Get(), 0);
         retry_interval_ = 0;
     }
     
     if (kTaskFailHandleDefault == _fail_handle) {
         if (kEctDns != _err_type && kEctSocket != _err_type) {  // not longlink callback
-            longlink_->Disconnect(LongLink::kDecodeErr);
+            __Disconnect(_longlink, LongLink::kDecodeErr);
         }
         MessageQueue::CancelMessage(asyncreg_.Get(), 0);
     }
     
     if (kEctNetMsgXP == _err_type) {
-        longlink_->Disconnect(LongLink::kTaskTimeout);
+        __Disconnect(_longlink, LongLink::kTaskTimeout);
         MessageQueue::CancelMessage(asyncreg_.Get(), 0);
     }
 }
@@ -518,10 +687,10 @@ std::list<TaskProfile>::iterator LongLinkTaskManager::__Locate(uint32_t _taskid)
     return it;
 }
 
-void LongLinkTaskManager::__OnResponse(ErrCmdType _error_type, int _error_code, uint32_t _cmdid, uint32_t _taskid, AutoBuffer& _body, AutoBuffer& _extension, const ConnectProfile& _connect_profile) {
+void LongLinkTaskManager::__OnResponse(LongLink* _longlink, ErrCmdType _error_type, int _error_code, uint32_t _cmdid, uint32_t _taskid, AutoBuffer& _body, AutoBuffer& _extension, const ConnectProfile& _connect_profile) {
     move_wrapper<AutoBuffer> body(_body);
     move_wrapper<AutoBuffer> extension(_extension);
-    RETURN_LONKLINK_SYNC2ASYNC_FUNC(boost::bind(&LongLinkTaskManager::__OnResponse, this, _error_type, _error_code, _cmdid, _taskid, body, extension, _connect_profile));
+    RETURN_LONKLINK_SYNC2ASYNC_FUNC(boost::bind(&LongLinkTaskManager::__OnResponse, this, _longlink, _error_type, _error_code, _cmdid, _taskid, body, extension, _connect_profile));
     // svr push notify
     
     if (kEctOK == _error_type && ::longlink_ispush(_cmdid, _taskid, body, extension))  {
@@ -536,7 +705,7 @@ void LongLinkTaskManager::__OnResponse(ErrCmdType _error_type, int _error_code,
     
     if (kEctOK != _error_type) {
         xwarn2(TSF"task error, taskid:%_, cmdid:%_, error_type:%_, error_code:%_", _taskid, _cmdid, _error_type, _error_code);
-        __BatchErrorRespHandle(_error_type, _error_code, kTaskFailHandleDefault, 0, _connect_profile);
+        __BatchErrorRespHandle(_longlink, _error_type, _error_code, kTaskFailHandleDefault, 0, _connect_profile);
         return;
     }
     
@@ -548,9 +717,12 @@ void LongLinkTaskManager::__OnResponse(ErrCmdType _error_type, int _error_code,
         return;
     }
     
-    it->transfer_profile.received_size = body->Length();
-    it->transfer_profile.receive_data_size = body->Length();
+    if (!it->task.stream_response) {  // a streamed body is not here, keep the frame sizes __OnRecv saw
+        it->transfer_profile.received_size = body->Length();
+        it->transfer_profile.receive_data_size = body->Length();
+    }
     it->transfer_profile.last_receive_pkg_time = ::gettickcount();
+    if (0 == it->transfer_profile.first_receive_pkg_time) it->transfer_profile.first_receive_pkg_time = it->transfer_profile.last_receive_pkg_time;
     
     int err_code = 0;
     int handle_type = Buf2Resp(it->task.taskid, it->task.user_context, body, extension, err_code, Task::kChannelLong);
@@ -558,7 +730,8 @@ void LongLinkTaskManager::__OnResponse(ErrCmdType _error_type, int _error_code,
     switch(handle_type){
         case kTaskFailHandleNoError:
         {
-            dynamic_timeout_.CgiTaskStatistic(it->task.cgi, (unsigned int)it->transfer_profile.send_data_size + (unsigned int)body->Length(), ::gettickcount() - it->transfer_profile.start_send_time);
+            dynamic_timeout_.CgiTaskStatistic(it->task.cgi, (unsigned int)it->transfer_profile.send_data_size + (unsigned int)it->transfer_profile.receive_data_size, ::gettickcount() - it->transfer_profile.start_send_time);
+            dynamic_timeout_.CgiLatencyStatistic(it->task.cgi, it->transfer_profile.first_receive_pkg_time - it->transfer_profile.start_send_time, ::gettickcount() - it->transfer_profile.start_send_time);
             __SingleRespHandle(it, kEctOK, err_code, handle_type, _connect_profile);
             xassert2(fun_notify_network_err_);
             fun_notify_network_err_(__LINE__, kEctOK, err_code, _connect_profile.ip, _connect_profile.port);
@@ -587,7 +760,7 @@ void LongLinkTaskManager::__OnResponse(ErrCmdType _error_type, int _error_code,
         case kTaskFailHandleDefault:
         {
             xerror2(TSF"task decode error taskid:%_, handle_type:%_, err_code:%_, body dump:%_", it->task.taskid, handle_type, err_code, xdump(body->Ptr(), body->Length()));
-            __BatchErrorRespHandle(kEctEnDecode, err_code, handle_type, it->task.taskid, _connect_profile);
+            __BatchErrorRespHandle(_longlink, kEctEnDecode, err_code, handle_type, it->task.taskid, _connect_profile);
             xassert2(fun_notify_network_err_);
             fun_notify_network_err_(__LINE__, kEctEnDecode, err_code, _connect_profile.ip, _connect_profile.port);
         }
@@ -595,7 +768,7 @@ void LongLinkTaskManager::__OnResponse(ErrCmdType _error_type, int _error_code,
         default:
         {
 			xassert2(false, TSF"task decode error fail_handle:%_, taskid:%_", handle_type, it->task.taskid);
-			__BatchErrorRespHandle(kEctEnDecode, err_code, handle_type, it->task.taskid, _connect_profile);
+			__BatchErrorRespHandle(_longlink, kEctEnDecode, err_code, handle_type, it->task.taskid, _connect_profile);
 			xassert2(fun_notify_network_err_);
 			fun_notify_network_err_(__LINE__, kEctEnDecode, handle_type, _connect_profile.ip, _connect_profile.port);
 			break;
@@ -631,6 +804,7 @@ void LongLinkTaskManager::__OnRecv(uint32_t _taskid, size_t _cachedsize, size_t
         it->transfer_profile.received_size = _cachedsize;
         it->transfer_profile.receive_data_size = _totalsize;
         it->transfer_profile.last_receive_pkg_time = ::gettickcount();
+        if (0 == it->transfer_profile.first_receive_pkg_time) it->transfer_profile.first_receive_pkg_time = it->transfer_profile.last_receive_pkg_time;
         xdebug2(TSF"taskid:%_, cachedsize:%_, _totalsize:%_", it->task.taskid, _cachedsize, _totalsize);
     } else {
         xwarn2(TSF"not found taskid:%_ cachedsize:%_, _totalsize:%_", _taskid, _cachedsize, _totalsize);
@@ -638,7 +812,7 @@ void LongLinkTaskManager::__OnRecv(uint32_t _taskid, size_t _cachedsize, size_t
 }
 
 void LongLinkTaskManager::__SignalConnection(LongLink::TLongLinkStatus _connect_status) {
-	if (LongLink::kConnected == _connect_status)
+	if (LongLink::kConnected == _connect_status || LongLink::kConnecting == _connect_status)  // kConnecting: for a resuming longlink
         __RunLoop();
 }
 
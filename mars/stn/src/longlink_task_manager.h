@@ -22,6 +22,8 @@
 #define STN_SRC_LONGLINK_TASK_MANAGER_H_
 
 #include <list>
+#include <map>
+#include <vector>
 #include <stdint.h>
 
 #include "boost/function.hpp"
@@ -49,13 +51,26 @@ struct TaskProfile;
 class DynamicTimeout;
 class LongLinkConnectMonitor;
 
+/*
+ * the tasks run on a pool of longlinks. the first one is the longlink everybody else knows
+ * (noop, signalling, identify, push, connect monitor) and carries the interactive tasks,
+ * the others are connected on demand and carry the bulk ones, so a big sync does not
+ * hold up the small cgis behind it on the same tcp connection.
+ * a pool of 1 (the default) is the single longlink it has always been.
+ */
 class LongLinkTaskManager {
+  public:
+    // _pool_size: longlinks in the pool, 1 turns it off
+    // _bulk_send_size: requests at least this big go to the bulk longlinks, as do tasks less urgent than kTaskPriorityNormal
+    // _spread_ips: the n-th longlink starts connecting from the n-th ip of GetLongLinkItems
+    static void SetPoolStrategy(unsigned int _pool_size, size_t _bulk_send_size, bool _spread_ips);
+
   public:
     boost::function<int (ErrCmdType _err_type, int _err_code, int _fail_handle, const Task& _task, unsigned int _taskcosttime)> fun_callback_;
 
     boost::function<void (ErrCmdType _err_type, int _err_code, int _fail_handle, uint32_t _src_taskid)> fun_notify_retry_all_tasks;
     boost::function<void (int _line, ErrCmdType _err_type, int _err_code, const std::string& _ip, uint16_t _port)> fun_notify_network_err_;
-    boost::function<bool (const Task& _task, const void* _buffer, int _len)> fun_anti_avalanche_check_;
+    boost::function<bool (const Task& _task, const void* _buffer, int _len, bool _deferred, uint64_t _max_defer, uint64_t& _defer)> fun_anti_avalanche_check_;
     
     boost::function<void (uint64_t _channel_id, uint32_t _cmdid, uint32_t _taskid, const AutoBuffer& _body, const AutoBuffer& _extend)> fun_on_push_;
     
@@ -70,6 +85,8 @@ class LongLinkTaskManager {
     void ClearTasks();
     void RedoTasks();
     void RetryTasks(ErrCmdType _err_type, int _err_code, int _fail_handle, uint32_t _src_taskid);
+    void Disconnect(LongLink::TDisconnectInternalCode _scene);
+    void OnNetworkChange();
 
     LongLink& LongLinkChannel() { return *longlink_; }
     LongLinkConnectMonitor& getLongLinkConnectMonitor() { return *longlinkconnectmon_; }
@@ -79,16 +96,24 @@ class LongLinkTaskManager {
 
   private:
     // from ILongLinkObserver
-    void __OnResponse(ErrCmdType _error_type, int _error_code, uint32_t _cmdid, uint32_t _taskid, AutoBuffer& _body, AutoBuffer& _extension, const ConnectProfile& _connect_profile);
+    void __OnResponse(LongLink* _longlink, ErrCmdType _error_type, int _error_code, uint32_t _cmdid, uint32_t _taskid, AutoBuffer& _body, AutoBuffer& _extension, const ConnectProfile& _connect_profile);
     void __OnSend(uint32_t _taskid);
     void __OnRecv(uint32_t _taskid, size_t _cachedsize, size_t _totalsize);
     void __SignalConnection(LongLink::TLongLinkStatus _connect_status);
 
+    void __Observe(LongLink& _longlink);
+    LongLink& __LinkOf(const TaskProfile& _task_profile);
+    LongLink* __SelectLink(const TaskProfile& _task_profile, size_t _send_size, const std::map<intptr_t, int>& _running_count);
+    bool __MakeSureConnected(LongLink& _longlink);
+    void __Disconnect(LongLink* _longlink, LongLink::TDisconnectInternalCode _scene);
+
     void __RunLoop();
     void __RunOnTimeout();
     void __RunOnStartTask();
+    bool __AntiAvalancheCheck(std::list<TaskProfile>::iterator _it, const AutoBuffer& _bufreq, const ConnectProfile& _connect_profile);
 
-    void __BatchErrorRespHandle(ErrCmdType _err_type, int _err_code, int _fail_handle, uint32_t _src_taskid, const ConnectProfile& _connect_profile, bool _callback_runing_task_only = true);
+    // _longlink: only the tasks running on it and only it is disconnected, NULL for all of them
+    void __BatchErrorRespHandle(LongLink* _longlink, ErrCmdType _err_type, int _err_code, int _fail_handle, uint32_t _src_taskid, const ConnectProfile& _connect_profile, bool _callback_runing_task_only = true);
     bool __SingleRespHandle(std::list<TaskProfile>::iterator _it, ErrCmdType _err_type, int _err_code, int _fail_handle, const ConnectProfile& _connect_profile);
 
     std::list<TaskProfile>::iterator __Locate(uint32_t  _taskid);
@@ -100,7 +125,9 @@ class LongLinkTaskManager {
     unsigned long                   retry_interval_;	//ms
     unsigned int                    tasks_continuous_fail_count_;
 
+    NetSource&                      netsource_;
     LongLink*                       longlink_;
+    std::vector<LongLink*>          bulk_longlinks_;
     LongLinkConnectMonitor*         longlinkconnectmon_;
     DynamicTimeout&                 dynamic_timeout_;
 
@@ -28,6 +28,7 @@
 
 #include "mars/comm/messagequeue/message_queue.h"
 #include "mars/comm/network/netinfo_util.h"
+#include "mars/comm/network/netstate_cache.h"
 #include "mars/comm/socket/local_ipstack.h"
 #include "mars/comm/xlogger/xlogger.h"
 #include "mars/comm/singleton.h"
@@ -122,34 +123,35 @@ NetCore::NetCore()
     xassert2(messagequeue_creater_.GetMessageQueue() != MessageQueue::KInvalidQueueID, "CreateNewMessageQueue Error!!!");
     xinfo2(TSF"netcore messagequeue_id=%_, handler:(%_,%_)", messagequeue_creater_.GetMessageQueue(), asyncreg_.Get().queue, asyncreg_.Get().seq);
 
-    std::string printinfo;
+    {
+        //note: iOS getwifiinfo may block for 10+ seconds sometimes
+        //the sim and account info only go to the log, they don't hold up the creation either
+        ASYNC_BLOCK_START
 
-    SIMInfo info;
-    getCurSIMInfo(info);
-    printinfo = printinfo + "ISP_NAME : " + info.isp_name + "\n";
-    printinfo = printinfo + "ISP_CODE : " + info.isp_code + "\n";
+        std::string printinfo;
 
-    AccountInfo account = ::GetAccountInfo();
+        SIMInfo info;
+        getCurSIMInfo(info);
+        printinfo = printinfo + "ISP_NAME : " + info.isp_name + "\n";
+        printinfo = printinfo + "ISP_CODE : " + info.isp_code + "\n";
 
-    if (0 != account.uin) {
-        char uinBuffer[64] = {0};
-        snprintf(uinBuffer, sizeof(uinBuffer), "%u", (unsigned int)account.uin);
-        printinfo = printinfo + "Uin :" + uinBuffer  + "\n";
-    }
+        AccountInfo account = ::GetAccountInfo();
 
-    if (!account.username.empty()) {
-        printinfo = printinfo + "UserName :" + account.username + "\n";
-    }
+        if (0 != account.uin) {
+            char uinBuffer[64] = {0};
+            snprintf(uinBuffer, sizeof(uinBuffer), "%u", (unsigned int)account.uin);
+            printinfo = printinfo + "Uin :" + uinBuffer  + "\n";
+        }
 
-    char version[256] = {0};
-    snprintf(version, sizeof(version), "0x%X", mars::app::GetClientVersion());
-    printinfo = printinfo + "ClientVersion :" + version + "\n";
+        if (!account.username.empty()) {
+            printinfo = printinfo + "UserName :" + account.username + "\n";
+        }
 
-    xwarn2(TSF"\n%0", printinfo.c_str());
+        char version[256] = {0};
+        snprintf(version, sizeof(version), "0x%X", mars::app::GetClientVersion());
+        printinfo = printinfo + "ClientVersion :" + version + "\n";
 
-    {
-        //note: iOS getwifiinfo may block for 10+ seconds sometimes
-        ASYNC_BLOCK_START
+        xwarn2(TSF"\n%0", printinfo.c_str());
 
         xinfo2(TSF"net info:%_", GetDetailNetInfo());
         
@@ -171,7 +173,7 @@ NetCore::NetCore()
     // sync
     longlink_task_manager_->fun_notify_retry_all_tasks = boost::bind(&NetCore::RetryTasks, this, _1, _2, _3, _4);
     longlink_task_manager_->fun_notify_network_err_ = boost::bind(&NetCore::__OnLongLinkNetworkError, this, _1, _2, _3, _4, _5);
-    longlink_task_manager_->fun_anti_avalanche_check_ = boost::bind(&AntiAvalanche::Check, anti_avalanche_, _1, _2, _3);
+    longlink_task_manager_->fun_anti_avalanche_check_ = boost::bind(&AntiAvalanche::Check, anti_avalanche_, _1, _2, _3, (int)Task::kChannelLong, _4, _5, _6);
     longlink_task_manager_->LongLinkChannel().fun_network_report_ = boost::bind(&NetCore::__OnLongLinkNetworkError, this, _1, _2, _3, _4, _5);
 
     longlink_task_manager_->LongLinkChannel().SignalConnection.connect(boost::bind(&TimingSync::OnLongLinkStatuChanged, timing_sync_, _1));
@@ -192,7 +194,7 @@ NetCore::NetCore()
     // sync
     shortlink_task_manager_->fun_notify_retry_all_tasks = boost::bind(&NetCore::RetryTasks, this, _1, _2, _3, _4);
     shortlink_task_manager_->fun_notify_network_err_ = boost::bind(&NetCore::__OnShortLinkNetworkError, this, _1, _2, _3, _4, _5, _6);
-    shortlink_task_manager_->fun_anti_avalanche_check_ = boost::bind(&AntiAvalanche::Check, anti_avalanche_, _1, _2, _3);
+    shortlink_task_manager_->fun_anti_avalanche_check_ = boost::bind(&AntiAvalanche::Check, anti_avalanche_, _1, _2, _3, (int)Task::kChannelShort, _4, _5, _6);
     shortlink_task_manager_->fun_shortlink_response_ = boost::bind(&NetCore::__OnShortLinkResponse, this, _1);
 
         
@@ -370,6 +372,10 @@ bool NetCore::HasTask(uint32_t _taskid) const {
 	return false;
 }
 
+void NetCore::GetCgiLatencies(std::vector<CgiLatencyProfile>& _latencies) const {
+    dynamic_timeout_->GetCgiLatencies(_latencies);  // locks itself, no need to go to the net thread
+}
+
 void NetCore::ClearTasks() {
     ASYNC_BLOCK_START
     
@@ -388,6 +394,8 @@ void NetCore::OnNetworkChange() {
 
     xinfo_function();
 
+    NetStateCache::Instance().Invalidate("OnNetworkChange");
+
     std::string ip_stack_log;
     TLocalIPStack ip_stack = local_ipstack_detect_log(ip_stack_log);
 
@@ -430,8 +438,7 @@ void NetCore::OnNetworkChange() {
     dynamic_timeout_->ResetStatus();
 #ifdef USE_LONG_LINK
     timing_sync_->OnNetworkChange();
-    if (longlink_task_manager_->getLongLinkConnectMonitor().NetworkChange())
-        longlink_task_manager_->RedoTasks();
+    longlink_task_manager_->OnNetworkChange();
     zombie_task_manager_->RedoTasks();
 #endif
     
@@ -461,7 +468,7 @@ LongLink& NetCore::Longlink() { return longlink_task_manager_->LongLinkChannel()
 void NetCore::__ResetLongLink() {
     SYNC2ASYNC_FUNC(boost::bind(&NetCore::__ResetLongLink, this));
 
-    longlink_task_manager_->LongLinkChannel().Disconnect(LongLink::kNetworkChange);
+    longlink_task_manager_->Disconnect(LongLink::kNetworkChange);
     longlink_task_manager_->RedoTasks();
     
 }
@@ -480,7 +487,7 @@ void NetCore::RedoTasks() {
     net_source_->ClearCache();
 
 #ifdef USE_LONG_LINK
-    longlink_task_manager_->LongLinkChannel().Disconnect(LongLink::kReset);
+    longlink_task_manager_->Disconnect(LongLink::kReset);
     longlink_task_manager_->LongLinkChannel().MakeSureConnected();
     longlink_task_manager_->RedoTasks();
     zombie_task_manager_->RedoTasks();
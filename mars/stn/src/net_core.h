@@ -75,6 +75,7 @@ class NetCore {
     void    StartTask(const Task& _task);
     void    StopTask(uint32_t _taskid);
     bool    HasTask(uint32_t _taskid) const;
+    void    GetCgiLatencies(std::vector<CgiLatencyProfile>& _latencies) const;
     void    ClearTasks();
     void    RedoTasks();
     void    RetryTasks(ErrCmdType _err_type, int _err_code, int _fail_handle, uint32_t _src_taskid);
@@ -486,11 +486,23 @@ void NetSource::ReportShortIP(bool _is_success, const std::string& _ip, const st
     ipportstrategy_.Update(_ip, _port, _is_success);
 }
 
+void NetSource::ReportConnect(bool _is_success, const std::string& _ip, uint16_t _port, int _rtt) {
+    if (_ip.empty() || 0 == _port) return;
+
+    if (kNoNet == getNetInfo()) return;
+
+    ipportstrategy_.UpdateConnect(_ip, _port, _is_success, _rtt);
+}
+
 void NetSource::ClearCache() {
     xinfo_function();
     ipportstrategy_.InitHistory2BannedList(true);
 }
 
+void NetSource::PrefetchRecords() {
+    ipportstrategy_.Load();
+}
+
 std::string NetSource::DumpTable(const std::vector<IPPortItem>& _ipport_items) {
     XMessage stream;
 
@@ -102,9 +102,13 @@ class NetSource {
     void AddServerBan(const std::string& _ip);
     
     void ClearCache();
+    // the ip records are read at the first connect otherwise
+    void PrefetchRecords();
 
     void ReportLongIP(bool _is_success, const std::string& _ip, uint16_t _port);
     void ReportShortIP(bool _is_success, const std::string& _ip, const std::string& _host, uint16_t _port);
+    // every connect attempt of a longlink or shortlink, _rtt in ms
+    void ReportConnect(bool _is_success, const std::string& _ip, uint16_t _port, int _rtt);
 
     void RemoveLongBanIP(const std::string& _ip);
 
@@ -20,12 +20,14 @@
 
 #include "proxy_test.h"
 
+#include "boost/bind.hpp"
+
 #include "mars/comm/comm_data.h"
 #include "mars/comm/socket/complexconnect.h"
 
 #include "mars/comm/socket/socket_address.h"
 #include "mars/comm/socket/local_ipstack.h"
-#include "mars/comm/socket/block_socket.h"
+#include "mars/comm/coroutine/coro_io.h"
 #include "mars/comm/xlogger/xlogger.h"
 
 #include "mars/comm/platform_comm.h"
@@ -57,6 +59,14 @@ bool ProxyTest::ProxyIsAvailable(const mars::comm::ProxyInfo _proxy_info, const
         return false;
     }
     
+#ifdef MARS_CORO_IO
+    // probe on the shared poller instead of blocking this thread in its own select loop
+    if (!coroutine::isCoroutine()) {
+        return coroutine::WaitInvoke(boost::bind(&ProxyTest::ProxyIsAvailable, this, _proxy_info, _host, _hardcode_ips),
+                                     MessageQueue::DefAsyncInvokeHandler(coroutine::SharedIOQueue()));
+    }
+#endif
+
     SOCKET sock = __Connect(_proxy_info, _host, _hardcode_ips);
     if (INVALID_SOCKET == sock) {
         return false;
@@ -81,7 +91,10 @@ SOCKET ProxyTest::__Connect(const mars::comm::ProxyInfo& _proxy_info, const std:
             proxy_ip = _proxy_info.ip;
         } else {
             std::vector<std::string> proxy_ips;
-            if (!dns_util_.GetDNS().GetHostByName(_proxy_info.host, proxy_ips) || proxy_ips.empty()) {
+            bool dns_ret = coroutine::BlockingInvoke([&dns_util_, &_proxy_info, &proxy_ips]() {
+                return dns_util_.GetDNS().GetHostByName(_proxy_info.host, proxy_ips);
+            });
+            if (!dns_ret || proxy_ips.empty()) {
                 xwarn2(TSF"dns proxy host error, host:%_", _proxy_info.host);
                 return INVALID_SOCKET;
             }
@@ -96,7 +109,10 @@ SOCKET ProxyTest::__Connect(const mars::comm::ProxyInfo& _proxy_info, const std:
         vecaddr.push_back(socket_address(proxy_ip.c_str(), _proxy_info.port).v4tov6_address(isnat64));
     } else {
         std::vector<std::string> test_ips;
-        if (!dns_util_.GetDNS().GetHostByName(_host, test_ips) || test_ips.empty()) {
+        bool dns_ret = coroutine::BlockingInvoke([&dns_util_, &_host, &test_ips]() {
+            return dns_util_.GetDNS().GetHostByName(_host, test_ips);
+        });
+        if (!dns_ret || test_ips.empty()) {
             xwarn2(TSF"dns test_host error, host:%_", _host);
             if (_hardcode_ips.empty()) {
                 return INVALID_SOCKET;
@@ -125,7 +141,7 @@ SOCKET ProxyTest::__Connect(const mars::comm::ProxyInfo& _proxy_info, const std:
         proxy_addr = &((new socket_address(proxy_ip.c_str(), _proxy_info.port))->v4tov6_address(isnat64));
     }
     
-    ComplexConnect com_connect(kLonglinkConnTimeout, kLonglinkConnInteral, kLonglinkConnInteral, kLonglinkConnMax);
+    coroutine::AutoComplexConnect com_connect(kLonglinkConnTimeout, kLonglinkConnInteral, kLonglinkConnInteral, kLonglinkConnMax);
     
     SOCKET sock = com_connect.ConnectImpatient(vecaddr, testproxybreak_, NULL, _proxy_info.type, proxy_addr, _proxy_info.username, _proxy_info.password);
     delete proxy_addr;
@@ -203,7 +219,7 @@ int ProxyTest::__ReadWrite(SOCKET _sock, const mars::comm::ProxyInfo& _proxy_inf
     req_builder.HeaderToBuffer(out_buff);
     
     int err_code = 0;
-    int send_ret = block_socket_send(_sock, (const unsigned char*)out_buff.Ptr(), (unsigned int)out_buff.Length(), testproxybreak_, err_code);
+    int send_ret = coroutine::auto_socket_send(_sock, (const unsigned char*)out_buff.Ptr(), (unsigned int)out_buff.Length(), testproxybreak_, err_code);
     
     if (send_ret < 0) {
         xerror2(TSF"test proxy Error, ret:%0, errno:%1, nread:%_, nwrite:%_", send_ret, strerror(err_code), socket_nread(_sock), socket_nwrite(_sock));
@@ -224,7 +240,7 @@ int ProxyTest::__ReadWrite(SOCKET _sock, const mars::comm::ProxyInfo& _proxy_inf
     int status_code = 0;
     
     while (true) {
-        int recv_ret = block_socket_recv(_sock, recv_buf, BUFFER_SIZE, testproxybreak_, err_code, 5000);
+        int recv_ret = coroutine::auto_socket_recv(_sock, recv_buf, BUFFER_SIZE, testproxybreak_, err_code, 5000);
         
         if (recv_ret < 0) {
             xerror2(TSF"read block socket return false, error:%0, nread:%_, nwrite:%_", strerror(err_code), socket_nread(_sock), socket_nwrite(_sock));
@@ -27,7 +27,7 @@
 #include "mars/comm/socket/unix_socket.h"
 #include "mars/comm/socket/socket_address.h"
 #include "mars/comm/socket/local_ipstack.h"
-#include "mars/comm/socket/block_socket.h"
+#include "mars/comm/coroutine/coro_io.h"
 #include "mars/comm/strutil.h"
 #include "mars/comm/time_utils.h"
 #include "mars/comm/http.h"
@@ -59,7 +59,7 @@ namespace stn{
 
 class ShortLinkConnectObserver : public MComplexConnect {
   public:
-    ShortLinkConnectObserver(ShortLink& _shortlink): shortlink_(_shortlink), rtt_(0), last_err_(-1) {
+    ShortLinkConnectObserver(ShortLink& _shortlink, NetSource& _netsource): shortlink_(_shortlink), netsource_(_netsource), rtt_(0), last_err_(-1) {
         memset(ConnectingIndex, 0, sizeof(ConnectingIndex));
     };
 
@@ -70,6 +70,9 @@ class ShortLinkConnectObserver : public MComplexConnect {
     virtual void OnConnected(unsigned int _index, const socket_address& _addr, SOCKET _socket, int _error, int _rtt) {
         ConnectingIndex[_index] = 0;
 
+        if (_index < shortlink_.Profile().ip_items.size())
+            netsource_.ReportConnect(0 == _error, shortlink_.Profile().ip_items[_index].str_ip, shortlink_.Profile().ip_items[_index].port, _rtt);
+
         if (0 != _error) {
 //            xassert2(shortlink_.func_network_report);
 
@@ -94,10 +97,46 @@ class ShortLinkConnectObserver : public MComplexConnect {
 
   private:
     ShortLink& shortlink_;
+    NetSource& netsource_;
     int rtt_;
     int last_err_;
 };
 
+// a streamed body goes to OnResponseChunk as the parser cuts it out, none of it is kept.
+// only a 200 body is the response, the body of an error status is counted and dropped
+class ChunkBodyReceiver : public BodyReceiver {
+  public:
+    explicit ChunkBodyReceiver(uint32_t _taskid): taskid_(_taskid), parser_(NULL), started_(false) {}
+
+    // the parser it receives for, it tells the status
+    void Attach(const http::Parser* _parser) { parser_ = _parser; }
+
+    virtual void AppendData(const void* _body, size_t _length) {
+        BodyReceiver::AppendData(_body, _length);
+        if (!__Start()) return;
+        OnResponseChunk(taskid_, _body, _length);
+    }
+
+    virtual void EndData() {
+        __Start();  // an empty body still drops what a failed try delivered
+    }
+
+  private:
+    bool __Start() {
+        if (NULL == parser_ || 200 != parser_->Status().StatusCode()) return false;
+        if (!started_) {
+            started_ = true;
+            OnResponseChunk(taskid_, NULL, 0);
+        }
+        return true;
+    }
+
+  private:
+    uint32_t taskid_;
+    const http::Parser* parser_;
+    bool started_;
+};
+
 }}
 ///////////////////////////////////////////////////////////////////////////////////////
 
@@ -111,6 +150,7 @@ ShortLink::ShortLink(MessageQueue::MessageQueue_t _messagequeueid, NetSource& _n
     {
     xinfo2(TSF"%_, handler:(%_,%_)",XTHIS, asyncreg_.Get().queue, asyncreg_.Get().seq);
     xassert2(breaker_.IsCreateSuc(), "Create Breaker Fail!!!");
+    thread_.pooled(true);
 }
 
 ShortLink::~ShortLink() {
@@ -124,7 +164,12 @@ void ShortLink::SendRequest(AutoBuffer& _buf_req, AutoBuffer& _buffer_extend) {
     xdebug2(XTHIS)(TSF"bufReq.size:%_", _buf_req.Length());
     send_body_.Attach(_buf_req);
     send_extend_.Attach(_buffer_extend);
+#ifdef MARS_CORO_IO
+    coro_.reset(new coroutine::Coroutine(boost::bind(&ShortLink::__Run, this), MessageQueue::DefAsyncInvokeHandler(coroutine::SharedIOQueue())));
+    coro_->Start();
+#else
     thread_.start();
+#endif
 }
 
 void ShortLink::__Run() {
@@ -184,7 +229,10 @@ SOCKET ShortLink::__RunConnect(ConnectProfile& _conn_profile) {
         if (!outter_vec_addr_.empty()) {
             _conn_profile.ip_items = outter_vec_addr_;
         } else {
-            net_source_.GetShortLinkItems(task_.shortlink_host_list, _conn_profile.ip_items, dns_util_);
+            std::vector<IPPortItem>& ip_items = _conn_profile.ip_items;
+            coroutine::BlockingInvoke([this, &ip_items]() {
+                return net_source_.GetShortLinkItems(task_.shortlink_host_list, ip_items, dns_util_);
+            });
         }
         
         if (!_conn_profile.ip_items.empty()) {
@@ -200,7 +248,11 @@ SOCKET ShortLink::__RunConnect(ConnectProfile& _conn_profile) {
     if (use_proxy && mars::comm::kProxyNone != _conn_profile.proxy_info.type) {
 		std::vector<std::string> proxy_ips;
         if (_conn_profile.proxy_info.ip.empty() && !_conn_profile.proxy_info.host.empty()) {
-            if (!dns_util_.GetDNS().GetHostByName(_conn_profile.proxy_info.host, proxy_ips) || proxy_ips.empty()) {
+            const std::string& proxy_host = _conn_profile.proxy_info.host;
+            bool dns_ret = coroutine::BlockingInvoke([this, &proxy_host, &proxy_ips]() {
+                return dns_util_.GetDNS().GetHostByName(proxy_host, proxy_ips);
+            });
+            if (!dns_ret || proxy_ips.empty()) {
                 xwarn2(TSF"dns %_ error", _conn_profile.proxy_info.host);
                 return INVALID_SOCKET;
             }
@@ -248,8 +300,8 @@ SOCKET ShortLink::__RunConnect(ConnectProfile& _conn_profile) {
 
     // set the first ip info to the profiler, after connect, the ip info will be overwrriten by the real one
 
-    ShortLinkConnectObserver connect_observer(*this);
-	ComplexConnect conn(kShortlinkConnTimeout, kShortlinkConnInterval);
+    ShortLinkConnectObserver connect_observer(*this, net_source_);
+	coroutine::AutoComplexConnect conn(kShortlinkConnTimeout, kShortlinkConnInterval);
     
     SOCKET sock = conn.ConnectImpatient(vecaddr, breaker_, &connect_observer, _conn_profile.proxy_info.type, proxy_addr, _conn_profile.proxy_info.username, _conn_profile.proxy_info.password);
     delete proxy_addr;
@@ -282,6 +334,8 @@ SOCKET ShortLink::__RunConnect(ConnectProfile& _conn_profile) {
     for (int i = 0; i < conn.Index(); ++i) {
         if (1 == connect_observer.ConnectingIndex[i] && func_network_report)
             func_network_report(__LINE__, kEctSocket, SOCKET_ERRNO(ETIMEDOUT), _conn_profile.ip_items[i].str_ip, _conn_profile.ip_items[i].str_host, _conn_profile.ip_items[i].port);
+        if (1 == connect_observer.ConnectingIndex[i])
+            net_source_.ReportConnect(false, _conn_profile.ip_items[i].str_ip, _conn_profile.ip_items[i].port, -1);
     }
 
     _conn_profile.host = _conn_profile.ip_items[conn.Index()].str_host;
@@ -355,7 +409,7 @@ void ShortLink::__RunReadWrite(SOCKET _socket, int& _err_type, int& _err_code, C
 	xgroup2_define(group_send);
 	xinfo2(TSF"task socket send sock:%_, %_ http len:%_, ", _socket, message.String(), out_buff.Length()) >> group_send;
 
-	int send_ret = block_socket_send(_socket, (const unsigned char*)out_buff.Ptr(), (unsigned int)out_buff.Length(), breaker_, _err_code);
+	int send_ret = coroutine::auto_socket_send(_socket, (const unsigned char*)out_buff.Ptr(), (unsigned int)out_buff.Length(), breaker_, _err_code);
 
 	if (send_ret < 0) {
 		xerror2(TSF"Send Request Error, ret:%0, errno:%1, nread:%_, nwrite:%_", send_ret, strerror(_err_code), socket_nread(_socket), socket_nwrite(_socket)) >> group_send;
@@ -364,6 +418,7 @@ void ShortLink::__RunReadWrite(SOCKET _socket, int& _err_type, int& _err_code, C
 	}
     
     GetSignalOnNetworkDataChange()(XLOGGER_TAG, send_ret, 0);
+    TrafficCmdData(Task::kChannelShort, task_.cmdid, send_ret, 0);
 
     if (breaker_.IsBreak()) {
         xwarn2(TSF"Send Request break, sent:%_ nread:%_, nwrite:%_", send_ret, socket_nread(_socket), socket_nwrite(_socket)) >> group_send;
@@ -384,11 +439,15 @@ void ShortLink::__RunReadWrite(SOCKET _socket, int& _err_type, int& _err_code, C
 	AutoBuffer extension;
     int        status_code = -1;
 	off_t recv_pos = 0;
-	MemoryBodyReceiver* receiver = new MemoryBodyReceiver(body);
+	size_t recv_total = 0;
+	ChunkBodyReceiver* chunk_receiver = task_.stream_response ? new ChunkBodyReceiver(task_.taskid) : NULL;
+	BodyReceiver* receiver = chunk_receiver;
+	if (NULL == receiver) receiver = new MemoryBodyReceiver(body);
 	http::Parser parser(receiver, true);
+	if (chunk_receiver) chunk_receiver->Attach(&parser);
 
 	while (true) {
-		int recv_ret = block_socket_recv(_socket, recv_buf, KBufferSize, breaker_, _err_code, 5000);
+		int recv_ret = coroutine::auto_socket_recv(_socket, recv_buf, KBufferSize, breaker_, _err_code, 5000);
 
 		if (recv_ret < 0) {
 			xerror2(TSF"read block socket return false, error:%0, nread:%_, nwrite:%_", strerror(_err_code), socket_nread(_socket), socket_nwrite(_socket)) >> group_close;
@@ -414,16 +473,23 @@ void ShortLink::__RunReadWrite(SOCKET _socket, int& _err_type, int& _err_code, C
 
 		if (recv_ret > 0) {
             GetSignalOnNetworkDataChange()(XLOGGER_TAG, 0, recv_ret);
+            TrafficCmdData(Task::kChannelShort, task_.cmdid, 0, recv_ret);
             
 			xinfo2(TSF"recv len:%_ ", recv_ret) >> group_recv;
-            if (OnRecv)
-                OnRecv(this, (unsigned int)(recv_buf.Length() - recv_pos), (unsigned int)recv_buf.Length());
-            else
+			recv_total += recv_ret;
+            // recv_buf does not keep a streamed response, its sizes are counted
+            if (!OnRecv)
                 xwarn2(TSF"OnRecv NULL.");
+            else if (task_.stream_response)
+                OnRecv(this, (unsigned int)recv_total, (unsigned int)recv_total);
+            else
+                OnRecv(this, (unsigned int)(recv_buf.Length() - recv_pos), (unsigned int)recv_buf.Length());
 			recv_pos = recv_buf.Pos();
 		}
 
 		Parser::TRecvStatus parse_status = parser.Recv(recv_buf.Ptr(recv_buf.Length() - recv_ret), recv_ret);
+		// the parser has copied out what it needs, a streamed response does not pile up in recv_buf
+		if (task_.stream_response) recv_buf.Length(0, 0);
         if (parser.FirstLineReady()) {
             status_code = parser.Status().StatusCode();
         }
@@ -514,7 +580,11 @@ void ShortLink::FillOutterIPAddr(const std::vector<IPPortItem>& _out_addr) {
 void ShortLink::__CancelAndWaitWorkerThread() {
     xdebug_function();
 
+#ifdef MARS_CORO_IO
+    if (!coro_) return;
+#else
     if (!thread_.isruning()) return;
+#endif
 
     xassert2(breaker_.IsCreateSuc());
 
@@ -524,5 +594,9 @@ void ShortLink::__CancelAndWaitWorkerThread() {
     }
 
     dns_util_.Cancel();
+#ifdef MARS_CORO_IO
+    coro_->Join();
+#else
     thread_.join();
+#endif
 }
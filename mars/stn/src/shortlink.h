@@ -40,6 +40,10 @@
 #include "net_source.h"
 #include "shortlink_interface.h"
 
+#ifdef MARS_CORO_IO
+namespace coroutine { class Coroutine; }
+#endif
+
 namespace mars {
 namespace stn {
     
@@ -72,6 +76,9 @@ class ShortLink : public ShortLinkInterface {
     NetSource&                      net_source_;
     Task                            task_;
     Thread                          thread_;
+#ifdef MARS_CORO_IO
+    boost::scoped_ptr<coroutine::Coroutine> coro_;  // runs __Run on coroutine::SharedIOQueue() instead of thread_
+#endif
 
     SocketBreaker                   breaker_;
     ConnectProfile                  conn_profile_;
@@ -157,12 +157,14 @@ void ShortLinkTaskManager::__RunLoop() {
     __RunOnStartTask();
 
     if (!lst_cmd_.empty()) {
+        // only tasks waiting for the flow limit, nothing to do until the first of them may go
+        uint64_t deferred = __FlowDeferredWait(lst_cmd_);
 #ifdef ANDROID
-        wakeup_lock_->Lock(60 * 1000);
+        if (0 == deferred) wakeup_lock_->Lock(60 * 1000);
 #endif
         MessageQueue::FasterMessage(asyncreg_.Get(),
                                     MessageQueue::Message((MessageQueue::MessageTitle_t)this, boost::bind(&ShortLinkTaskManager::__RunLoop, this), "ShortLinkTaskManager::__RunLoop"),
-                                    MessageQueue::MessageTiming(1000));
+                                    MessageQueue::MessageTiming(0 == deferred ? 1000 : deferred));
     } else {
 #ifdef ANDROID
         /*cancel the last wakeuplock*/
@@ -192,10 +194,12 @@ void ShortLinkTaskManager::__RunOnTimeout() {
             xerror2(TSF"task read-write timeout, taskid:%_, wworker:%_, nStartSendTime:%_, nReadWriteTimeOut:%_", first->task.taskid, (void*)first->running_id, first->transfer_profile.start_send_time / 1000, first->transfer_profile.read_write_timeout / 1000);
             err_type = kEctHttp;
             socket_timeout_code = kEctHttpReadWriteTimeout;
+            dynamic_timeout_.CgiLatencyStatistic(first->task.cgi, 0 < first->transfer_profile.first_receive_pkg_time ? first->transfer_profile.first_receive_pkg_time - first->transfer_profile.start_send_time : first->transfer_profile.read_write_timeout, first->transfer_profile.read_write_timeout);
         } else if (first->running_id && 0 < first->transfer_profile.start_send_time && 0 == first->transfer_profile.last_receive_pkg_time && cur_time - first->transfer_profile.start_send_time >= first->transfer_profile.first_pkg_timeout) {
             xerror2(TSF"task first-pkg timeout taskid:%_, wworker:%_, nStartSendTime:%_, nfirstpkgtimeout:%_", first->task.taskid, (void*)first->running_id, first->transfer_profile.start_send_time / 1000, first->transfer_profile.first_pkg_timeout / 1000);
             err_type = kEctHttp;
             socket_timeout_code = kEctHttpFirstPkgTimeout;
+            dynamic_timeout_.CgiLatencyStatistic(first->task.cgi, first->transfer_profile.first_pkg_timeout, first->transfer_profile.first_pkg_timeout);
         } else if (first->running_id && 0 < first->transfer_profile.start_send_time && 0 < first->transfer_profile.last_receive_pkg_time &&
                 cur_time - first->transfer_profile.last_receive_pkg_time >= ((kMobile != getNetInfo()) ? kWifiPackageInterval : kGPRSPackageInterval)) {
             xerror2(TSF"task pkg-pkg timeout, taskid:%_, wworker:%_, nLastRecvTime:%_, pkg-pkg timeout:%_",
@@ -275,16 +279,30 @@ void ShortLinkTaskManager::__RunOnStartTask() {
         //雪崩检测
         xassert2(fun_anti_avalanche_check_);
 
-        if (!fun_anti_avalanche_check_(first->task, bufreq.Ptr(), (int)bufreq.Length())) {
+        // over the flow quota, it waits for the tokens if they come before the task times out
+        uint64_t deadline = first->start_task_time + first->task_timeout;
+        uint64_t defer = 0;
+        if (!fun_anti_avalanche_check_(first->task, bufreq.Ptr(), (int)bufreq.Length(), first->flow_deferred, deadline > curtime ? deadline - curtime : 0, defer)) {
+            if (0 < defer) {
+                xwarn2(TSF"task deferred by flow limit, taskid:%_, cmdid:%_, cgi:%_, defer:%_", first->task.taskid, first->task.cmdid, first->task.cgi, defer);
+                first->flow_deferred = true;
+                first->retry_start_time = curtime;
+                first->retry_time_interval = defer;
+                first = next;
+                continue;
+            }
+
             __SingleRespHandle(first, kEctLocal, kEctLocalAntiAvalanche, kTaskFailHandleTaskEnd, 0, first->running_id ? ((ShortLinkInterface*)first->running_id)->Profile() : ConnectProfile());
             first = next;
             continue;
         }
+        first->flow_deferred = false;
 
         first->transfer_profile.loop_start_task_time = ::gettickcount();
         first->transfer_profile.first_pkg_timeout = __FirstPkgTimeout(first->task.server_process_cost, bufreq.Length(), sent_count, dynamic_timeout_.GetStatus());
         first->current_dyntime_status = (first->task.server_process_cost <= 0) ? dynamic_timeout_.GetStatus() : kEValuating;
         first->transfer_profile.read_write_timeout = __ReadWriteTimeout(first->transfer_profile.first_pkg_timeout);
+        if (first->task.server_process_cost <= 0) dynamic_timeout_.CgiTimeout(first->task.cgi, first->transfer_profile.first_pkg_timeout, first->transfer_profile.read_write_timeout);
         first->transfer_profile.send_data_size = bufreq.Length();
 
         first->use_proxy =  (first->remain_retry_count == 0 && first->task.retry_count > 0) ? !default_use_proxy_ : default_use_proxy_;
@@ -347,9 +365,12 @@ void ShortLinkTaskManager::__OnResponse(ShortLinkInterface* _worker, ErrCmdType
 
     }
 
-    it->transfer_profile.received_size = _body.Length();
-    it->transfer_profile.receive_data_size = _body.Length();
+    if (!it->task.stream_response) {  // a streamed body was counted by __OnRecv as it came
+        it->transfer_profile.received_size = _body.Length();
+        it->transfer_profile.receive_data_size = _body.Length();
+    }
     it->transfer_profile.last_receive_pkg_time = ::gettickcount();
+    if (0 == it->transfer_profile.first_receive_pkg_time) it->transfer_profile.first_receive_pkg_time = it->transfer_profile.last_receive_pkg_time;
 
     int err_code = 0;
     int handle_type = Buf2Resp(it->task.taskid, it->task.user_context, _body, _extension, err_code, Task::kChannelShort);
@@ -357,7 +378,8 @@ void ShortLinkTaskManager::__OnResponse(ShortLinkInterface* _worker, ErrCmdType
     switch(handle_type){
         case kTaskFailHandleNoError:
         {
-            dynamic_timeout_.CgiTaskStatistic(it->task.cgi, (unsigned int)it->transfer_profile.send_data_size + (unsigned int)_body.Length(), ::gettickcount() - it->transfer_profile.start_send_time);
+            dynamic_timeout_.CgiTaskStatistic(it->task.cgi, (unsigned int)it->transfer_profile.send_data_size + (unsigned int)it->transfer_profile.receive_data_size, ::gettickcount() - it->transfer_profile.start_send_time);
+            dynamic_timeout_.CgiLatencyStatistic(it->task.cgi, it->transfer_profile.first_receive_pkg_time - it->transfer_profile.start_send_time, ::gettickcount() - it->transfer_profile.start_send_time);
             __SingleRespHandle(it, kEctOK, err_code, handle_type, (unsigned int)it->transfer_profile.receive_data_size, _conn_profile);
             xassert2(fun_notify_network_err_);
             fun_notify_network_err_(__LINE__, kEctOK, err_code, _conn_profile.ip, _conn_profile.host, _conn_profile.port);
@@ -425,6 +447,7 @@ void ShortLinkTaskManager::__OnRecv(ShortLinkInterface* _worker, unsigned int _c
         else
             WeakNetworkLogic::Singleton::Instance()->OnPkgEvent(false, (int)(::gettickcount() - it->transfer_profile.last_receive_pkg_time));
         it->transfer_profile.last_receive_pkg_time = ::gettickcount();
+        if (0 == it->transfer_profile.first_receive_pkg_time) it->transfer_profile.first_receive_pkg_time = it->transfer_profile.last_receive_pkg_time;
         it->transfer_profile.received_size = _cached_size;
         it->transfer_profile.receive_data_size = _total_size;
         xdebug2(TSF"worker:%_, last_recvtime:%_, cachedsize:%_, totalsize:%_", _worker, it->transfer_profile.last_receive_pkg_time / 1000, _cached_size, _total_size);
@@ -48,7 +48,7 @@ class ShortLinkTaskManager {
   public:
     boost::function<int (ErrCmdType _err_type, int _err_code, int _fail_handle, const Task& _task, unsigned int _taskcosttime)> fun_callback_;
     boost::function<void (int _line, ErrCmdType _err_type, int _err_code, const std::string& _ip, const std::string& _host, uint16_t _port)> fun_notify_network_err_;
-    boost::function<bool (const Task& _task, const void* _buffer, int _len)> fun_anti_avalanche_check_;
+    boost::function<bool (const Task& _task, const void* _buffer, int _len, bool _deferred, uint64_t _max_defer, uint64_t& _defer)> fun_anti_avalanche_check_;
     boost::function<void (int _status_code)> fun_shortlink_response_;
     boost::function<void (ErrCmdType _err_type, int _err_code, int _fail_handle, uint32_t _src_taskid)> fun_notify_retry_all_tasks;
 
@@ -42,7 +42,7 @@ SignallingKeeper::SignallingKeeper(const LongLink& _longlink, MessageQueue::Mess
 , keeping_(false)
 , longlink_(_longlink)
 , port_(0)
-, udp_client_(ip_, port_, this)
+, udp_client_(ip_, port_, this, &UdpPoller::Shared())
 , use_UDP_(_use_UDP)
 {
     xinfo2(TSF"SignallingKeeper messagequeue_id=%_, handler:(%_,%_)", MessageQueue::Handler2Queue(msgreg_.Get()), msgreg_.Get().queue, msgreg_.Get().seq);
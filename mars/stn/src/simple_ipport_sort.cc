@@ -50,6 +50,11 @@ static const char* const kPort = "port";
 //static const char* const kSuccess = "succ";
 //static const char* const kTotal = "total";
 static const char* const kHistoryResult = "historyresult";
+static const char* const kRtt = "rtt";
+static const char* const kRttVar = "rttvar";
+static const char* const kLoss = "loss";
+static const char* const kSamples = "samples";
+static const char* const kRttSamples = "rttsamples";
 
 static const unsigned int kBanTime = 6 * 60 * 1000;  // 6 min
 static const unsigned int kMaxBanTime = 30 * 60 * 1000; // 30 min
@@ -58,6 +63,15 @@ static const int kBanFailCount = 3;
 static const int kSuccessUpdateInterval = 10*1000;
 static const int kFailUpdateInterval = 10*1000;
 
+// connect estimator, rfc6298 gains for rtt and rttvar
+static const float kRttGain = 1.0f / 8;
+static const float kRttVarGain = 1.0f / 4;
+static const float kLossGain = 1.0f / 8;
+static const float kUnknownRtt = 1000;          // ms, assumed for an ip that never connected
+static const float kLostConnectCost = 4 * 1000;  // ms, a lost connect waits out the racing interval before the next ip
+static const int kExploreOneIn = 10;             // how often an ip measured too little goes first
+static const uint32_t kExploreSamples = 4;       // below this many connects an ip counts as measured too little
+
 #define SET_BIT(SET, RECORDS)  RECORDS = (((RECORDS)<<1) | (bool(SET)))
 
 static inline
@@ -93,28 +107,50 @@ namespace mars { namespace stn {
         uint8_t records;
         tickcount_t last_fail_time;
         tickcount_t last_suc_time;
-        BanItem(): port(0), records(0) {}
+
+        float srtt;
+        float rttvar;
+        float loss;
+        uint32_t samples;
+        uint32_t rtt_samples;
+        BanItem(): port(0), records(0), srtt(0), rttvar(0), loss(0), samples(0), rtt_samples(0) {}
     };
 }}
 
+// what connecting to the ip is expected to take, in ms
+static float __ExpectedConnectCost(const mars::stn::BanItem& _item) {
+    float loss = 0 < _item.samples ? _item.loss : CAL_BIT_COUNT(_item.records) / 8.0f;
+    float rtt = 0 < _item.rtt_samples ? _item.srtt + _item.rttvar : kUnknownRtt;
+    return (1 - loss) * rtt + loss * kLostConnectCost;
+}
+
 using namespace mars::stn;
 
 SimpleIPPortSort::SimpleIPPortSort()
-: hostpath_(mars::app::GetAppFilePath() + "/" + kFolderName) {
-        
-    if (!boost::filesystem::exists(hostpath_)){
-        boost::filesystem::create_directory(hostpath_);
-    }
-        
-    ScopedLock lock(mutex_);
-    __LoadXml();
-    lock.unlock();
-    InitHistory2BannedList(false);
+: hostpath_(mars::app::GetAppFilePath() + "/" + kFolderName)
+, loaded_(false) {
 }
 
 SimpleIPPortSort::~SimpleIPPortSort() {
     ScopedLock lock(mutex_);
-    __SaveXml();
+    if (loaded_) __SaveXml();  // the file is left as it is if it was never read
+}
+
+void SimpleIPPortSort::Load() {
+    ScopedLock lock(mutex_);
+    __Load();
+}
+
+void SimpleIPPortSort::__Load() {
+    if (loaded_) return;
+    loaded_ = true;
+
+    if (!boost::filesystem::exists(hostpath_)){
+        boost::filesystem::create_directory(hostpath_);
+    }
+
+    __LoadXml();
+    __InitBannedList();
 }
 
 void SimpleIPPortSort::__SaveXml() {
@@ -156,8 +192,16 @@ void SimpleIPPortSort::__RemoveTimeoutXml() {
 
 void SimpleIPPortSort::InitHistory2BannedList(bool _savexml) {
     ScopedLock lock(mutex_);
+    if (!loaded_) {
+        __Load();
+        return;
+    }
+
     if (_savexml) __SaveXml();
-    
+    __InitBannedList();
+}
+
+void SimpleIPPortSort::__InitBannedList() {
     _ban_fail_list_.clear();
     
     std::string curr_netinfo;
@@ -191,12 +235,18 @@ void SimpleIPPortSort::InitHistory2BannedList(bool _savexml) {
             SET_BIT(historyresult & 0xFF, banitem.records);
             historyresult >>= 8;
         }
+        banitem.srtt = item->FloatAttribute(kRtt);
+        banitem.rttvar = item->FloatAttribute(kRttVar);
+        banitem.loss = item->FloatAttribute(kLoss);
+        banitem.samples = item->UnsignedAttribute(kSamples);
+        banitem.rtt_samples = item->UnsignedAttribute(kRttSamples);
         _ban_fail_list_.push_back(banitem);
     }
 }
 
 void SimpleIPPortSort::RemoveBannedList(const std::string& _ip) {
     ScopedLock lock(mutex_);
+    __Load();
 
     for (std::vector<BanItem>::iterator iter = _ban_fail_list_.begin(); iter != _ban_fail_list_.end();) {
         if (iter->ip == _ip)
@@ -211,17 +261,56 @@ void SimpleIPPortSort::Update(const std::string& _ip, uint16_t _port, bool _is_s
     if (kNoNet == getCurrNetLabel(curr_net_info)) return;
 
     ScopedLock lock(mutex_);
+    __Load();
     
     if (!__CanUpdate(_ip, _port, _is_success)) return;
     
     __UpdateBanList(_is_success,  _ip,  _port);
 
+    tinyxml2::XMLElement* item = __FindOrAddXmlItem(curr_net_info, _ip, _port);
+    uint64_t history_result = item->Int64Attribute(kHistoryResult);
+    SET_BIT(!_is_success, history_result);
+    item->SetAttribute(kHistoryResult, (int64_t)history_result);
+}
+
+void SimpleIPPortSort::UpdateConnect(const std::string& _ip, uint16_t _port, bool _is_success, int _rtt) {
+    std::string curr_net_info;
+    if (kNoNet == getCurrNetLabel(curr_net_info)) return;
+
+    ScopedLock lock(mutex_);
+    __Load();
+
+    BanItem& banitem = __FindOrAddBanItem(_ip, _port);
+    float lost = _is_success ? 0 : 1;
+    banitem.loss = 0 == banitem.samples ? lost : banitem.loss + kLossGain * (lost - banitem.loss);
+    ++banitem.samples;
+
+    if (_is_success && 0 <= _rtt) {
+        if (0 == banitem.rtt_samples) {
+            banitem.srtt = (float)_rtt;
+            banitem.rttvar = _rtt / 2.0f;
+        } else {
+            banitem.rttvar += kRttVarGain * (fabsf(banitem.srtt - _rtt) - banitem.rttvar);
+            banitem.srtt += kRttGain * (_rtt - banitem.srtt);
+        }
+        ++banitem.rtt_samples;
+    }
+
+    tinyxml2::XMLElement* item = __FindOrAddXmlItem(curr_net_info, _ip, _port);
+    item->SetAttribute(kRtt, banitem.srtt);
+    item->SetAttribute(kRttVar, banitem.rttvar);
+    item->SetAttribute(kLoss, banitem.loss);
+    item->SetAttribute(kSamples, banitem.samples);
+    item->SetAttribute(kRttSamples, banitem.rtt_samples);
+}
+
+tinyxml2::XMLElement* SimpleIPPortSort::__FindOrAddXmlItem(const std::string& _netinfo, const std::string& _ip, uint16_t _port) {
     tinyxml2::XMLElement* record = NULL;
 
     for (record = recordsxml_.FirstChildElement(kRecord);
             NULL != record; record = record->NextSiblingElement(kRecord)) {
         const char* netinfo_chr = record->Attribute(kNetInfo);
-        if (netinfo_chr && (0 == strcmp(netinfo_chr, curr_net_info.c_str()))) break;
+        if (netinfo_chr && (0 == strcmp(netinfo_chr, _netinfo.c_str()))) break;
     }
 
     if (NULL == record) {
@@ -231,7 +320,7 @@ void SimpleIPPortSort::Update(const std::string& _ip, uint16_t _port, bool _is_s
         snprintf(timebuf, sizeof(timebuf), "%ld", timeval.tv_sec);
         
         record = recordsxml_.NewElement(kRecord);
-        record->SetAttribute(kNetInfo, curr_net_info.c_str());
+        record->SetAttribute(kNetInfo, _netinfo.c_str());
         record->SetAttribute(kTime, timebuf);
         recordsxml_.InsertEndChild(record);
     }
@@ -253,9 +342,7 @@ void SimpleIPPortSort::Update(const std::string& _ip, uint16_t _port, bool _is_s
         record->InsertEndChild(item);
     }
 
-    uint64_t history_result = item->Int64Attribute(kHistoryResult);
-    SET_BIT(!_is_success, history_result);
-    item->SetAttribute(kHistoryResult, (int64_t)history_result);
+    return item;
 }
 
 std::vector<BanItem>::iterator  SimpleIPPortSort::__FindBannedIter(const std::string& _ip, unsigned short _port) const {
@@ -298,28 +385,24 @@ bool SimpleIPPortSort::__IsBanned(std::vector<BanItem>::iterator _iter) const {
 }
 
 void SimpleIPPortSort::__UpdateBanList(bool _is_success, const std::string& _ip, unsigned short _port) {
-    for (std::vector<BanItem>::iterator iter = _ban_fail_list_.begin(); iter != _ban_fail_list_.end(); ++iter) {
-        if (iter->ip == _ip && iter->port == _port) {
-            SET_BIT(!_is_success, iter->records);
-            if (_is_success)
-                iter->last_suc_time.gettickcount();
-            else
-                iter->last_fail_time.gettickcount();
-            return;
-        }
-    }
-
-    BanItem item;
-    item.ip = _ip;
-    item.port = _port;
+    BanItem& item = __FindOrAddBanItem(_ip, _port);
     SET_BIT(!_is_success, item.records);
-    
+
     if (_is_success)
         item.last_suc_time.gettickcount();
     else
         item.last_fail_time.gettickcount();
-    
+}
+
+BanItem& SimpleIPPortSort::__FindOrAddBanItem(const std::string& _ip, uint16_t _port) {
+    std::vector<BanItem>::iterator iter = __FindBannedIter(_ip, _port);
+    if (iter != _ban_fail_list_.end()) return *iter;
+
+    BanItem item;
+    item.ip = _ip;
+    item.port = _port;
     _ban_fail_list_.push_back(item);
+    return _ban_fail_list_.back();
 }
 
 bool SimpleIPPortSort::__CanUpdate(const std::string& _ip, uint16_t _port, bool _is_success) const {
@@ -421,8 +504,10 @@ void SimpleIPPortSort::__SortbyBanned(std::vector<IPPortItem>& _items, bool _use
                  if(l == _ban_fail_list_.end() || r == _ban_fail_list_.end())
                   return false;
                  
-                 if (CAL_BIT_COUNT(l->records) != CAL_BIT_COUNT(r->records))
-                     return CAL_BIT_COUNT(l->records) < CAL_BIT_COUNT(r->records);
+                 float l_cost = __ExpectedConnectCost(*l);
+                 float r_cost = __ExpectedConnectCost(*r);
+                 if (l_cost != r_cost)
+                     return l_cost < r_cost;
                       
                  if (l->last_fail_time != r->last_fail_time)
                      return l->last_fail_time < r->last_fail_time;
@@ -433,6 +518,15 @@ void SimpleIPPortSort::__SortbyBanned(std::vector<IPPortItem>& _items, bool _use
                   //random by std::random_shuffle(_items.begin(), _items.end());
                   return false;
               });
+
+    // now and then an ip with too few connects goes first, so that every ip gets an estimate of its own
+    if (1 < items_history.size() && 0 == rand() % kExploreOneIn) {
+        std::deque<IPPortItem>::iterator explore = std::min_element(items_history.begin(), items_history.end(),
+              [&](const IPPortItem& _l, const IPPortItem& _r) {
+                  return __FindBannedIter(_l.str_ip, _l.port)->samples < __FindBannedIter(_r.str_ip, _r.port)->samples;
+              });
+        if (__FindBannedIter(explore->str_ip, explore->port)->samples < kExploreSamples) std::rotate(items_history.begin(), explore, explore + 1);
+    }
     
    //merge
     _items.clear();
@@ -530,6 +624,7 @@ void SimpleIPPortSort::__PickIpItemRandom(std::vector<IPPortItem>& _items, std::
 
 void SimpleIPPortSort::SortandFilter(std::vector<IPPortItem>& _items, int _needcount, bool _use_IPv6) const {
     ScopedLock lock(mutex_);
+    const_cast<SimpleIPPortSort*>(this)->__Load();
     __FilterbyBanned(_items);
     __SortbyBanned(_items, _use_IPv6);
     
@@ -41,23 +41,31 @@ class SimpleIPPortSort {
     SimpleIPPortSort();
     ~SimpleIPPortSort();
 
+    // the records are read at first use, this reads them ahead of it
+    void Load();
     void InitHistory2BannedList(bool _savexml);
     void RemoveBannedList(const std::string& _ip);
     void Update(const std::string& _ip, uint16_t _port, bool _is_success);
+    // one connect attempt, _rtt in ms is only looked at when it succeeded
+    void UpdateConnect(const std::string& _ip, uint16_t _port, bool _is_success, int _rtt);
 
     void SortandFilter(std::vector<IPPortItem>& _items, int _needcount, bool _use_IPv6) const;
 
     void AddServerBan(const std::string& _ip);
     
   private:
+    void __Load();
+    void __InitBannedList();
     void __LoadXml();
     void __SaveXml();
     void __RemoveTimeoutXml();
+    tinyxml2::XMLElement* __FindOrAddXmlItem(const std::string& _netinfo, const std::string& _ip, uint16_t _port);
 
     std::vector<BanItem>::iterator __FindBannedIter(const std::string& _ip, uint16_t _port) const;
     bool __IsBanned(std::vector<BanItem>::iterator _iter) const;
     bool __IsBanned(const std::string& _ip, uint16_t _port) const;
     void __UpdateBanList(bool _isSuccess, const std::string& _ip, uint16_t _port);
+    BanItem& __FindOrAddBanItem(const std::string& _ip, uint16_t _port);
     bool __CanUpdate(const std::string& _ip, uint16_t _port, bool _is_success) const;
 
     void __FilterbyBanned(std::vector<IPPortItem>& _items) const;
@@ -73,6 +81,7 @@ class SimpleIPPortSort {
   private:
     std::string hostpath_;
     tinyxml2::XMLDocument recordsxml_;
+    bool loaded_;
 
     mutable Mutex mutex_;
     mutable std::vector<BanItem> _ban_fail_list_;
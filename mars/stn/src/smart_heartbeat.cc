@@ -24,6 +24,8 @@
 
 #include "smart_heartbeat.h"
 
+#include <stddef.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -42,27 +44,75 @@
 
 #define KV_KEY_SMARTHEART 11249
 
-static const std::string kFileName = "Heartbeat.ini";
+static const std::string kFileName = "Heartbeat.state";
+static const std::string kLegacyFileName = "Heartbeat.ini";
+static const size_t kMaxNetworks = 20;
+static const unsigned int kMaxNoopRtt = 60 * 1000;  // the back off stops doubling there
+
+// the value of a network in the store, fields are only ever appended
+struct HeartStateRecord {
+    int32_t net_type;
+    uint32_t cur_heart;
+    int32_t heart_type;
+    uint8_t is_stable;
+    int64_t last_modify_time;
+    uint32_t fail_heart_count;
+    uint32_t min_heart_fail_count;
+    uint32_t probe_low;
+    uint32_t probe_high;
+    uint32_t noop_rtt;
+    uint32_t noop_rttvar;
+};
+
+// a record saved before the probe fields were appended
+static const size_t kMinHeartStateSize = offsetof(HeartStateRecord, min_heart_fail_count) + sizeof(uint32_t);
+
+static void __EncodeHeartState(const NetHeartbeatInfo& _info, std::string& _value) {
+    HeartStateRecord record;
+    memset(&record, 0, sizeof(record));
+    record.net_type = _info.net_type_;
+    record.cur_heart = _info.cur_heart_;
+    record.heart_type = _info.heart_type_;
+    record.is_stable = _info.is_stable_;
+    record.last_modify_time = _info.last_modify_time_;
+    record.fail_heart_count = _info.fail_heart_count_;
+    record.min_heart_fail_count = _info.min_heart_fail_count_;
+    record.probe_low = _info.probe_low_;
+    record.probe_high = _info.probe_high_;
+    record.noop_rtt = _info.noop_rtt_;
+    record.noop_rttvar = _info.noop_rttvar_;
+    _value.assign((const char*)&record, sizeof(record));
+}
 
-// INI key
-static const char* const kKeyModifyTime      = "modifyTime";
-static const char* const kKeyCurHeart        = "curHeart";
-static const char* const kKeyFailHeartCount  = "failHeartCount";
-static const char* const kKeyStable          = "stable";
-static const char* const kKeyNetType         = "netType";
-static const char* const kKeyHeartType       = "hearttype";
-static const char* const kKeyMinHeartFail    = "minheartfail";
+static bool __DecodeHeartState(const std::string& _value, NetHeartbeatInfo& _info) {
+    HeartStateRecord record;
+    if (_value.size() < kMinHeartStateSize) return false;
+    memset(&record, 0, sizeof(record));
+    memcpy(&record, _value.data(), std::min(_value.size(), sizeof(record)));
+
+    _info.net_type_ = record.net_type;
+    _info.cur_heart_ = record.cur_heart;
+    _info.heart_type_ = (TSmartHeartBeatType)record.heart_type;
+    _info.is_stable_ = 0 != record.is_stable;
+    _info.last_modify_time_ = (time_t)record.last_modify_time;
+    _info.fail_heart_count_ = record.fail_heart_count;
+    _info.min_heart_fail_count_ = record.min_heart_fail_count;
+    _info.probe_low_ = std::max(record.probe_low, (uint32_t)MinHeartInterval);
+    _info.probe_high_ = 0 == record.probe_high ? MaxHeartInterval : record.probe_high;
+    _info.noop_rtt_ = record.noop_rtt;
+    _info.noop_rttvar_ = record.noop_rttvar;
+    return true;
+}
 
 SmartHeartbeat::SmartHeartbeat(): report_smart_heart_(NULL), is_wait_heart_response_(false), success_heart_count_(0), last_heart_(MinHeartInterval),
-    ini_(mars::app::GetAppFilePath() + "/" + kFileName, false)
+    store_(mars::stn::StateStore::Shared(mars::app::GetAppFilePath() + "/" + kFileName, kMaxNetworks))
     , doze_mode_count_(0), normal_mode_count_(0), noop_start_tick_(false) {
     xinfo_function();
-    ini_.Parse();
 }
 
 SmartHeartbeat::~SmartHeartbeat() {
     xinfo_function();
-    __SaveINI();
+    __SaveState();
 }
 
 void SmartHeartbeat::OnHeartbeatStart() {
@@ -74,7 +124,7 @@ void SmartHeartbeat::OnHeartbeatStart() {
 
 void SmartHeartbeat::OnLongLinkEstablished() {
     xdebug_function();
-    __LoadINI();
+    __LoadState();
     success_heart_count_ = 0;
 }
 
@@ -104,6 +154,8 @@ void SmartHeartbeat::OnHeartResult(bool _sucess, bool _fail_of_timeout) {
     
     xdebug2(TSF"heart result:%0, timeout:%1", _sucess, _fail_of_timeout);
     is_wait_heart_response_ = false;
+    if (_sucess && noop_start_tick_.isValid()) __OnNoopRtt((unsigned int)noop_start_tick_.gettickspan());
+    if (!_sucess && _fail_of_timeout) __OnNoopTimeout();
 
     xassert2(!current_net_heart_info_.net_detail_.empty(), "something wrong,net_detail_ shoudn't be NULL");
     if (current_net_heart_info_.net_detail_.empty()) return;
@@ -139,47 +191,42 @@ void SmartHeartbeat::OnHeartResult(bool _sucess, bool _fail_of_timeout) {
         // probe bigger heart on Wednesday
         if ((cur_time - current_net_heart_info_.last_modify_time_) >= 7*ONE_DAY_SECONEDS && current_net_heart_info_.cur_heart_ < (MaxHeartInterval - SuccessStep)) {
             xinfo2(TSF"tryProbeBiggerHeart. curHeart=%_, last modify:%_", current_net_heart_info_.cur_heart_, current_net_heart_info_.last_modify_time_);
+            // the nat may have grown, search again above the stable value
+            current_net_heart_info_.probe_low_ = current_net_heart_info_.cur_heart_;
+            current_net_heart_info_.probe_high_ = MaxHeartInterval;
             current_net_heart_info_.cur_heart_ += SuccessStep;
             current_net_heart_info_.succ_heart_count_ = 0;
             current_net_heart_info_.is_stable_ = false;
             current_net_heart_info_.fail_heart_count_ = 0;
             if(report_smart_heart_)
                 report_smart_heart_(kActionReCalc, current_net_heart_info_, false);
-            __SaveINI();
+            __SaveState();
         }
         return;
     }
     
     if (_sucess) {
         if(current_net_heart_info_.succ_heart_count_ >= BaseSuccCount) {
-            if (current_net_heart_info_.cur_heart_ >= (MaxHeartInterval - SuccessStep)) {
-                //already max, make stable
+            current_net_heart_info_.succ_heart_count_ = 0;
+            current_net_heart_info_.probe_low_ = std::max(current_net_heart_info_.probe_low_, current_net_heart_info_.cur_heart_);
+
+            unsigned int old_heart = current_net_heart_info_.cur_heart_;
+            if(__IsDozeStyle() && current_net_heart_info_.cur_heart_ < (MaxHeartInterval - SuccessStep)) {
                 current_net_heart_info_.cur_heart_ = MaxHeartInterval - SuccessStep;
-                current_net_heart_info_.succ_heart_count_ = 0;
-                current_net_heart_info_.is_stable_ = true;
-                current_net_heart_info_.heart_type_ = __IsDozeStyle() ? kDozeModeHeart : kSmartHeartBeat;
-                xinfo2(TSF"%0 find the smart heart interval = %1", current_net_heart_info_.net_detail_, current_net_heart_info_.cur_heart_);
-                if(report_smart_heart_)
-                    report_smart_heart_(kActionCalcEnd, current_net_heart_info_, false);
             } else {
-                current_net_heart_info_.succ_heart_count_ = 0;
-                
-                unsigned int old_heart = current_net_heart_info_.cur_heart_;
-                if(__IsDozeStyle()) {
-                    current_net_heart_info_.cur_heart_ = MaxHeartInterval - SuccessStep;
-                } else {
-                    current_net_heart_info_.cur_heart_ += HeartStep;
-                    current_net_heart_info_.cur_heart_ = std::min((unsigned int)(MaxHeartInterval - SuccessStep), current_net_heart_info_.cur_heart_);
-                }
-                
-                xinfo2(TSF"increace curHeart from %_ to %_", old_heart, current_net_heart_info_.cur_heart_);
+                __ProbeNextHeart();
             }
+
+            xinfo2(TSF"increace curHeart from %_ to %_, probe:(%_, %_)", old_heart, current_net_heart_info_.cur_heart_, current_net_heart_info_.probe_low_, current_net_heart_info_.probe_high_);
         }
     } else {
         if (last_heart_ == MinHeartInterval) return;
         
         if (current_net_heart_info_.fail_heart_count_ >= MaxHeartFailCount) {
             if (current_net_heart_info_.is_stable_) {
+                // the nat timeout went below the stable value, search again below it
+                current_net_heart_info_.probe_low_ = MinHeartInterval;
+                current_net_heart_info_.probe_high_ = current_net_heart_info_.cur_heart_;
                 current_net_heart_info_.cur_heart_ = MinHeartInterval;
                 current_net_heart_info_.succ_heart_count_ = 0;
                 current_net_heart_info_.is_stable_ = false;
@@ -189,27 +236,22 @@ void SmartHeartbeat::OnHeartResult(bool _sucess, bool _fail_of_timeout) {
                 current_net_heart_info_.fail_heart_count_  = 0;
                 xinfo2(TSF"in stable sate,can't use old value to Keep TCP alive");
             } else {
-                if(__IsDozeStyle()) {
-                    current_net_heart_info_.cur_heart_ = MinHeartInterval;
-                } else if ((current_net_heart_info_.cur_heart_ - HeartStep - SuccessStep) > MinHeartInterval) {
-                    current_net_heart_info_.cur_heart_ = current_net_heart_info_.cur_heart_ - HeartStep - SuccessStep;
-                } else {
-                    current_net_heart_info_.cur_heart_ = MinHeartInterval;
-                }
-                
                 current_net_heart_info_.succ_heart_count_ = 0;
                 current_net_heart_info_.fail_heart_count_ = 0;
-                current_net_heart_info_.is_stable_ = true;
-                current_net_heart_info_.heart_type_ = __IsDozeStyle() ? kDozeModeHeart : kSmartHeartBeat;
-                xinfo2(TSF"finish choose the proper value %0", current_net_heart_info_.cur_heart_);
-                if(report_smart_heart_)
-                    report_smart_heart_(kActionCalcEnd, current_net_heart_info_, false);
+                current_net_heart_info_.probe_high_ = std::min(current_net_heart_info_.probe_high_, current_net_heart_info_.cur_heart_);
+
+                if(__IsDozeStyle()) {
+                    current_net_heart_info_.probe_low_ = MinHeartInterval;
+                    current_net_heart_info_.probe_high_ = MinHeartInterval;
+                }
+                __ProbeNextHeart();
+                xinfo2(TSF"decrease curHeart to %_, probe:(%_, %_)", current_net_heart_info_.cur_heart_, current_net_heart_info_.probe_low_, current_net_heart_info_.probe_high_);
             }
         }
     }
     
     __DumpHeartInfo();
-    __SaveINI();
+    __SaveState();
 }
 
 
@@ -236,6 +278,55 @@ bool SmartHeartbeat::__IsDozeStyle() {
     return ((doze_mode_count_ > (2*normal_mode_count_)) && kMobile == ::getNetInfo());
 }
 
+// halves the range the nat timeout is known to be in, it ends within SuccessStep below it
+void SmartHeartbeat::__ProbeNextHeart() {
+    NetHeartbeatInfo& info = current_net_heart_info_;
+    info.probe_low_ = std::min(info.probe_low_, (unsigned int)(MaxHeartInterval - SuccessStep));
+
+    if (info.probe_high_ <= info.probe_low_ + SuccessStep || info.probe_low_ >= (MaxHeartInterval - SuccessStep)) {
+        info.cur_heart_ = info.probe_low_;
+        info.is_stable_ = true;
+        info.heart_type_ = __IsDozeStyle() ? kDozeModeHeart : kSmartHeartBeat;
+        xinfo2(TSF"%0 find the smart heart interval = %1", info.net_detail_, info.cur_heart_);
+        if(report_smart_heart_)
+            report_smart_heart_(kActionCalcEnd, info, false);
+        return;
+    }
+
+    info.cur_heart_ = info.probe_low_ + (info.probe_high_ - info.probe_low_) / 2;
+    info.is_stable_ = false;
+}
+
+// rfc 6298, the way tcp times its retransmissions
+void SmartHeartbeat::__OnNoopRtt(unsigned int _rtt) {
+    NetHeartbeatInfo& info = current_net_heart_info_;
+    if (0 == info.noop_rtt_) {
+        info.noop_rtt_ = std::max(_rtt, 1u);
+        info.noop_rttvar_ = _rtt / 2;
+        return;
+    }
+
+    unsigned int delta = info.noop_rtt_ > _rtt ? info.noop_rtt_ - _rtt : _rtt - info.noop_rtt_;
+    info.noop_rttvar_ = (3 * info.noop_rttvar_ + delta) / 4;
+    info.noop_rtt_ = std::max((7 * info.noop_rtt_ + _rtt) / 8, 1u);
+}
+
+// rfc 6298 5.5, the next noop waits twice as long, the rtt of the next answer pulls it back
+void SmartHeartbeat::__OnNoopTimeout() {
+    NetHeartbeatInfo& info = current_net_heart_info_;
+    if (0 == info.noop_rtt_) return;
+
+    info.noop_rtt_ = std::min(2 * info.noop_rtt_, kMaxNoopRtt);
+    info.noop_rttvar_ = std::min(2 * info.noop_rttvar_, kMaxNoopRtt);
+    xinfo2(TSF"noop timeout, back off noop rtt:%_, rttvar:%_", info.noop_rtt_, info.noop_rttvar_);
+}
+
+unsigned int SmartHeartbeat::GetNoopTimeout(unsigned int _max) const {
+    const NetHeartbeatInfo& info = current_net_heart_info_;
+    if (0 == info.noop_rtt_) return _max;
+    return std::min(_max, std::max((unsigned int)MinNoopTimeout, info.noop_rtt_ + 4 * info.noop_rttvar_));
+}
+
 unsigned int SmartHeartbeat::GetNextHeartbeatInterval() {  //
     // xinfo_function();
     
@@ -262,7 +353,7 @@ unsigned int SmartHeartbeat::GetNextHeartbeatInterval() {  //
     return last_heart_;
 }
 
-void SmartHeartbeat::__LoadINI() {
+void SmartHeartbeat::__LoadState() {
     xinfo_function();
     std::string net_info;
     int net_type = getCurrNetLabel(net_info);
@@ -278,16 +369,9 @@ void SmartHeartbeat::__LoadINI() {
     current_net_heart_info_.net_detail_ = net_info;
     current_net_heart_info_.net_type_ = net_type;
 
-    if (ini_.Select(net_info)) {
-        current_net_heart_info_.last_modify_time_ = ini_.Get(kKeyModifyTime, current_net_heart_info_.last_modify_time_);
-        current_net_heart_info_.cur_heart_ = ini_.Get(kKeyCurHeart, current_net_heart_info_.cur_heart_);
-        current_net_heart_info_.fail_heart_count_ = ini_.Get(kKeyFailHeartCount, current_net_heart_info_.fail_heart_count_);
-        current_net_heart_info_.is_stable_ = ini_.Get(kKeyStable, current_net_heart_info_.is_stable_);
-        current_net_heart_info_.net_type_ = ini_.Get(kKeyNetType, current_net_heart_info_.net_type_);
-        current_net_heart_info_.heart_type_ = (TSmartHeartBeatType)ini_.Get(kKeyHeartType, 0);
-        current_net_heart_info_.min_heart_fail_count_ = ini_.Get(kKeyMinHeartFail, 0);
-        
-        xassert2(net_type == current_net_heart_info_.net_type_, "cur:%d, INI:%d", net_type, current_net_heart_info_.net_type_);
+    std::string value;
+    if (store_->Get(net_info, value) && __DecodeHeartState(value, current_net_heart_info_)) {
+        xassert2(net_type == current_net_heart_info_.net_type_, "cur:%d, stored:%d", net_type, current_net_heart_info_.net_type_);
         
         if (current_net_heart_info_.cur_heart_ < MinHeartInterval) {
             xerror2(TSF"current_net_heart_info_.cur_heart_:%_ < MinHeartInterval:%_", current_net_heart_info_.cur_heart_, MinHeartInterval);
@@ -306,84 +390,37 @@ void SmartHeartbeat::__LoadINI() {
             current_net_heart_info_.last_modify_time_ = cur_time;
         }
     } else {
-        __LimitINISize();
-        bool ret = ini_.Create(net_info);
-        xassert2(ret);
-        __SaveINI();
-    }
-    __DumpHeartInfo();
-}
-
-#define MAX_INI_SECTIONS (20)
-
-void SmartHeartbeat::__LimitINISize() {
-    xinfo_function();
-    SpecialINI::sections_t& sections =  ini_.Sections();
-
-    if (ini_.Sections().size() <= MAX_INI_SECTIONS)
-        return;
-
-    xwarn2(TSF"sections.size=%0 > MAX_INI_SECTIONS=%1", sections.size(), MAX_INI_SECTIONS);
-
-    time_t cur_time = time(NULL);
-
-    time_t min_time = 0;
-    SpecialINI::sections_t::iterator min_iter = sections.end();
-
-    for (SpecialINI::sections_t::iterator iter = sections.begin(); iter != sections.end();) {
-        SpecialINI::keys_t::iterator time_iter = iter->second.find(kKeyModifyTime);
-
-        if (time_iter == iter->second.end()) {
-            // remove dirty value
-            sections.erase(iter++);
-            xinfo2(TSF"remove dirty value because miss KEY_ModifyTime");
-            continue;
+        // the store drops the network saved least recently past kMaxNetworks.
+        // an empty store is a first run, the ini from before it is not read any more
+        if (0 == store_->Size()) {
+            boost::system::error_code ec;
+            boost::filesystem::remove(mars::app::GetAppFilePath() + "/" + kLegacyFileName, ec);
         }
-
-        time_t time_value = number_cast<time_t>(time_iter->second.c_str());
-        
-        if (time_value > cur_time) {
-            // remove dirty value
-            sections.erase(iter++);
-            xinfo2(TSF"remove dirty value because Wrong ModifyTime ");
-            continue;
-        }
-
-        if (0 == min_time || time_value < min_time) {
-            min_iter = iter;
-            min_time = time_value;
-        }
-
-        ++iter;
+        __SaveState();
     }
-
-    if (min_iter != sections.end()) sections.erase(min_iter);
+    __DumpHeartInfo();
 }
 
-void SmartHeartbeat::__SaveINI() {
+void SmartHeartbeat::__SaveState() {
     xdebug_function();
     if(current_net_heart_info_.net_detail_.empty())return;
     
     current_net_heart_info_.last_modify_time_ = time(NULL);
 
-    ini_.Set<time_t>(kKeyModifyTime, current_net_heart_info_.last_modify_time_);
-    ini_.Set(kKeyCurHeart, current_net_heart_info_.cur_heart_);
-    ini_.Set(kKeyFailHeartCount, current_net_heart_info_.fail_heart_count_);
-    ini_.Set(kKeyStable, current_net_heart_info_.is_stable_);
-    ini_.Set(kKeyNetType, current_net_heart_info_.net_type_);
-    ini_.Set(kKeyHeartType, current_net_heart_info_.heart_type_);
-    ini_.Set(kKeyMinHeartFail, current_net_heart_info_.min_heart_fail_count_);
-    ini_.Save();
+    std::string value;
+    __EncodeHeartState(current_net_heart_info_, value);
+    store_->Put(current_net_heart_info_.net_detail_, value);
 }
 
 void SmartHeartbeat::__DumpHeartInfo() {
     xinfo2(TSF"SmartHeartbeat Info last_heart_:%0,successHeartCount:%1, currSuccCount:%2", last_heart_, success_heart_count_, current_net_heart_info_.succ_heart_count_);
 
     if (!current_net_heart_info_.net_detail_.empty()) {
-        xinfo2(TSF"currentNetHeartInfo detail:%0,curHeart:%1,isStable:%2,failcount:%3,modifyTime:%4,type:%5,min_fail:%6",
+        xinfo2(TSF"currentNetHeartInfo detail:%_,curHeart:%_,isStable:%_,failcount:%_,modifyTime:%_,type:%_,min_fail:%_,probe:(%_,%_),rtt:(%_,%_)",
                current_net_heart_info_.net_detail_, current_net_heart_info_.cur_heart_, current_net_heart_info_.is_stable_,
                current_net_heart_info_.fail_heart_count_, current_net_heart_info_.last_modify_time_
-               ,(int)current_net_heart_info_.heart_type_, current_net_heart_info_.min_heart_fail_count_);
+               ,(int)current_net_heart_info_.heart_type_, current_net_heart_info_.min_heart_fail_count_
+               , current_net_heart_info_.probe_low_, current_net_heart_info_.probe_high_, current_net_heart_info_.noop_rtt_, current_net_heart_info_.noop_rttvar_);
     }
 }
 
@@ -403,4 +440,7 @@ void NetHeartbeatInfo::Clear() {
     succ_heart_count_ = fail_heart_count_ = min_heart_fail_count_ = 0;
     heart_type_ = kNoSmartHeartBeat;
     is_stable_ = false;
+    probe_low_ = MinHeartInterval;
+    probe_high_ = MaxHeartInterval;
+    noop_rtt_ = noop_rttvar_ = 0;
 }
@@ -27,7 +27,7 @@
 #include "mars/comm/tickcount.h"
 #include "mars/stn/config.h"
 
-#include "special_ini.h"
+#include "state_store.h"
 
 enum HeartbeatReportType {
     kReportTypeCompute            = 1,        // report info of compute smart heartbeat
@@ -70,6 +70,13 @@ class NetHeartbeatInfo {
     unsigned int succ_heart_count_;
     unsigned int min_heart_fail_count_;
 
+    // the nat timeout is searched between them, probe_low_ has kept the link, probe_high_ has not
+    unsigned int probe_low_;
+    unsigned int probe_high_;
+
+    unsigned int noop_rtt_;  // smoothed, 0 before the first noop came back
+    unsigned int noop_rttvar_;
+
     friend class SmartHeartbeat;
 };
 
@@ -85,6 +92,7 @@ class SmartHeartbeat {
     void OnLongLinkDisconnect();
     void OnHeartResult(bool _sucess, bool _fail_of_timeout);
     unsigned int GetNextHeartbeatInterval();   // bIsUseSmartBeat is add by andrewu for stat
+    unsigned int GetNoopTimeout(unsigned int _max) const;  // from the noop rtt of the network, _max before it is known
 
     // MIUI align alarm response at Times of five minutes, We should  handle this case specailly.
     void JudgeDozeStyle();
@@ -94,9 +102,12 @@ class SmartHeartbeat {
 
     bool __IsDozeStyle();
 
-    void __LimitINISize();
-    void __LoadINI();
-    void __SaveINI();
+    void __ProbeNextHeart();
+    void __OnNoopRtt(unsigned int _rtt);
+    void __OnNoopTimeout();
+
+    void __LoadState();
+    void __SaveState();
 
   private:
     bool is_wait_heart_response_;
@@ -105,7 +116,7 @@ class SmartHeartbeat {
     unsigned int last_heart_;
     NetHeartbeatInfo current_net_heart_info_;
 
-    SpecialINI ini_;
+    boost::shared_ptr<mars::stn::StateStore> store_;  // of all longlinks, read at the first one, not when a longlink is built
     
     int doze_mode_count_;
     int normal_mode_count_;
@@ -0,0 +1,311 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * state_store.cc
+ *
+ * file: magic, record count, the records, adler32 of all that. a record: seq, key length, key,
+ * value length, value. the integers are in the byte order of the device, the file never leaves it.
+ */
+
+#include "state_store.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <map>
+
+#include "boost/bind.hpp"
+#include "boost/filesystem.hpp"
+
+#include "mars/comm/adler32.h"
+#include "mars/comm/startup_pipeline.h"
+#include "mars/comm/thread/lock.h"
+#include "mars/comm/time_utils.h"
+#include "mars/comm/xlogger/xlogger.h"
+
+using namespace mars::stn;
+
+static const uint32_t kMagic = 0x3153534D;  // "MSS1"
+static const size_t kMaxFileSize = 1024 * 1024;
+
+template <typename T>
+static void __Append(std::string& _data, T _value) {
+    _data.append((const char*)&_value, sizeof(_value));
+}
+
+template <typename T>
+static bool __Take(const std::string& _data, size_t& _pos, T& _value) {
+    if (_data.size() - _pos < sizeof(_value)) return false;
+    memcpy(&_value, _data.data() + _pos, sizeof(_value));
+    _pos += sizeof(_value);
+    return true;
+}
+
+static bool __Take(const std::string& _data, size_t& _pos, size_t _len, std::string& _value) {
+    if (_data.size() - _pos < _len) return false;
+    _value.assign(_data, _pos, _len);
+    _pos += _len;
+    return true;
+}
+
+struct SharedStore {
+    SharedStore(): store(NULL), refs(0) {}
+    StateStore* store;
+    int refs;
+};
+
+static Mutex sg_shared_mutex;
+static std::map<std::string, SharedStore> sg_shared_stores;
+
+static void __ReleaseShared(StateStore* _store, const std::string& _path) {
+    ScopedLock lock(sg_shared_mutex);
+    std::map<std::string, SharedStore>::iterator it = sg_shared_stores.find(_path);
+    if (it == sg_shared_stores.end() || 0 < --it->second.refs) return;
+
+    // deleted under the lock, the next store of the path reads the file after this one wrote it
+    sg_shared_stores.erase(it);
+    delete _store;
+}
+
+boost::shared_ptr<StateStore> StateStore::Shared(const std::string& _path, size_t _max_records, int _write_delay) {
+    ScopedLock lock(sg_shared_mutex);
+    SharedStore& shared = sg_shared_stores[_path];
+    if (NULL == shared.store) shared.store = new StateStore(_path, _max_records, _write_delay);
+    ++shared.refs;
+    return boost::shared_ptr<StateStore>(shared.store, boost::bind(&__ReleaseShared, _1, _path));
+}
+
+StateStore::StateStore(const std::string& _path, size_t _max_records, int _write_delay)
+    : path_(_path)
+    , max_records_(_max_records)
+    , write_delay_(_write_delay)
+    , next_seq_(1)
+    , loaded_(false)
+    , dirty_(false)
+    , writes_(0)
+    , write_alarm_(boost::bind(&StateStore::Flush, this))
+{}
+
+StateStore::~StateStore() {
+    write_alarm_.Cancel();
+    Flush();
+}
+
+bool StateStore::Get(const std::string& _key, std::string& _value) const {
+    ScopedLock lock(mutex_);
+    __Load();
+
+    std::map<std::string, Record>::const_iterator it = records_.find(_key);
+    if (it == records_.end()) return false;
+
+    _value = it->second.value;
+    return true;
+}
+
+void StateStore::Put(const std::string& _key, const std::string& _value) {
+    ScopedLock lock(mutex_);
+    __Load();
+
+    Record& record = records_[_key];
+    record.seq = next_seq_++;
+    record.value = _value;
+
+    while (0 < max_records_ && max_records_ < records_.size()) {
+        std::map<std::string, Record>::iterator oldest = records_.begin();
+        for (std::map<std::string, Record>::iterator it = records_.begin(); it != records_.end(); ++it) {
+            if (it->second.seq < oldest->second.seq) oldest = it;
+        }
+        records_.erase(oldest);
+    }
+
+    __Dirty();
+}
+
+bool StateStore::Erase(const std::string& _key) {
+    ScopedLock lock(mutex_);
+    __Load();
+
+    if (0 == records_.erase(_key)) return false;
+    __Dirty();
+    return true;
+}
+
+void StateStore::Keys(std::vector<std::string>& _keys) const {
+    ScopedLock lock(mutex_);
+    __Load();
+
+    _keys.clear();
+    for (std::map<std::string, Record>::const_iterator it = records_.begin(); it != records_.end(); ++it) {
+        _keys.push_back(it->first);
+    }
+}
+
+size_t StateStore::Size() const {
+    ScopedLock lock(mutex_);
+    __Load();
+    return records_.size();
+}
+
+bool StateStore::Flush() {
+    // one writer at a time, the table is only locked while it is serialized
+    ScopedLock file_lock(file_mutex_);
+
+    ScopedLock lock(mutex_);
+    if (!dirty_) return true;
+
+    std::string data;
+    __Serialize(data);
+    dirty_ = false;
+    lock.unlock();
+
+    if (__WriteFile(data)) return true;
+
+    lock.lock();
+    dirty_ = true;
+    write_alarm_.Start(write_delay_);
+    return false;
+}
+
+uint64_t StateStore::Writes() const {
+    ScopedLock lock(mutex_);
+    return writes_;
+}
+
+void StateStore::__Load() const {
+    if (loaded_) return;
+    loaded_ = true;
+
+    uint64_t begin = ::gettickcount();
+    FILE* file = fopen(path_.c_str(), "rb");
+    if (NULL == file) return;
+
+    std::string data;
+    char buffer[4096];
+    size_t len = 0;
+    while (0 < (len = fread(buffer, 1, sizeof(buffer), file)) && data.size() < kMaxFileSize) data.append(buffer, len);
+    fclose(file);
+
+    __Parse(data);
+    StartupPipeline::Shared().Record(boost::filesystem::path(path_).filename().string().c_str(), begin, ::gettickcount() - begin);
+}
+
+void StateStore::__Parse(const std::string& _data) const {
+    uint32_t checksum = 0;
+    if (_data.size() < sizeof(kMagic) + sizeof(uint32_t) + sizeof(checksum)) {
+        xwarn2(TSF"state file %_ too short:%_", path_, _data.size());
+        return;
+    }
+
+    size_t body = _data.size() - sizeof(checksum);
+    memcpy(&checksum, _data.data() + body, sizeof(checksum));
+    if (checksum != (uint32_t)adler32(1, (const unsigned char*)_data.data(), (unsigned int)body)) {
+        xerror2(TSF"state file %_ checksum mismatch, dropped", path_);
+        return;
+    }
+
+    std::string records(_data, 0, body);
+    size_t pos = 0;
+    uint32_t magic = 0, count = 0;
+    if (!__Take(records, pos, magic) || kMagic != magic || !__Take(records, pos, count)) {
+        xerror2(TSF"state file %_ bad header", path_);
+        return;
+    }
+
+    std::map<std::string, Record> parsed;
+    uint32_t max_seq = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        Record record;
+        uint16_t keylen = 0;
+        uint32_t valuelen = 0;
+        std::string key;
+
+        if (!__Take(records, pos, record.seq) || !__Take(records, pos, keylen) || !__Take(records, pos, keylen, key)
+                || !__Take(records, pos, valuelen) || !__Take(records, pos, valuelen, record.value)) {
+            xerror2(TSF"state file %_ truncated record %_ of %_", path_, i, count);
+            return;
+        }
+
+        max_seq = std::max(max_seq, record.seq);
+        parsed[key] = record;
+    }
+
+    records_.swap(parsed);
+    next_seq_ = max_seq + 1;
+}
+
+void StateStore::__Serialize(std::string& _data) const {
+    __Append(_data, kMagic);
+    __Append(_data, (uint32_t)records_.size());
+
+    for (std::map<std::string, Record>::const_iterator it = records_.begin(); it != records_.end(); ++it) {
+        __Append(_data, it->second.seq);
+        __Append(_data, (uint16_t)it->first.size());
+        _data.append(it->first);
+        __Append(_data, (uint32_t)it->second.value.size());
+        _data.append(it->second.value);
+    }
+
+    __Append(_data, (uint32_t)adler32(1, (const unsigned char*)_data.data(), (unsigned int)_data.size()));
+}
+
+bool StateStore::__WriteFile(const std::string& _data) {
+    // another process may write the file at the same time
+    char suffix[32] = {0};
+#ifdef _WIN32
+    snprintf(suffix, sizeof(suffix), ".%d.tmp", (int)_getpid());
+#else
+    snprintf(suffix, sizeof(suffix), ".%d.tmp", (int)getpid());
+#endif
+    std::string tmp_path = path_ + suffix;
+    FILE* file = fopen(tmp_path.c_str(), "wb");
+    if (NULL == file) {
+        xerror2(TSF"open %_ error:%_", tmp_path, strerror(errno));
+        return false;
+    }
+
+    bool written = _data.size() == fwrite(_data.data(), 1, _data.size(), file) && 0 == fflush(file);
+#ifdef _WIN32
+    written = written && 0 == _commit(_fileno(file));
+#else
+    written = written && 0 == fsync(fileno(file));
+#endif
+    fclose(file);
+
+    boost::system::error_code ec;
+    if (written) boost::filesystem::rename(tmp_path, path_, ec);
+
+    if (!written || ec) {
+        xerror2(TSF"write %_ error, written:%_, rename:%_", path_, written, ec.message());
+        boost::filesystem::remove(tmp_path, ec);
+        return false;
+    }
+
+    ScopedLock lock(mutex_);
+    ++writes_;
+    return true;
+}
+
+void StateStore::__Dirty() {
+    if (dirty_) return;
+
+    dirty_ = true;
+    write_alarm_.Start(write_delay_);
+}
@@ -0,0 +1,94 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * state_store.h
+ *
+ * a small table of binary records persisted in one file, for the state stn keeps per network.
+ * the file is read at first use, Put only changes the table in memory and the file is written
+ * behind, _write_delay after the first change that is not on disk yet.
+ * a write goes to a temporary file that replaces the old one, a file that does not check out
+ * is dropped, so a crash leaves the last complete table.
+ * two stores of one path would write over each other, the users of a file share it by Shared.
+ */
+
+#ifndef STN_SRC_STATE_STORE_H_
+#define STN_SRC_STATE_STORE_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "boost/shared_ptr.hpp"
+
+#include "mars/comm/alarm.h"
+#include "mars/comm/thread/mutex.h"
+
+namespace mars {
+namespace stn {
+
+class StateStore {
+  public:
+    // _max_records 0 is no limit, otherwise the record put least recently goes first
+    StateStore(const std::string& _path, size_t _max_records = 0, int _write_delay = 5 * 1000);
+    ~StateStore();  // writes what is not on disk yet
+
+    // the store of _path in this process, made by the first caller with its _max_records and _write_delay,
+    // it goes when the last caller lets it go
+    static boost::shared_ptr<StateStore> Shared(const std::string& _path, size_t _max_records = 0, int _write_delay = 5 * 1000);
+
+    bool Get(const std::string& _key, std::string& _value) const;
+    void Put(const std::string& _key, const std::string& _value);
+    bool Erase(const std::string& _key);
+    void Keys(std::vector<std::string>& _keys) const;
+    size_t Size() const;
+
+    bool Flush();  // writes now if anything changed, block api
+    uint64_t Writes() const;
+
+  private:
+    StateStore(const StateStore&);
+    StateStore& operator=(const StateStore&);
+
+    struct Record {
+        Record(): seq(0) {}
+        uint32_t seq;  // when it was put last
+        std::string value;
+    };
+
+    void __Load() const;
+    void __Parse(const std::string& _data) const;
+    void __Serialize(std::string& _data) const;
+    bool __WriteFile(const std::string& _data);
+    void __Dirty();
+
+  private:
+    std::string path_;
+    size_t max_records_;
+    int write_delay_;
+
+    mutable Mutex mutex_;
+    mutable std::map<std::string, Record> records_;
+    mutable uint32_t next_seq_;
+    mutable bool loaded_;
+    bool dirty_;
+    uint64_t writes_;
+
+    Mutex file_mutex_;
+    Alarm write_alarm_;  // last, it is joined before the rest is gone
+};
+
+}}
+
+#endif  // STN_SRC_STATE_STORE_H_
@@ -70,4 +70,18 @@ bool __CompareTask(const TaskProfile& _first, const TaskProfile& _second) {
     return _first.task.priority < _second.task.priority;
 }
 
+uint64_t __FlowDeferredWait(const std::list<TaskProfile>& _tasks) {
+    uint64_t curtime = ::gettickcount();
+    uint64_t wait = 0;
+
+    for (std::list<TaskProfile>::const_iterator it = _tasks.begin(); it != _tasks.end(); ++it) {
+        if (!it->flow_deferred || 0 != it->running_id || it->retry_time_interval <= curtime - it->retry_start_time) return 0;
+
+        uint64_t left = it->retry_time_interval - (curtime - it->retry_start_time);
+        wait = 0 == wait ? left : std::min(wait, left);
+    }
+
+    return wait;
+}
+
 }}
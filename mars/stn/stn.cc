@@ -48,6 +48,7 @@ Task::Task(uint32_t _taskid) {
     retry_count = -1;
     server_process_cost = -1;
     total_timetout = -1;
+    stream_response = false;
     user_context = NULL;
 
 }
@@ -24,7 +24,9 @@
 
 #include <stdint.h>
 
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "mars/comm/autobuffer.h"
@@ -86,6 +88,7 @@ public:
     int32_t     retry_count;  // user
     int32_t     server_process_cost;  // user
     int32_t     total_timetout;  // user ms
+    bool        stream_response;  // user, the body goes to OnResponseChunk as it arrives and Buf2Resp gets an empty one
     
     void*       user_context;  // user
     std::string report_arg;  // user for cgi report
@@ -214,11 +217,47 @@ struct IPPortItem {
     IPSourceType 	source_type;
     std::string 	str_host;
 };
+
+// bytes per second and the bytes that may go at once
+struct FlowQuota {
+    FlowQuota(int _rate = 0, int _burst = 0): rate(_rate), burst(_burst) {}
+    int rate;
+    int burst;
+};
+
+// the flow limit of the limit_flow tasks on mobile networks. a task takes its bytes from the global
+// bucket, the bucket of its channel if it has one and the bucket of its cmdid. once its cmdid is
+// out of bytes, it borrows from the buckets above while they keep a reserve, a bigger one for a
+// lower priority, so one chatty cmdid cannot use up the budget of the others.
+struct FlowLimitStrategy {
+    FlowLimitStrategy();
+    int active_rate;  // global, while the app is in the foreground
+    int inactive_rate;
+    int burst;
+    std::map<int, FlowQuota> channel_quotas;  // Task::kChannelShort, Task::kChannelLong
+    FlowQuota cmdid_quota;  // of the cmdids not in cmdid_quotas, a burst of 0 leaves them unlimited
+    std::map<uint32_t, FlowQuota> cmdid_quotas;
+};
+
+// the latency stn has seen for a cgi on one type of network, from sending the request, in ms
+struct CgiLatencyProfile {
+    std::string cgi;
+    int net_type;  // kWifi, kMobile, ... of getNetInfo
+    uint32_t samples;  // halved every 1024, the recent ones count more
+    uint64_t first_pkg_p50;
+    uint64_t first_pkg_p99;
+    uint64_t total_p50;
+    uint64_t total_p99;
+    std::vector<std::pair<uint64_t, uint32_t> > first_pkg_histogram;  // bucket upper bound, count
+    std::vector<std::pair<uint64_t, uint32_t> > total_histogram;
+};
         
 extern bool (*MakesureAuthed)();
 
 //流量统计
 extern void (*TrafficData)(ssize_t _send, ssize_t _recv);
+//同一份流量按通道(Task::kChannelShort/kChannelLong)和cmdid再报一次, 在io线程上调用
+extern void (*TrafficCmdData)(int _channel, uint32_t _cmdid, ssize_t _send, ssize_t _recv);
         
 //底层询问上层该host对应的ip列表 
 extern std::vector<std::string> (*OnNewDns)(const std::string& host);
@@ -230,6 +269,10 @@ extern bool (*Req2Buf)(uint32_t taskid, void* const user_context, AutoBuffer& ou
 extern int (*Buf2Resp)(uint32_t taskid, void* const user_context, const AutoBuffer& inbuffer, const AutoBuffer& extend, int& error_code, const int channel_select);
 //任务执行结束 
 extern int  (*OnTaskEnd)(uint32_t taskid, void* const user_context, int error_type, int error_code);
+//回包分段交给上层, 只对stream_response的task; (NULL, 0)表示回包(重新)开始, 重试时上一次的分段作废
+//在LongLink的socket线程和ShortLink的工作线程上同步调用, 回调慢会拖住这条连接的收发, 耗时的处理请抛到别的线程
+//短连接只分段交出http 200的回包, 其他状态码的回包不交给上层, 任务按kEctHttp失败
+extern void (*OnResponseChunk)(uint32_t taskid, const void* data, size_t len);
 
 //上报网络连接状态 
 extern void (*ReportConnectStatus)(int status, int longlink_status);
@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <string>
 #include <map>
+#include <algorithm>
 
 #include "mars/log/appender.h"
 
@@ -34,10 +35,13 @@
 #include "mars/comm/singleton.h"
 #include "mars/comm/bootrun.h"
 #include "mars/comm/platform_comm.h"
+#include "mars/comm/startup_pipeline.h"
 #include "mars/boost/signals2.hpp"
 #include "stn/src/net_core.h"//一定要放这里，Mac os 编译
 #include "stn/src/net_source.h"
 #include "stn/src/signalling_keeper.h"
+#include "stn/src/longlink_task_manager.h"
+#include "stn/src/flow_limit.h"
 #include "stn/src/proxy_test.h"
 
 #ifdef WIN32
@@ -85,9 +89,16 @@ static void onCreate() {
 #endif
 
     xinfo2(TSF"stn oncreate");
-    ActiveLogic::Singleton::Instance();
-    NetCore::Singleton::Instance();
-
+    StartupPipeline& pipeline = StartupPipeline::Shared();
+    pipeline.Run("active_logic", [] { ActiveLogic::Singleton::Instance(); });
+    pipeline.Run("net_core", [] { NetCore::Singleton::Instance(); });
+
+    // the first connect waits for what is not read by then, a destroy in between waits for the read
+    pipeline.Spawn("ipport_records", [] {
+        boost::shared_ptr<NetCore> stn_ptr = NetCore::Singleton::Instance_Weak().lock();
+        if (stn_ptr) stn_ptr->GetNetSourceRef().PrefetchRecords();
+    });
+    pipeline.Finish();
 }
 
 static void onDestroy() {
@@ -171,6 +182,12 @@ bool (*HasTask)(uint32_t _taskid)
 	return has_task;
 };
 
+void (*GetCgiLatencies)(std::vector<CgiLatencyProfile>& _latencies)
+= [](std::vector<CgiLatencyProfile>& _latencies) {
+    _latencies.clear();
+    STN_WEAK_CALL(GetCgiLatencies(_latencies));
+};
+
 void (*RedoTasks)()
 = []() {
    STN_WEAK_CALL(RedoTasks());
@@ -247,6 +264,18 @@ void (*SetSignallingStrategy)(long _period, long _keepTime)
     SignallingKeeper::SetStrategy((unsigned int)_period, (unsigned int)_keepTime);
 };
 
+void (*SetLongLinkPoolStrategy)(int _pool_size, int _bulk_send_size, bool _spread_ips)
+= [](int _pool_size, int _bulk_send_size, bool _spread_ips) {
+#ifdef USE_LONG_LINK
+    LongLinkTaskManager::SetPoolStrategy((unsigned int)std::max(1, _pool_size), (size_t)std::max(0, _bulk_send_size), _spread_ips);
+#endif
+};
+
+void (*SetFlowLimitStrategy)(const FlowLimitStrategy& _strategy)
+= [](const FlowLimitStrategy& _strategy) {
+    FlowLimit::SetStrategy(_strategy);
+};
+
 void (*KeepSignalling)()
 = []() {
 #ifdef USE_LONG_LINK
@@ -283,6 +312,12 @@ void (*TrafficData)(ssize_t _send, ssize_t _recv)
     return sg_callback->TrafficData(_send, _recv);
 };
 
+void (*TrafficCmdData)(int _channel, uint32_t _cmdid, ssize_t _send, ssize_t _recv)
+= [](int _channel, uint32_t _cmdid, ssize_t _send, ssize_t _recv) {
+    xassert2(sg_callback != NULL);
+    sg_callback->TrafficCmdData(_channel, _cmdid, _send, _recv);
+};
+
 //底层询问上层该host对应的ip列表 
 std::vector<std::string> (*OnNewDns)(const std::string& host)
 = [](const std::string& host) {
@@ -314,6 +349,12 @@ int  (*OnTaskEnd)(uint32_t taskid, void* const user_context, int error_type, int
 	xassert2(sg_callback != NULL);
 	return sg_callback->OnTaskEnd(taskid, user_context, error_type, error_code);
  };
+//回包分段回调 
+void (*OnResponseChunk)(uint32_t taskid, const void* data, size_t len)
+= [](uint32_t taskid, const void* data, size_t len) {
+	xassert2(sg_callback != NULL);
+	sg_callback->OnResponseChunk(taskid, data, len);
+};
 
 //上报网络连接状态 
 void (*ReportConnectStatus)(int status, int longlink_status)
@@ -45,6 +45,8 @@ namespace stn{
         
         //流量统计 
         virtual void TrafficData(ssize_t _send, ssize_t _recv) = 0;
+        //按通道和cmdid的流量, 在io线程上调用 
+        virtual void TrafficCmdData(int _channel, uint32_t _cmdid, ssize_t _send, ssize_t _recv) {}
         
         //底层询问上层该host对应的ip列表 
         virtual std::vector<std::string> OnNewDns(const std::string& host) = 0;
@@ -56,6 +58,9 @@ namespace stn{
         virtual int Buf2Resp(uint32_t _taskid, void* const _user_context, const AutoBuffer& _inbuffer, const AutoBuffer& _extend, int& _error_code, const int _channel_select) = 0;
         //任务执行结束 
         virtual int  OnTaskEnd(uint32_t _taskid, void* const _user_context, int _error_type, int _error_code) = 0;
+        //stream_response的task回包分段回调, (NULL, 0)表示回包(重新)开始 
+        //在网络线程上同步调用, 回调慢会拖住连接, 见stn.h的OnResponseChunk
+        virtual void OnResponseChunk(uint32_t _taskid, const void* _data, size_t _len) {}
 
 
         //上报网络连接状态 
@@ -111,6 +116,9 @@ namespace stn{
     // check whether task's list has the task or not.
 	extern bool (*HasTask)(uint32_t taskid);
 
+    // the latency histograms of the cgis on each type of network, their p99 sets the timeouts of the tasks
+	extern void (*GetCgiLatencies)(std::vector<CgiLatencyProfile>& latencies);
+
     // reconnect longlink and redo all task
     // when you change svr ip, you must call this function.
 	extern void (*RedoTasks)();
@@ -125,6 +133,17 @@ namespace stn{
     //if you did not call this function, stn will use default value: period:  5s, keeptime: 20s
 	extern void (*SetSignallingStrategy)(long period, long keeptime);
 
+    //run longlink tasks on up to 'pool_size' connections: the first one carries interactive tasks,
+    //the others tasks with priority lower than kTaskPriorityNormal or requests of at least 'bulk_send_size' bytes.
+    //'spread_ips' starts each connection from a different longlink ip.
+    //call it before the tasks start. if you did not call this function, stn will use one connection.
+	extern void (*SetLongLinkPoolStrategy)(int pool_size, int bulk_send_size, bool spread_ips);
+
+    //the rates and bursts of the flow limit, see FlowLimitStrategy. a task over them waits for its bytes
+    //when it can get them before its timeout, otherwise it fails with kEctLocalAntiAvalanche.
+    //call it before the tasks start. if you did not call this function, stn will use FlowLimitStrategy().
+	extern void (*SetFlowLimitStrategy)(const FlowLimitStrategy& strategy);
+
     // used to keep longlink active
     // keep signnaling once 'period' and last 'keeptime'
 	extern void (*KeepSignalling)();
@@ -157,6 +157,7 @@ struct TransferProfile {
         loop_start_task_time = 0;
         first_start_send_time = 0;
         start_send_time = 0;
+        first_receive_pkg_time = 0;
         last_receive_pkg_time = 0;
         read_write_timeout = 0;
         first_pkg_timeout = 0;
@@ -178,6 +179,7 @@ struct TransferProfile {
     uint64_t loop_start_task_time;  // ms
     uint64_t first_start_send_time; //ms
     uint64_t start_send_time;    // ms
+    uint64_t first_receive_pkg_time;  // ms
     uint64_t last_receive_pkg_time;  // ms
     uint64_t read_write_timeout;    // ms
     uint64_t first_pkg_timeout;  // ms
@@ -243,6 +245,7 @@ struct TaskProfile {
         current_dyntime_status = 0;
         
         antiavalanche_checked = false;
+        flow_deferred = false;
         
         use_proxy = false;
         retry_time_interval = 0;
@@ -289,6 +292,7 @@ struct TaskProfile {
     int current_dyntime_status;
     
     bool antiavalanche_checked;
+    bool flow_deferred;  // waiting retry_time_interval for the flow limit, the frequency limit counted it already
     
     bool use_proxy;
     uint64_t retry_time_interval;    // ms
@@ -305,6 +309,7 @@ void __SetLastFailedStatus(std::list<TaskProfile>::iterator _it);
 uint64_t __ReadWriteTimeout(uint64_t  _first_pkg_timeout);
 uint64_t  __FirstPkgTimeout(int64_t  _init_first_pkg_timeout, size_t _sendlen, int _send_count, int _dynamictimeout_status);
 bool __CompareTask(const TaskProfile& _first, const TaskProfile& _second);
+uint64_t __FlowDeferredWait(const std::list<TaskProfile>& _tasks);  // until the first waits no more, 0 unless all of them wait for the flow limit
 }}
 
 #endif
@@ -0,0 +1,144 @@
+#include "gtest/gtest.h"
+
+#include "../src/anti_avalanche.h"
+#include "../src/flow_limit.h"
+#include "../stn.h"
+
+using namespace mars::stn;
+
+// no refill, so the counts do not depend on the clock
+static FlowLimitStrategy StaticStrategy(int _burst, const FlowQuota& _cmdid_quota) {
+    FlowLimitStrategy strategy;
+    strategy.active_rate = 0;
+    strategy.inactive_rate = 0;
+    strategy.burst = _burst;
+    strategy.cmdid_quota = _cmdid_quota;
+    return strategy;
+}
+
+static int SendUntilLimited(FlowLimit& _limit, const Task& _task, int _len) {
+    uint64_t wait = 0;
+    int sent = 0;
+    while (sent < 1000 && _limit.Check(_task, Task::kChannelLong, _len, wait)) ++sent;
+    return sent;
+}
+
+class FlowLimitTest : public testing::Test {
+  protected:
+    virtual void TearDown() { FlowLimit::SetStrategy(FlowLimitStrategy()); }
+};
+
+TEST_F(FlowLimitTest, ChattyCmdIdKeepsOthersGoing) {
+    FlowLimit::SetStrategy(StaticStrategy(1000, FlowQuota(0, 100)));
+    FlowLimit limit(true);
+
+    Task chatty;
+    chatty.cmdid = 1;
+    chatty.priority = Task::kTaskPriorityLowest;
+
+    // its own 100 bytes, then it borrows until the global bucket is down to the reserve of 500
+    EXPECT_EQ(5, SendUntilLimited(limit, chatty, 100));
+
+    Task other;
+    other.cmdid = 2;
+    other.priority = Task::kTaskPriorityLowest;
+    EXPECT_EQ(1, SendUntilLimited(limit, other, 100));
+}
+
+TEST_F(FlowLimitTest, HigherPriorityBorrowsMore) {
+    FlowLimit::SetStrategy(StaticStrategy(1000, FlowQuota(0, 100)));
+    FlowLimit limit(true);
+
+    Task task;
+    task.cmdid = 1;
+    task.priority = Task::kTaskPriorityLowest;
+    EXPECT_EQ(5, SendUntilLimited(limit, task, 100));
+
+    // no reserve is kept from the highest priority
+    task.priority = Task::kTaskPriorityHighest;
+    EXPECT_EQ(5, SendUntilLimited(limit, task, 100));
+}
+
+TEST_F(FlowLimitTest, WaitUntilRefilled) {
+    FlowLimitStrategy strategy = StaticStrategy(1000, FlowQuota());
+    strategy.active_rate = 1000;
+    FlowLimit::SetStrategy(strategy);
+    FlowLimit limit(true);
+
+    Task task;
+    uint64_t wait = 0;
+    EXPECT_TRUE(limit.Check(task, Task::kChannelLong, 1000, wait));
+    EXPECT_EQ(0u, wait);
+
+    EXPECT_FALSE(limit.Check(task, Task::kChannelLong, 500, wait));
+    EXPECT_LT(400u, wait);
+    EXPECT_GE(500u, wait);
+}
+
+TEST_F(FlowLimitTest, BiggerThanBurstNeverGoes) {
+    FlowLimit::SetStrategy(StaticStrategy(1000, FlowQuota()));
+    FlowLimit limit(true);
+
+    Task task;
+    uint64_t wait = 0;
+    EXPECT_FALSE(limit.Check(task, Task::kChannelLong, 1001, wait));
+    EXPECT_EQ(FlowLimit::kNever, wait);
+
+    task.limit_flow = false;
+    EXPECT_TRUE(limit.Check(task, Task::kChannelLong, 1001, wait));
+}
+
+TEST_F(FlowLimitTest, ChannelQuota) {
+    FlowLimitStrategy strategy = StaticStrategy(1000, FlowQuota());
+    strategy.channel_quotas[Task::kChannelShort] = FlowQuota(0, 200);
+    FlowLimit::SetStrategy(strategy);
+    FlowLimit limit(true);
+
+    Task task;
+    uint64_t wait = 0;
+    EXPECT_TRUE(limit.Check(task, Task::kChannelShort, 200, wait));
+    EXPECT_FALSE(limit.Check(task, Task::kChannelShort, 100, wait));
+    EXPECT_TRUE(limit.Check(task, Task::kChannelLong, 800, wait));
+}
+
+TEST_F(FlowLimitTest, InactiveKeepsAQuarter) {
+    FlowLimit::SetStrategy(StaticStrategy(1000, FlowQuota()));
+    FlowLimit limit(true);
+
+    Task task;
+    uint64_t wait = 0;
+    EXPECT_TRUE(limit.Check(task, Task::kChannelLong, 1000, wait));
+
+    limit.Active(false);
+    EXPECT_TRUE(limit.Check(task, Task::kChannelLong, 250, wait));
+    EXPECT_FALSE(limit.Check(task, Task::kChannelLong, 1, wait));
+}
+
+// a deferred task comes back to the check, only its final failure counts
+TEST_F(FlowLimitTest, DeferredTaskIsCheckedOnce) {
+    FlowLimitStrategy strategy = StaticStrategy(1000, FlowQuota());
+    strategy.active_rate = 1000;
+    FlowLimit::SetStrategy(strategy);
+    AntiAvalanche anti_avalanche(true);
+
+    Task task;
+    task.limit_flow = false;
+    char buffer[128] = {0};
+    uint64_t defer = 0;
+
+    // the frequency limit stops the same buffer at 105, but not the checks of a deferred task
+    int sent = 0;
+    while (sent < 200 && anti_avalanche.Check(task, buffer, sizeof(buffer), Task::kChannelLong, false, 0, defer)) ++sent;
+    EXPECT_EQ(105, sent);
+    EXPECT_TRUE(anti_avalanche.Check(task, buffer, sizeof(buffer), Task::kChannelLong, true, 0, defer));
+
+    task.limit_flow = true;
+    buffer[0] = 1;
+    EXPECT_TRUE(anti_avalanche.Check(task, buffer, 1000, Task::kChannelLong, false, 0, defer));
+
+    // tokens for 500 bytes come in ~500ms, it waits for them only before its timeout
+    EXPECT_FALSE(anti_avalanche.Check(task, buffer, 500, Task::kChannelLong, true, 10 * 1000, defer));
+    EXPECT_LT(400u, defer);
+    EXPECT_FALSE(anti_avalanche.Check(task, buffer, 500, Task::kChannelLong, true, 100, defer));
+    EXPECT_EQ(0u, defer);
+}
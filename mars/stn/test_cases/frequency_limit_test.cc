@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../src/frequency_limit.h"
+#include "../stn.h"
+#include "../../comm/adler32.h"
+#include "../../comm/xxhash64.h"
+#include "../../comm/time_utils.h"
+
+using namespace mars::stn;
+
+TEST(FrequencyLimit, SameBufferIsLimited) {
+    FrequencyLimit limit;
+    Task task;
+    task.limit_frequency = true;
+    char buffer[128] = {0};
+
+    int i = 0;
+    unsigned int span = 0;
+    for (; i < 200; ++i) {
+        if (!limit.Check(task, buffer, sizeof(buffer), span)) break;
+    }
+    EXPECT_EQ(105, i);
+
+    // a different buffer has its own record
+    buffer[0] = 1;
+    EXPECT_TRUE(limit.Check(task, buffer, sizeof(buffer), span));
+}
+
+TEST(FrequencyLimit, CapacityIsBounded) {
+    FrequencyLimit limit(1000);
+    EXPECT_EQ(1024u, limit.Capacity());
+
+    Task task;
+    task.limit_frequency = true;
+    unsigned int span = 0;
+
+    // far more distinct requests than slots: old ones get evicted, none are limited
+    for (int i = 0; i < 100000; ++i) {
+        EXPECT_TRUE(limit.Check(task, &i, sizeof(i), span));
+    }
+    EXPECT_EQ(1024u, limit.Capacity());
+}
+
+TEST(FrequencyLimit, Benchmark) {
+    std::vector<unsigned char> upload(4 * 1024 * 1024);
+    for (size_t i = 0; i < upload.size(); ++i) upload[i] = (unsigned char)(i * 131);
+
+    const int rounds = 20;
+    volatile uint64_t sink = 0;
+
+    uint64_t start = gettickcount();
+    for (int i = 0; i < rounds; ++i) sink += adler32(0, &upload[0], (unsigned int)upload.size());
+    uint64_t adler_cost = gettickcount() - start;
+
+    start = gettickcount();
+    for (int i = 0; i < rounds; ++i) sink += xxh64(&upload[0], upload.size(), 0);
+    uint64_t xxh_cost = gettickcount() - start;
+
+    printf("hash 4MB x %d: adler32 %llums, xxh64 %llums\n", rounds, (unsigned long long)adler_cost, (unsigned long long)xxh_cost);
+
+    FrequencyLimit limit;
+    Task task;
+    task.limit_frequency = true;
+    unsigned int span = 0;
+    char buffer[256] = {0};
+
+    const int checks = 1000000;
+    start = gettickcount();
+    for (int i = 0; i < checks; ++i) {
+        memcpy(buffer, &i, sizeof(i));
+        limit.Check(task, buffer, sizeof(buffer), span);
+    }
+    uint64_t check_cost = gettickcount() - start;
+    printf("check 256B x %d distinct: %llums\n", checks, (unsigned long long)check_cost);
+}
@@ -0,0 +1,101 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../src/latency_sketch.h"
+#include "../src/dynamic_timeout.h"
+#include "../config.h"
+
+using namespace mars::stn;
+
+TEST(LatencySketch, SmallValuesAreExact) {
+    LatencySketch sketch;
+    EXPECT_EQ(0u, sketch.Percentile(99));
+
+    for (uint64_t i = 0; i < 8; ++i) sketch.Add(i);
+    EXPECT_EQ(8u, sketch.Count());
+    EXPECT_EQ(0u, sketch.Percentile(0));
+    EXPECT_EQ(3u, sketch.Percentile(50));
+    EXPECT_EQ(7u, sketch.Percentile(100));
+}
+
+TEST(LatencySketch, PercentileWithinABucket) {
+    srand(1);
+    LatencySketch sketch;
+    std::vector<uint64_t> samples;
+    for (int i = 0; i < 1000; ++i) {
+        // mostly 100-400ms, a tail up to seconds
+        uint64_t ms = 100 + rand() % 300 + (0 == i % 50 ? rand() % 5000 : 0);
+        samples.push_back(ms);
+        sketch.Add(ms);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    const double percents[] = {50, 90, 99};
+    for (size_t i = 0; i < sizeof(percents) / sizeof(percents[0]); ++i) {
+        uint64_t exact = samples[(size_t)ceil(samples.size() * percents[i] / 100) - 1];
+        uint64_t estimate = sketch.Percentile(percents[i]);
+        EXPECT_LE(exact, estimate);
+        EXPECT_LE(estimate, exact + exact / 8) << percents[i];
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t> > buckets;
+    sketch.Buckets(buckets);
+    uint32_t total = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) total += buckets[i].second;
+    EXPECT_EQ(sketch.Count(), total);
+}
+
+TEST(LatencySketch, OldSamplesDecay) {
+    LatencySketch sketch;
+    for (uint32_t i = 0; i < LatencySketch::kDecayCount - 1; ++i) sketch.Add(5000);
+    EXPECT_GE(sketch.Percentile(50), 5000u);
+
+    // after a few halvings the fast network is all that is left
+    for (uint32_t i = 0; i < 4 * LatencySketch::kDecayCount; ++i) sketch.Add(100);
+    EXPECT_LT(sketch.Count(), LatencySketch::kDecayCount);
+    EXPECT_LE(sketch.Percentile(99), 111u);
+}
+
+TEST(LatencySketch, HugeValuesShareTheLastBucket) {
+    LatencySketch sketch;
+    sketch.Add(UINT64_MAX);
+    sketch.Add(10 * 60 * 1000);
+    EXPECT_EQ((1u << 18) - 1, sketch.Percentile(100));
+}
+
+TEST(DynamicTimeout, CgiTimeoutFollowsP99) {
+    DynamicTimeout dynamic_timeout;
+    uint64_t first_pkg_timeout = 12 * 1000;
+    uint64_t read_write_timeout = 20 * 1000;
+
+    for (unsigned int i = 0; i + 1 < kDynTimeLatencyMinSamples; ++i) dynamic_timeout.CgiLatencyStatistic("/fast", 200, 300);
+    EXPECT_FALSE(dynamic_timeout.CgiTimeout("/fast", first_pkg_timeout, read_write_timeout));
+    EXPECT_EQ(12u * 1000, first_pkg_timeout);
+
+    dynamic_timeout.CgiLatencyStatistic("/fast", 200, 300);
+    EXPECT_TRUE(dynamic_timeout.CgiTimeout("/fast", first_pkg_timeout, read_write_timeout));
+    EXPECT_EQ(kDynTimeLatencyMinFirstPkgTimeout, first_pkg_timeout);
+    EXPECT_EQ(kDynTimeLatencyMinFirstPkgTimeout, read_write_timeout);
+
+    // a slow cgi gets more than the fixed rule, as far as a big request would
+    for (unsigned int i = 0; i < kDynTimeLatencyMinSamples; ++i) dynamic_timeout.CgiLatencyStatistic("/slow", 10 * 1000, 14 * 1000);
+    first_pkg_timeout = 12 * 1000;
+    read_write_timeout = 20 * 1000;
+    EXPECT_TRUE(dynamic_timeout.CgiTimeout("/slow", first_pkg_timeout, read_write_timeout));
+    EXPECT_LT(12u * 1000, first_pkg_timeout);
+    EXPECT_LE(first_pkg_timeout, std::max(kMaxFirstPackageWifiTimeout, kMaxFirstPackageGPRSTimeout));
+    EXPECT_LT(first_pkg_timeout, read_write_timeout);
+
+    std::vector<CgiLatencyProfile> latencies;
+    dynamic_timeout.GetCgiLatencies(latencies);
+    ASSERT_EQ(2u, latencies.size());
+    EXPECT_EQ("/fast", latencies[0].cgi);
+    EXPECT_EQ(kDynTimeLatencyMinSamples, latencies[0].samples);
+    EXPECT_EQ(207u, latencies[0].first_pkg_p99);
+    EXPECT_EQ(1u, latencies[0].first_pkg_histogram.size());
+}
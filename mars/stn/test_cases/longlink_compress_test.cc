@@ -0,0 +1,267 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * longlink_compress_test.cc
+ *
+ * bytes on the wire and cpu per MB of the longlink packer's deflate on a few kinds of payload,
+ * and that nothing gets deflated towards a server that does not answer with the extended header.
+ */
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <random>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/xlogger/xlogger.h"
+#include "mars/stn/proto/longlink_packer.h"
+#include "mars/stn/proto/stnproto_logic.h"
+
+using namespace mars::stn;
+
+static const size_t kThreshold = 256;
+static const size_t kWireBytesPerRun = 32 * 1024 * 1024;
+
+// field names and values the messages of an im protocol keep repeating
+static const char* const kDictionary =
+    "{\"msg_id\":\"from_user\":\"to_user\":\"create_time\":\"msg_type\":1,\"content\":\"status\":0,\"seq\":"
+    "\"nickname\":\"avatar_url\":\"https://cdn.example.com/avatar/\",\"chatroom\":\"ret\":0,\"err_msg\":\"\"}";
+
+namespace {
+
+std::mt19937 sg_rng(20161227);
+
+std::string __Word() {
+    static const char* const kWords[] = {"ok", "see", "you", "tomorrow", "the", "meeting", "at", "lunch", "haha", "photo", "sent", "where", "are"};
+    return kWords[sg_rng() % (sizeof(kWords) / sizeof(kWords[0]))];
+}
+
+// a sync response: a list of chat messages as json
+std::string __ChatMessages(size_t _size) {
+    std::string json = "[";
+    for (int i = 0; json.size() < _size; ++i) {
+        char head[256];
+        snprintf(head, sizeof(head), "{\"msg_id\":%u,\"from_user\":\"wxid_%06u\",\"to_user\":\"wxid_%06u\",\"create_time\":%u,\"msg_type\":1,\"content\":\"",
+                 (unsigned)sg_rng(), (unsigned)(sg_rng() % 1000000), (unsigned)(sg_rng() % 1000000), 1480000000u + (unsigned)(sg_rng() % 1000000));
+        json += head;
+        for (int w = 3 + sg_rng() % 12; 0 < w; --w) json += __Word() + " ";
+        json += "\",\"status\":0},";
+    }
+    json[json.size() - 1] = ']';
+    return json;
+}
+
+// a protobuf-ish record list: small tags and varints with short strings
+std::string __Records(size_t _size) {
+    std::string pb;
+    while (pb.size() < _size) {
+        pb += (char)0x08;
+        for (uint32_t v = sg_rng() % 100000; ; v >>= 7) {
+            if (v < 0x80) { pb += (char)v; break; }
+            pb += (char)(0x80 | (v & 0x7f));
+        }
+        std::string name = "user_" + __Word();
+        pb += (char)0x12;
+        pb += (char)name.size();
+        pb += name;
+        pb += (char)0x18;
+        pb += (char)(sg_rng() % 4);
+    }
+    return pb;
+}
+
+// an encrypted or already compressed body
+std::string __Random(size_t _size) {
+    std::string bytes(_size, 0);
+    for (size_t i = 0; i < _size; ++i) bytes[i] = (char)sg_rng();
+    return bytes;
+}
+
+double __CpuMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// a connection as both ends see it, the server running this packer too when _server_compresses
+struct Connection {
+    explicit Connection(bool _server_compresses)
+    : client(longlink_tracker::Create()), server(_server_compresses ? longlink_tracker::Create() : NULL) {}
+    ~Connection() { delete client; delete server; }
+
+    // client to server and back, returns the bytes the request took on the wire
+    size_t RoundTrip(const AutoBuffer& _body, AutoBuffer& _echoed) {
+        AutoBuffer packed;
+        longlink_pack(1001, 1, _body, KNullAtuoBuffer, packed, client);
+
+        uint32_t cmdid = 0, seq = 0;
+        size_t packlen = 0;
+        AutoBuffer body, extension;
+        EXPECT_EQ(LONGLINK_UNPACK_OK, longlink_unpack(packed, cmdid, seq, packlen, body, extension, server));
+        EXPECT_EQ(packed.Length(), packlen);
+
+        AutoBuffer reply;
+        longlink_pack(cmdid, seq, body, KNullAtuoBuffer, reply, server);
+        AutoBuffer reply_extension;
+        EXPECT_EQ(LONGLINK_UNPACK_OK, longlink_unpack(reply, cmdid, seq, packlen, _echoed, reply_extension, client));
+        return packed.Length();
+    }
+
+    longlink_tracker* client;
+    longlink_tracker* server;
+};
+
+struct Payload {
+    const char* name;
+    std::string (*make)(size_t);
+    size_t size;
+};
+
+}
+
+enum Mode {
+    kOff,
+    kDeflate,
+    kDeflateDict,
+};
+
+static void __Bench(const Payload& _payload, Mode _mode) {
+    static const char* const kModes[] = {"off", "deflate", "deflate+dict"};
+    SetLonglinkCompression(kOff == _mode ? 0 : kThreshold, kDeflateDict == _mode ? kDictionary : "");
+    std::string raw = _payload.make(_payload.size);
+    AutoBuffer body;
+    body.Write(raw.data(), raw.size());
+
+    Connection conn(true);
+    AutoBuffer echoed;
+    conn.RoundTrip(body, echoed);  // both sides have seen the other's header
+
+    int runs = (int)(kWireBytesPerRun / raw.size());
+    size_t wire = 0;
+    double start = __CpuMs();
+    for (int i = 0; i < runs; ++i) {
+        AutoBuffer out;
+        wire += conn.RoundTrip(body, out);
+        if (0 == i) {
+            ASSERT_EQ(raw.size(), out.Length());
+            EXPECT_EQ(0, memcmp(raw.data(), out.Ptr(), raw.size()));
+        }
+    }
+    double cpu = __CpuMs() - start;
+
+    // a round trip packs and unpacks on each side
+    double raw_mb = 2.0 * runs * raw.size() / (1024 * 1024);
+    printf("%-6s %6zuB %-12s wire:%5.1f%% of raw, %6.2fms cpu/MB (pack+unpack)\n", _payload.name, raw.size(), kModes[_mode],
+           100.0 * wire / runs / raw.size(), cpu / raw_mb);
+}
+
+TEST(LongLinkCompress, BytesOnWireAndCpu) {
+    xlogger_SetLevel(kLevelNone);
+    const Payload kPayloads[] = {
+        {"chat", __ChatMessages, 600},
+        {"chat", __ChatMessages, 8 * 1024},
+        {"chat", __ChatMessages, 128 * 1024},
+        {"pb", __Records, 8 * 1024},
+        {"random", __Random, 8 * 1024},
+    };
+
+    for (size_t i = 0; i < sizeof(kPayloads) / sizeof(kPayloads[0]); ++i) {
+        __Bench(kPayloads[i], kOff);
+        __Bench(kPayloads[i], kDeflate);
+        __Bench(kPayloads[i], kDeflateDict);
+    }
+    SetLonglinkCompression(0);
+}
+
+TEST(LongLinkCompress, OldServerGetsNoDeflate) {
+    SetLonglinkCompression(kThreshold);
+    std::string raw = __ChatMessages(8 * 1024);
+    AutoBuffer body;
+    body.Write(raw.data(), raw.size());
+
+    // the old server: skips head_length to the body and answers with the plain header
+    Connection conn(false);
+    for (int i = 0; i < 3; ++i) {
+        AutoBuffer echoed;
+        size_t wire = conn.RoundTrip(body, echoed);
+        EXPECT_EQ(raw.size(), echoed.Length());
+        EXPECT_LT(raw.size(), wire);
+    }
+    SetLonglinkCompression(0);
+}
+
+TEST(LongLinkCompress, OffKeepsThePlainHeader) {
+    SetLonglinkCompression(0);
+    AutoBuffer body;
+    body.Write("0123456789", 10);
+
+    longlink_tracker* tracker = longlink_tracker::Create();
+    AutoBuffer packed;
+    longlink_pack(1001, 1, body, KNullAtuoBuffer, packed, tracker);
+    EXPECT_EQ(20u + 10u, packed.Length());
+    delete tracker;
+}
+
+// a server packet with a head_length of 32 and _tail in the 12 bytes after the plain header
+static void __LongHeaderPacket(const char* _body, const uint32_t _tail[3], AutoBuffer& _packed) {
+    uint32_t head[8] = {htonl(32), 0, htonl(1001), htonl(1), htonl((uint32_t)strlen(_body)), htonl(_tail[0]), htonl(_tail[1]), htonl(_tail[2])};
+    _packed.Write(head, sizeof(head));
+    _packed.Write(_body, strlen(_body));
+    _packed.Seek(0, AutoBuffer::ESeekStart);
+}
+
+// bytes after the first 20 of a server header mean nothing to the packer unless they carry the extension magic
+TEST(LongLinkCompress, LongerServerHeaderIsSkipped) {
+    const uint32_t kTail[3] = {0x2, 0x1, 7};
+    longlink_tracker* tracker = longlink_tracker::Create();
+
+    for (int threshold = 0; threshold < 2; ++threshold) {
+        SetLonglinkCompression(threshold * kThreshold);
+        AutoBuffer packed;
+        __LongHeaderPacket("0123456789", kTail, packed);
+
+        uint32_t cmdid = 0, seq = 0;
+        size_t packlen = 0;
+        AutoBuffer body, extension;
+        ASSERT_EQ(LONGLINK_UNPACK_OK, longlink_unpack(packed, cmdid, seq, packlen, body, extension, tracker));
+        EXPECT_EQ(42u, packlen);
+        ASSERT_EQ(10u, body.Length());
+        EXPECT_EQ(0, memcmp("0123456789", body.Ptr(), 10));
+    }
+
+    // nor did it say the server inflates
+    std::string raw = __ChatMessages(8 * 1024);
+    AutoBuffer body, packed;
+    body.Write(raw.data(), raw.size());
+    longlink_pack(1001, 2, body, KNullAtuoBuffer, packed, tracker);
+    EXPECT_LT(raw.size(), packed.Length());
+
+    SetLonglinkCompression(0);
+    delete tracker;
+}
+
+// the app replaced longlink_tracker::Create, its trackers get the plain header
+TEST(LongLinkCompress, ForeignTrackerIsNotCast) {
+    SetLonglinkCompression(kThreshold);
+    longlink_tracker tracker;
+    AutoBuffer body, packed;
+    body.Write("0123456789", 10);
+    longlink_pack(1001, 1, body, KNullAtuoBuffer, packed, &tracker);
+    EXPECT_EQ(20u + 10u, packed.Length());
+    SetLonglinkCompression(0);
+}
@@ -0,0 +1,282 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * longlink_pool_test.cc
+ *
+ * latency of small tasks while bulk tasks keep the longlink busy, with one longlink and with a pool.
+ * the mock server answers requests in order on each connection and sends at kMockBytesPerSec,
+ * the first 4 bytes of a request body are the size of the response it wants.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "mars/app/app_logic.h"
+#include "mars/baseevent/active_logic.h"
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/messagequeue/message_queue.h"
+#include "mars/comm/xlogger/xlogger.h"
+#include "mars/stn/stn.h"
+#include "mars/stn/proto/longlink_packer.h"
+#include "mars/stn/src/dynamic_timeout.h"
+#include "mars/stn/src/longlink_task_manager.h"
+#include "mars/stn/src/net_source.h"
+
+using namespace mars::stn;
+
+static const size_t kMockBytesPerSec = 4 * 1024 * 1024;
+static const uint32_t kSmallRespSize = 200;
+static const uint32_t kBulkRespSize = 900 * 1024;  // the default packer takes 1M at most
+static const int kBulkConcurrency = 3;
+static const int kSmallTaskCount = 200;
+static const int kSmallTaskInterval = 50;  // ms
+
+namespace {
+
+class MockServer {
+  public:
+    MockServer(): listen_fd_(socket(AF_INET, SOCK_STREAM, 0)), port_(0) {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+
+        bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr));
+        listen(listen_fd_, 16);
+        getsockname(listen_fd_, (struct sockaddr*)&addr, &len);
+        port_ = ntohs(addr.sin_port);
+
+        std::thread([this] {
+            int fd = -1;
+            while (0 <= (fd = accept(listen_fd_, NULL, NULL))) std::thread(&MockServer::__Serve, fd).detach();
+        }).detach();
+    }
+
+    uint16_t Port() const { return port_; }
+
+  private:
+    static void __Serve(int _fd) {
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::deque<AutoBuffer*> outs;
+        bool closed = false;
+
+        std::thread writer([&] {
+            while (true) {
+                AutoBuffer* out = NULL;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cond.wait(lock, [&] { return closed || !outs.empty(); });
+                    if (outs.empty()) return;
+                    out = outs.front();
+                    outs.pop_front();
+                }
+
+                for (size_t pos = 0; pos < out->Length();) {
+                    size_t len = std::min((size_t)16 * 1024, out->Length() - pos);
+                    if (0 >= send(_fd, (const char*)out->Ptr() + pos, len, MSG_NOSIGNAL)) break;
+                    pos += len;
+                    usleep((useconds_t)(len * 1000000 / kMockBytesPerSec));
+                }
+                delete out;
+            }
+        });
+
+        AutoBuffer in;
+        char buf[64 * 1024];
+        ssize_t recvlen = 0;
+        while (0 < (recvlen = recv(_fd, buf, sizeof(buf), 0))) {
+            in.Write(buf, recvlen);
+
+            while (true) {
+                uint32_t cmdid = 0, seq = 0;
+                size_t packlen = 0;
+                AutoBuffer body, extension;
+                if (LONGLINK_UNPACK_OK != longlink_unpack(in, cmdid, seq, packlen, body, extension, NULL)) break;
+
+                uint32_t respsize = 0;  // noop has no body and gets none
+                if (sizeof(respsize) <= body.Length()) memcpy(&respsize, body.Ptr(), sizeof(respsize));
+
+                AutoBuffer resp;
+                resp.AllocWrite(respsize);
+                memset(resp.Ptr(), 'r', respsize);
+                resp.Length(0, respsize);
+
+                AutoBuffer* out = new AutoBuffer;
+                longlink_pack(cmdid, seq, resp, KNullAtuoBuffer, *out, NULL);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    outs.push_back(out);
+                }
+                cond.notify_one();
+
+                memmove(in.Ptr(), (const char*)in.Ptr() + packlen, in.Length() - packlen);
+                in.Length(0, in.Length() - packlen);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        cond.notify_one();
+        writer.join();
+        close(_fd);
+    }
+
+  private:
+    int listen_fd_;
+    uint16_t port_;
+};
+
+class AppCallback : public mars::app::Callback {
+  public:
+    virtual std::string GetAppFilePath() { return "/tmp"; }
+    virtual mars::app::AccountInfo GetAccountInfo() { return mars::app::AccountInfo(); }
+    virtual unsigned int GetClientVersion() { return 0; }
+    virtual mars::app::DeviceInfo GetDeviceInfo() { return mars::app::DeviceInfo(); }
+};
+
+struct RequestSpec {
+    uint32_t respsize;
+    bool small;
+};
+
+std::mutex sg_mutex;
+std::vector<unsigned int> sg_small_costs;
+
+}
+
+static void __SetupCallbacks() {
+    static AppCallback app_callback;
+    mars::app::SetCallback(&app_callback);
+
+    Req2Buf = [](uint32_t, void* const _user_context, AutoBuffer& _out, AutoBuffer&, int&, const int) {
+        const RequestSpec* spec = (const RequestSpec*)_user_context;
+        _out.AllocWrite(256);
+        memset(_out.Ptr(), 0, 256);
+        memcpy(_out.Ptr(), &spec->respsize, sizeof(spec->respsize));
+        _out.Length(0, 256);
+        return true;
+    };
+    Buf2Resp = [](uint32_t, void* const, const AutoBuffer&, const AutoBuffer&, int&, const int) { return (int)kTaskFailHandleNoError; };
+    GetLonglinkIdentifyCheckBuffer = [](AutoBuffer&, AutoBuffer&, int32_t&) { return (int)kCheckNever; };
+    ReportTaskProfile = [](const TaskProfile&) {};
+    ReportDnsProfile = [](const DnsProfile&) {};
+    TrafficData = [](ssize_t, ssize_t) {};
+    TrafficCmdData = [](int, uint32_t, ssize_t, ssize_t) {};
+    OnNewDns = [](const std::string&) { return std::vector<std::string>(); };
+}
+
+// p99 of the small tasks, in ms
+static unsigned int __RunSmallTasksUnderBulk(unsigned int _pool_size, uint16_t _port) {
+    static RequestSpec small_spec = {kSmallRespSize, true};
+    static RequestSpec bulk_spec = {kBulkRespSize, false};
+
+    std::vector<std::string> hosts(1, "longlink.mock");
+    std::vector<uint16_t> ports(1, _port);
+    NetSource::SetLongLink(hosts, ports, "127.0.0.1");
+    LongLinkTaskManager::SetPoolStrategy(_pool_size, kDynTimeBigPackageLen, false);
+
+    MessageQueue::MessageQueueCreater creater(true, "longlink_pool_test");
+    MessageQueue::MessageQueue_t queue = creater.CreateMessageQueue();
+    MessageQueue::MessageHandler_t handler = MessageQueue::DefAsyncInvokeHandler(queue);
+    NetSource netsource(*ActiveLogic::Singleton::Instance());
+    DynamicTimeout dynamic_timeout;
+    LongLinkTaskManager* manager = NULL;
+    std::atomic<bool> stopped(false);
+
+    MessageQueue::WaitMessage(MessageQueue::AsyncInvoke([&] {
+        manager = new LongLinkTaskManager(netsource, *ActiveLogic::Singleton::Instance(), dynamic_timeout, queue);
+    }, handler));
+
+    std::function<void (bool)> start = [&](bool _small) {
+        Task task;
+        task.cmdid = _small ? 1001 : 1002;
+        task.cgi = _small ? "/small" : "/bulk";
+        task.priority = _small ? Task::kTaskPriorityNormal : Task::kTaskPriorityLowest;
+        task.retry_count = 0;
+        task.user_context = _small ? &small_spec : &bulk_spec;
+        MessageQueue::AsyncInvoke([=] { manager->StartTask(task); }, handler);
+    };
+
+    manager->fun_anti_avalanche_check_ = [](const Task&, const void*, int, bool, uint64_t, uint64_t&) { return true; };
+    manager->fun_notify_network_err_ = [](int, ErrCmdType, int, const std::string&, uint16_t) {};
+    manager->fun_notify_retry_all_tasks = [](ErrCmdType, int, int, uint32_t) {};
+    manager->fun_on_push_ = [](uint64_t, uint32_t, uint32_t, const AutoBuffer&, const AutoBuffer&) {};
+    manager->fun_callback_ = [&](ErrCmdType _err_type, int _err_code, int, const Task& _task, unsigned int _cost) {
+        if (((const RequestSpec*)_task.user_context)->small) {
+            EXPECT_EQ(kEctOK, _err_type) << "taskid:" << _task.taskid << " err_code:" << _err_code;
+            std::lock_guard<std::mutex> lock(sg_mutex);
+            sg_small_costs.push_back(_cost);
+        } else if (!stopped) {  // the bulk ones still running are reset at the end
+            start(false);
+        }
+        return 0;
+    };
+
+    start(true);  // connect first
+    usleep(500 * 1000);
+    {
+        std::lock_guard<std::mutex> lock(sg_mutex);
+        sg_small_costs.clear();
+    }
+
+    for (int i = 0; i < kBulkConcurrency; ++i) start(false);
+    for (int i = 0; i < kSmallTaskCount; ++i) {
+        start(true);
+        usleep(kSmallTaskInterval * 1000);
+    }
+    sleep(2);
+    stopped = true;
+
+    MessageQueue::WaitMessage(MessageQueue::AsyncInvoke([&] { delete manager; }, handler));
+
+    std::vector<unsigned int> costs;
+    {
+        std::lock_guard<std::mutex> lock(sg_mutex);
+        costs.swap(sg_small_costs);
+    }
+    EXPECT_EQ((size_t)kSmallTaskCount, costs.size());
+    if (costs.empty()) return 0;
+
+    std::sort(costs.begin(), costs.end());
+    unsigned int p99 = costs[costs.size() * 99 / 100];
+    printf("pool:%u small tasks:%zu p50:%ums p90:%ums p99:%ums max:%ums\n", _pool_size, costs.size(),
+           costs[costs.size() / 2], costs[costs.size() * 9 / 10], p99, costs.back());
+    return p99;
+}
+
+TEST(LongLinkPool, SmallTaskLatencyUnderBulk) {
+    xlogger_SetLevel(kLevelNone);
+    __SetupCallbacks();
+    MockServer server;
+
+    unsigned int single = __RunSmallTasksUnderBulk(1, server.Port());
+    unsigned int pooled = __RunSmallTasksUnderBulk(2, server.Port());
+
+    EXPECT_LT(pooled, single);
+}
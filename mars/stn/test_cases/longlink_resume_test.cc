@@ -0,0 +1,428 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * longlink_resume_test.cc
+ *
+ * reconnect-to-first-byte of a task queued while the longlink reconnects, after a drop the longlink
+ * resumes from and after a network change it does not.
+ * the mock server answers every request kMockRtt after it arrives, emulating the round trip loopback lacks.
+ * a request body starting with kCloseMagic makes it close the connection.
+ * the tasks queued while a resume fails have to fail with it, not wait for their task timeout.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "mars/app/app_logic.h"
+#include "mars/baseevent/active_logic.h"
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/messagequeue/message_queue.h"
+#include "mars/comm/xlogger/xlogger.h"
+#include "mars/stn/stn.h"
+#include "mars/stn/proto/longlink_packer.h"
+#include "mars/stn/src/longlink.h"
+#include "mars/stn/src/net_source.h"
+
+using namespace mars::stn;
+
+typedef std::chrono::steady_clock Clock;
+
+static const std::chrono::milliseconds kMockRtt(20);
+static const uint32_t kCloseMagic = 0xC105EC10;
+static const uint32_t kProbeTaskID = 100;
+static const int kTrialCount = 10;
+
+namespace {
+
+class MockServer {
+  public:
+    MockServer(): listen_fd_(socket(AF_INET, SOCK_STREAM, 0)), port_(0) {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+
+        bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr));
+        listen(listen_fd_, 16);
+        getsockname(listen_fd_, (struct sockaddr*)&addr, &len);
+        port_ = ntohs(addr.sin_port);
+
+        std::thread([this] {
+            int fd = -1;
+            while (0 <= (fd = accept(listen_fd_, NULL, NULL))) std::thread(&MockServer::__Serve, fd).detach();
+        }).detach();
+    }
+
+    uint16_t Port() const { return port_; }
+
+    // new connections are refused from now on
+    void Close() {
+        shutdown(listen_fd_, SHUT_RDWR);
+        close(listen_fd_);
+    }
+
+  private:
+    struct Reply {
+        Clock::time_point due;
+        AutoBuffer* data;
+    };
+
+    static void __Serve(int _fd) {
+        int nodelay = 1;
+        setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::deque<Reply> outs;
+        bool closed = false;
+
+        std::thread writer([&] {
+            while (true) {
+                Reply out;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cond.wait(lock, [&] { return closed || !outs.empty(); });
+                    if (outs.empty()) return;
+                    out = outs.front();
+                    outs.pop_front();
+                }
+
+                std::this_thread::sleep_until(out.due);
+                send(_fd, out.data->Ptr(), out.data->Length(), MSG_NOSIGNAL);
+                delete out.data;
+            }
+        });
+
+        AutoBuffer in;
+        char buf[64 * 1024];
+        ssize_t recvlen = 0;
+        while (0 < (recvlen = recv(_fd, buf, sizeof(buf), 0))) {
+            in.Write(buf, recvlen);
+
+            bool close_now = false;
+            while (!close_now) {
+                uint32_t cmdid = 0, seq = 0;
+                size_t packlen = 0;
+                AutoBuffer body, extension;
+                if (LONGLINK_UNPACK_OK != longlink_unpack(in, cmdid, seq, packlen, body, extension, NULL)) break;
+
+                uint32_t magic = 0;
+                if (sizeof(magic) <= body.Length()) memcpy(&magic, body.Ptr(), sizeof(magic));
+                close_now = kCloseMagic == magic;
+
+                Reply out = {Clock::now() + kMockRtt, new AutoBuffer};
+                longlink_pack(cmdid, seq, KNullAtuoBuffer, KNullAtuoBuffer, *out.data, NULL);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    outs.push_back(out);
+                }
+                cond.notify_one();
+
+                memmove(in.Ptr(), (const char*)in.Ptr() + packlen, in.Length() - packlen);
+                in.Length(0, in.Length() - packlen);
+            }
+            if (close_now) break;
+        }
+
+        shutdown(_fd, SHUT_RDWR);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            for (auto& out : outs) delete out.data;
+            outs.clear();
+        }
+        cond.notify_one();
+        writer.join();
+        close(_fd);
+    }
+
+  private:
+    int listen_fd_;
+    uint16_t port_;
+};
+
+// the longlink asks for the proxy first thing when it connects, a held gate keeps it from connecting
+class ConnectGate {
+  public:
+    ConnectGate(): held_(false) {}
+
+    void Hold() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        held_ = true;
+    }
+
+    void Release() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        held_ = false;
+        cond_.notify_all();
+    }
+
+    void Pass() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return !held_; });
+    }
+
+  private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool held_;
+};
+
+static ConnectGate sg_connect_gate;
+
+class AppCallback : public mars::app::Callback {
+  public:
+    virtual bool GetProxyInfo(const std::string& _host, mars::comm::ProxyInfo& _proxy_info) {
+        sg_connect_gate.Pass();
+        return false;
+    }
+    virtual std::string GetAppFilePath() { return "/tmp"; }
+    virtual mars::app::AccountInfo GetAccountInfo() { return mars::app::AccountInfo(); }
+    virtual unsigned int GetClientVersion() { return 0; }
+    virtual mars::app::DeviceInfo GetDeviceInfo() { return mars::app::DeviceInfo(); }
+};
+
+}
+
+static void __SetupCallbacks() {
+    static AppCallback app_callback;
+    mars::app::SetCallback(&app_callback);
+
+    GetLonglinkIdentifyCheckBuffer = [](AutoBuffer&, AutoBuffer&, int32_t&) { return (int)kCheckNever; };
+    ReportDnsProfile = [](const DnsProfile&) {};
+    TrafficData = [](ssize_t, ssize_t) {};
+    TrafficCmdData = [](int, uint32_t, ssize_t, ssize_t) {};
+    OnNewDns = [](const std::string&) { return std::vector<std::string>(); };
+    // a protocol that checks every new connection with a noop before using it
+    longlink_complexconnect_need_verify = []() { return true; };
+}
+
+static bool __WaitStatus(LongLink& _longlink, LongLink::TLongLinkStatus _status) {
+    for (int i = 0; i < 5000; ++i) {
+        if (_status == _longlink.ConnectStatus()) return true;
+        usleep(1000);
+    }
+    return false;
+}
+
+static void __Send(LongLink& _longlink, uint32_t _taskid, uint32_t _magic) {
+    AutoBuffer body;
+    body.Write(&_magic, sizeof(_magic));
+    Task task(_taskid);
+    task.cmdid = 1001;
+    // the way a queued task waits for the longlink in LongLinkTaskManager
+    while (!_longlink.Send(body, KNullAtuoBuffer, task)) usleep(100);
+}
+
+// median reconnect-to-first-byte, in ms
+static double __RunReconnects(LongLink& _longlink, bool _drop_by_server) {
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool answered = false;
+    Clock::time_point answered_time;
+
+    _longlink.OnResponse = [&](ErrCmdType _type, int, uint32_t, uint32_t _taskid, AutoBuffer&, AutoBuffer&, const ConnectProfile&) {
+        if (kEctOK != _type || kProbeTaskID != _taskid) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        answered = true;
+        answered_time = Clock::now();
+        cond.notify_one();
+    };
+
+    std::vector<double> costs;
+    for (int i = 0; i < kTrialCount; ++i) {
+        _longlink.MakeSureConnected();
+        EXPECT_TRUE(__WaitStatus(_longlink, LongLink::kConnected));
+        usleep(100 * 1000);  // the verify and the first noop are answered
+
+        if (_drop_by_server) {
+            __Send(_longlink, kProbeTaskID + 1, kCloseMagic);
+            EXPECT_TRUE(__WaitStatus(_longlink, LongLink::kDisConnected));
+            usleep(50 * 1000);  // the connection thread finishes
+        } else {
+            _longlink.Disconnect(LongLink::kNetworkChange);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            answered = false;
+        }
+
+        Clock::time_point start = Clock::now();
+        bool newone = false;
+        _longlink.MakeSureConnected(&newone);
+        EXPECT_TRUE(newone);
+        EXPECT_EQ(_drop_by_server, _longlink.IsResuming());
+        __Send(_longlink, kProbeTaskID, 0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        EXPECT_TRUE(cond.wait_for(lock, std::chrono::seconds(5), [&] { return answered; }));
+        costs.push_back(std::chrono::duration<double, std::milli>(answered_time - start).count());
+    }
+
+    _longlink.OnResponse = NULL;
+    std::sort(costs.begin(), costs.end());
+    printf("%s reconnect-to-first-byte min:%.1fms median:%.1fms max:%.1fms\n", _drop_by_server ? "resumed" : "full",
+           costs.front(), costs[costs.size() / 2], costs.back());
+    fflush(stdout);
+    return costs[costs.size() / 2];
+}
+
+TEST(LongLinkResume, ReconnectToFirstByte) {
+    xlogger_SetLevel(kLevelNone);
+    __SetupCallbacks();
+    MockServer server;
+
+    std::vector<std::string> hosts(1, "longlink.mock");
+    std::vector<uint16_t> ports(1, server.Port());
+    NetSource::SetLongLink(hosts, ports, "127.0.0.1");
+
+    MessageQueue::MessageQueueCreater creater(true, "longlink_resume_test");
+    MessageQueue::MessageQueue_t queue = creater.CreateMessageQueue();
+    NetSource netsource(*ActiveLogic::Singleton::Instance());
+    LongLink longlink(queue, netsource);
+
+    double full = __RunReconnects(longlink, false);
+    double resumed = __RunReconnects(longlink, true);
+    EXPECT_LT(resumed, full);
+
+    longlink.Disconnect(LongLink::kReset);
+}
+
+TEST(LongLinkResume, QueuedTasksFailWhenBothConnectsFail) {
+    xlogger_SetLevel(kLevelNone);
+    __SetupCallbacks();
+    MockServer server;
+
+    std::vector<std::string> hosts(1, "longlink.mock");
+    std::vector<uint16_t> ports(1, server.Port());
+    NetSource::SetLongLink(hosts, ports, "127.0.0.1");
+
+    MessageQueue::MessageQueueCreater creater(true, "longlink_resume_fail_test");
+    MessageQueue::MessageQueue_t queue = creater.CreateMessageQueue();
+    NetSource netsource(*ActiveLogic::Singleton::Instance());
+    LongLink longlink(queue, netsource);
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool failed = false;
+    longlink.OnResponse = [&](ErrCmdType _type, int, uint32_t, uint32_t, AutoBuffer&, AutoBuffer&, const ConnectProfile&) {
+        if (kEctOK == _type) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = true;
+        cond.notify_one();
+    };
+
+    longlink.MakeSureConnected();
+    ASSERT_TRUE(__WaitStatus(longlink, LongLink::kConnected));
+    usleep(100 * 1000);
+
+    // the server goes away with the connection, the resume and the full connect after it are refused
+    server.Close();
+    __Send(longlink, kProbeTaskID + 1, kCloseMagic);
+    ASSERT_TRUE(__WaitStatus(longlink, LongLink::kDisConnected));
+    usleep(50 * 1000);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = false;
+    }
+
+    sg_connect_gate.Hold();
+    bool newone = false;
+    longlink.MakeSureConnected(&newone);
+    EXPECT_TRUE(newone);
+    EXPECT_TRUE(longlink.IsResuming());
+    EXPECT_TRUE(__WaitStatus(longlink, LongLink::kConnecting));
+    __Send(longlink, kProbeTaskID, 0);
+    sg_connect_gate.Release();
+
+    EXPECT_TRUE(__WaitStatus(longlink, LongLink::kConnectFailed));
+    std::unique_lock<std::mutex> lock(mutex);
+    EXPECT_TRUE(cond.wait_for(lock, std::chrono::seconds(5), [&] { return failed; }));
+    lock.unlock();
+
+    longlink.OnResponse = NULL;
+    longlink.Disconnect(LongLink::kReset);
+}
+
+TEST(LongLinkResume, QueuedTasksFailWhenResumeIsStopped) {
+    xlogger_SetLevel(kLevelNone);
+    __SetupCallbacks();
+    MockServer server;
+
+    std::vector<std::string> hosts(1, "longlink.mock");
+    std::vector<uint16_t> ports(1, server.Port());
+    NetSource::SetLongLink(hosts, ports, "127.0.0.1");
+
+    MessageQueue::MessageQueueCreater creater(true, "longlink_resume_stop_test");
+    MessageQueue::MessageQueue_t queue = creater.CreateMessageQueue();
+    NetSource netsource(*ActiveLogic::Singleton::Instance());
+    LongLink longlink(queue, netsource);
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool failed = false;
+    longlink.OnResponse = [&](ErrCmdType _type, int, uint32_t, uint32_t, AutoBuffer&, AutoBuffer&, const ConnectProfile&) {
+        if (kEctOK == _type) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = true;
+        cond.notify_one();
+    };
+
+    longlink.MakeSureConnected();
+    ASSERT_TRUE(__WaitStatus(longlink, LongLink::kConnected));
+    usleep(100 * 1000);
+
+    server.Close();
+    __Send(longlink, kProbeTaskID + 1, kCloseMagic);
+    ASSERT_TRUE(__WaitStatus(longlink, LongLink::kDisConnected));
+    usleep(50 * 1000);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = false;
+    }
+
+    // a disconnect scene stops the connect, __RunConnect does not report that
+    sg_connect_gate.Hold();
+    longlink.MakeSureConnected();
+    EXPECT_TRUE(longlink.IsResuming());
+    EXPECT_TRUE(__WaitStatus(longlink, LongLink::kConnecting));
+    __Send(longlink, kProbeTaskID, 0);
+    std::thread disconnect([&] { longlink.Disconnect(LongLink::kNetworkChange); });
+    usleep(50 * 1000);
+    sg_connect_gate.Release();
+    disconnect.join();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    EXPECT_TRUE(cond.wait_for(lock, std::chrono::seconds(5), [&] { return failed; }));
+    lock.unlock();
+
+    longlink.OnResponse = NULL;
+}
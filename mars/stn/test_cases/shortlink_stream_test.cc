@@ -0,0 +1,212 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * shortlink_stream_test.cc
+ *
+ * peak memory of a kBodySize download over a shortlink, streamed to OnResponseChunk and kept whole.
+ * the streamed one runs first, ru_maxrss only grows.
+ * the body of an error status is not streamed.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "mars/app/app_logic.h"
+#include "mars/baseevent/active_logic.h"
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/messagequeue/message_queue.h"
+#include "mars/comm/xlogger/xlogger.h"
+#include "mars/stn/stn.h"
+#include "mars/stn/src/net_source.h"
+#include "mars/stn/src/shortlink.h"
+
+using namespace mars::stn;
+
+static const size_t kBodySize = 20 * 1024 * 1024;
+
+namespace {
+
+class MockServer {
+  public:
+    MockServer(): listen_fd_(socket(AF_INET, SOCK_STREAM, 0)), port_(0) {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+
+        bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr));
+        listen(listen_fd_, 16);
+        getsockname(listen_fd_, (struct sockaddr*)&addr, &len);
+        port_ = ntohs(addr.sin_port);
+
+        std::thread([this] {
+            int fd = -1;
+            while (0 <= (fd = accept(listen_fd_, NULL, NULL))) std::thread(&MockServer::__Serve, fd).detach();
+        }).detach();
+    }
+
+    uint16_t Port() const { return port_; }
+
+  private:
+    static void __Serve(int _fd) {
+        std::string request;
+        char buf[4096];
+        ssize_t recvlen = 0;
+        while (std::string::npos == request.find("\r\n\r\n") && 0 < (recvlen = recv(_fd, buf, sizeof(buf), 0))) request.append(buf, recvlen);
+
+        if (std::string::npos != request.find("/missing")) {
+            const char* reply = "HTTP/1.1 404 Not Found\r\nContent-Length: 9\r\n\r\nnot found";
+            send(_fd, reply, strlen(reply), MSG_NOSIGNAL);
+            close(_fd);
+            return;
+        }
+
+        char head[128];
+        snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n\r\n", kBodySize);
+        send(_fd, head, strlen(head), MSG_NOSIGNAL);
+
+        memset(buf, 'b', sizeof(buf));
+        for (size_t sent = 0; sent < kBodySize;) {
+            ssize_t ret = send(_fd, buf, std::min(sizeof(buf), kBodySize - sent), MSG_NOSIGNAL);
+            if (0 >= ret) break;
+            sent += ret;
+        }
+        close(_fd);
+    }
+
+  private:
+    int listen_fd_;
+    uint16_t port_;
+};
+
+class AppCallback : public mars::app::Callback {
+  public:
+    virtual std::string GetAppFilePath() { return "/tmp"; }
+    virtual mars::app::AccountInfo GetAccountInfo() { return mars::app::AccountInfo(); }
+    virtual unsigned int GetClientVersion() { return 0; }
+    virtual mars::app::DeviceInfo GetDeviceInfo() { return mars::app::DeviceInfo(); }
+};
+
+size_t sg_chunked = 0;
+size_t sg_chunk_starts = 0;
+
+}
+
+static long __MaxRssKB() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// body bytes that came back, through the chunks or the response
+static size_t __Download(NetSource& _netsource, MessageQueue::MessageQueue_t _queue, bool _stream,
+                         const std::string& _cgi = "/download", ErrCmdType _expected = kEctOK) {
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool done = false;
+    size_t received = 0;
+
+    Task task;
+    task.cgi = _cgi;
+    task.shortlink_host_list.push_back("stream.mock");
+    task.stream_response = _stream;
+
+    ShortLinkInterface* shortlink = new ShortLink(_queue, _netsource, task, false);
+    shortlink->OnResponse.set([&](ShortLinkInterface*, ErrCmdType _err_type, int, AutoBuffer& _body, AutoBuffer&, bool, ConnectProfile&) {
+        EXPECT_EQ(_expected, _err_type);
+        std::lock_guard<std::mutex> lock(mutex);
+        received = _stream ? sg_chunked : _body.Length();
+        done = true;
+        cond.notify_one();
+    });
+
+    AutoBuffer req, extend;
+    req.Write("get", 3);
+    shortlink->SendRequest(req, extend);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        EXPECT_TRUE(cond.wait_for(lock, std::chrono::seconds(30), [&] { return done; }));
+    }
+    delete shortlink;
+    return received;
+}
+
+TEST(ShortLinkStream, PeakMemory) {
+    xlogger_SetLevel(kLevelNone);
+    static AppCallback app_callback;
+    mars::app::SetCallback(&app_callback);
+    ReportDnsProfile = [](const DnsProfile&) {};
+    TrafficData = [](ssize_t, ssize_t) {};
+    TrafficCmdData = [](int, uint32_t, ssize_t, ssize_t) {};
+    OnNewDns = [](const std::string&) { return std::vector<std::string>(); };
+    OnResponseChunk = [](uint32_t, const void* _data, size_t _len) {
+        if (NULL == _data) ++sg_chunk_starts;
+        sg_chunked += _len;  // a consumer would spill it to disk here
+    };
+
+    MockServer server;
+    NetSource::SetShortlink(server.Port(), "127.0.0.1");
+
+    MessageQueue::MessageQueueCreater creater(true, "shortlink_stream_test");
+    MessageQueue::MessageQueue_t queue = creater.CreateMessageQueue();
+    NetSource netsource(*ActiveLogic::Singleton::Instance());
+
+    long base = __MaxRssKB();
+    EXPECT_EQ(kBodySize, __Download(netsource, queue, true));
+    long streamed = __MaxRssKB();
+    EXPECT_EQ(kBodySize, __Download(netsource, queue, false));
+    long whole = __MaxRssKB();
+
+    printf("body:%zuKB peak rss growth streamed:%ldKB kept whole:%ldKB\n", kBodySize / 1024, streamed - base, whole - base);
+    EXPECT_EQ(1u, sg_chunk_starts);
+    EXPECT_LT(streamed - base, (long)(kBodySize / 1024 / 4));
+}
+
+TEST(ShortLinkStream, ErrorStatusIsNotStreamed) {
+    xlogger_SetLevel(kLevelNone);
+    static AppCallback app_callback;
+    mars::app::SetCallback(&app_callback);
+    ReportDnsProfile = [](const DnsProfile&) {};
+    TrafficData = [](ssize_t, ssize_t) {};
+    TrafficCmdData = [](int, uint32_t, ssize_t, ssize_t) {};
+    OnNewDns = [](const std::string&) { return std::vector<std::string>(); };
+    OnResponseChunk = [](uint32_t, const void* _data, size_t _len) {
+        if (NULL == _data) ++sg_chunk_starts;
+        sg_chunked += _len;
+    };
+
+    MockServer server;
+    NetSource::SetShortlink(server.Port(), "127.0.0.1");
+
+    MessageQueue::MessageQueueCreater creater(true, "shortlink_stream_error_test");
+    MessageQueue::MessageQueue_t queue = creater.CreateMessageQueue();
+    NetSource netsource(*ActiveLogic::Singleton::Instance());
+
+    sg_chunked = 0;
+    sg_chunk_starts = 0;
+    __Download(netsource, queue, true, "/missing", kEctHttp);
+    EXPECT_EQ(0u, sg_chunk_starts);
+    EXPECT_EQ(0u, sg_chunked);
+}
@@ -0,0 +1,169 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * simple_ipport_sort_test.cc
+ *
+ * connect time of the order SimpleIPPortSort picks, replaying recorded connect outcomes.
+ * every ip has a trace of outcomes (rtt or lost), the ips are tried one after another in the sorted order,
+ * a lost attempt costs kRacingInterval before the next one starts.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "mars/app/app_logic.h"
+#include "mars/comm/xlogger/xlogger.h"
+#include "mars/stn/stn.h"
+#include "mars/stn/src/simple_ipport_sort.h"
+
+using namespace mars::stn;
+
+static const int kRacingInterval = 4 * 1000;  // ms, kLonglinkConnInteral
+static const int kTraceLength = 256;
+static const int kRounds = 5000;
+static const int kHistoryReplays = 3;  // the order without rtts depends on how lucky the first picks were
+static const uint16_t kPort = 8080;
+
+namespace {
+
+struct IPProfile {
+    const char* ip;
+    int rtt;       // ms
+    int jitter;    // ms
+    double loss;
+};
+
+// what the ips of one network looked like, slow ones are not necessarily lossy and the other way round
+const IPProfile kProfiles[] = {
+    {"10.0.0.1", 35, 10, 0.02},
+    {"10.0.0.2", 60, 20, 0.30},
+    {"10.0.0.3", 45, 5, 0.05},
+    {"10.0.0.4", 180, 60, 0.00},
+    {"10.0.0.5", 250, 80, 0.10},
+    {"10.0.0.6", 90, 30, 0.02},
+    {"10.0.0.7", 40, 10, 0.60},
+    {"10.0.0.8", 400, 100, 0.00},
+};
+const size_t kProfileCount = sizeof(kProfiles) / sizeof(kProfiles[0]);
+
+struct Outcome {
+    bool success;
+    int rtt;
+};
+
+class AppCallback : public mars::app::Callback {
+  public:
+    explicit AppCallback(const std::string& _path): path_(_path) {}
+    virtual std::string GetAppFilePath() { return path_; }
+    virtual mars::app::AccountInfo GetAccountInfo() { return mars::app::AccountInfo(); }
+    virtual unsigned int GetClientVersion() { return 0; }
+    virtual mars::app::DeviceInfo GetDeviceInfo() { return mars::app::DeviceInfo(); }
+
+  private:
+    std::string path_;
+};
+
+}
+
+static std::vector<std::vector<Outcome> > __RecordTraces() {
+    std::mt19937 rng(20140616);
+    std::vector<std::vector<Outcome> > traces(kProfileCount);
+
+    for (size_t i = 0; i < kProfileCount; ++i) {
+        std::normal_distribution<double> rtt(kProfiles[i].rtt, kProfiles[i].jitter);
+        std::bernoulli_distribution lost(kProfiles[i].loss);
+        for (int j = 0; j < kTraceLength; ++j) {
+            Outcome outcome = {!lost(rng), std::max(1, (int)rtt(rng))};
+            traces[i].push_back(outcome);
+        }
+    }
+    return traces;
+}
+
+// mean connect time in ms, _p90 gets the 90th percentile
+static double __Replay(const std::vector<std::vector<Outcome> >& _traces, bool _report_rtt, int& _p90) {
+    char dir[] = "/tmp/ipport_sort_XXXXXX";
+    static AppCallback* app_callback = NULL;
+    delete app_callback;
+    app_callback = new AppCallback(mkdtemp(dir));
+    mars::app::SetCallback(app_callback);
+
+    srand(1);
+    SimpleIPPortSort sort;
+    std::vector<size_t> cursor(kProfileCount, 0);
+    std::vector<int> costs;
+
+    for (int round = 0; round < kRounds; ++round) {
+        std::vector<IPPortItem> items;
+        for (size_t i = 0; i < kProfileCount; ++i) {
+            IPPortItem item;
+            item.str_ip = kProfiles[i].ip;
+            item.port = kPort;
+            item.source_type = kIPSourceDNS;
+            items.push_back(item);
+        }
+        std::vector<IPPortItem> all = items;
+        sort.SortandFilter(items, (int)items.size(), false);
+        if (items.empty()) items = all;  // NetSource falls back to the backup ips then
+
+        int cost = 0;
+        for (size_t i = 0; i < items.size(); ++i) {
+            size_t index = 0;
+            while (items[i].str_ip != kProfiles[index].ip) ++index;
+            const Outcome& outcome = _traces[index][cursor[index]++ % kTraceLength];
+
+            sort.Update(items[i].str_ip, kPort, outcome.success);
+            if (_report_rtt) sort.UpdateConnect(items[i].str_ip, kPort, outcome.success, outcome.success ? outcome.rtt : -1);
+
+            if (outcome.success) {
+                cost += outcome.rtt;
+                break;
+            }
+            cost += kRacingInterval;
+        }
+        costs.push_back(cost);
+    }
+
+    std::sort(costs.begin(), costs.end());
+    _p90 = costs[costs.size() * 9 / 10];
+
+    double sum = 0;
+    for (size_t i = 0; i < costs.size(); ++i) sum += costs[i];
+    return sum / costs.size();
+}
+
+TEST(SimpleIPPortSort, ConnectTimeReplay) {
+    xlogger_SetLevel(kLevelNone);
+    std::vector<std::vector<Outcome> > traces = __RecordTraces();
+
+    double history = 0;
+    for (int i = 0; i < kHistoryReplays; ++i) {
+        int p90 = 0;
+        double mean = __Replay(traces, false, p90);
+        printf("rounds:%d success/fail history mean:%.1fms p90:%dms\n", kRounds, mean, p90);
+        history += mean / kHistoryReplays;
+    }
+
+    int estimator_p90 = 0;
+    double estimator = __Replay(traces, true, estimator_p90);
+    printf("rounds:%d rtt/loss estimator mean:%.1fms p90:%dms\n", kRounds, estimator, estimator_p90);
+
+    EXPECT_LT(estimator, history);
+}
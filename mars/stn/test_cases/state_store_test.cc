@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "boost/filesystem.hpp"
+
+#include "../src/state_store.h"
+#include "../../comm/time_utils.h"
+
+using namespace mars::stn;
+
+static std::string TestPath(const char* _name) {
+    std::string path = (boost::filesystem::temp_directory_path() / _name).string();
+    boost::filesystem::remove(path);
+    return path;
+}
+
+TEST(StateStore, RoundTrip) {
+    std::string path = TestPath("state_store_round_trip");
+    {
+        StateStore store(path);
+        store.Put("wifi", std::string("\0\1\2", 3));
+        store.Put("mobile", "value");
+        EXPECT_TRUE(store.Erase("mobile"));
+    }
+
+    StateStore store(path);
+    std::string value;
+    EXPECT_TRUE(store.Get("wifi", value));
+    EXPECT_EQ(std::string("\0\1\2", 3), value);
+    EXPECT_FALSE(store.Get("mobile", value));
+    EXPECT_EQ(1u, store.Size());
+}
+
+TEST(StateStore, CorruptFileIsDropped) {
+    std::string path = TestPath("state_store_corrupt");
+    {
+        StateStore store(path);
+        store.Put("wifi", "value");
+    }
+
+    FILE* file = fopen(path.c_str(), "r+b");
+    ASSERT_TRUE(NULL != file);
+    fseek(file, 12, SEEK_SET);
+    fputc('x', file);
+    fclose(file);
+
+    StateStore store(path);
+    EXPECT_EQ(0u, store.Size());
+
+    boost::filesystem::resize_file(path, 10);
+    StateStore truncated(path);
+    EXPECT_EQ(0u, truncated.Size());
+}
+
+TEST(StateStore, LeastRecentlyPutGoesFirst) {
+    std::string path = TestPath("state_store_lru");
+    {
+        StateStore store(path, 3);
+        store.Put("a", "1");
+        store.Put("b", "2");
+        store.Put("c", "3");
+        store.Put("a", "4");
+        store.Put("d", "5");
+    }
+
+    StateStore store(path, 3);
+    std::vector<std::string> keys;
+    store.Keys(keys);
+    ASSERT_EQ(3u, keys.size());
+    EXPECT_EQ("a", keys[0]);
+    EXPECT_EQ("c", keys[1]);
+    EXPECT_EQ("d", keys[2]);
+
+    // the order survives a reload
+    store.Put("e", "6");
+    std::string value;
+    EXPECT_FALSE(store.Get("c", value));
+    EXPECT_TRUE(store.Get("a", value));
+}
+
+TEST(StateStore, WritesBehind) {
+    std::string path = TestPath("state_store_write_behind");
+    StateStore store(path, 20, 60 * 1000);
+
+    uint64_t begin = gettickcount();
+    for (int i = 0; i < 10000; ++i) {
+        char key[16] = {0};
+        snprintf(key, sizeof(key), "net%d", i % 20);
+        store.Put(key, std::string(40, (char)i));
+    }
+    uint64_t cost = gettickcount() - begin;
+
+    EXPECT_EQ(0u, store.Writes());
+    EXPECT_FALSE(boost::filesystem::exists(path));
+    EXPECT_TRUE(store.Flush());
+    EXPECT_EQ(1u, store.Writes());
+    EXPECT_TRUE(store.Flush());
+    EXPECT_EQ(1u, store.Writes());
+
+    printf("10000 puts %llums, 1 write of %llu bytes\n", (unsigned long long)cost, (unsigned long long)boost::filesystem::file_size(path));
+}
+
+TEST(StateStore, WriteAfterDelay) {
+    std::string path = TestPath("state_store_delay");
+    StateStore store(path, 0, 100);
+    store.Put("wifi", "value");
+
+    for (int i = 0; i < 50 && 0 == store.Writes(); ++i) usleep(20 * 1000);
+    EXPECT_EQ(1u, store.Writes());
+}
+
+// the bulk longlinks each have a SmartHeartbeat on the same file
+TEST(StateStore, SharedByPath) {
+    std::string path = TestPath("state_store_shared");
+    {
+        boost::shared_ptr<StateStore> first = StateStore::Shared(path);
+        boost::shared_ptr<StateStore> second = StateStore::Shared(path);
+        EXPECT_EQ(first.get(), second.get());
+
+        first->Put("wifi", "first");
+        second->Put("mobile", "second");
+        first.reset();
+        EXPECT_EQ(0u, second->Writes());
+    }
+
+    boost::shared_ptr<StateStore> store = StateStore::Shared(path);
+    std::string value;
+    EXPECT_TRUE(store->Get("wifi", value));
+    EXPECT_EQ("first", value);
+    EXPECT_TRUE(store->Get("mobile", value));
+    EXPECT_EQ("second", value);
+}
@@ -0,0 +1,88 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * traffic_statistics_test.cc
+ *
+ * threads reporting reads and writes the way the longlink and shortlink io threads do,
+ * every byte has to show up in exactly one report, in the totals and under its cmdid.
+ */
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "mars/app/src/traffic_statistics.h"
+#include "mars/comm/xlogger/xlogger.h"
+
+using namespace mars::app;
+
+static const int kThreadCount = 4;
+static const int kCallsPerThread = 500 * 1000;
+static const uint32_t kCmdIdCount = 80;  // more than the table holds, the rest goes to kOtherCmdId
+
+TEST(TrafficStatistics, ConcurrentData) {
+    xlogger_SetLevel(kLevelNone);
+
+    std::mutex mutex;
+    uint64_t reported = 0;
+    std::map<std::pair<int, uint32_t>, uint64_t> reported_cmds;
+
+    TrafficStatistics statistics(10 * 1000, 64 * 1024);
+    statistics.SetCallback([&](int32_t _wifi_recv, int32_t _wifi_send, int32_t _mobile_recv, int32_t _mobile_send) {
+        std::lock_guard<std::mutex> lock(mutex);
+        reported += (uint32_t)_wifi_recv + (uint32_t)_wifi_send + (uint32_t)_mobile_recv + (uint32_t)_mobile_send;
+    });
+    statistics.SetCmdCallback([&](const std::vector<TrafficStatistics::CmdTraffic>& _flows) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < _flows.size(); ++i)
+            reported_cmds[std::make_pair(_flows[i].channel, _flows[i].cmdid)] += _flows[i].send + _flows[i].recv;
+    });
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreadCount; ++t) {
+        threads.push_back(std::thread([&statistics, t] {
+            int channel = 0 == t % 2 ? TrafficStatistics::kChannelLong : TrafficStatistics::kChannelShort;
+            for (int i = 0; i < kCallsPerThread; ++i) {
+                unsigned int len = 1 + i % 1400;
+                statistics.Data(len, len);
+                statistics.CmdData(channel, (uint32_t)i % kCmdIdCount, len, len);
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); ++t) threads[t].join();
+    double cost = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    statistics.Flush();
+
+    uint64_t expected = 0;
+    for (int i = 0; i < kCallsPerThread; ++i) expected += 2 * (1 + i % 1400);
+
+    uint64_t reported_cmd_total = 0;
+    size_t other_count = 0;
+    for (std::map<std::pair<int, uint32_t>, uint64_t>::iterator it = reported_cmds.begin(); it != reported_cmds.end(); ++it) {
+        reported_cmd_total += it->second;
+        if (TrafficStatistics::kOtherCmdId == it->first.second) ++other_count;
+    }
+
+    printf("threads:%d calls:%d %.1fns per Data+CmdData, cmdids reported:%zu\n", kThreadCount, kThreadCount * kCallsPerThread,
+           cost / (kThreadCount * kCallsPerThread), reported_cmds.size());
+
+    EXPECT_EQ(expected * kThreadCount, reported);
+    EXPECT_EQ(expected * kThreadCount, reported_cmd_total);
+    EXPECT_EQ(2u, other_count);
+}
@@ -80,6 +80,14 @@ extern uint32_t (*longlink_noop_interval)();
 
 extern bool (*longlink_complexconnect_need_verify)();
 
+/**
+ * session resumption for a longlink reconnecting to the ip it has just lost
+ * _cmdid, _body, _extend: a request handing the server the session of the last connection,
+ *                         it goes out ahead of the queued tasks and stands in for the identify check
+ * return: false if the protocol has no resumption (default), the identify check runs as usual then
+ */
+extern bool (*longlink_resume_req)(uint32_t& _cmdid, AutoBuffer& _body, AutoBuffer& _extend);
+
 /**
  * return: whether the received data is pushing from server or not
  */